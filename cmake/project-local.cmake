@@ -105,6 +105,45 @@ if(NOT ${RCSW_WITHOUT_STDIO})
 
 endif()
 
+# ##############################################################################
+# Abstraction Layer
+# ##############################################################################
+# Should mutexes/semaphores/condition variables be built directly on futexes
+# instead of wrapping pthreads/POSIX semaphores? Only available on linux.
+if(NOT RCSW_CONFIG_AL_FUTEX_SYNC)
+  set(RCSW_CONFIG_AL_FUTEX_SYNC NO)
+endif()
+
+if(RCSW_CONFIG_AL_FUTEX_SYNC AND NOT "${CMAKE_SYSTEM_NAME}" STREQUAL "Linux")
+  message(FATAL_ERROR "RCSW_CONFIG_AL_FUTEX_SYNC requires building for linux")
+endif()
+
+# ##############################################################################
+# Multithreading
+# ##############################################################################
+# Should mutexes/semaphores/reader-writer locks carry contention profiling
+# state, so they can be registered with RCSW_LOCKPROF_REGISTER()?
+if(NOT RCSW_CONFIG_MT_LOCKPROF)
+  set(RCSW_CONFIG_MT_LOCKPROF NO)
+endif()
+
+if(RCSW_CONFIG_MT_LOCKPROF AND NOT "${RCSW_BUILD_FOR}" MATCHES "POSIX")
+  message(FATAL_ERROR "RCSW_CONFIG_MT_LOCKPROF requires building for POSIX")
+endif()
+
+# ##############################################################################
+# Software Bus
+# ##############################################################################
+# Should swbus timestamp packets at reserve/release/receive and keep per-PID
+# latency histograms?
+if(NOT RCSW_CONFIG_SWBUS_TRACE)
+  set(RCSW_CONFIG_SWBUS_TRACE NO)
+endif()
+
+if(RCSW_CONFIG_SWBUS_TRACE AND NOT "${RCSW_BUILD_FOR}" MATCHES "POSIX")
+  message(FATAL_ERROR "RCSW_CONFIG_SWBUS_TRACE requires building for POSIX")
+endif()
+
 # ##############################################################################
 # Event Reporting
 # ##############################################################################
@@ -203,6 +242,16 @@ foreach(config ${RCSW_ONOFF_CONFIG})
   endif()
 endforeach()
 
+# These change the layout of public structs, so they have to be PUBLIC
+set(RCSW_ONOFF_CONFIG_PUBLIC RCSW_CONFIG_AL_FUTEX_SYNC RCSW_CONFIG_MT_LOCKPROF
+                             RCSW_CONFIG_SWBUS_TRACE)
+
+foreach(config ${RCSW_ONOFF_CONFIG_PUBLIC})
+  if(${config})
+    target_compile_definitions(${PROJECT_NAME} PUBLIC ${config})
+  endif()
+endforeach()
+
 set(RCSW_VALUE_CONFIG_PUBLIC RCSW_CONFIG_STDIO_PUTCHAR
                              RCSW_CONFIG_STDIO_GETCHAR RCSW_CONFIG_PTR_ALIGN)
 set(RCSW_VALUE_CONFIG_PRIVATE
@@ -281,6 +330,9 @@ This is a ${RCSW_CONFIG_LIBTYPE} library, built for ${RCSW_BUILD_FOR}:
   * RCSW_CONFIG_NOALLOC=${RCSW_CONFIG_NOALLOC}
   * RCSW_CONFIG_ZALLOC=${RCSW_CONFIG_ZALLOC}
   * RCSW_CONFIG_TOOL_NO_GRIND=${RCSW_CONFIG_TOOL_NO_GRIND}
+  * RCSW_CONFIG_AL_FUTEX_SYNC=${RCSW_CONFIG_AL_FUTEX_SYNC}
+  * RCSW_CONFIG_MT_LOCKPROF=${RCSW_CONFIG_MT_LOCKPROF}
+  * RCSW_CONFIG_SWBUS_TRACE=${RCSW_CONFIG_SWBUS_TRACE}
   * RCSW_WITHOUT_STDIO=${RCSW_WITHOUT_STDIO}
   * RCSW_CONFIG_STDIO_GETCHAR=${RCSW_CONFIG_STDIO_GETCHAR}
   * RCSW_CONFIG_STDIO_PUTCHAR=${RCSW_CONFIG_STDIO_PUTCHAR}
@@ -315,6 +367,9 @@ set(fields
     RCSW_CONFIG_NOALLOC
     RCSW_CONFIG_ZALLOC
     RCSW_CONFIG_TOOL_NO_GRIND
+    RCSW_CONFIG_AL_FUTEX_SYNC
+    RCSW_CONFIG_MT_LOCKPROF
+    RCSW_CONFIG_SWBUS_TRACE
     RCSW_WITHOUT_STDIO
     RCSW_CONFIG_STDIO_GETCHAR
     RCSW_CONFIG_STDIO_PUTCHAR
@@ -366,6 +421,18 @@ rcsw_message(
   STATUS
   "Always zero alloc'd memory before use         : ${ColorBold}${EMIT_RCSW_CONFIG_ZALLOC}${ColorReset} [RCSW_CONFIG_ZALLOC]"
 )
+rcsw_message(
+  STATUS
+  "Futex-based mutexes/semaphores/condvars       : ${ColorBold}${EMIT_RCSW_CONFIG_AL_FUTEX_SYNC}${ColorReset} [RCSW_CONFIG_AL_FUTEX_SYNC]"
+)
+rcsw_message(
+  STATUS
+  "Lock contention profiling                     : ${ColorBold}${EMIT_RCSW_CONFIG_MT_LOCKPROF}${ColorReset} [RCSW_CONFIG_MT_LOCKPROF]"
+)
+rcsw_message(
+  STATUS
+  "SWBUS packet latency tracing                  : ${ColorBold}${EMIT_RCSW_CONFIG_SWBUS_TRACE}${ColorReset} [RCSW_CONFIG_SWBUS_TRACE]"
+)
 rcsw_message(
   STATUS
   "Data pointer alignment                        : ${ColorBold}${EMIT_RCSW_CONFIG_PTR_ALIGN}${ColorReset} [RCSW_CONFIG_PTR_ALIGN={1,2,4}]"
@@ -0,0 +1,20 @@
+/**
+ * \file futex.h
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/al/al.h"
+
+#if RCSW_CONFIG_AL_TARGET == RCSW_AL_TARGET_POSIX
+#include "rcsw/al/posix/futex.h"
+#else
+#error "No supported futex for AL target"
+#endif
@@ -0,0 +1,149 @@
+/**
+ * \file futex.h
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <time.h>
+
+#include "rcsw/rcsw.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Upper bound on the # of times the futex-based synchronization
+ * primitives spin on a contended lock/semaphore before sleeping in the kernel.
+ */
+#define RCSW_FUTEX_SPIN_MAX 256
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Per-lock contention counters for the futex-based synchronization
+ * primitives (see \ref RCSW_CONFIG_AL_FUTEX_SYNC).
+ *
+ * Only updated on slow paths, so uncontended operations don't pay for them.
+ */
+struct futex_stats {
+  /** # of spin iterations spent waiting before acquiring/going to sleep. */
+  size_t n_spins;
+
+  /** # of times a thread went to sleep in the kernel. */
+  size_t n_sleeps;
+
+  /** # of times a thread made a system call to wake up sleepers. */
+  size_t n_wakeups;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Sleep until another thread calls \ref futex_wake() on \p addr, as long
+ * as \p *addr still contains \p val when the kernel checks it.
+ *
+ * Like all futex waits, this can return spuriously: callers must re-check the
+ * condition they are waiting on in a loop. On non-Linux POSIX targets this
+ * yields the CPU instead of sleeping.
+ *
+ * \param addr The futex word.
+ *
+ * \param val The value \p addr is expected to contain.
+ *
+ * \param to An ABSOLUTE timeout relative to \ref clock_monotime(), or NULL to
+ *           wait forever.
+ *
+ * \return \ref status_t. Sets errno to ETIMEDOUT if the timeout expired.
+ */
+RCSW_API status_t futex_wait(uint32_t* addr,
+                             uint32_t val,
+                             const struct timespec* to);
+
+/**
+ * \brief Wake up to \p n threads waiting on \p addr in \ref futex_wait().
+ *
+ * \param addr The futex word.
+ *
+ * \param n # of waiters to wake; INT_MAX to wake all of them.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t futex_wake(uint32_t* addr, int n);
+
+/**
+ * \brief Like \ref futex_wait(), but for a futex word in memory shared between
+ * processes (e.g., via mmap(MAP_SHARED)).
+ *
+ * Slightly more expensive than \ref futex_wait(), as the kernel has to key the
+ * futex on the underlying page rather than the address.
+ */
+RCSW_API status_t futex_wait_shared(uint32_t* addr,
+                                    uint32_t val,
+                                    const struct timespec* to);
+
+/**
+ * \brief Like \ref futex_wake(), but for a futex word in memory shared between
+ * processes.
+ */
+RCSW_API status_t futex_wake_shared(uint32_t* addr, int n);
+
+/**
+ * \brief Get the # of times to spin before sleeping on a contended futex.
+ *
+ * The bound adapts to how long spinning took to succeed recently (as tracked
+ * by \ref futex_spin_update()), so that locks with short critical sections
+ * spin long enough to avoid the kernel, and locks with long ones don't waste
+ * CPU.
+ *
+ * \param est The spin estimate for the lock.
+ */
+static inline uint32_t futex_spin_limit(const uint32_t* const est) {
+  uint32_t limit = 2 * __atomic_load_n(est, __ATOMIC_RELAXED) + 16;
+  return RCSW_MIN(limit, (uint32_t)RCSW_FUTEX_SPIN_MAX);
+}
+
+/**
+ * \brief Update the spin estimate for a lock after spinning.
+ *
+ * \param est The spin estimate for the lock.
+ *
+ * \param n_spins How many times the caller spun.
+ *
+ * \param acquired Did spinning pay off? If not, the estimate decays, so that
+ *                 we spin less next time.
+ */
+static inline void futex_spin_update(uint32_t* const est,
+                                     uint32_t n_spins,
+                                     bool_t acquired) {
+  /* racy, but it is only a heuristic */
+  int32_t cur = (int32_t)__atomic_load_n(est, __ATOMIC_RELAXED);
+  int32_t target = acquired ? (int32_t)n_spins : 0;
+  int32_t diff = target - cur;
+
+  /*
+   * Move 1/8 of the way, rounded away from 0 so that small gaps still close
+   * (otherwise the estimate would get stuck up to 7 away from the target).
+   */
+  int32_t step = (diff + (diff > 0 ? 7 : -7)) / 8;
+  __atomic_store_n(est, (uint32_t)(cur + step), __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Bump one of the \ref futex_stats counters.
+ */
+static inline void futex_stats_add(size_t* const counter, size_t n) {
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+END_C_DECLS
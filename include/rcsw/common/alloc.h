@@ -13,9 +13,35 @@
  ******************************************************************************/
 #include "rcsw/common/common.h"
 
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Where \ref rcsw_alloc() gets memory from when it actually has to
+ * allocate, instead of malloc()/free().
+ */
+struct rcsw_alloc_backend {
+  /**
+   * Allocate \p n_bytes. Does not need to zero the memory.
+   */
+  void* (*alloc)(void* ctx, size_t n_bytes);
+
+  /**
+   * Free memory from \ref rcsw_alloc_backend.alloc.
+   */
+  void (*free)(void* ctx, void* ptr);
+
+  /**
+   * Passed to the callbacks.
+   */
+  void* ctx;
+};
+
 /*******************************************************************************
  * API Functions
  ******************************************************************************/
+BEGIN_C_DECLS
+
 /**
  * \brief Allocate \p n_bytes of memory using malloc()/calloc()/etc.
  *
@@ -41,10 +67,39 @@
  * - \ref RCSW_NOALLOC_HANDLE
  * - \ref RCSW_ZALLOC
  *
+ * Memory comes from the backend set with \ref rcsw_alloc_backend_set(), if
+ * there is one.
  */
-void* rcsw_alloc(void* ptr, size_t n_bytes, uint32_t flags);
+RCSW_API void* rcsw_alloc(void* ptr, size_t n_bytes, uint32_t flags);
+
+/**
+ * \brief Resize memory previously allocated with \ref rcsw_alloc() (without
+ * any RCSW_NOALLOC_XX flags), as realloc() would.
+ *
+ * \param ptr The memory to resize. Can be NULL.
+ * \param old_bytes The current size of \p ptr, so that its contents can be
+ *                  copied if the backend set with \ref
+ *                  rcsw_alloc_backend_set() can't resize in place.
+ * \param n_bytes The new size.
+ *
+ * \return The resized memory, or NULL on failure, in which case \p ptr is
+ * untouched.
+ */
+RCSW_API void* rcsw_realloc(void* ptr, size_t old_bytes, size_t n_bytes);
 
 /**
  * \brief Free memory previously allocated with \ref rcsw_alloc().
  */
-void rcsw_free(void* ptr, uint32_t flags);
+RCSW_API void rcsw_free(void* ptr, uint32_t flags);
+
+/**
+ * \brief Set where \ref rcsw_alloc()/\ref rcsw_free() get memory from.
+ *
+ * Not threadsafe, and memory allocated from a backend must not be freed after
+ * switching away from it, so this should be called once at startup.
+ *
+ * \param backend The backend. NULL to go back to malloc()/free().
+ */
+RCSW_API void rcsw_alloc_backend_set(const struct rcsw_alloc_backend* backend);
+
+END_C_DECLS
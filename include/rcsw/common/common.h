@@ -38,6 +38,24 @@
  */
 #define RCSW_DOUBLE_EPSILON 0.00000000001
 
+/**
+ * \brief Size of a cache line in bytes, for separating data written by
+ * different threads to avoid false sharing. 64 is correct for all x86 and most
+ * ARM targets.
+ */
+#define RCSW_CACHELINE_SIZE 64
+
+/**
+ * \def RCSW_CACHELINE_PAD(name)
+ *
+ * Declare a struct member \c name which is one cache line of padding, so that
+ * the members before and after it are never on the same cache line. Unlike
+ * \c aligned(RCSW_CACHELINE_SIZE), this holds wherever the struct lives, so it
+ * can be allocated via \ref rcsw_alloc() (plain malloc()) or placed in
+ * application-provided memory.
+ */
+#define RCSW_CACHELINE_PAD(name) uint8_t name[RCSW_CACHELINE_SIZE]
+
 /*******************************************************************************
  * String Macros
  ******************************************************************************/
@@ -381,6 +381,18 @@
 #ifndef typeof
 #define typeof __typeof__
 #endif
+
+/**
+ * \def RCSW_CPU_RELAX() Hint to the CPU that the calling thread is in a
+ * spin-wait loop, so it can back off (and be nicer to hyperthread siblings).
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define RCSW_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define RCSW_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define RCSW_CPU_RELAX()
+#endif
 /*******************************************************************************
  * C++ Definitions
  ******************************************************************************/
@@ -127,11 +127,30 @@ enum ds_tag {
  */
 #define RCSW_DS_BINHEAP_MIN  (1 << (RCSW_MODFLAGS_START + 9))
 
+/**
+ * \brief Indicate that a \ref rbuffer should map its storage twice,
+ * back-to-back in virtual memory, so that every readable/writable region of the
+ * ringbuffer is contiguous, even when it wraps around (Linux only).
+ *
+ * Cannot be used with \ref RCSW_NOALLOC_DATA.
+ */
+#define RCSW_DS_RBUFFER_MIRRORED  (1 << (RCSW_MODFLAGS_START + 10))
+
+/**
+ * \brief Indicate that the \ref hashmap should protect its statistics with a
+ * \ref seqlock, so that other threads can take snapshots of them via \ref
+ * hashmap_stats_snapshot() while the hashmap is being modified.
+ *
+ * Each modification of the hashmap costs an extra uncontended mutex
+ * lock/unlock.
+ */
+#define RCSW_DS_HASHMAP_SEQSTATS  (1 << (RCSW_MODFLAGS_START + 11))
+
 /**
  * \brief If you want to define additional flags for derived data structures,
  * start with this one to ensure no conflicts.
  */
-#define RCSW_DS_EXTFLAGS_START 10
+#define RCSW_DS_EXTFLAGS_START 12
 
 /*******************************************************************************
  * RCSW Private Functions
@@ -14,6 +14,7 @@
  ******************************************************************************/
 #include "rcsw/ds/ds.h"
 #include "rcsw/ds/darray.h"
+#include "rcsw/multithread/seqlock.h"
 
 /*******************************************************************************
  * Constant Definitions
@@ -165,6 +166,10 @@ struct hashmap {
    */
   struct hashmap_stats stats;
 
+  /**
+   * Protects \ref hashmap.stats if \ref RCSW_DS_HASHMAP_SEQSTATS is passed.
+   */
+  struct seqlock stats_sl;
 
   /**
    * Number of of successful adds to wait before automatically sorting
@@ -186,6 +191,7 @@ struct hashmap {
    * - \ref RCSW_NOALLOC_DATA.
    * - \ref RCSW_NOALLOC_META.
    * - \ref RCSW_DS_HASHMAP_LINPROB
+   * - \ref RCSW_DS_HASHMAP_SEQSTATS
    * - \ref RCSW_DS_SORTED
    *
    * All other flags are ignored.
@@ -371,6 +377,21 @@ RCSW_API void hashmap_print(const struct hashmap * map);
 RCSW_API status_t hashmap_gather(const struct hashmap * map,
                                  struct hashmap_stats * stats);
 
+/**
+ * \brief Get a consistent snapshot of the hashmap counters (# nodes, adds,
+ * add failures, collisions). Unlike \ref hashmap_gather(), does not look at the
+ * buckets, so with \ref RCSW_DS_HASHMAP_SEQSTATS this is safe to call from any
+ * thread, even while the hashmap is being modified.
+ *
+ * \param map The hashmap handle.
+ * \param stats The statistics to be filled. Fields other than the counters are
+ *              left untouched.
+ *
+ * \return \ref status_t
+ */
+RCSW_API status_t hashmap_stats_snapshot(const struct hashmap * map,
+                                         struct hashmap_stats * stats);
+
 /**
  * \brief Print the hashmap distribution.
  *
@@ -108,7 +108,8 @@ struct multififo_children_mgmt {
  * - \ref multififo_remove()
  *
  * All other functions must be called synchronously or bad things will probably
- * happen.
+ * happen. If the producer and consumers are on different threads, use \ref
+ * bcring instead.
  */
 struct multififo {
   /**
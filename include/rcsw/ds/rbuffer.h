@@ -48,7 +48,9 @@ struct rbuffer_params {
   size_t elt_size;
 
   /**
-   * Maximum number of elements allowed.
+   * Maximum number of elements allowed. If \ref RCSW_DS_RBUFFER_MIRRORED is
+   * passed, this is rounded up so that the ringbuffer occupies a whole number
+   * of pages.
    */
   size_t max_elts;
 
@@ -110,6 +112,7 @@ struct rbuffer {
    * - \ref RCSW_NOALLOC_HANDLE
    * - \ref RCSW_NOALLOC_DATA
    * - \ref RCSW_DS_RBUFFER_AS_FIFO
+   * - \ref RCSW_DS_RBUFFER_MIRRORED
    *
    * All other flags are ignored.
    */
@@ -190,6 +193,14 @@ static inline size_t rbuffer_element_space(size_t max_elts, size_t elt_size) {
 /**
  * \brief Initialize a ringbuffer.
  *
+ * If \ref RCSW_DS_RBUFFER_MIRRORED is passed, the storage for the elements is
+ * obtained from the kernel rather than from \ref rcsw_alloc(), and the same
+ * physical pages are mapped twice, back-to-back, so that the regions returned
+ * by \ref rbuffer_rd_region() and \ref rbuffer_wr_region() never need to be
+ * split at the wraparound point. Sets errno to ENOTSUP if this is not supported
+ * on the current platform, and EINVAL if it is combined with \ref
+ * RCSW_NOALLOC_DATA.
+ *
  * \param rb_in An application allocated handle for the ringbuffer. Can be NULL,
  *        depending on if \ref RCSW_NOALLOC_HANDLE is passed in \ref
  *        rbuffer_params.flags or not.
@@ -338,6 +349,66 @@ RCSW_API status_t rbuffer_inject(struct rbuffer * rb,
                         void (*f)(void *elt, void *res),
                         void *result);
 
+/**
+ * \brief Get the largest contiguous region of valid elements at the front of
+ * the ringbuffer, for reading/parsing in place.
+ *
+ * If \ref RCSW_DS_RBUFFER_MIRRORED was passed during initialization, the
+ * region always contains every element currently in the ringbuffer. Otherwise,
+ * it stops at the end of the underlying array, and the rest of the elements
+ * will be returned by a subsequent call after \ref rbuffer_rd_commit().
+ *
+ * The ringbuffer is not modified.
+ *
+ * \param rb The ringbuffer handle.
+ * \param n_elts Filled with the # of elements in the returned region.
+ *
+ * \return The start of the region, or NULL if the ringbuffer is empty or an
+ * error occurred.
+ */
+RCSW_API void* rbuffer_rd_region(const struct rbuffer* rb, size_t* n_elts);
+
+/**
+ * \brief Remove elements from the front of the ringbuffer after they have been
+ * consumed in place via \ref rbuffer_rd_region().
+ *
+ * \param rb The ringbuffer handle.
+ * \param n_elts # of elements to remove. Must be <= \ref rbuffer_size().
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t rbuffer_rd_commit(struct rbuffer* rb, size_t n_elts);
+
+/**
+ * \brief Get the largest contiguous region of free elements at the back of the
+ * ringbuffer, for writing in place (e.g., via read(2)).
+ *
+ * If \ref RCSW_DS_RBUFFER_MIRRORED was passed during initialization, the
+ * region always covers all free space in the ringbuffer. Otherwise, it stops at
+ * the end of the underlying array.
+ *
+ * The ringbuffer is not modified.
+ *
+ * \param rb The ringbuffer handle.
+ * \param n_elts Filled with the # of elements in the returned region.
+ *
+ * \return The start of the region, or NULL if the ringbuffer is full or an
+ * error occurred.
+ */
+RCSW_API void* rbuffer_wr_region(const struct rbuffer* rb, size_t* n_elts);
+
+/**
+ * \brief Add elements to the back of the ringbuffer after they have been
+ * written in place via \ref rbuffer_wr_region().
+ *
+ * \param rb The ringbuffer handle.
+ * \param n_elts # of elements to add. Must be <= the # of free elements in the
+ * ringbuffer.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t rbuffer_wr_commit(struct rbuffer* rb, size_t n_elts);
+
 /**
  * \brief Print the ringbuffer.
  *
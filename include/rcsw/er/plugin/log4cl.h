@@ -90,6 +90,9 @@
     ekLOG4CL_MT_RADIX,                          \
     ekLOG4CL_MULTIPROCESS,                      \
     ekLOG4CL_CTRL_PID,                          \
+    ekLOG4CL_MT_SLAB,                           \
+    ekLOG4CL_MT_EBR,                            \
+    ekLOG4CL_MT_THREADM,                        \
     ekLOG4CL_EXTERNAL
 
 enum log4cl_module_codes {RCSW_XTABLE_SEQ_ENUM(RCSW_LOG4CL_MODULES)};
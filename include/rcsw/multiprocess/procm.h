@@ -1,7 +1,8 @@
 /**
  * \file procm.h
  * \ingroup multiprocess
- * \brief Useful routines related to fork()/exec() process management.
+ * \brief Useful routines related to fork()/exec() process management, and a
+ * pool for running many short-lived child processes.
  *
  * \copyright 2017 John Harwell, All rights reserved.
  *
@@ -13,7 +14,158 @@
 /*******************************************************************************
  * Includes
  ******************************************************************************/
+#include <poll.h>
+#include <sys/types.h>
+
 #include "rcsw/rcsw.h"
+#include "rcsw/ds/fifo.h"
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Parameters for \ref procm_spawn().
+ */
+struct procm_spawn_params {
+  /**
+   * NULL-terminated argv of the command to run. cmd[0] is the path to the
+   * executable; PATH is not searched.
+   */
+  char* const* cmd;
+
+  /**
+   * NULL-terminated environment for the child, or NULL to inherit the
+   * parent's.
+   */
+  char* const* envp;
+
+  /**
+   * The working directory of the child, or NULL if no change is desired.
+   */
+  const char* new_wd;
+
+  /**
+   * File descriptors to use as the child's stdin/stdout/stderr, or -1 to
+   * inherit the parent's.
+   */
+  int stdin_fd;
+  int stdout_fd;
+  int stderr_fd;
+};
+
+/**
+ * \brief A command to run in a \ref procm_pool, and its results.
+ *
+ * Owned by the application, and must stay valid until it has finished.
+ */
+struct procm_job {
+  /** NULL-terminated argv of the command; cmd[0] is the executable path. */
+  char* const* cmd;
+
+  /** Working directory for the command, or NULL if no change is desired. */
+  const char* new_wd;
+
+  /**
+   * Buffer to collect the command's stdout into. Can be NULL, in which case the
+   * output is discarded. Output past \ref procm_job.output_size is discarded.
+   */
+  char* output;
+
+  /** Size of \ref procm_job.output in bytes. */
+  size_t output_size;
+
+  /** # of bytes of output collected (filled by the pool). */
+  size_t output_len;
+
+  /** PID of the command while it is running (filled by the pool). */
+  pid_t pid;
+
+  /**
+   * Status of the finished command as returned by waitpid(), or -1 if it could
+   * not be started (filled by the pool).
+   */
+  int status;
+};
+
+/**
+ * \brief A running \ref procm_job.
+ */
+struct procm_slot {
+  struct procm_job* job;
+
+  /** Read end of the pipe connected to the child's stdout, or -1 on EOF. */
+  int fd;
+};
+
+/**
+ * \brief \ref procm_pool initialization parameters.
+ */
+struct procm_pool_params {
+  /**
+   * Max # of commands running at once. 0 means the # of online CPUs.
+   */
+  size_t max_procs;
+
+  /**
+   * Max # of jobs which can be waiting to run.
+   */
+  size_t max_jobs;
+
+  /**
+   * Callback run on each job after it finishes. Can be NULL.
+   */
+  void (*done)(struct procm_job* job, void* arg);
+
+  /** Argument passed to \ref procm_pool_params.done. */
+  void* done_arg;
+
+  /**
+   * Configuration flags. See \ref procm_pool.flags for valid flags.
+   */
+  uint32_t flags;
+};
+
+/**
+ * \brief A pool for running many short-lived commands with bounded
+ * concurrency, collecting their output through pipes.
+ *
+ * Commands are started with \ref procm_spawn(), so starting one doesn't
+ * depend on how much memory the parent has mapped, unlike \ref
+ * procm_fork_exec(). Jobs beyond \ref procm_pool.max_procs are queued, and
+ * started as running ones finish.
+ *
+ * The pool makes progress when the application calls into it: there is no
+ * background thread, and the pool is not threadsafe.
+ */
+struct procm_pool {
+  /** Jobs waiting to run: a FIFO of \ref procm_job pointers. */
+  struct fifo queue;
+
+  /** Running jobs; the first \ref procm_pool.n_running are in use. */
+  struct procm_slot* slots;
+
+  /** For poll()ing the pipes of running jobs. */
+  struct pollfd* pfds;
+
+  /** Max # of commands running at once. */
+  size_t max_procs;
+
+  /** # of commands currently running. */
+  size_t n_running;
+
+  /** Job completion callback. */
+  void (*done)(struct procm_job* job, void* arg);
+  void* done_arg;
+
+  /**
+   * Run time configuration flags. Valid flags are:
+   *
+   * - \ref RCSW_NOALLOC_HANDLE
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+};
 
 /*******************************************************************************
  * Function Prototypes
@@ -43,4 +195,87 @@ status_t procm_socket_lock(int socket);
 pid_t procm_fork_exec(char** const cmd, const char* new_wd,
                       bool_t stdout_sup, int* pipefd);
 
+/**
+ * \brief Start a command in a child process without fork()ing.
+ *
+ * Uses posix_spawn(), which doesn't copy the parent's page tables, so the cost
+ * of starting a command doesn't grow with the parent's size. If a working
+ * directory change is requested, vfork()/exec() is used instead. Either way,
+ * failing to exec() the command is reported here, not as a child exit status.
+ *
+ * \param params The command and how to run it.
+ *
+ * \return The pid of the child, or -1 if an ERROR occurred.
+ */
+pid_t procm_spawn(const struct procm_spawn_params* params);
+
+/**
+ * \brief Initialize a \ref procm_pool.
+ *
+ * \param pool_in The pool handle. Can be NULL, depending on if \ref
+ *                RCSW_NOALLOC_HANDLE is passed or not.
+ * \param params Initialization parameters.
+ *
+ * \return The initialized pool, or NULL if an ERROR occurred.
+ */
+struct procm_pool* procm_pool_init(
+    struct procm_pool* pool_in,
+    const struct procm_pool_params* params) RCSW_WUR;
+
+/**
+ * \brief Destroy a \ref procm_pool, waiting for all queued and running jobs to
+ * finish first.
+ *
+ * \param pool The pool.
+ */
+void procm_pool_destroy(struct procm_pool* pool);
+
+/**
+ * \brief Add a job to a \ref procm_pool, starting it right away if fewer than
+ * \ref procm_pool.max_procs commands are running.
+ *
+ * If the queue is full, this waits for running jobs to finish to make room.
+ *
+ * \param pool The pool.
+ * \param job The job to run.
+ *
+ * \return \ref status_t.
+ */
+status_t procm_pool_submit(struct procm_pool* pool, struct procm_job* job);
+
+/**
+ * \brief Collect output from running jobs, reap finished ones, and start queued
+ * ones in their place.
+ *
+ * \param pool The pool.
+ * \param timeout_ms Max time to wait for something to happen; 0 to not wait,
+ *                   -1 to wait until at least one job finishes (if there are
+ *                   any).
+ *
+ * \return # of jobs which finished.
+ */
+size_t procm_pool_poll(struct procm_pool* pool, int timeout_ms);
+
+/**
+ * \brief Wait for all queued and running jobs in a \ref procm_pool to
+ * finish.
+ *
+ * \param pool The pool.
+ *
+ * \return \ref status_t.
+ */
+status_t procm_pool_wait(struct procm_pool* pool);
+
+/**
+ * \brief Get the # of jobs in a \ref procm_pool which have not finished.
+ *
+ * \param pool The pool.
+ *
+ * \return # of queued + running jobs.
+ */
+static inline size_t procm_pool_pending(const struct procm_pool* const pool) {
+  RCSW_FPC_NV(0, NULL != pool);
+  return fifo_size(&pool->queue) + pool->n_running;
+}
+
 END_C_DECLS
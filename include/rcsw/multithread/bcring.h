@@ -0,0 +1,317 @@
+/**
+ * \file bcring.h
+ * \ingroup multithread
+ * \brief Lock-free single-producer, multi-consumer broadcast ring.
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/common/common.h"
+#include "rcsw/common/fpc.h"
+#include "rcsw/common/flags.h"
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Parameters for \ref bcring.
+ */
+struct bcring_params {
+  /**
+   * Pointer to application-allocated space for storing data managed by the
+   * \ref bcring. Ignored unless \ref RCSW_NOALLOC_DATA is passed.
+   */
+  dptr_t* elements;
+
+  /**
+   * Pointer to application-allocated space for storing consumer
+   * state. Ignored unless \ref RCSW_NOALLOC_META is passed.
+   */
+  dptr_t* meta;
+
+  /**
+   * Size of the elements in the ring in bytes.
+   */
+  size_t elt_size;
+
+  /**
+   * Maximum number of elements in the ring.
+   */
+  size_t max_elts;
+
+  /**
+   * The # of consumers. Can be 0, in which case everything which is added is
+   * immediately discarded.
+   */
+  size_t n_consumers;
+
+  /**
+   * The size in bytes of the chunks which each consumer reads elements in. Must
+   * evenly divide \ref bcring_params.elt_size. If NULL, all consumers read
+   * whole elements.
+   */
+  size_t* chunks;
+
+  /**
+   * Configuration flags. See \ref bcring.flags for valid flags.
+   */
+  uint32_t flags;
+};
+
+/**
+ * \brief Per-consumer state, on its own cache line so that consumers don't
+ * false share with each other or with the producer.
+ */
+struct bcring_consumer {
+  RCSW_CACHELINE_PAD(pad);
+
+  /**
+   * # of chunks this consumer has read. This is a monotonic counter; the
+   * element it is in is this value divided by \ref bcring_consumer.n_chunks.
+   * Only written by the consumer, read by the producer.
+   */
+  size_t cursor;
+
+  /**
+   * Last seen value of \ref bcring_producer.tail, so that the producer's cache
+   * line only has to be read when the ring appears empty.
+   */
+  size_t cached;
+
+  /**
+   * Size of the chunks this consumer reads in bytes.
+   */
+  size_t chunk_size;
+
+  /**
+   * # chunks per element.
+   */
+  size_t n_chunks;
+};
+
+/**
+ * \brief Producer state, on its own cache line.
+ */
+struct bcring_producer {
+  RCSW_CACHELINE_PAD(pad);
+
+  /**
+   * Index of the next element to add. This is a monotonic counter; the
+   * position in the array is this value modulo the ring capacity.
+   */
+  size_t tail;
+
+  /**
+   * Last computed value of the index of the oldest element which some consumer
+   * still has not finished reading, so that the consumer cursors only have to
+   * be scanned when the ring appears full.
+   */
+  size_t head;
+};
+
+/**
+ * \brief A ring buffer where every element added is seen by every consumer.
+ *
+ * One producer adds elements; each of an arbitrary number of consumers reads
+ * them in its own chunk size (e.g., the producer adds 64 byte packets, one
+ * consumer reads them 1 byte at a time, another 16 bytes at a time). All data
+ * lives in one buffer: each consumer just has a cursor into it, and a slot is
+ * reused once all consumers have moved past it. Nothing is copied unless a
+ * consumer asks for a copy via \ref bcring_remove().
+ *
+ * Adding and removing take no locks: the producer publishes elements with a
+ * release store, and consumers release their slots the same way. The producer
+ * can be on a different thread than any of the consumers, and all consumers
+ * can be on different threads. Calling \ref bcring_add() from more than one
+ * thread, or the consumer functions for a given consumer from more than one
+ * thread, is undefined.
+ *
+ * Neither side ever waits; callers which need to should poll (the functions
+ * are cheap enough to do this from a periodic ISR/tick) or pair the ring with
+ * a semaphore.
+ *
+ * This is the thread safe counterpart of \ref multififo.
+ */
+struct bcring {
+  /**
+   * The element storage.
+   */
+  dptr_t* elements;
+
+  /**
+   * Size of elements in bytes.
+   */
+  size_t elt_size;
+
+  /**
+   * Maximum number of elements in the ring.
+   */
+  size_t max_elts;
+
+  /**
+   * Per-consumer state.
+   */
+  struct bcring_consumer* consumers;
+
+  /**
+   * # of consumers.
+   */
+  size_t n_consumers;
+
+  /**
+   * Run-time configuration parameters. Valid flags are:
+   *
+   * - \ref RCSW_ZALLOC
+   * - \ref RCSW_NOALLOC_HANDLE
+   * - \ref RCSW_NOALLOC_DATA
+   * - \ref RCSW_NOALLOC_META
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+
+  /**
+   * Producer state.
+   */
+  struct bcring_producer prod;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Get the ring capacity.
+ *
+ * \param ring The ring handle.
+ *
+ * \return Capacity of the ring, or 0 on ERROR.
+ */
+static inline size_t bcring_capacity(const struct bcring* const ring) {
+  RCSW_FPC_NV(0, NULL != ring);
+  return ring->max_elts;
+}
+
+/**
+ * \brief Determine the # of chunks a consumer has not read yet. The value
+ * returned by this function is only a snapshot in a multi-threaded context.
+ *
+ * \param ring The ring handle.
+ * \param id The consumer.
+ *
+ * \return # unread chunks, or 0 on ERROR.
+ */
+static inline size_t bcring_consumer_size(const struct bcring* const ring,
+                                          size_t id) {
+  RCSW_FPC_NV(0, NULL != ring, id < ring->n_consumers);
+  const struct bcring_consumer* consumer = &ring->consumers[id];
+  size_t tail = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+  return tail * consumer->n_chunks -
+      __atomic_load_n(&consumer->cursor, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * \brief Calculate the # of bytes that the ring will require if \ref
+ * RCSW_NOALLOC_DATA is passed to manage a specified # of elements of a
+ * specified size.
+ *
+ * \param max_elts # of desired elements the ring will hold.
+ * \param elt_size size of elements in bytes.
+ *
+ * \return The total # of bytes the application would need to allocate.
+ */
+static inline size_t bcring_element_space(size_t max_elts, size_t elt_size) {
+  return max_elts * elt_size;
+}
+
+/**
+ * \brief Calculate the # of bytes that the ring will require if \ref
+ * RCSW_NOALLOC_META is passed to manage a specified # of consumers.
+ *
+ * \param n_consumers # of consumers.
+ *
+ * \return The total # of bytes the application would need to allocate.
+ */
+static inline size_t bcring_meta_space(size_t n_consumers) {
+  return sizeof(struct bcring_consumer) * n_consumers;
+}
+
+/**
+ * \brief Initialize a broadcast ring.
+ *
+ * \param ring_in An application allocated handle for the ring. Cannot be NULL
+ *                if \ref RCSW_NOALLOC_HANDLE is passed in \ref
+ *                bcring_params.flags.
+ *
+ * \param params The initialization parameters.
+ *
+ * \return The initialized ring, or NULL if an error occurred.
+ */
+RCSW_API struct bcring* bcring_init(struct bcring* ring_in,
+                                    const struct bcring_params* params) RCSW_WUR;
+
+/**
+ * \brief Destroy a broadcast ring.
+ *
+ * Any further use of the ring after this function is called is undefined.
+ *
+ * \param ring The ring to destroy.
+ */
+RCSW_API void bcring_destroy(struct bcring* ring);
+
+/**
+ * \brief Determine # elements currently in the ring, i.e., which at least one
+ * consumer has not finished reading. Producer only.
+ *
+ * \param ring The ring handle.
+ *
+ * \return # elements in the ring, or 0 on ERROR.
+ */
+RCSW_API size_t bcring_size(struct bcring* ring);
+
+/**
+ * \brief Add an element to the ring, making it visible to all consumers.
+ * Producer only.
+ *
+ * \param ring The ring handle.
+ * \param e The element to add. Cannot be NULL.
+ *
+ * \return \ref status_t. Sets errno to EAGAIN if the ring is full, i.e., the
+ * slowest consumer has not finished reading the oldest element.
+ */
+RCSW_API status_t bcring_add(struct bcring* ring, const void* e);
+
+/**
+ * \brief Get a reference to the next chunk a consumer has not read yet,
+ * without consuming it.
+ *
+ * \param ring The ring handle.
+ * \param id The consumer.
+ *
+ * \return The chunk, or NULL if the consumer has read everything.
+ */
+RCSW_API void* bcring_front(struct bcring* ring, size_t id);
+
+/**
+ * \brief Consume the next chunk a consumer has not read yet.
+ *
+ * \param ring The ring handle.
+ * \param id The consumer.
+ * \param e To be filled with a copy of the chunk. Can be NULL, in which case
+ *          the chunk is just skipped (e.g., after it was processed in place via
+ *          \ref bcring_front()).
+ *
+ * \return \ref status_t. Sets errno to EAGAIN if the consumer has read
+ * everything.
+ */
+RCSW_API status_t bcring_remove(struct bcring* ring, size_t id, void* e);
+
+END_C_DECLS
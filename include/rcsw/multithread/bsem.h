@@ -27,11 +27,26 @@
  * Currently supports:
  *
  * - Non-POSIX (not part of POSIX standard for various reasons)
+ * - Linux futexes, if \ref RCSW_CONFIG_AL_FUTEX_SYNC is defined.
  */
 struct bsem {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  /** The semaphore value (0/1); also the futex word waiters sleep on. */
+  uint32_t val;
+
+  /** # of threads sleeping (or about to), so posts can skip the wakeup. */
+  uint32_t n_waiters;
+
+  /** Adaptive spin estimate; see \ref futex_spin_limit(). */
+  uint32_t spin_est;
+
+  /** Contention counters. */
+  struct futex_stats stats;
+#else
   struct mutex mtx;
   struct condv cv;
   bool_t val;
+#endif
 
   /**
    * \brief Configuration flags.
@@ -111,4 +126,18 @@ RCSW_API status_t  bsem_timedwait(struct bsem * sem,
  */
 RCSW_API status_t bsem_wait(struct bsem * sem);
 
+/**
+ * \brief Get the contention counters for a binary semaphore.
+ *
+ * \param sem The semaphore handle.
+ *
+ * \param stats The counters (output parameter). Zeroed if the counters are not
+ *              available.
+ *
+ * \return \ref status_t. ERROR if \ref RCSW_CONFIG_AL_FUTEX_SYNC is not
+ * defined.
+ */
+RCSW_API status_t bsem_stats_get(const struct bsem * sem,
+                                 struct futex_stats* stats);
+
 END_C_DECLS
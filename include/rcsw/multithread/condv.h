@@ -27,9 +27,24 @@
  * Currently supports:
  *
  * - POSIX condition variables
+ * - Linux futexes, if \ref RCSW_CONFIG_AL_FUTEX_SYNC is defined.
  */
 struct condv {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  /**
+   * Bumped on every signal/broadcast; waiters sleep until it changes from the
+   * value they saw while still holding the mutex.
+   */
+  uint32_t seq;
+
+  /** # of threads sleeping (or about to), so signals can skip the wakeup. */
+  uint32_t n_waiters;
+
+  /** Contention counters. Condition variables never spin. */
+  struct futex_stats stats;
+#else
   pthread_cond_t impl;
+#endif
 
   /**
    * Valid flags are:
@@ -116,4 +131,18 @@ RCSW_API status_t condv_timedwait(struct condv* cv,
                         struct mutex* mtx,
                         const struct timespec * to);
 
+/**
+ * \brief Get the contention counters for a condition variable.
+ *
+ * \param cv The cv handle.
+ *
+ * \param stats The counters (output parameter). Zeroed if the counters are not
+ *              available.
+ *
+ * \return \ref status_t. ERROR if \ref RCSW_CONFIG_AL_FUTEX_SYNC is not
+ * defined.
+ */
+RCSW_API status_t condv_stats_get(const struct condv* cv,
+                                  struct futex_stats* stats);
+
 END_C_DECLS
@@ -16,6 +16,8 @@
 
 #include "rcsw/multithread/mutex.h"
 #include "rcsw/rcsw.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/multithread/lockprof.h"
 
 /*******************************************************************************
  * Type Definitions
@@ -26,9 +28,29 @@
  * Currently supports:
  *
  * - POSIX
+ * - Linux futexes, if \ref RCSW_CONFIG_AL_FUTEX_SYNC is defined.
  */
 struct csem {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  /** The semaphore value; also the futex word waiters sleep on. */
+  uint32_t val;
+
+  /** # of threads sleeping (or about to), so posts can skip the wakeup. */
+  uint32_t n_waiters;
+
+  /** Adaptive spin estimate; see \ref futex_spin_limit(). */
+  uint32_t spin_est;
+
+  /** Contention counters. */
+  struct futex_stats stats;
+#else
   sem_t impl;
+#endif
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  /** Contention profiling; see \ref RCSW_LOCKPROF_REGISTER(). */
+  struct lockprof prof;
+#endif
 
   /**
    * Valid flags are:
@@ -78,6 +100,20 @@ RCSW_API void csem_destroy(struct csem * sem);
  */
 RCSW_API status_t csem_post(struct csem * sem);
 
+/**
+ * \brief Increment (unlock) a counting semaphore \p n times at once.
+ *
+ * With \ref RCSW_CONFIG_AL_FUTEX_SYNC this is a single atomic add, plus a
+ * single wakeup call if there are waiters. Otherwise it posts \p n times.
+ *
+ * \param sem The semaphore handle.
+ *
+ * \param n The amount to increment by.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t csem_post_n(struct csem * sem, size_t n);
+
 /**
  * Wait on a counting semaphore with a timeout.
  *
@@ -111,4 +147,33 @@ RCSW_API status_t csem_wait(struct csem *sem);
  */
 RCSW_API status_t csem_trywait(struct csem *sem);
 
+/**
+ * \brief Decrement a counting semaphore by as much as possible, up to \p
+ * max, without waiting.
+ *
+ * With \ref RCSW_CONFIG_AL_FUTEX_SYNC this is a single CAS (retried only if it
+ * races). Otherwise it tries to wait up to \p max times.
+ *
+ * \param sem The semaphore handle.
+ *
+ * \param max The max amount to decrement by.
+ *
+ * \return The amount the semaphore was decremented by; 0 if it was 0.
+ */
+RCSW_API size_t csem_trywait_n(struct csem *sem, size_t max);
+
+/**
+ * \brief Get the contention counters for a counting semaphore.
+ *
+ * \param sem The semaphore handle.
+ *
+ * \param stats The counters (output parameter). Zeroed if the counters are not
+ *              available.
+ *
+ * \return \ref status_t. ERROR if \ref RCSW_CONFIG_AL_FUTEX_SYNC is not
+ * defined.
+ */
+RCSW_API status_t csem_stats_get(const struct csem *sem,
+                                 struct futex_stats* stats);
+
 END_C_DECLS
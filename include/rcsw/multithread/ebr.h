@@ -0,0 +1,365 @@
+/**
+ * \file ebr.h
+ * \ingroup multithread
+ * \brief Epoch-based memory reclamation for lock-free data structures.
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <pthread.h>
+#include <time.h>
+
+#include "rcsw/rcsw.h"
+#include "rcsw/common/fpc.h"
+#include "rcsw/common/flags.h"
+#include "rcsw/multithread/mutex.h"
+#include "rcsw/multithread/csem.h"
+#include "rcsw/multithread/mpool.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Run a background thread which reclaims retired memory every \ref
+ * ebr_params.period, so that it is freed even if the retiring threads never
+ * retire anything else.
+ */
+#define RCSW_EBR_RECLAIMER (1 << (RCSW_MODFLAGS_START + 0))
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Epoch-based reclamation initialization parameters.
+ */
+struct ebr_params {
+  /**
+   * Pointer to application-allocated space for the per-thread records. See
+   * \ref ebr_meta_space(). Ignored unless \ref RCSW_NOALLOC_META is passed.
+   */
+  dptr_t* meta;
+
+  /**
+   * Pointer to application-allocated space for the retire lists. See \ref
+   * ebr_element_space(). Ignored unless \ref RCSW_NOALLOC_DATA is passed.
+   */
+  dptr_t* elements;
+
+  /** Max # of threads which can be registered at once. */
+  size_t max_threads;
+
+  /** Max # of retired objects each thread can have waiting to be reclaimed. */
+  size_t retire_max;
+
+  /** How often the reclaimer runs with \ref RCSW_EBR_RECLAIMER. */
+  struct timespec period;
+
+  /**
+   * Configuration flags. See \ref ebr.flags for valid flags.
+   */
+  uint32_t flags;
+};
+
+/**
+ * \brief An object which has been unlinked from a data structure, but which
+ * readers might still be looking at.
+ */
+struct ebr_retired {
+  /** The object. */
+  void* ptr;
+
+  /** Called to free \ref ebr_retired.ptr once no reader can see it. */
+  void (*reclaim)(void* ctx, void* ptr);
+
+  /** Passed to \ref ebr_retired.reclaim. */
+  void* ctx;
+
+  /** Global epoch when the object was retired. */
+  uint64_t epoch;
+};
+
+/**
+ * \brief Per-thread state; obtained via \ref ebr_register().
+ */
+struct ebr_rec {
+  RCSW_CACHELINE_PAD(pad);
+
+  /**
+   * The global epoch when the thread entered its current critical section, or
+   * 0 if it is not in one. Written only by the owning thread.
+   */
+  uint64_t epoch;
+
+  /** Critical section nesting depth. Only touched by the owning thread. */
+  size_t nesting;
+
+  /** Non-zero if the record belongs to a registered thread. */
+  uint32_t in_use;
+
+  /**
+   * Protects the retire list, which the owning thread appends to and the
+   * reclaimer frees from.
+   */
+  struct mutex mtx;
+
+  /** The retire list. */
+  struct ebr_retired* retired;
+
+  /** # entries in \ref ebr_rec.retired. */
+  size_t n_retired;
+
+  /** The parent instance. */
+  struct ebr* ebr;
+};
+
+/**
+ * \brief Epoch-based memory reclamation (EBR).
+ *
+ * Lets lock-free data structures free memory which concurrent readers might
+ * still hold pointers to. Readers bracket each access to the data structure
+ * with \ref ebr_enter()/\ref ebr_exit(), which only write to the thread's own
+ * record. Writers unlink an object so new readers can't find it, and then \ref
+ * ebr_retire() it. The object is actually freed once the global epoch has
+ * advanced twice, which can only happen after every reader which was in a
+ * critical section at the time of the retire has left it.
+ *
+ * Can also be used for quiescent state based reclamation (QSBR): threads stay
+ * in a critical section permanently, and call \ref ebr_quiescent() whenever
+ * they hold no references into the protected data structures (e.g., at the top
+ * of their event loop), making reads free.
+ */
+struct ebr {
+  RCSW_CACHELINE_PAD(pad);
+
+  /** The global epoch. Starts at 1; 0 marks a quiescent thread. */
+  uint64_t epoch;
+
+  /** Per-thread records. */
+  struct ebr_rec* recs;
+
+  /** Space for all the retire lists. */
+  struct ebr_retired* retired;
+
+  /** Max # registered threads. */
+  size_t max_threads;
+
+  /** Max # retired objects per thread. */
+  size_t retire_max;
+
+  /** How often the reclaimer runs. */
+  struct timespec period;
+
+  /** The reclaimer thread, with \ref RCSW_EBR_RECLAIMER. */
+  pthread_t reclaimer;
+
+  /** Posted to stop the reclaimer. */
+  struct csem stop;
+
+  /**
+   * Run time configuration flags. Valid flags are:
+   *
+   * - \ref RCSW_ZALLOC
+   * - \ref RCSW_NOALLOC_HANDLE
+   * - \ref RCSW_NOALLOC_DATA
+   * - \ref RCSW_NOALLOC_META
+   * - \ref RCSW_EBR_RECLAIMER
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Get # of bytes needed for the per-thread records.
+ *
+ * \param max_threads Max # of registered threads.
+ *
+ * \return The # of bytes the application would need to allocate.
+ */
+static inline size_t ebr_meta_space(size_t max_threads) {
+  return max_threads * sizeof(struct ebr_rec);
+}
+
+/**
+ * \brief Get # of bytes needed for the retire lists.
+ *
+ * \param max_threads Max # of registered threads.
+ * \param retire_max Max # of retired objects per thread.
+ *
+ * \return The # of bytes the application would need to allocate.
+ */
+static inline size_t ebr_element_space(size_t max_threads, size_t retire_max) {
+  return max_threads * retire_max * sizeof(struct ebr_retired);
+}
+
+/**
+ * \brief Enter a critical section, after which pointers read from protected
+ * data structures stay valid until the matching \ref ebr_exit(). Can be
+ * nested.
+ *
+ * \param rec The calling thread's record.
+ */
+static inline void ebr_enter(struct ebr_rec* const rec) {
+  if (0 == rec->nesting++) {
+    __atomic_store_n(&rec->epoch,
+                     __atomic_load_n(&rec->ebr->epoch, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELAXED);
+    /* announce the epoch BEFORE reading any protected pointers */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  }
+}
+
+/**
+ * \brief Exit a critical section. Pointers read from protected data structures
+ * must not be used afterwards.
+ *
+ * \param rec The calling thread's record.
+ */
+static inline void ebr_exit(struct ebr_rec* const rec) {
+  if (0 == --rec->nesting) {
+    __atomic_store_n(&rec->epoch, 0, __ATOMIC_RELEASE);
+  }
+}
+
+/**
+ * \brief Announce a quiescent state: the calling thread holds no pointers read
+ * from protected data structures, even though it is in a critical section
+ * (QSBR-style usage).
+ *
+ * \param rec The calling thread's record.
+ */
+static inline void ebr_quiescent(struct ebr_rec* const rec) {
+  __atomic_store_n(&rec->epoch,
+                   __atomic_load_n(&rec->ebr->epoch, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * \brief Initialize an epoch-based reclamation instance.
+ *
+ * \param ebr_in An application allocated handle. Can be NULL, depending on if
+ *               \ref RCSW_NOALLOC_HANDLE is passed or not.
+ *
+ * \param params The initialization parameters.
+ *
+ * \return The initialized instance, or NULL if an error occurred.
+ */
+RCSW_API struct ebr* ebr_init(struct ebr* ebr_in,
+                              const struct ebr_params* params) RCSW_WUR;
+
+/**
+ * \brief Destroy an epoch-based reclamation instance, reclaiming everything
+ * which is still retired.
+ *
+ * No thread can be in a critical section when this is called. Any further use
+ * of the handle after calling this function is undefined.
+ *
+ * \param the_ebr The handle.
+ */
+RCSW_API void ebr_destroy(struct ebr* the_ebr);
+
+/**
+ * \brief Register the calling thread.
+ *
+ * \param the_ebr The handle.
+ *
+ * \return The thread's record, or NULL if \ref ebr_params.max_threads threads
+ * are already registered.
+ */
+RCSW_API struct ebr_rec* ebr_register(struct ebr* the_ebr) RCSW_WUR;
+
+/**
+ * \brief Unregister a thread. Anything it retired which has not been reclaimed
+ * yet will be reclaimed later by another thread/the reclaimer.
+ *
+ * \param rec The thread's record. Must not be in a critical section.
+ */
+RCSW_API void ebr_unregister(struct ebr_rec* rec);
+
+/**
+ * \brief Retire an object which has been unlinked from a protected data
+ * structure, so that it will be reclaimed once no reader can see it any more.
+ *
+ * If the thread's retire list is full, tries to reclaim first.
+ *
+ * \param rec The calling thread's record.
+ * \param ptr The object.
+ * \param reclaim Called to free the object.
+ * \param ctx Passed to \p reclaim.
+ *
+ * \return \ref status_t. ERROR (errno set to ENOMEM) if the retire list is
+ * still full after trying to reclaim, in which case the object is still owned
+ * by the caller.
+ */
+RCSW_API status_t ebr_retire(struct ebr_rec* rec,
+                             void* ptr,
+                             void (*reclaim)(void* ctx, void* ptr),
+                             void* ctx);
+
+/**
+ * \brief Make sure there is room on a thread's retire list, reclaiming first
+ * if it is full. Only the owning thread adds to the list, so its next \ref
+ * ebr_retire() will then succeed.
+ *
+ * Lets an object be retired without fail after it has been unlinked, by
+ * checking before it is unlinked.
+ *
+ * \param rec The calling thread's record.
+ *
+ * \return \ref status_t. ERROR (errno set to ENOMEM) if the retire list is
+ * still full after trying to reclaim.
+ */
+RCSW_API status_t ebr_retire_reserve(struct ebr_rec* rec);
+
+/**
+ * \brief Retire an object allocated with \ref rcsw_alloc(); it will be freed
+ * with \ref rcsw_free().
+ *
+ * \param rec The calling thread's record.
+ * \param ptr The object.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t ebr_retire_free(struct ebr_rec* rec, void* ptr);
+
+/**
+ * \brief Retire a chunk from an \ref mpool; it will be released with \ref
+ * mpool_release().
+ *
+ * \param rec The calling thread's record.
+ * \param pool The pool the chunk came from.
+ * \param ptr The chunk.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t ebr_retire_mpool(struct ebr_rec* rec,
+                                   struct mpool* pool,
+                                   void* ptr);
+
+/**
+ * \brief Try to advance the global epoch, and reclaim everything retired by
+ * any thread which is now safe to reclaim.
+ *
+ * If called from inside a critical section, the epoch can't advance past the
+ * caller's, so less will be reclaimed.
+ *
+ * \param the_ebr The handle.
+ *
+ * \return # of objects reclaimed.
+ */
+RCSW_API size_t ebr_reclaim(struct ebr* the_ebr);
+
+END_C_DECLS
@@ -0,0 +1,215 @@
+/**
+ * \file lockprof.h
+ * \ingroup multithread
+ * \brief Opt-in lock contention profiling for the multithread primitives.
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <time.h>
+
+#include "rcsw/rcsw.h"
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+/**
+ * \brief Register a \ref mutex, \ref csem, or \ref rdwrlock for profiling
+ * under \p name. Compiles to nothing without \ref RCSW_CONFIG_MT_LOCKPROF.
+ */
+#define RCSW_LOCKPROF_REGISTER(lock, name) \
+  lockprof_register(&(lock)->prof, name)
+
+/**
+ * \brief Unregister a lock; locks are also unregistered when destroyed.
+ * Compiles to nothing without \ref RCSW_CONFIG_MT_LOCKPROF.
+ */
+#define RCSW_LOCKPROF_UNREGISTER(lock) lockprof_unregister(&(lock)->prof)
+#else
+#define RCSW_LOCKPROF_REGISTER(lock, name)
+#define RCSW_LOCKPROF_UNREGISTER(lock)
+#endif
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Max length of lock names, including the NULL terminator.
+ */
+#define RCSW_LOCKPROF_NAMELEN 32
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Contention statistics for a single lock. All times are in
+ * nanoseconds.
+ */
+struct lockprof_stats {
+  /** # of times the lock was acquired. */
+  size_t n_acquires;
+
+  /** # of acquisitions which could not take the fast path and had to wait. */
+  size_t n_contended;
+
+  /** Total time spent waiting to acquire the lock. */
+  uint64_t wait_total;
+
+  /** Longest single wait to acquire the lock. */
+  uint64_t wait_max;
+
+  /**
+   * Total time the lock was held. Only tracked for exclusive holders (\ref
+   * mutex, \ref rdwrlock writers); semaphores are not "held" by anyone.
+   */
+  uint64_t hold_total;
+
+  /** Longest single hold of the lock. */
+  uint64_t hold_max;
+};
+
+/**
+ * \brief Per-lock profiling state, embedded in each lock when \ref
+ * RCSW_CONFIG_MT_LOCKPROF is defined.
+ *
+ * Locks which have not been registered are not profiled, and only pay for a
+ * single branch on acquire/release.
+ */
+struct lockprof {
+  /** Name in the registry; empty if the lock is not registered. */
+  char name[RCSW_LOCKPROF_NAMELEN];
+
+  /** The statistics. Updated with relaxed atomics. */
+  struct lockprof_stats stats;
+
+  /**
+   * When the current exclusive holder acquired the lock, or 0 if it is not
+   * held or was acquired before the lock was registered.
+   */
+  uint64_t acquired_at;
+
+  /** Next lock in the registry. */
+  struct lockprof* next;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Is a lock being profiled?
+ */
+static inline bool_t lockprof_enabled(const struct lockprof* const prof) {
+  return '\0' != prof->name[0];
+}
+
+/**
+ * \brief Get a monotonic timestamp for profiling, in nanoseconds.
+ */
+static inline uint64_t lockprof_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * \brief Initialize the profiling state for a lock (unregistered).
+ */
+static inline void lockprof_init(struct lockprof* const prof) {
+  prof->name[0] = '\0';
+  prof->next = NULL;
+}
+
+/**
+ * \brief Record an acquisition of a lock.
+ *
+ * \param prof The lock's profiling state.
+ *
+ * \param contended Did the acquirer have to wait?
+ *
+ * \param start When the acquirer started waiting for the lock (\ref
+ *              lockprof_now()). Only read if \p contended, so uncontended
+ *              acquirers need not read the clock.
+ *
+ * \param exclusive Is the acquirer an exclusive holder, whose hold time should
+ *                  be tracked?
+ */
+RCSW_API void lockprof_acquired(struct lockprof* prof,
+                                bool_t contended,
+                                uint64_t start,
+                                bool_t exclusive);
+
+/**
+ * \brief Record the release of a lock by its exclusive holder.
+ *
+ * \param prof The lock's profiling state.
+ */
+RCSW_API void lockprof_released(struct lockprof* prof);
+
+/**
+ * \brief Register a lock in the global registry and start profiling it. Its
+ * statistics are reset.
+ *
+ * \param prof The lock's profiling state.
+ *
+ * \param name The name to register the lock under. Truncated to \ref
+ *             RCSW_LOCKPROF_NAMELEN - 1 characters. Need not be unique, but
+ *             \ref lockprof_lookup() will only find the most recently
+ *             registered lock with a given name.
+ *
+ * \return \ref status_t. ERROR if the lock is already registered.
+ */
+RCSW_API status_t lockprof_register(struct lockprof* prof, const char* name);
+
+/**
+ * \brief Stop profiling a lock and remove it from the registry. Does nothing if
+ * the lock is not registered.
+ *
+ * \param prof The lock's profiling state.
+ */
+RCSW_API void lockprof_unregister(struct lockprof* prof);
+
+/**
+ * \brief Get a snapshot of the statistics for a registered lock.
+ *
+ * \param name The name the lock was registered under.
+ *
+ * \param stats The statistics (output parameter).
+ *
+ * \return \ref status_t. ERROR if no lock is registered under \p name.
+ */
+RCSW_API status_t lockprof_lookup(const char* name,
+                                  struct lockprof_stats* stats);
+
+/**
+ * \brief Call \p cb on a snapshot of the statistics for each registered lock.
+ *
+ * The registry is locked while iterating, so \p cb must not register or
+ * unregister locks.
+ *
+ * \param cb The callback.
+ *
+ * \param arg Passed to \p cb.
+ *
+ * \return # of registered locks.
+ */
+RCSW_API size_t lockprof_foreach(void (*cb)(const char* name,
+                                            const struct lockprof_stats* stats,
+                                            void* arg),
+                                 void* arg);
+
+/**
+ * \brief Reset the statistics for all registered locks.
+ */
+RCSW_API void lockprof_reset_all(void);
+
+END_C_DECLS
@@ -13,10 +13,51 @@
 /*******************************************************************************
  * Includes
  ******************************************************************************/
+#include <pthread.h>
+
 #include "rcsw/multithread/csem.h"
-#include "rcsw/multithread/mutex.h"
 #include "rcsw/ds/ds.h"
-#include "rcsw/ds/llist.h"
+#include "rcsw/common/fpc.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Use per-thread caches of free chunks ("magazines") in front of the
+ * free list, and wait on a futex instead of a semaphore.
+ *
+ * \ref mpool_req() and \ref mpool_release() then only touch shared state when
+ * the calling thread's magazine is empty/full, and only sleep when there are
+ * no free chunks anywhere in the pool, including other threads' magazines.
+ *
+ * Each such pool uses one POSIX thread-specific data key, and magazines are
+ * flushed back to the pool when their thread exits.
+ */
+#define RCSW_MPOOL_LOCKFREE (1 << (RCSW_MODFLAGS_START + 0))
+
+/**
+ * \brief Place the pool's chunks on a single NUMA node (\ref
+ * mpool_params.numa_node), so that threads running on that node get local
+ * memory no matter which thread touches a chunk first. Ignored with \ref
+ * RCSW_NOALLOC_DATA.
+ */
+#define RCSW_MPOOL_NUMA (1 << (RCSW_MODFLAGS_START + 1))
+
+/**
+ * \brief Max # of free chunks cached per thread per pool with \ref
+ * RCSW_MPOOL_LOCKFREE.
+ */
+#define RCSW_MPOOL_MAGAZINE_SIZE 16
+
+/**
+ * \brief \ref mpool_slot.state for chunks on the free list (or in a magazine).
+ */
+#define MPOOL_SLOT_FREE 0
+
+/**
+ * \brief \ref mpool_slot.state for chunks which have been handed out.
+ */
+#define MPOOL_SLOT_ALLOC 1
 
 /*******************************************************************************
  * Structure Definitions
@@ -26,8 +67,8 @@
  */
 struct mpool_params {
   /**
-   * Pointer to application-allocated space for storing the \ref llist_node
-   * objects used to carve up \ref mpool_params.elements. Ignored unless \ref
+   * Pointer to application-allocated space for storing the \ref mpool_slot
+   * objects used to track \ref mpool_params.elements. Ignored unless \ref
    * RCSW_NOALLOC_META is passed.
    */
   dptr_t *meta;
@@ -48,32 +89,103 @@ struct mpool_params {
    */
   size_t max_elts;
 
+  /**
+   * Index of the NUMA node (see \ref threadm_topology) to place the pool's
+   * chunks on with \ref RCSW_MPOOL_NUMA, or -1 for the node of the calling
+   * thread. Ignored otherwise.
+   */
+  int numa_node;
+
   /**
    * Configuration flags. See \ref mpool.flags for valid flags.
    */
   uint32_t flags;
 };
 
+/**
+ * \brief Per-thread cache of free chunk indices for \ref RCSW_MPOOL_LOCKFREE.
+ *
+ * Only ever touched by its owning thread, except when another thread finds the
+ * pool empty and steals from it, so the lock is almost always uncontended.
+ */
+struct mpool_magazine {
+  RCSW_CACHELINE_PAD(pad);
+
+  /** The free chunks, as indices into \ref mpool.elements. */
+  uint32_t slots[RCSW_MPOOL_MAGAZINE_SIZE];
+
+  /** # of valid entries in \ref mpool_magazine.slots. */
+  size_t count;
+
+  /**
+   * # of chunks allocated minus # of chunks freed by the owning thread. Can be
+   * "negative" (wraps) if chunks are freed by a different thread than they were
+   * allocated on; the sum over all magazines is the # of allocated chunks.
+   */
+  size_t n_out;
+
+  /** Spinlock protecting \ref mpool_magazine.slots against stealing. */
+  uint32_t lock;
+
+  /** The owning pool. */
+  struct mpool* pool;
+
+  /** Next magazine for the same pool. */
+  struct mpool_magazine* next;
+};
+
+/**
+ * \brief State for \ref RCSW_MPOOL_LOCKFREE.
+ */
+struct mpool_lf {
+  RCSW_CACHELINE_PAD(pad);
+
+  /** # of threads sleeping in \ref mpool_req() waiting for a free chunk. */
+  uint32_t waiters;
+
+  /** Futex word waiters sleep on; bumped when chunks are freed to them. */
+  uint32_t seq;
+
+  /** All magazines ever created for the pool, so they can be freed/stolen. */
+  struct mpool_magazine* magazines;
+
+  /** Thread-specific key holding each thread's magazine. */
+  pthread_key_t key;
+};
+
+/**
+ * \brief Per-chunk metadata.
+ */
+struct mpool_slot {
+  /** Reference count. */
+  int refs;
+
+  /**
+   * Free stack link: index of the next free chunk after this one + 1, or 0 if
+   * there is none. Only meaningful while the chunk is free.
+   */
+  uint32_t next;
+
+  /** \ref MPOOL_SLOT_FREE or \ref MPOOL_SLOT_ALLOC. */
+  uint8_t state;
+};
+
 /**
  * \brief Memory pool: a threadsafe malloc()/free() over a set of memory chunks.
  *
  * Memory chunks must be fixed size.
+ *
+ * Free chunks are kept on a lock-free stack of chunk indices, and chunk
+ * pointers are mapped to their \ref mpool_slot arithmetically, so every
+ * operation is O(1). Adding/removing a reference, and releasing a chunk which
+ * still has other references, is a single atomic operation.
  */
 struct mpool {
   /** The chunks of managed memory. */
   dptr_t           *elements;
 
-  /** Space for the llist nodes for both the free and allocated lists. */
-  struct llist_node *nodes;
-
-  /** List of free chunks of memory. */
-  struct llist      free;
-
-  /** List of free chunks of memory. */
-  struct llist      alloc;
-
-  /** Reference counting. Same length as max # elements. */
-  int               *refs;
+  /** Per-chunk metadata. Same length as max # elements. */
+  struct mpool_slot *slots;
 
   /** Size of elements in the pool in bytes. */
   size_t            elt_size;
@@ -82,12 +194,36 @@ struct mpool {
   size_t            max_elts;
 
   /**
-   * Used to wait for a chunk to become free in \ref mpool_req().
+   * # of allocated chunks. Not used with \ref RCSW_MPOOL_LOCKFREE, which
+   * tracks this per-magazine to avoid another shared cache line.
+   */
+  size_t            n_alloc;
+
+  RCSW_CACHELINE_PAD(pad);
+
+  /**
+   * Top of the free stack: low 32 bits are the index of the first free chunk
+   * + 1 (0 if empty), high 32 bits are a counter which is bumped on every
+   * update, so that a CAS which races with a pop+push of the same chunk (ABA)
+   * fails.
+   */
+  uint64_t          free_top;
+
+  /**
+   * Used to wait for a chunk to become free in \ref mpool_req(). Not used with
+   * \ref RCSW_MPOOL_LOCKFREE.
    */
   struct csem       slots_avail;
 
-  /** Lock around most operations for concurrency safety. */
-  struct mutex      mutex;
+  /** Per-thread caches and futex waiting. */
+  struct mpool_lf   lf;
+
+  /**
+   * Whether \ref mpool_lf.key or \ref mpool.slots_avail (depending on \ref
+   * RCSW_MPOOL_LOCKFREE) has been created, so a pool whose initialization
+   * failed part way through can be destroyed.
+   */
+  bool_t            waiting_valid;
 
   /**
    * Run time configuration flags. Valid flags are:
@@ -96,6 +232,8 @@ struct mpool {
    * - \ref RCSW_NOALLOC_HANDLE
    * - \ref RCSW_NOALLOC_DATA
    * - \ref RCSW_NOALLOC_META
+   * - \ref RCSW_MPOOL_LOCKFREE
+   * - \ref RCSW_MPOOL_NUMA
    *
    * All other flags are ignored.
    */
@@ -108,15 +246,14 @@ struct mpool {
 BEGIN_C_DECLS
 
 /**
- * \brief Get # of bytes needed for space for the mpool nodes.
+ * \brief Get # of bytes needed for space for the mpool metadata.
  *
  * \param max_elts # of desired elements in pool.
  *
  * \return The # of bytes the application would need to allocate.
  */
 static inline size_t  mpool_meta_space(size_t max_elts) {
-    /* x2 for free and alloc lists */
-    return 2 * llist_meta_space(max_elts);
+    return max_elts * sizeof(struct mpool_slot);
 }
 
 /**
@@ -133,62 +270,53 @@ static inline size_t  mpool_element_space(size_t max_elts, size_t elt_size) {
 
 
 /**
- * \brief Determine if the memory pool is currently full.
- *
- * \note The returned value cannot be relied upon in concurrent contexts without
- * additional synchronization.
+ * \brief Determine maximum # elements in the memory pool.
  *
  * \param pool The pool handle.
  *
- * \return \ref bool_t
+ * \return Max # elements in memory pool, or 0 on ERROR.
  */
-static inline bool_t mpool_isfull(const struct mpool* const pool) {
-    RCSW_FPC_NV(false, NULL != pool);
-    return llist_isfull(&pool->alloc);
+static inline size_t mpool_capacity(const struct mpool* const pool) {
+    RCSW_FPC_NV(0, NULL != pool);
+    return pool->max_elts;
 }
 
+
 /**
- * \brief Determine if the \ref mpool is currently empty.
+ * \brief Determine # elements currently allocated from the memory pool.
  *
  * \note The returned value cannot be relied upon in concurrent contexts without
  * additional synchronization.
  *
  * \param pool The pool handle.
  *
- * \return \ref bool_t
+ * \return # elements in memory pool, or 0 on ERROR.
  */
-static inline bool_t mpool_isempty(const struct mpool* const pool) {
-    RCSW_FPC_NV(false, NULL != pool);
-    return llist_isempty(&pool->alloc);
-}
+RCSW_API size_t mpool_size(const struct mpool* pool);
 
 /**
- * \brief Determine # elements currently in the memory pool.
+ * \brief Determine if the memory pool is currently full.
  *
  * \note The returned value cannot be relied upon in concurrent contexts without
  * additional synchronization.
  *
  * \param pool The pool handle.
  *
- * \return # elements in memory pool, or 0 on ERROR.
+ * \return \ref bool_t
  */
-static inline size_t mpool_size(const struct mpool* const pool) {
-    RCSW_FPC_NV(0, NULL != pool);
-    return llist_size(&pool->alloc);
-}
+RCSW_API bool_t mpool_isfull(const struct mpool* pool);
 
 /**
- * \brief Determine maximum # elements in the memory pool.
+ * \brief Determine if the \ref mpool is currently empty.
+ *
+ * \note The returned value cannot be relied upon in concurrent contexts without
+ * additional synchronization.
  *
  * \param pool The pool handle.
  *
- * \return Max # elements in memory pool, or 0 on ERROR.
+ * \return \ref bool_t
  */
-static inline size_t mpool_capacity(const struct mpool* const pool) {
-    RCSW_FPC_NV(0, NULL != pool);
-    return pool->max_elts;
-}
-
+RCSW_API bool_t mpool_isempty(const struct mpool* pool);
 
 /**
  * \brief Initialize a \ref mpool.
@@ -14,6 +14,8 @@
  ******************************************************************************/
 #include <pthread.h>
 #include "rcsw/rcsw.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/multithread/lockprof.h"
 
 /*******************************************************************************
  * Type Definitions
@@ -24,9 +26,28 @@
  * Currently supports:
  *
  * - POSIX mutexes
+ * - Linux futexes, if \ref RCSW_CONFIG_AL_FUTEX_SYNC is defined. Contended
+ *   lockers spin for a bounded, adaptive # of iterations before sleeping in the
+ *   kernel, and unlocking only makes a system call if someone is sleeping.
  */
 struct mutex {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  /** The lock word: unlocked, locked, or locked with waiters. */
+  uint32_t word;
+
+  /** Adaptive spin estimate; see \ref futex_spin_limit(). */
+  uint32_t spin_est;
+
+  /** Contention counters. */
+  struct futex_stats stats;
+#else
   pthread_mutex_t impl;
+#endif
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  /** Contention profiling; see \ref RCSW_LOCKPROF_REGISTER(). */
+  struct lockprof prof;
+#endif
 
   /**
    * Valid flags are:
@@ -81,4 +102,18 @@ RCSW_API status_t mutex_lock(struct mutex *mutex);
  */
 RCSW_API status_t mutex_unlock(struct mutex *mutex);
 
+/**
+ * \brief Get the contention counters for a mutex.
+ *
+ * \param mutex The mutex handle.
+ *
+ * \param stats The counters (output parameter). Zeroed if the counters are not
+ *              available.
+ *
+ * \return \ref status_t. ERROR if \ref RCSW_CONFIG_AL_FUTEX_SYNC is not
+ * defined, as pthread mutexes don't keep counters.
+ */
+RCSW_API status_t mutex_stats_get(const struct mutex *mutex,
+                                  struct futex_stats* stats);
+
 END_C_DECLS
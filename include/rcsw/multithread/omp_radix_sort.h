@@ -16,6 +16,19 @@
  ******************************************************************************/
 #include "rcsw/rcsw.h"
 #include "rcsw/ds/fifo.h"
+#include "rcsw/multithread/threadm.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Pin the sorting threads to CPUs spread across NUMA nodes, and place
+ * each thread's chunk of the data and its bins on its node explicitly, rather
+ * than relying on first touch from unpinned threads.
+ *
+ * OpenMP runs thread 0 on the calling thread, so the caller is pinned too.
+ */
+#define RCSW_OMP_RADIX_SORTER_NUMA (1 << (RCSW_MODFLAGS_START + 0))
 
 /*******************************************************************************
  * Structure Definitions
@@ -28,6 +41,7 @@ struct omp_radix_sorter_params {
     size_t n_elts;     /// # elements to sort.
     size_t base;       /// base for sort (10, 16, etc.).
     size_t n_threads;  /// # OpenMP threads to use for sorting.
+    uint32_t flags;    /// Configuration flags.
 };
 
 /**
@@ -45,6 +59,23 @@ struct omp_radix_sorter {
      * Cumulative prefix sums used to compute receive and displacement counts.
      */
     size_t *cum_prefix_sums;
+
+    /**
+     * With \ref RCSW_OMP_RADIX_SORTER_NUMA: the topology, the CPU each thread
+     * is pinned to, and the node-local storage for each thread's bins.
+     */
+    struct threadm_topology* topo;
+    size_t* cpus;
+    dptr_t** bin_space;
+
+    /**
+     * Run time configuration flags. Valid flags are:
+     *
+     * - \ref RCSW_OMP_RADIX_SORTER_NUMA
+     *
+     * All other flags are ignored.
+     */
+    uint32_t flags;
 };
 
 /*******************************************************************************
@@ -16,6 +16,20 @@
 #include "rcsw/multithread/mutex.h"
 #include "rcsw/ds/fifo.h"
 
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Use a bounded lock-free multi-producer, multi-consumer ring (Vyukov
+ * style, with a sequence number per slot) instead of a mutex-protected \ref
+ * fifo. Producers/consumers only contend on the slot they are claiming, so
+ * throughput scales much better with the # of threads.
+ *
+ * Requires allocating metadata (a sequence # per slot), so cannot be used if
+ * dynamic memory allocation is disabled.
+ */
+#define RCSW_PCQUEUE_MPMC (1 << (RCSW_MODFLAGS_START + RCSW_DS_EXTFLAGS_START))
+
 /*******************************************************************************
  * Structure Definitions
  ******************************************************************************/
@@ -24,19 +38,68 @@
  */
 #define pcqueue_params fifo_params
 
+/**
+ * \brief Lock-free ring backing a \ref pcqueue when \ref RCSW_PCQUEUE_MPMC is
+ * passed.
+ */
+struct pcqueue_mpmc {
+  /**
+   * The element storage. Same layout as \ref fifo.
+   */
+  dptr_t* elements;
+
+  /**
+   * Per-slot sequence #s. A slot is free for the producer claiming position
+   * \c pos when its sequence # is \c pos, and ready for the consumer claiming
+   * position \c pos when its sequence # is \c pos + 1.
+   */
+  size_t* seqs;
+
+  /**
+   * Size of elements in bytes.
+   */
+  size_t elt_size;
+
+  /**
+   * Maximum number of elements in the ring.
+   */
+  size_t max_elts;
+
+  RCSW_CACHELINE_PAD(pad0);
+
+  /**
+   * Next position to enqueue at (monotonic).
+   */
+  size_t enq_pos;
+
+  RCSW_CACHELINE_PAD(pad1);
+
+  /**
+   * Next position to dequeue from (monotonic).
+   */
+  size_t deq_pos;
+
+  RCSW_CACHELINE_PAD(pad2);
+};
+
 /**
  * \brief Producer-consumer queue, providing thread-safe access to data at both
  * ends of a FIFO.
  */
 struct pcqueue {
   /**
-   * The underlying FIFO.
+   * The underlying FIFO. Not used if \ref RCSW_PCQUEUE_MPMC is passed.
    */
   struct fifo fifo;
+
   /**
-   * Mutex protecting fifo.
+   * The underlying ring if \ref RCSW_PCQUEUE_MPMC is passed.
    */
+  struct pcqueue_mpmc mpmc;
 
+  /**
+   * Mutex protecting fifo. Not used if \ref RCSW_PCQUEUE_MPMC is passed.
+   */
   struct mutex mutex;
 
   /**
@@ -50,7 +113,9 @@ struct pcqueue {
   struct csem slots_inuse;
 
   /**
-   * \brief Configuration flags--same as \ref fifo.
+   * \brief Configuration flags--same as \ref fifo, plus:
+   *
+   * - \ref RCSW_PCQUEUE_MPMC
    */
   uint32_t flags;
 };
@@ -60,30 +125,6 @@ struct pcqueue {
  ******************************************************************************/
 BEGIN_C_DECLS
 
-/**
- * \brief Determine if the queue is currently full.
- *
- * \param queue The queue  handle.
- *
- * \return \ref bool_t
- */
-static inline bool_t pcqueue_isfull(const struct pcqueue* const queue) {
-    RCSW_FPC_NV(false, NULL != queue);
-    return fifo_isfull(&queue->fifo);
-}
-
-/**
- * \brief Determine if the queue is currently empty.
- *
- * \param queue The linked queue handle.
- *
- * \return \ref bool_t
- */
-static inline bool_t pcqueue_isempty(const struct pcqueue* const queue) {
-    RCSW_FPC_NV(false, NULL != queue);
-    return fifo_isempty(&queue->fifo);
-}
-
 /**
  * \brief Determine # elements currently in the queue. The value returned by
  * this function should not be relied upon for accuracy among multiple threads
@@ -95,6 +136,13 @@ static inline bool_t pcqueue_isempty(const struct pcqueue* const queue) {
  */
 static inline size_t pcqueue_size(const struct pcqueue* const queue) {
     RCSW_FPC_NV(0, NULL != queue);
+    if (queue->flags & RCSW_PCQUEUE_MPMC) {
+      size_t deq = __atomic_load_n(&queue->mpmc.deq_pos, __ATOMIC_ACQUIRE);
+      size_t enq = __atomic_load_n(&queue->mpmc.enq_pos, __ATOMIC_ACQUIRE);
+
+      /* positions can be claimed but not yet filled/emptied */
+      return (enq > deq) ? RCSW_MIN(enq - deq, queue->mpmc.max_elts) : 0;
+    }
     return fifo_size(&queue->fifo);
 }
 
@@ -109,9 +157,36 @@ static inline size_t pcqueue_size(const struct pcqueue* const queue) {
  */
 static inline size_t pcqueue_capacity(const struct pcqueue* const queue) {
     RCSW_FPC_NV(0, NULL != queue);
+    if (queue->flags & RCSW_PCQUEUE_MPMC) {
+      return queue->mpmc.max_elts;
+    }
     return fifo_capacity(&queue->fifo);
 }
 
+/**
+ * \brief Determine if the queue is currently full.
+ *
+ * \param queue The queue  handle.
+ *
+ * \return \ref bool_t
+ */
+static inline bool_t pcqueue_isfull(const struct pcqueue* const queue) {
+    RCSW_FPC_NV(false, NULL != queue);
+    return pcqueue_size(queue) == pcqueue_capacity(queue);
+}
+
+/**
+ * \brief Determine if the queue is currently empty.
+ *
+ * \param queue The linked queue handle.
+ *
+ * \return \ref bool_t
+ */
+static inline bool_t pcqueue_isempty(const struct pcqueue* const queue) {
+    RCSW_FPC_NV(false, NULL != queue);
+    return 0 == pcqueue_size(queue);
+}
+
 /**
  * \brief Get the # slots available in the queue. The value returned cannot be
  * relied upon in a multi-thread context without additional synchronization.
@@ -169,6 +244,130 @@ RCSW_API status_t pcqueue_push(struct pcqueue * pcqueue, const void * e);
  */
 RCSW_API status_t pcqueue_pop(struct pcqueue * pcqueue, void * e);
 
+/**
+ * \brief Push an item to the back of the queue if there is space for it,
+ * without waiting.
+ *
+ * Does not enter the kernel unless there are threads waiting for the queue to
+ * become non-empty.
+ *
+ * \param queue The queue handle.
+ * \param e The item to enqueue.
+ *
+ * \return \ref status_t. Sets errno to EAGAIN if the queue is full.
+ */
+RCSW_API status_t pcqueue_trypush(struct pcqueue* queue, const void* e);
+
+/**
+ * \brief Pop the first element in the queue if it exists, without waiting.
+ *
+ * Does not enter the kernel unless there are threads waiting for the queue to
+ * become non-full.
+ *
+ * \param queue The queue handle.
+ * \param e The item to dequeue. Can be NULL.
+ *
+ * \return \ref status_t. Sets errno to EAGAIN if the queue is empty.
+ */
+RCSW_API status_t pcqueue_trypop(struct pcqueue* queue, void* e);
+
+/**
+ * \brief Get the first element in the queue if it exists, without waiting.
+ *
+ * Only takes the mutex protecting the queue (nothing for \ref
+ * RCSW_PCQUEUE_MPMC); the semaphores are not touched.
+ *
+ * \note The filled value returned by this function cannot be relied upon in a
+ * multi-threaded context without additional synchronization.
+ *
+ * \param queue The queue handle.
+ * \param e To be filled with the address of the first element, if it exists,
+ *          and set to NULL otherwise.
+ *
+ * \return \ref status_t. Sets errno to EAGAIN if the queue is empty.
+ */
+RCSW_API status_t pcqueue_trypeek(struct pcqueue* queue, void** e);
+
+/**
+ * \brief Overwrite the most recently pushed element in the queue which \p
+ * match()es \p e with \p e, without waiting.
+ *
+ * The # of elements in the queue is unchanged, so this succeeds even if the
+ * queue is full. Only takes the mutex protecting the queue; the semaphores are
+ * not touched. Not supported with \ref RCSW_PCQUEUE_MPMC.
+ *
+ * \note Any pointer to the replaced element obtained via \ref pcqueue_peek()
+ * and friends will see the new value.
+ *
+ * \param queue The queue handle.
+ * \param e The item to write.
+ * \param match Callback returning true if a queued element (first argument)
+ *              should be replaced by \p e (second argument).
+ * \param old To be filled with the replaced element. Can be NULL.
+ *
+ * \return \ref status_t. Sets errno to ENOENT if no element matched.
+ */
+RCSW_API status_t pcqueue_tryreplace(struct pcqueue* queue,
+                                     const void* e,
+                                     bool_t (*match)(const void* elt,
+                                                     const void* e),
+                                     void* old);
+
+/**
+ * \brief Push a batch of items to the back of the queue, waiting if necessary
+ * for space to become available.
+ *
+ * Items are added in chunks as large as the available space allows, taking the
+ * lock protecting the queue once per chunk rather than once per item. Items
+ * from other producers are not interleaved within a chunk.
+ *
+ * \param queue The queue handle.
+ * \param elts Array of \p n items to enqueue.
+ * \param n # of items in \p elts.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t pcqueue_push_n(struct pcqueue* queue,
+                                 const void* elts,
+                                 size_t n);
+
+/**
+ * \brief Pop a batch of items from the front of the queue, waiting if necessary
+ * for the queue to become non-empty.
+ *
+ * Once at least one item is available, as many items as are available (up to
+ * \p max) are popped at once, taking the lock protecting the queue once.
+ *
+ * \param queue The queue handle.
+ * \param out Array of at least \p max items to dequeue into. Can be NULL.
+ * \param max Maximum # of items to dequeue.
+ * \param got Filled with the # of items dequeued.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t pcqueue_pop_n(struct pcqueue* queue,
+                                void* out,
+                                size_t max,
+                                size_t* got);
+
+/**
+ * \brief Pop all items currently in the queue (up to \p max), without waiting.
+ *
+ * Intended for consumer loops which wake up and want to process everything
+ * which has been queued since they last ran.
+ *
+ * \param queue The queue handle.
+ * \param out Array of at least \p max items to dequeue into. Can be NULL.
+ * \param max Maximum # of items to dequeue.
+ * \param got Filled with the # of items dequeued, which may be 0.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t pcqueue_drain(struct pcqueue* queue,
+                                void* out,
+                                size_t max,
+                                size_t* got);
+
 /**
  * \brief Pop and return the first element in the queue, waiting until the
  * timeout if necessary for the queue to become non-empty.
@@ -17,10 +17,51 @@
  ******************************************************************************/
 #include "rcsw/multithread/csem.h"
 #include "rcsw/rcsw.h"
+#include "rcsw/common/fpc.h"
+#include "rcsw/common/flags.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Bias the lock towards readers.
+ *
+ * Readers announce themselves by incrementing one of \ref
+ * RCSW_RDWRLOCK_STRIPES per-thread counters, each on its own cache line, so
+ * entering/exiting a read section when no writer is around is a single atomic
+ * operation on a (usually) uncontended cache line, and never enters the
+ * kernel.
+ *
+ * Writers revoke the bias: they announce themselves, which sends any new
+ * readers to the slow path, and then wait for the readers already inside to
+ * drain. Readers on the slow path queue up in the same order as writers do, so
+ * the lock is still fair: neither readers nor writers starve.
+ *
+ * Writers are more expensive than without this flag, so only use it for locks
+ * which are read far more often than they are written.
+ */
+#define RCSW_RDWRLOCK_RDBIAS (1 << (RCSW_MODFLAGS_START + 0))
+
+/**
+ * \brief # of reader counters with \ref RCSW_RDWRLOCK_RDBIAS. Threads are
+ * spread over them round-robin, so this many threads can read without sharing
+ * any cache lines.
+ */
+#define RCSW_RDWRLOCK_STRIPES 16
 
 /*******************************************************************************
  * Type Definitions
  ******************************************************************************/
+/**
+ * \brief A reader counter for \ref RCSW_RDWRLOCK_RDBIAS, on its own cache line.
+ */
+struct rdwrl_stripe {
+  RCSW_CACHELINE_PAD(pad);
+
+  /** # readers which entered via this counter, minus # which exited. */
+  uint32_t n_readers;
+};
+
 /**
  * \brief Fair reader-writer lock that guarantees that neither readers nor
  * writers will starve.
@@ -43,10 +84,36 @@ struct rdwrlock {
    *
    * - \ref RCSW_ZALLOC
    * - \ref RCSW_NOALLOC_HANDLE
+   * - \ref RCSW_RDWRLOCK_RDBIAS
    *
    * All other flags are ignored.
    */
   uint32_t flags;
+
+  /** Reader counters, with \ref RCSW_RDWRLOCK_RDBIAS. */
+  struct rdwrl_stripe stripes[RCSW_RDWRLOCK_STRIPES];
+
+  RCSW_CACHELINE_PAD(pad);
+
+  /**
+   * Non-zero if a writer has revoked the reader bias, with \ref
+   * RCSW_RDWRLOCK_RDBIAS. Only read by readers unless a writer is around.
+   */
+  uint32_t wr_active;
+
+  /** Futex word slow path readers sleep on until the writer is done. */
+  uint32_t wr_seq;
+
+  /** Futex word a revoking writer sleeps on until readers drain. */
+  uint32_t drain_seq;
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  /**
+   * Contention profiling; see \ref RCSW_LOCKPROF_REGISTER(). Hold times are
+   * only tracked for writers.
+   */
+  struct lockprof prof;
+#endif
 };
 
 /**
@@ -66,6 +133,31 @@ enum rdwrlock_scope {
  ******************************************************************************/
 BEGIN_C_DECLS
 
+/**
+ * \brief Get the # of readers currently holding the lock. The value returned
+ * by this function is only a snapshot in a multi-threaded context.
+ *
+ * \param rdwr The lock handle.
+ *
+ * \return # readers, or 0 on ERROR.
+ */
+static inline size_t rdwrl_n_readers(const struct rdwrlock* const rdwr) {
+  RCSW_FPC_NV(0, NULL != rdwr);
+
+  if (!(rdwr->flags & RCSW_RDWRLOCK_RDBIAS)) {
+    return rdwr->n_readers;
+  }
+  /*
+   * A reader can exit on a different thread than it entered on, so individual
+   * counters can wrap; the sum is still right.
+   */
+  uint32_t n = 0;
+  for (size_t i = 0; i < RCSW_RDWRLOCK_STRIPES; ++i) {
+    n += __atomic_load_n(&rdwr->stripes[i].n_readers, __ATOMIC_RELAXED);
+  } /* for(i..) */
+  return n;
+}
+
 /**
  * \brief Initialize a reader/writer fair lock
  *
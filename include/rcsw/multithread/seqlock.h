@@ -0,0 +1,202 @@
+/**
+ * \file seqlock.h
+ * \ingroup multithread
+ * \brief Sequence lock for small, read-mostly shared state.
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/rcsw.h"
+#include "rcsw/common/fpc.h"
+#include "rcsw/multithread/mutex.h"
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/**
+ * \brief Copy \p src into \p dst (which must be of the same type), retrying
+ * until a copy is made which no writer interfered with.
+ *
+ * \param sl The seqlock handle protecting \p src.
+ * \param dst The lvalue to copy into.
+ * \param src The protected lvalue to copy from.
+ */
+#define RCSW_SEQLOCK_READ(sl, dst, src)                                 \
+  do {                                                                  \
+    uint32_t rcsw_seq_;                                                 \
+    do {                                                                \
+      rcsw_seq_ = seqlock_rd_begin((sl));                               \
+      (dst) = (src);                                                    \
+    } while (seqlock_rd_retry((sl), rcsw_seq_));                        \
+  } while (0)
+
+/**
+ * \brief Copy \p src into the protected \p dst (which must be of the same
+ * type) as a single write.
+ *
+ * \param sl The seqlock handle protecting \p dst.
+ * \param dst The protected lvalue to copy into.
+ * \param src The lvalue to copy from.
+ */
+#define RCSW_SEQLOCK_WRITE(sl, dst, src)                                \
+  do {                                                                  \
+    seqlock_wr_enter(sl);                                               \
+    (dst) = (src);                                                      \
+    seqlock_wr_exit(sl);                                                \
+  } while (0)
+
+/*******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+/**
+ * \brief Sequence lock: a lock for small shared state which is read constantly
+ * and written rarely.
+ *
+ * Readers never write to shared memory (unlike with \ref rdwrlock, where they
+ * at least update a reader count), so any number of them can read
+ * concurrently without bouncing cache lines between cores. Instead, they copy
+ * the state out and then check that no writer was active while they did so,
+ * retrying if one was. Writers are serialized with a \ref mutex, and never
+ * wait on readers.
+ *
+ * Only use this for plain data which can be safely copied while being written
+ * (i.e., no pointers which readers will follow), and which is small enough
+ * that copying it out is cheap.
+ */
+struct seqlock {
+  /**
+   * Sequence counter. Odd while a write is in progress; bumped by 2 for every
+   * write.
+   */
+  uint32_t seq;
+
+  /** Serializes writers. */
+  struct mutex mtx;
+
+  /**
+   * Configuration flags. Valid flags are:
+   *
+   * - \ref RCSW_ZALLOC
+   * - \ref RCSW_NOALLOC_HANDLE
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Start a read of the state protected by a seqlock.
+ *
+ * Waits for any write in progress to finish.
+ *
+ * \param sl The seqlock handle.
+ *
+ * \return The sequence # to pass to \ref seqlock_rd_retry() once the read is
+ * done.
+ */
+static inline uint32_t seqlock_rd_begin(const struct seqlock* const sl) {
+  uint32_t seq;
+  while ((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 0x1) {
+    RCSW_CPU_RELAX();
+  } /* while() */
+  return seq;
+}
+
+/**
+ * \brief Finish a read of the state protected by a seqlock.
+ *
+ * \param sl The seqlock handle.
+ * \param seq The sequence # from \ref seqlock_rd_begin().
+ *
+ * \return \ref bool_t: true if a writer interfered and the read must be
+ * retried, false if what was read is consistent.
+ */
+static inline bool_t seqlock_rd_retry(const struct seqlock* const sl,
+                                      uint32_t seq) {
+  /* all reads of the protected state must happen before re-reading seq */
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return RCSW_UNLIKELY(__atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq);
+}
+
+/**
+ * \brief Initialize a seqlock.
+ *
+ * \param sl_in The seqlock to initialize. Can be NULL if \ref
+ *              RCSW_NOALLOC_HANDLE is not passed.
+ *
+ * \param flags Configuration flags. See \ref seqlock.flags for valid flags.
+ *
+ * \return The initialized seqlock, or NULL if an ERROR occurred.
+ */
+RCSW_API struct seqlock* seqlock_init(struct seqlock* sl_in,
+                                      uint32_t flags) RCSW_WUR;
+
+/**
+ * \brief Destroy a seqlock.
+ *
+ * \param sl The seqlock handle.
+ */
+RCSW_API void seqlock_destroy(struct seqlock* sl);
+
+/**
+ * \brief Start a write of the state protected by a seqlock. Blocks until any
+ * other writer is done.
+ *
+ * \param sl The seqlock handle.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t seqlock_wr_enter(struct seqlock* sl);
+
+/**
+ * \brief Finish a write of the state protected by a seqlock.
+ *
+ * \param sl The seqlock handle.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t seqlock_wr_exit(struct seqlock* sl);
+
+/**
+ * \brief Get a consistent copy of the state protected by a seqlock.
+ *
+ * \param sl The seqlock handle.
+ * \param dst Where to copy the state to.
+ * \param src The protected state.
+ * \param n_bytes Size of the state in bytes.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t seqlock_read(const struct seqlock* sl,
+                               void* dst,
+                               const void* src,
+                               size_t n_bytes);
+
+/**
+ * \brief Overwrite the state protected by a seqlock.
+ *
+ * \param sl The seqlock handle.
+ * \param dst The protected state.
+ * \param src What to copy into the state.
+ * \param n_bytes Size of the state in bytes.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t seqlock_write(struct seqlock* sl,
+                                void* dst,
+                                const void* src,
+                                size_t n_bytes);
+
+END_C_DECLS
@@ -0,0 +1,329 @@
+/**
+ * \file slab.h
+ * \ingroup multithread
+ * \brief Size-class slab allocator built on \ref mpool.
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <pthread.h>
+
+#include "rcsw/multithread/mpool.h"
+#include "rcsw/multithread/mutex.h"
+#include "rcsw/common/alloc.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Keep per-thread caches of free chunks for each size class in front of
+ * the pages, so that \ref slab_alloc()/\ref slab_free() only touch shared
+ * state when the calling thread's cache for the class is empty/full.
+ *
+ * Each such slab uses one POSIX thread-specific data key. Caches are carved
+ * out of the slab itself, so the largest size class must be able to hold one
+ * (see \ref slab_cache_space()), and are flushed back to the slab when their
+ * thread exits.
+ */
+#define RCSW_SLAB_CACHE (1 << (RCSW_MODFLAGS_START + 0))
+
+/**
+ * \brief Max # of size classes in a slab.
+ */
+#define RCSW_SLAB_MAX_CLASSES 16
+
+/**
+ * \brief Max # of free chunks cached per thread per size class with \ref
+ * RCSW_SLAB_CACHE.
+ */
+#define RCSW_SLAB_CACHE_SIZE 8
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Slab allocator initialization parameters.
+ */
+struct slab_params {
+  /**
+   * Pointer to application-allocated space that pages are carved from. Must be
+   * \ref slab_params.max_pages * \ref slab_params.page_size bytes. Ignored
+   * unless \ref RCSW_NOALLOC_DATA is passed.
+   */
+  dptr_t* arena;
+
+  /**
+   * Pointer to application-allocated space for the page table. See \ref
+   * slab_meta_space(). Ignored unless \ref RCSW_NOALLOC_META is passed.
+   */
+  dptr_t* meta;
+
+  /**
+   * Size of each page in bytes. Must be big enough to hold at least one chunk
+   * of the largest size class along with its \ref mpool_slot.
+   */
+  size_t page_size;
+
+  /**
+   * Max # of pages the slab can grow to.
+   */
+  size_t max_pages;
+
+  /**
+   * Size of the smallest size class in bytes. Must be a power of 2 which is at
+   * least sizeof(void*).
+   */
+  size_t min_size;
+
+  /**
+   * Size of the largest size class in bytes. Must be a power of 2 which is at
+   * least \ref slab_params.min_size. Size classes are all the powers of 2 in
+   * between, so there can be at most \ref RCSW_SLAB_MAX_CLASSES of them.
+   */
+  size_t max_size;
+
+  /**
+   * Configuration flags. See \ref slab.flags for valid flags.
+   */
+  uint32_t flags;
+};
+
+/**
+ * \brief A page of chunks of one size class, managed by an \ref mpool.
+ */
+struct slab_page {
+  /** The pool for the chunks in the page. */
+  struct mpool pool;
+
+  /** The size class the page belongs to, or NULL if not handed out yet. */
+  struct slab_class* cls;
+
+  /** Next page in the same size class. */
+  struct slab_page* next;
+};
+
+/**
+ * \brief A size class: all the pages holding chunks of a given size.
+ */
+struct slab_class {
+  RCSW_CACHELINE_PAD(pad);
+
+  /**
+   * Protects the page list, and serializes taking chunks out of the pages (so
+   * that a page which is not full stays that way until we get a chunk from
+   * it). Chunks are put back without it.
+   */
+  struct mutex mtx;
+
+  /** Size of chunks in bytes. */
+  size_t size;
+
+  /** # chunks per page. */
+  size_t per_page;
+
+  /** Pages in this class, most recently added first. */
+  struct slab_page* pages;
+
+  /**
+   * Last page known to have free chunks. Set when a chunk is freed, so that
+   * allocation does not have to search the page list in the common case.
+   */
+  struct slab_page* hint;
+};
+
+/**
+ * \brief Slab allocator: a threadsafe malloc()/free() over power-of-2 size
+ * classes.
+ *
+ * Mapping a size to its class is O(1) (a count-leading-zeroes), as is mapping
+ * a chunk back to its page (a divide). Each class grows one page at a time as
+ * needed, with pages carved sequentially out of one arena, so on systems with
+ * demand paging memory is only committed as pages are handed out. Pages stay
+ * with the class they were first handed to.
+ *
+ * Can be used as the backend for \ref rcsw_alloc() via \ref
+ * slab_backend_init(), so that any data structure can allocate from it.
+ */
+struct slab {
+  /** The memory pages are carved from. */
+  dptr_t* arena;
+
+  /** Page table. Same length as max # pages. */
+  struct slab_page* pages;
+
+  /** Size of each page in bytes. */
+  size_t page_size;
+
+  /** Max # of pages. */
+  size_t max_pages;
+
+  /** # pages handed out to a size class so far. */
+  size_t n_pages;
+
+  /** log2 of the smallest class size. */
+  size_t min_shift;
+
+  /** # size classes. */
+  size_t n_classes;
+
+  /** The size classes, smallest first. */
+  struct slab_class classes[RCSW_SLAB_MAX_CLASSES];
+
+  /** Thread-specific data key for per-thread caches. */
+  pthread_key_t key;
+
+  /**
+   * Run time configuration flags. Valid flags are:
+   *
+   * - \ref RCSW_NOALLOC_HANDLE
+   * - \ref RCSW_NOALLOC_DATA
+   * - \ref RCSW_NOALLOC_META
+   * - \ref RCSW_SLAB_CACHE
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Get # of bytes needed for the page table.
+ *
+ * \param max_pages Max # pages in the slab.
+ *
+ * \return The # of bytes the application would need to allocate.
+ */
+static inline size_t slab_meta_space(size_t max_pages) {
+  return max_pages * sizeof(struct slab_page);
+}
+
+/**
+ * \brief Get # of bytes needed for the arena.
+ *
+ * \param max_pages Max # pages in the slab.
+ * \param page_size Size of each page in bytes.
+ *
+ * \return The # of bytes the application would need to allocate.
+ */
+static inline size_t slab_arena_space(size_t max_pages, size_t page_size) {
+  return max_pages * page_size;
+}
+
+/**
+ * \brief Get # of bytes each per-thread cache takes up with \ref
+ * RCSW_SLAB_CACHE.
+ *
+ * \param n_classes # of size classes.
+ *
+ * \return The cache size in bytes.
+ */
+static inline size_t slab_cache_space(size_t n_classes) {
+  return sizeof(struct slab*) + RCSW_SLAB_MAX_CLASSES * sizeof(size_t) +
+      n_classes * RCSW_SLAB_CACHE_SIZE * sizeof(void*);
+}
+
+/**
+ * \brief Get the index of the size class that \p n_bytes falls into.
+ *
+ * \param the_slab The slab handle.
+ * \param n_bytes The requested size.
+ *
+ * \return The class index, which is >= \ref slab.n_classes if \p n_bytes is
+ * too big for the slab.
+ */
+static inline size_t slab_class_idx(const struct slab* const the_slab,
+                                    size_t n_bytes) {
+  if (n_bytes <= ((size_t)1 << the_slab->min_shift)) {
+    return 0;
+  }
+  size_t shift = sizeof(unsigned long) * 8 - __builtin_clzl(n_bytes - 1);
+  return shift - the_slab->min_shift;
+}
+
+/**
+ * \brief Determine if a chunk was allocated from a slab.
+ *
+ * \param the_slab The slab handle.
+ * \param ptr The chunk.
+ *
+ * \return \ref bool_t
+ */
+static inline bool_t slab_owns(const struct slab* const the_slab,
+                               const void* const ptr) {
+  RCSW_FPC_NV(false, NULL != the_slab);
+  const uint8_t* start = (const uint8_t*)the_slab->arena;
+  return RCSW_IS_BETWEENHO((const uint8_t*)ptr,
+                           start,
+                           start + slab_arena_space(the_slab->max_pages,
+                                                    the_slab->page_size));
+}
+
+/**
+ * \brief Initialize a slab allocator.
+ *
+ * \param slab_in An application allocated handle for the slab. Can be NULL,
+ *                depending on if \ref RCSW_NOALLOC_HANDLE is passed or not.
+ *
+ * \param params The initialization parameters.
+ *
+ * \return The initialized slab, or NULL if an error occurred.
+ */
+RCSW_API struct slab* slab_init(struct slab* slab_in,
+                                const struct slab_params* params) RCSW_WUR;
+
+/**
+ * \brief Destroy a slab allocator.
+ *
+ * Any further use of the slab, or any chunk allocated from it, after calling
+ * this function is undefined.
+ *
+ * \param the_slab The slab handle.
+ */
+RCSW_API void slab_destroy(struct slab* the_slab);
+
+/**
+ * \brief Allocate a chunk of at least \p n_bytes.
+ *
+ * \param the_slab The slab handle.
+ * \param n_bytes The requested size.
+ *
+ * \return The chunk, or NULL if \p n_bytes is bigger than the largest size
+ * class (errno set to EINVAL), or there are no free chunks in the class and
+ * the slab can't grow any more (errno set to ENOMEM).
+ */
+RCSW_API void* slab_alloc(struct slab* the_slab, size_t n_bytes);
+
+/**
+ * \brief Return a chunk to the slab.
+ *
+ * \param the_slab The slab handle.
+ * \param ptr The chunk, from \ref slab_alloc().
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t slab_free(struct slab* the_slab, void* ptr);
+
+/**
+ * \brief Fill in an \ref rcsw_alloc_backend which allocates from a slab.
+ *
+ * Requests bigger than the largest size class, and frees of memory not from
+ * the slab, are passed through to malloc()/free().
+ *
+ * \param the_slab The slab handle. Must outlive any use of the backend.
+ * \param backend The backend to fill in.
+ */
+RCSW_API void slab_backend_init(struct slab* the_slab,
+                                struct rcsw_alloc_backend* backend);
+
+END_C_DECLS
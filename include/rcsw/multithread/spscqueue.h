@@ -0,0 +1,291 @@
+/**
+ * \file spscqueue.h
+ * \ingroup multithread
+ * \brief Lock-free single-producer, single-consumer queue.
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/ds/fifo.h"
+#include "rcsw/common/fpc.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Have \ref spscqueue_push() and \ref spscqueue_pop() sleep in the
+ * kernel when the queue is full/empty instead of spinning.
+ *
+ * This costs one extra fence on each push/pop so the other side can tell
+ * whether a wakeup is needed, so only pass it if one side is expected to wait
+ * for long periods.
+ */
+#define RCSW_SPSCQUEUE_FUTEX \
+  (1 << (RCSW_MODFLAGS_START + RCSW_DS_EXTFLAGS_START))
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief SPSC queue initialization parameters. Same as \ref fifo, so that the
+ * same application-allocated storage can be used for either one.
+ */
+#define spscqueue_params fifo_params
+
+/**
+ * \brief State owned by one side of a \ref spscqueue, on its own cache line so
+ * that the producer and consumer don't false share.
+ */
+struct spscqueue_end {
+  RCSW_CACHELINE_PAD(pad);
+
+  /**
+   * Index of the next element to push (producer)/pop (consumer). This is a
+   * monotonic counter; the position in the array is this value modulo the
+   * queue capacity.
+   */
+  size_t idx;
+
+  /**
+   * Last seen value of the OTHER side's \ref spscqueue_end.idx, so that the
+   * shared cache line only has to be read when the queue appears full/empty.
+   */
+  size_t cached;
+
+  /**
+   * Futex word the OTHER side sleeps on waiting for this side to make
+   * progress. Only used with \ref RCSW_SPSCQUEUE_FUTEX.
+   */
+  uint32_t seq;
+
+  /**
+   * Non-zero if the OTHER side is (about to be) sleeping on \ref
+   * spscqueue_end.seq.
+   */
+  uint32_t waiting;
+};
+
+/**
+ * \brief Single-producer, single-consumer queue.
+ *
+ * Pushes and pops are a handful of loads/stores with acquire/release ordering;
+ * no locks are taken, and the kernel is only entered when one side must wait
+ * and \ref RCSW_SPSCQUEUE_FUTEX was passed.
+ *
+ * Calling any of the push functions from more than one thread, or any of the
+ * pop functions from more than one thread, is undefined.
+ */
+struct spscqueue {
+  /**
+   * The element storage. Same layout as \ref fifo.
+   */
+  dptr_t* elements;
+
+  /**
+   * Size of elements in bytes.
+   */
+  size_t elt_size;
+
+  /**
+   * Maximum number of elements in the queue.
+   */
+  size_t max_elts;
+
+  /**
+   * \brief Configuration flags.
+   *
+   * Valid flags are:
+   *
+   * - \ref RCSW_NOALLOC_HANDLE
+   * - \ref RCSW_NOALLOC_DATA
+   * - \ref RCSW_ZALLOC
+   * - \ref RCSW_SPSCQUEUE_FUTEX
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+
+  /**
+   * Producer state.
+   */
+  struct spscqueue_end prod;
+
+  /**
+   * Consumer state.
+   */
+  struct spscqueue_end cons;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Determine # elements currently in the queue. The value returned by
+ * this function is only a snapshot in a multi-threaded context.
+ *
+ * \param queue The queue handle.
+ *
+ * \return # elements in queue, or 0 on ERROR.
+ */
+static inline size_t spscqueue_size(const struct spscqueue* const queue) {
+  RCSW_FPC_NV(0, NULL != queue);
+  size_t head = __atomic_load_n(&queue->cons.idx, __ATOMIC_ACQUIRE);
+  size_t tail = __atomic_load_n(&queue->prod.idx, __ATOMIC_ACQUIRE);
+  return tail - head;
+}
+
+/**
+ * \brief Determine if the queue is currently empty. The value returned by
+ * this function is only a snapshot in a multi-threaded context.
+ *
+ * \param queue The queue handle.
+ *
+ * \return \ref bool_t
+ */
+static inline bool_t spscqueue_isempty(const struct spscqueue* const queue) {
+  RCSW_FPC_NV(false, NULL != queue);
+  return 0 == spscqueue_size(queue);
+}
+
+/**
+ * \brief Determine if the queue is currently full. The value returned by
+ * this function is only a snapshot in a multi-threaded context.
+ *
+ * \param queue The queue handle.
+ *
+ * \return \ref bool_t
+ */
+static inline bool_t spscqueue_isfull(const struct spscqueue* const queue) {
+  RCSW_FPC_NV(false, NULL != queue);
+  return queue->max_elts == spscqueue_size(queue);
+}
+
+/**
+ * \brief Get the capacity of the queue.
+ *
+ * \param queue The queue handle.
+ *
+ * \return Queue capacity, or 0 on ERROR.
+ */
+static inline size_t spscqueue_capacity(const struct spscqueue* const queue) {
+  RCSW_FPC_NV(0, NULL != queue);
+  return queue->max_elts;
+}
+
+/**
+ * \brief Calculate the # of bytes that the queue will require if \ref
+ * RCSW_NOALLOC_DATA is passed to manage a specified # of elements of a
+ * specified size.
+ *
+ * \param max_elts # of desired elements the queue will hold.
+ * \param elt_size size of elements in bytes.
+ *
+ * \return The total # of bytes the application would need to allocate.
+ */
+static inline size_t spscqueue_element_space(size_t max_elts, size_t elt_size) {
+  return fifo_element_space(max_elts, elt_size);
+}
+
+/**
+ * \brief Initialize a SPSC queue.
+ *
+ * \param queue_in An application allocated handle for the queue. Can be NULL,
+ *                 depending on if \ref RCSW_NOALLOC_HANDLE is passed or not.
+ *
+ * \param params The initialization parameters.
+ *
+ * \return The initialized queue, or NULL if an error occurred.
+ */
+RCSW_API struct spscqueue* spscqueue_init(struct spscqueue* queue_in,
+                                          const struct spscqueue_params* params) RCSW_WUR;
+
+/**
+ * \brief Destroy a SPSC queue.
+ *
+ * Any further use of the queue handle after calling this function is undefined.
+ *
+ * \param queue The queue handle.
+ */
+RCSW_API void spscqueue_destroy(struct spscqueue* queue);
+
+/**
+ * \brief Push an item to the back of the queue if there is space for it,
+ * without waiting.
+ *
+ * Sets errno to EAGAIN if the queue is full.
+ *
+ * \param queue The queue handle.
+ * \param e The item to enqueue.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t spscqueue_trypush(struct spscqueue* queue, const void* e);
+
+/**
+ * \brief Push an item to the back of the queue, waiting if necessary for space
+ * to become available.
+ *
+ * \param queue The queue handle.
+ * \param e The item to enqueue.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t spscqueue_push(struct spscqueue* queue, const void* e);
+
+/**
+ * \brief Pop the first element in the queue if it exists, without waiting.
+ *
+ * Sets errno to EAGAIN if the queue is empty.
+ *
+ * \param queue The queue handle.
+ * \param e The item to dequeue. Can be NULL.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t spscqueue_trypop(struct spscqueue* queue, void* e);
+
+/**
+ * \brief Pop the first element in the queue, waiting if necessary for the
+ * queue to become non-empty.
+ *
+ * \param queue The queue handle.
+ * \param e The item to dequeue. Can be NULL.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t spscqueue_pop(struct spscqueue* queue, void* e);
+
+/**
+ * \brief Pop the first element in the queue, waiting until the timeout if
+ * necessary for the queue to become non-empty.
+ *
+ * \param queue The queue handle.
+ * \param to A RELATIVE timeout.
+ * \param e The item to dequeue. Can be NULL.
+ *
+ * \return \ref status_t. Sets errno to ETIMEDOUT if the timeout expired.
+ */
+RCSW_API status_t spscqueue_timedpop(struct spscqueue* queue,
+                                     const struct timespec* to,
+                                     void* e);
+
+/**
+ * \brief Get a reference to the first element in the queue, without removing
+ * it. Can only be called from the consumer thread.
+ *
+ * \param queue The queue handle.
+ *
+ * \return The first element, or NULL if the queue is empty.
+ */
+RCSW_API void* spscqueue_front(struct spscqueue* queue);
+
+END_C_DECLS
@@ -13,7 +13,219 @@
 /*******************************************************************************
  * Includes
  ******************************************************************************/
+#include <pthread.h>
+
 #include "rcsw/rcsw.h"
+#include "rcsw/common/flags.h"
+#include "rcsw/multithread/pcqueue.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Pin each worker thread in a \ref threadm_pool to its own core via
+ * \ref threadm_core_lock(), spreading workers across NUMA nodes (see \ref
+ * threadm_cpus_spread()).
+ */
+#define RCSW_THREADM_POOL_PIN (1 << (RCSW_MODFLAGS_START + 0))
+
+/**
+ * \brief Max # of CPUs \ref threadm_topology_discover() can handle. CPUs with
+ * higher IDs are ignored.
+ */
+#define RCSW_THREADM_MAX_CPUS 1024
+
+/**
+ * \brief Max # of NUMA nodes \ref threadm_topology_discover() can handle.
+ */
+#define RCSW_THREADM_MAX_NODES 64
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Thread pool initialization parameters.
+ */
+struct threadm_pool_params {
+  /** # of worker threads. 0 = one per core the process can run on. */
+  size_t n_threads;
+
+  /**
+   * Max # of tasks each worker can have queued locally (rounded up to a power
+   * of 2). Tasks submitted to a full worker queue are run immediately by the
+   * submitting thread.
+   */
+  size_t deque_size;
+
+  /**
+   * Max # of tasks submitted from threads outside the pool which can be
+   * queued. Tasks submitted when the queue is full are run immediately by the
+   * submitting thread.
+   */
+  size_t queue_size;
+
+  /**
+   * Index of the first allowed core to pin workers to with \ref
+   * RCSW_THREADM_POOL_PIN.
+   */
+  size_t core_offset;
+
+  /**
+   * Configuration flags. See \ref threadm_pool.flags for valid flags.
+   */
+  uint32_t flags;
+};
+
+/**
+ * \brief A NUMA node: a set of CPUs with the same local memory.
+ */
+struct threadm_numa_node {
+  /** The node's ID, as in /sys/devices/system/node/node<ID>. */
+  size_t id;
+
+  /** Bitset of the IDs of the CPUs on the node the process can run on. */
+  uint64_t cpus[RCSW_THREADM_MAX_CPUS / 64];
+
+  /** # of CPUs in \ref threadm_numa_node.cpus. */
+  size_t n_cpus;
+};
+
+/**
+ * \brief The NUMA nodes and CPUs the calling process can run on, as found by
+ * \ref threadm_topology_discover(). Nodes without any such CPUs are omitted.
+ * Other functions refer to nodes by their index in \ref
+ * threadm_topology.nodes, not their ID.
+ */
+struct threadm_topology {
+  /** The nodes, sorted by ID. */
+  struct threadm_numa_node nodes[RCSW_THREADM_MAX_NODES];
+
+  /** # of nodes. Always at least 1 after successful discovery. */
+  size_t n_nodes;
+
+  /** Total # of CPUs over all nodes. */
+  size_t n_cpus;
+
+  /** Index of the node each CPU is on, or -1 if the process can't use it. */
+  int16_t cpu_node[RCSW_THREADM_MAX_CPUS];
+};
+
+/**
+ * \brief A set of tasks which can be waited on together via \ref
+ * threadm_pool_wait(). Must be zero-initialized before use.
+ */
+struct threadm_group {
+  /** # of tasks in the group which have not finished yet; the futex word. */
+  uint32_t n_pending;
+};
+
+/**
+ * \brief A unit of work for a \ref threadm_pool. Allocated by the application,
+ * and must stay valid until it has run.
+ */
+struct threadm_task {
+  /** The work to do. */
+  void (*fn)(void* arg);
+
+  /** Passed to \ref threadm_task.fn. */
+  void* arg;
+
+  /** The group the task belongs to; set by \ref threadm_pool_submit(). */
+  struct threadm_group* group;
+};
+
+/**
+ * \brief Chase-Lev work-stealing deque. The owning worker pushes and pops tasks
+ * at the bottom without atomic read-modify-write operations (except when
+ * taking the last task); other workers steal from the top with a CAS.
+ */
+struct threadm_deque {
+  RCSW_CACHELINE_PAD(pad0);
+
+  /** Index of the oldest task; advanced by thieves (and the owner). */
+  int64_t top;
+
+  RCSW_CACHELINE_PAD(pad1);
+
+  /** Index one past the newest task. Only written by the owner. */
+  int64_t bottom;
+
+  /** Task storage, indexed modulo its size. */
+  struct threadm_task** tasks;
+
+  /** Size of \ref threadm_deque.tasks - 1. */
+  size_t mask;
+};
+
+/**
+ * \brief Per-worker state of a \ref threadm_pool.
+ */
+struct threadm_worker {
+  /** Tasks submitted by the worker, and tasks other workers can steal. */
+  struct threadm_deque deque;
+
+  /** The parent pool. */
+  struct threadm_pool* pool;
+
+  /** The worker thread. */
+  pthread_t thread;
+
+  /** Index of the worker in \ref threadm_pool.workers. */
+  size_t index;
+
+  /** State for picking which worker to steal from. */
+  uint64_t rng;
+
+  /** # of tasks run by the worker. */
+  size_t n_executed;
+
+  /** # of tasks the worker stole from other workers. */
+  size_t n_steals;
+};
+
+/**
+ * \brief A persistent pool of worker threads which execute tasks, with
+ * per-worker work-stealing deques for load balancing.
+ *
+ * Tasks submitted from a worker (i.e., from inside another task) go on that
+ * worker's deque, where they are run newest-first by the worker, and stolen
+ * oldest-first by idle workers. Tasks submitted from other threads go on a
+ * shared lock-free queue which all workers take from. Idle workers sleep on a
+ * single futex, and submitting only makes a system call if some worker is
+ * sleeping. Threads waiting for tasks to finish run queued tasks while they
+ * wait, so tasks can themselves submit tasks and wait for them.
+ */
+struct threadm_pool {
+  /** The workers. */
+  struct threadm_worker* workers;
+
+  /** # of workers. */
+  size_t n_workers;
+
+  /** Tasks submitted from threads outside the pool. */
+  struct pcqueue queue;
+
+  RCSW_CACHELINE_PAD(pad);
+
+  /** Bumped when a task is submitted; the futex word idle workers sleep on. */
+  uint32_t events;
+
+  /** # of workers sleeping on \ref threadm_pool.events. */
+  uint32_t n_sleepers;
+
+  /** Non-zero once \ref threadm_pool_destroy() has been called. */
+  uint32_t stop;
+
+  /**
+   * Valid flags are:
+   *
+   * - \ref RCSW_NOALLOC_HANDLE
+   * - \ref RCSW_THREADM_POOL_PIN
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+};
 
 /*******************************************************************************
  * Function Prototypes
@@ -22,13 +234,193 @@ BEGIN_C_DECLS
 
 /**
  * \brief Lock a thread to a core.
+ * \param thread The thread handle.
+ * \param core The core to lock to, 0-indexed.
+ * \return \ref status_t.
+ */
+status_t threadm_core_lock(pthread_t thread, size_t core);
+
+/**
+ * \brief Find the NUMA nodes and the CPUs on each that the calling process can
+ * run on.
+ *
+ * On linux, this parses /sys/devices/system/node and
+ * /sys/devices/system/cpu. If the kernel doesn't expose NUMA information
+ * (or elsewhere), all usable CPUs are put in a single node with ID 0.
+ *
+ * \param topo The topology to fill.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t threadm_topology_discover(struct threadm_topology* topo);
+
+/**
+ * \brief Get the node a CPU is on.
+ *
+ * \param topo The topology.
+ * \param cpu The CPU ID.
+ *
+ * \return Index of the node, or -1 if the CPU is not in the topology.
+ */
+RCSW_API int threadm_cpu_node(const struct threadm_topology* topo, size_t cpu);
+
+/**
+ * \brief Get the node the calling thread is currently running on.
+ *
+ * \param topo The topology.
+ *
+ * \return Index of the node, or 0 if it can't be determined.
+ */
+RCSW_API size_t threadm_node_current(const struct threadm_topology* topo);
+
+/**
+ * \brief Lock a thread to the CPUs of a NUMA node, letting the scheduler pick
+ * which one.
  *
  * \param thread The thread handle.
+ * \param topo The topology.
+ * \param node Index of the node.
  *
- * \param core The core to lock to, 0-indexed.
+ * \return \ref status_t.
+ */
+RCSW_API status_t threadm_node_lock(pthread_t thread,
+                                    const struct threadm_topology* topo,
+                                    size_t node);
+
+/**
+ * \brief Pick CPUs to run threads on, spread evenly across NUMA nodes: the
+ * first CPU of each node, then the second CPU of each node, and so on, so that
+ * threads get as much memory bandwidth as possible. If more CPUs are requested
+ * than exist, the list repeats.
+ *
+ * \param topo The topology.
+ * \param cpus The IDs of the chosen CPUs (to be filled).
+ * \param n_cpus # of CPUs to choose.
+ *
+ * \return # of CPUs put in \p cpus.
+ */
+RCSW_API size_t threadm_cpus_spread(const struct threadm_topology* topo,
+                                    size_t* cpus,
+                                    size_t n_cpus);
+
+/**
+ * \brief Allocate page-aligned memory whose pages are placed on a NUMA node
+ * when first touched, rather than on the node of the touching thread.
+ *
+ * If the kernel refuses the placement request (e.g., no NUMA support) the
+ * memory is still returned, with the default placement policy.
+ *
+ * \param topo The topology.
+ * \param node Index of the node.
+ * \param size Size of the allocation in bytes.
+ *
+ * \return The memory, or NULL if an ERROR occurred. Must be freed with \ref
+ * threadm_numa_free().
+ */
+RCSW_API void* threadm_numa_alloc(const struct threadm_topology* topo,
+                                  size_t node,
+                                  size_t size) RCSW_WUR;
+
+/**
+ * \brief Free memory from \ref threadm_numa_alloc().
+ *
+ * \param ptr The memory.
+ * \param size Size passed to \ref threadm_numa_alloc().
+ */
+RCSW_API void threadm_numa_free(void* ptr, size_t size);
+
+/**
+ * \brief Place the not-yet-touched pages of part of a \ref
+ * threadm_numa_alloc() allocation on a NUMA node, e.g., so that each thread's
+ * chunk of a shared array is local to it. Only pages entirely inside the range
+ * are affected.
+ *
+ * \param topo The topology.
+ * \param node Index of the node.
+ * \param addr Start of the range.
+ * \param len Length of the range in bytes.
  *
  * \return \ref status_t.
  */
-status_t threadm_core_lock(pthread_t thread, size_t core);
+RCSW_API status_t threadm_numa_bind(const struct threadm_topology* topo,
+                                    size_t node,
+                                    void* addr,
+                                    size_t len);
+
+/**
+ * \brief Initialize a thread pool and start its workers.
+ *
+ * \param pool_in The pool handle. Can be NULL, depending on if \ref
+ *                RCSW_NOALLOC_HANDLE is passed or not.
+ * \param params Initialization parameters.
+ *
+ * \return The initialized pool, or NULL if an ERROR occurred.
+ */
+RCSW_API struct threadm_pool* threadm_pool_init(
+    struct threadm_pool* pool_in,
+    const struct threadm_pool_params* params) RCSW_WUR;
+
+/**
+ * \brief Stop the workers and deallocate a thread pool. All submitted tasks
+ * must have finished.
+ *
+ * \param pool The pool handle.
+ */
+RCSW_API void threadm_pool_destroy(struct threadm_pool* pool);
+
+/**
+ * \brief Submit a task to run on the pool.
+ *
+ * \param pool The pool handle.
+ * \param group The group to add the task to, so it can be waited on. Can be
+ *              NULL.
+ * \param task The task, with \ref threadm_task.fn and \ref threadm_task.arg
+ *             filled in.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t threadm_pool_submit(struct threadm_pool* pool,
+                                      struct threadm_group* group,
+                                      struct threadm_task* task);
+
+/**
+ * \brief Wait until all tasks in a group have finished, running queued tasks
+ * in the meantime.
+ *
+ * \param pool The pool handle.
+ * \param group The group to wait on.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t threadm_pool_wait(struct threadm_pool* pool,
+                                    struct threadm_group* group);
+
+/**
+ * \brief Call \p fn on disjoint chunks covering [\p begin, \p end) in
+ * parallel, and wait for all of them to finish.
+ *
+ * Chunks are split off lazily: a thread running part of the range only hands
+ * off half of what it has left when the work it handed off previously has
+ * been taken by another thread, so the # of tasks created adapts to how many
+ * threads are actually free, and to how uneven the cost of each index is.
+ *
+ * \param pool The pool handle.
+ * \param begin First index.
+ * \param end One past the last index.
+ * \param grain Min # of indices to pass to \p fn at once (except for the last
+ *              chunk). 0 picks a size giving ~8 chunks per worker.
+ * \param fn Called with [lo, hi) for each chunk.
+ * \param arg Passed to \p fn.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t threadm_pool_parallel_for(struct threadm_pool* pool,
+                                            size_t begin,
+                                            size_t end,
+                                            size_t grain,
+                                            void (*fn)(size_t lo,
+                                                       size_t hi,
+                                                       void* arg),
+                                            void* arg);
 
 END_C_DECLS
@@ -19,6 +19,9 @@
 #include "rcsw/multithread/mpool.h"
 #include "rcsw/ds/rbuffer.h"
 #include "rcsw/multithread/rdwrlock.h"
+#include "rcsw/multithread/seqlock.h"
+#include "rcsw/multithread/ebr.h"
+#include "rcsw/tool/grind.h"
 
 /*******************************************************************************
  * Constant Definitions
@@ -43,6 +46,88 @@
  */
 #define RCSW_SWBUS_ASYNC (1 << RCSW_MODFLAGS_START )
 
+/**
+ * \brief Protect the \ref swbus_meta for a \ref swbus with a \ref seqlock
+ * instead of the bus mutex, so that \ref swbus_meta_get() never contends with
+ * publishers/subscribers.
+ */
+#define RCSW_SWBUS_SEQMETA (1 << (RCSW_MODFLAGS_START + 1))
+
+/**
+ * \brief Publish without taking the bus mutex.
+ *
+ * Publishers read the subscription table inside an \ref ebr critical section,
+ * and subscribe/unsubscribe replace the table with an updated copy instead of
+ * modifying it in place (still serialized by the bus mutex), so publishers to
+ * disjoint subscribers never contend with each other, and only contend with
+ * subscribers on the RXQs themselves.
+ *
+ * Each thread which publishes/subscribes uses one of \ref
+ * swbus_params.max_threads epoch records, which is released when it exits.
+ *
+ * Old tables can't be freed while a publisher is stuck in its critical
+ * section, e.g. blocked on a full RXQ with \ref ekSWBUS_RXQ_BLOCK. If enough
+ * of them pile up, subscribe/unsubscribe fail until it gets unstuck, instead
+ * of waiting for it.
+ *
+ * Without \ref RCSW_SWBUS_ASYNC publishers still serialize on \ref
+ * swbus.syncl for the duration of the fan-out, so this is mostly useful in
+ * combination with it.
+ */
+#define RCSW_SWBUS_LOCKFREE (1 << (RCSW_MODFLAGS_START + 2))
+
+/**
+ * \brief Timestamp packets when they are released to the bus, and measure the
+ * delivery latency to each RXQ when they are received (see \ref
+ * swbus_rxq_stats). Costs a clock read per release and per receive.
+ */
+#define RCSW_SWBUS_LATENCY (1 << (RCSW_MODFLAGS_START + 3))
+
+/**
+ * \brief Max # of distinct PIDs latency is traced for per bus with \ref
+ * RCSW_CONFIG_SWBUS_TRACE. Packets with other PIDs are not traced.
+ */
+#define RCSW_SWBUS_TRACE_MAX_PIDS 64
+
+/**
+ * \brief # of packets \ref swbus_publish_batch() reserves space for and
+ * releases to the bus at a time.
+ */
+#define RCSW_SWBUS_BATCH_MAX 32
+
+/*******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+/**
+ * \brief What happens when a packet is published to a PID an RXQ is subscribed
+ * to and the RXQ is full.
+ *
+ * With anything other than \ref ekSWBUS_RXQ_BLOCK publishers never wait on the
+ * RXQ, and packets which are lost are counted in \ref swbus_rxq_stats.n_drops
+ * instead of \ref swbus_meta.n_notify_fails.
+ */
+enum swbus_rxq_policy {
+  /**
+   * Wait (holding the bus mutex, unless \ref RCSW_SWBUS_LOCKFREE) until the
+   * subscriber makes space. The default.
+   */
+  ekSWBUS_RXQ_BLOCK,
+
+  /** Drop the packet being published. */
+  ekSWBUS_RXQ_DROP_NEWEST,
+
+  /** Drop the oldest packet in the RXQ to make space. */
+  ekSWBUS_RXQ_DROP_OLDEST,
+
+  /**
+   * Keep only the latest packet for each PID: a packet replaces the most
+   * recent packet with the same PID still in the RXQ, keeping its place in
+   * line. If there is no such packet and the RXQ is full, the packet being
+   * published is dropped.
+   */
+  ekSWBUS_RXQ_CONFLATE,
+};
+
 /*******************************************************************************
  * Structure Definitions
  ******************************************************************************/
@@ -66,6 +151,12 @@ struct swbus_params {
   /** Max # of subscribers to a particular packet ID. */
   size_t max_subs;
 
+  /**
+   * Max # of threads which can publish/subscribe at once with \ref
+   * RCSW_SWBUS_LOCKFREE. Ignored otherwise.
+   */
+  size_t max_threads;
+
   /**
    * Configuration flags.
    *
@@ -75,6 +166,9 @@ struct swbus_params {
    * - \ref RCSW_NOALLOC_HANDLE
    * - \ref RCSW_SWBUS_NOALLOC_POOLS
    * - \ref RCSW_SWBUS_ASYNC
+   * - \ref RCSW_SWBUS_SEQMETA
+   * - \ref RCSW_SWBUS_LOCKFREE
+   * - \ref RCSW_SWBUS_LATENCY
    *
    * All other flags are ignored.
    */
@@ -105,6 +199,21 @@ struct swbus_rxq_ent {
 
   /** The buffer pool entry that the data resides in. */
   struct mpool *bp;
+
+  /**
+   * When the packet was released to the bus (monotonic, in nanoseconds) if
+   * \ref RCSW_SWBUS_LATENCY was passed or \ref RCSW_CONFIG_SWBUS_TRACE is
+   * defined, and 0 otherwise.
+   */
+  uint64_t released_at;
+
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  /** When the buffer for the packet was reserved, or 0 if unknown. */
+  uint64_t reserved_at;
+
+  /** When the packet was removed from the RXQ. */
+  uint64_t dequeued_at;
+#endif
 };
 
 /**
@@ -135,13 +244,21 @@ struct swbus_rsrvn {
 
   /** The \ref mpool that the actual data resides in. */
   struct mpool *bp;
+
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  /**
+   * When the buffer was reserved (monotonic, in nanoseconds). Should be 0 for
+   * manually created reservations, unless the application sets it.
+   */
+  uint64_t reserved_at;
+#endif
 };
 
 /**
  * \brief SWB subscription (maps a PID to an RXQ).
  *
  * Every time a task/thread subscribes to a packet ID, they get an subscription
- * entry, which is inserted into the sorted subscriber array for the swb
+ * entry, which is inserted into the sorted subscription table for the swb
  * instance.
  */
 struct swbus_sub {
@@ -156,6 +273,224 @@ struct swbus_sub {
   struct pcqueue *subscriber;
 };
 
+/**
+ * \brief SWB subscription table: all subscriptions, sorted by PID and then by
+ * RXQ, so that the subscribers to a given PID are contiguous and publishing
+ * only touches them.
+ */
+struct swbus_subtab {
+  /** # entries in \ref swbus_subtab.subs. */
+  size_t n_subs;
+
+  /** The subscriptions. */
+  struct swbus_sub subs[];
+};
+
+/**
+ * \brief SWB wildcard subscription: maps a range of PIDs or all PIDs matching
+ * a mask to an RXQ.
+ *
+ * Mask subscriptions whose mask is all ones followed by all zeros (e.g.,
+ * 0xFFFFF000) are stored as the equivalent range.
+ */
+struct swbus_wsub {
+  /** First PID in the range, or the value to match under the mask. */
+  uint32_t lo;
+
+  /** Last PID in the range. Equal to \ref swbus_wsub.lo for masks. */
+  uint32_t hi;
+
+  /** 0 for a range, otherwise match PIDs for which (pid & mask) == lo. */
+  uint32_t mask;
+
+  /** The \ref pcqueue (RXQ) subscriber. */
+  struct pcqueue *subscriber;
+};
+
+/**
+ * \brief SWB wildcard routing table: the RXQs matching each PID for all \ref
+ * swbus_wsub, precomputed on every wildcard subscribe/unsubscribe.
+ *
+ * Ranges divide the PID space into segments with the same set of subscribed
+ * RXQs, found by binary search. Masks are grouped by mask, and the values for
+ * each mask are binary searched. All arrays live in \ref swbus_routes.data, so
+ * the table is a single allocation.
+ */
+struct swbus_routes {
+  /** # 64-bit words in each bitset of RXQ indices. */
+  size_t n_words;
+
+  /** # segments. */
+  size_t n_segs;
+
+  /** # distinct masks. */
+  size_t n_masks;
+
+  /** First PID of each segment, sorted. The first segment starts at 0. */
+  uint32_t *seg_lo;
+
+  /** RXQ bitset for each segment. */
+  uint64_t *seg_sets;
+
+  /** The distinct masks. */
+  uint32_t *masks;
+
+  /**
+   * The values for mask \c i are at indices [mask_start[i], mask_start[i+1])
+   * in \ref swbus_routes.mvals, sorted.
+   */
+  size_t *mask_start;
+
+  /** Values to match under each mask. */
+  uint32_t *mvals;
+
+  /** RXQ bitset for each value in \ref swbus_routes.mvals. */
+  uint64_t *mval_sets;
+
+  /** Storage for the arrays. */
+  uint64_t data[];
+};
+
+/**
+ * \brief SWB subscriber metadata: a small, read-mostly summary of who is on the
+ * bus.
+ */
+struct swbus_meta {
+  /** Number of active receive queues. */
+  size_t n_rxqs;
+
+  /** Number of active subscriptions (RXQ-pid pairs and wildcards). */
+  size_t n_subs;
+
+  /** Number of packets released to the bus. */
+  size_t n_published;
+
+  /** Number of times an RXQ could not be notified of a packet. */
+  size_t n_notify_fails;
+};
+
+/**
+ * \brief Per-RXQ delivery statistics. Counters are updated with relaxed atomics
+ * by publishers and subscribers, so a snapshot is not necessarily consistent
+ * across fields.
+ */
+struct swbus_rxq_stats {
+  /** # packets added to the RXQ (including ones which replaced another). */
+  size_t n_enqueued;
+
+  /**
+   * # packets lost because the RXQ was full (the packet being published or one
+   * evicted to make space for it), or replaced via \ref ekSWBUS_RXQ_CONFLATE.
+   */
+  size_t n_drops;
+
+  /** Max # of packets which have been in the RXQ at once. */
+  size_t hwm;
+
+  /** # packets the delivery latency was measured for. */
+  size_t n_delivered;
+
+  /**
+   * Total time from release to receipt for measured packets, in nanoseconds.
+   * Only measured with \ref RCSW_SWBUS_LATENCY.
+   */
+  uint64_t latency_total;
+
+  /** Max time from release to receipt for a measured packet. */
+  uint64_t latency_max;
+};
+
+/**
+ * \brief Per-RXQ state the bus keeps alongside each \ref pcqueue.
+ */
+struct swbus_rxq_info {
+  /** What to do when the RXQ is full. */
+  enum swbus_rxq_policy policy;
+
+  /** Delivery statistics. */
+  struct swbus_rxq_stats stats;
+
+  /** The \ref swbus_rxq_set the RXQ belongs to, if any. */
+  struct swbus_rxq_set* set;
+
+  /**
+   * # of publishers currently signalling \ref swbus_rxq_info.set, so that
+   * removing the RXQ from the set can wait for them to finish.
+   */
+  uint32_t n_signalers;
+};
+
+/**
+ * \brief A set of RXQs on the same bus which one thread can wait on at once,
+ * like epoll for file descriptors.
+ *
+ * Waiters all sleep on a single event counter, which publishers bump after
+ * pushing packets to any RXQ in the set, rather than on per-RXQ semaphores.
+ * Publishers only make a system call to wake the set when someone is actually
+ * waiting on it.
+ */
+struct swbus_rxq_set {
+  /** The bus the RXQs in the set belong to. */
+  struct swbus* swb;
+
+  /** Bitset of the indices of the RXQs in the set. */
+  uint64_t* members;
+
+  /** # of RXQs in the set. */
+  size_t n_members;
+
+  /**
+   * Index of the RXQ to check first when looking for ready RXQs, so that a
+   * busy RXQ can't starve the others.
+   */
+  size_t next;
+
+  /** Bumped when a packet is pushed to an RXQ in the set; the futex word. */
+  uint32_t events;
+
+  /** # of threads waiting on the set. */
+  uint32_t n_waiters;
+
+  /**
+   * Valid flags are:
+   *
+   * - \ref RCSW_NOALLOC_HANDLE
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+};
+
+/**
+ * \brief Latency histograms for all traced packets with a given PID, in
+ * nanoseconds, with \ref RCSW_CONFIG_SWBUS_TRACE.
+ */
+struct swbus_trace_stats {
+  /** The PID. */
+  uint32_t pid;
+
+  /** Time from reserving a buffer to releasing the packet to the bus. */
+  struct grind_hist publish;
+
+  /** Time from releasing the packet to the bus to receiving it. */
+  struct grind_hist queue;
+
+  /** Time from reserving a buffer to receiving the packet. */
+  struct grind_hist total;
+};
+
+/**
+ * \brief Slot for a PID in the table of \ref swbus_trace_stats, claimed the
+ * first time a packet with the PID is received.
+ */
+struct swbus_trace {
+  /** 0 = free, 1 = being claimed, 2 = in use. */
+  uint32_t state;
+
+  /** The latency histograms. */
+  struct swbus_trace_stats stats;
+};
+
 /**
  * \brief Manage publisher-subscriber needs in an embedded environment.
  *
@@ -166,8 +501,11 @@ struct swbus {
   /** # buffer pools (static during lifetime). */
   size_t n_pools;
 
-  /** Number of active receive queues (dynamic during lifetime). */
-  size_t n_rxqs;
+  /** Subscriber metadata (dynamic during lifetime). */
+  struct swbus_meta meta;
+
+  /** Protects \ref swbus.meta if \ref RCSW_SWBUS_SEQMETA is passed. */
+  struct seqlock meta_sl;
 
   /** Max number of receive queues allowed. */
   size_t max_rxqs;
@@ -186,6 +524,9 @@ struct swbus {
    * - \ref RCSW_NOALLOC_HANDLE
    * - \ref RCSW_SWBUS_NOALLOC_POOLS
    * - \ref RCSW_SWBUS_ASYNC
+   * - \ref RCSW_SWBUS_SEQMETA
+   * - \ref RCSW_SWBUS_LOCKFREE
+   * - \ref RCSW_SWBUS_LATENCY
    *
    * All other flags are ignored.
    */
@@ -204,8 +545,67 @@ struct swbus {
    */
   struct pcqueue *rxqs;
 
-  /** List of \ref swbus_sub. Always sorted. */
-  struct llist *subscribers;
+  /**
+   * Overflow policy and statistics for each receive queue, parallel to \ref
+   * swbus.rxqs.
+   */
+  struct swbus_rxq_info *rxq_infos;
+
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  /**
+   * Open addressed table of per-PID latency histograms, with \ref
+   * RCSW_SWBUS_TRACE_MAX_PIDS slots.
+   */
+  struct swbus_trace *traces;
+#endif
+
+  /**
+   * The subscription table. Has space for \ref swbus.max_subs entries and is
+   * modified in place, or is replaced on every subscribe/unsubscribe with
+   * \ref RCSW_SWBUS_LOCKFREE.
+   */
+  struct swbus_subtab *subtab;
+
+  /**
+   * Wildcard subscriptions, with space for \ref swbus.max_subs
+   * entries. Protected by the bus mutex; publishers use \ref swbus.routes.
+   */
+  struct swbus_wsub *wsubs;
+
+  /** # entries in \ref swbus.wsubs. */
+  size_t n_wsubs;
+
+  /**
+   * Routing table for \ref swbus.wsubs, or NULL if there are none. Replaced on
+   * every wildcard subscribe/unsubscribe.
+   */
+  struct swbus_routes *routes;
+
+  /**
+   * Scratch RXQ bitsets for matching wildcard subscriptions when publishing,
+   * (\ref swbus.max_rxqs + 63) / 64 words each. One per \ref ebr_rec with
+   * \ref RCSW_SWBUS_LOCKFREE, since publishers can then run concurrently, and
+   * a single one otherwise, since publishers hold the bus mutex.
+   */
+  uint64_t *wild;
+
+  /**
+   * Protects readers of \ref swbus.subtab from it being freed out from under
+   * them with \ref RCSW_SWBUS_LOCKFREE.
+   */
+  struct ebr ebr;
+
+  /** Each thread's \ref ebr_rec with \ref RCSW_SWBUS_LOCKFREE. */
+  pthread_key_t ebr_key;
+
+  /**
+   * Whether \ref swbus.meta_sl, \ref swbus.ebr, and \ref swbus.ebr_key have
+   * been created, so a bus whose initialization failed part way through can be
+   * destroyed.
+   */
+  bool_t meta_sl_valid;
+  bool_t ebr_valid;
+  bool_t ebr_key_valid;
 
   /**
    * Prevents applications from servicing their receive queues for the packet
@@ -278,6 +678,123 @@ RCSW_API struct pcqueue *swbus_rxq_init(struct swbus * swb,
                                         void * buf_p,
                                         uint32_t n_entries) RCSW_WUR;
 
+/**
+ * \brief Set what happens when a packet is published to a full receive queue.
+ *
+ * With \ref ekSWBUS_RXQ_DROP_OLDEST or \ref ekSWBUS_RXQ_CONFLATE packets can
+ * be removed/overwritten from the queue by publishers, so the subscriber must
+ * receive with \ref swbus_rxq_wait_n() rather than \ref swbus_rxq_wait()
+ * and friends, which return a reference into the queue.
+ *
+ * \param swb The swb handle.
+ * \param queue The RXQ.
+ * \param policy The new policy. Newly created RXQs use \ref
+ *               ekSWBUS_RXQ_BLOCK.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_rxq_policy_set(struct swbus* swb,
+                                       struct pcqueue* queue,
+                                       enum swbus_rxq_policy policy);
+
+/**
+ * \brief Get a snapshot of the delivery statistics for a receive queue.
+ *
+ * \param swb The swb handle.
+ * \param queue The RXQ.
+ * \param stats The statistics to be filled.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_rxq_stats_get(struct swbus* swb,
+                                      struct pcqueue* queue,
+                                      struct swbus_rxq_stats* stats);
+
+/**
+ * \brief Initialize an (empty) set of RXQs to wait on.
+ *
+ * \param swb The swb handle.
+ * \param set_in The set handle. Can be NULL, depending on if \ref
+ *               RCSW_NOALLOC_HANDLE is passed or not.
+ * \param flags Configuration flags. See \ref swbus_rxq_set.flags for valid
+ *              flags.
+ *
+ * \return The initialized set, or NULL if an ERROR occurred.
+ */
+RCSW_API struct swbus_rxq_set* swbus_rxq_set_init(struct swbus* swb,
+                                                  struct swbus_rxq_set* set_in,
+                                                  uint32_t flags) RCSW_WUR;
+
+/**
+ * \brief Remove all RXQs from a set and deallocate it. No thread can be
+ * waiting on the set.
+ *
+ * \param set The set handle.
+ */
+RCSW_API void swbus_rxq_set_destroy(struct swbus_rxq_set* set);
+
+/**
+ * \brief Add an RXQ to a set. An RXQ can belong to at most one set at a time.
+ *
+ * \param set The set handle.
+ * \param queue The RXQ to add.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_rxq_set_add(struct swbus_rxq_set* set,
+                                    struct pcqueue* queue);
+
+/**
+ * \brief Remove an RXQ from a set. Once this returns, publishers no longer
+ * touch the set when pushing packets to the RXQ.
+ *
+ * \param set The set handle.
+ * \param queue The RXQ to remove.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_rxq_set_remove(struct swbus_rxq_set* set,
+                                       struct pcqueue* queue);
+
+/**
+ * \brief Wait until at least one RXQ in the set is not empty.
+ *
+ * Ready RXQs are returned starting after the last RXQ returned by the previous
+ * wait, so that all RXQs get serviced even if there is not room for all ready
+ * RXQs in \p ready. Packets are then received from each RXQ as usual, e.g.,
+ * with \ref swbus_rxq_wait_n(), which will not block if the calling thread is
+ * the only subscriber using the RXQ.
+ *
+ * \param set The set handle.
+ * \param ready The ready RXQs (to be filled).
+ * \param max_ready Max # of RXQs to put in \p ready.
+ * \param n_ready # of RXQs put in \p ready (to be filled).
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_rxq_set_wait(struct swbus_rxq_set* set,
+                                     struct pcqueue** ready,
+                                     size_t max_ready,
+                                     size_t* n_ready);
+
+/**
+ * \brief Wait (until a timeout) until at least one RXQ in the set is not empty.
+ *
+ * \param set The set handle.
+ * \param ready The ready RXQs (to be filled).
+ * \param max_ready Max # of RXQs to put in \p ready.
+ * \param n_ready # of RXQs put in \p ready (to be filled).
+ * \param to A RELATIVE timeout.
+ *
+ * \return \ref status_t. If the timeout expired with no RXQ ready, ERROR is
+ * returned and errno is set to ETIMEDOUT.
+ */
+RCSW_API status_t swbus_rxq_set_timedwait(struct swbus_rxq_set* set,
+                                          struct pcqueue** ready,
+                                          size_t max_ready,
+                                          size_t* n_ready,
+                                          const struct timespec* to);
+
 /**
  * \brief Subscribe the specified RXQ to the specified packet ID.
  *
@@ -304,6 +821,65 @@ RCSW_API status_t swbus_unsubscribe(struct swbus * swb,
                                     struct pcqueue * queue,
                                     uint32_t pid);
 
+/**
+ * \brief Subscribe the specified RXQ to all PIDs in a range.
+ *
+ * Publishing to a PID covered by any number of wildcard subscriptions costs
+ * O(log # subscriptions + # matching RXQs). An RXQ receives a packet only once
+ * no matter how many of its subscriptions match the PID.
+ *
+ * \param swb The swb handle.
+ * \param queue The RXQ to subscribe.
+ * \param lo The first PID to subscribe to.
+ * \param hi The last PID to subscribe to.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_subscribe_range(struct swbus* swb,
+                                        struct pcqueue* queue,
+                                        uint32_t lo,
+                                        uint32_t hi);
+
+/**
+ * \brief Subscribe the specified RXQ to all PIDs for which (pid & \p mask) ==
+ * (\p value & \p mask).
+ *
+ * Masks which select a contiguous block of PIDs (e.g., 0xFFFFF000) are
+ * equivalent to \ref swbus_subscribe_range(). Publishing costs an additional
+ * O(log # subscriptions) for each other distinct mask subscribed to.
+ *
+ * \param swb The swb handle.
+ * \param queue The RXQ to subscribe.
+ * \param value The value to match.
+ * \param mask The bits of the PID which must match.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_subscribe_mask(struct swbus* swb,
+                                       struct pcqueue* queue,
+                                       uint32_t value,
+                                       uint32_t mask);
+
+/**
+ * \brief Remove a subscription made with \ref swbus_subscribe_range().
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_unsubscribe_range(struct swbus* swb,
+                                          struct pcqueue* queue,
+                                          uint32_t lo,
+                                          uint32_t hi);
+
+/**
+ * \brief Remove a subscription made with \ref swbus_subscribe_mask().
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_unsubscribe_mask(struct swbus* swb,
+                                         struct pcqueue* queue,
+                                         uint32_t value,
+                                         uint32_t mask);
+
 /**
  * \brief Publish a packet to the bus.
  *
@@ -366,6 +942,31 @@ RCSW_API status_t swbus_publish_release(struct swbus* swb,
                                         struct swbus_rsrvn* res,
                                         size_t pkt_size);
 
+/**
+ * \brief Publish a batch of packets to the bus.
+ *
+ * Equivalent to calling \ref swbus_publish() for each packet in order, but the
+ * bus mutex and sync lock are taken once per \ref RCSW_SWBUS_BATCH_MAX packets
+ * instead of once per packet, subscribers are looked up once per run of
+ * consecutive packets with the same PID, each run is pushed to each subscribed
+ * RXQ all at once, and consecutive packets of the same size are reserved from
+ * the same buffer pool without searching.
+ *
+ * \param swb The swb handle.
+ * \param pids The packet IDs.
+ * \param pkt_sizes The sizes of the packets in bytes.
+ * \param pkts The packets to publish.
+ * \param n_pkts # of packets in the batch.
+ *
+ * \return \ref status_t. If space could not be reserved for a packet, the
+ * packets before it are still published, and ERROR is returned.
+ */
+RCSW_API status_t swbus_publish_batch(struct swbus* swb,
+                                      const uint32_t* pids,
+                                      const size_t* pkt_sizes,
+                                      const void* const* pkts,
+                                      size_t n_pkts);
+
 /**
  * \brief Wait (indefinitely) until the given receive queue is not empty,
  * returning a reference to the first item in the queue.
@@ -402,9 +1003,47 @@ RCSW_API struct swbus_rxq_ent* swbus_rxq_timedwait(struct swbus* swb,
                                                    struct pcqueue * queue,
                                                    struct timespec * to) RCSW_WUR;
 
+/**
+ * \brief Wait (indefinitely) until the given receive queue is not empty, and
+ * then remove as many packets as are available from it (up to \p max) at once.
+ *
+ * Unlike \ref swbus_rxq_wait(), the packets are removed from the queue, so
+ * they must be released with \ref swbus_rxq_release_n() instead of \ref
+ * swbus_rxq_pop_front() when you are finished with them.
+ *
+ * \param swb The swb handle.
+ * \param queue The receive queue to wait on.
+ * \param ents Array of at least \p max entries to receive into.
+ * \param max Max # of packets to receive.
+ * \param got Filled with the # of packets received.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_rxq_wait_n(struct swbus* swb,
+                                   struct pcqueue* queue,
+                                   struct swbus_rxq_ent* ents,
+                                   size_t max,
+                                   size_t* got);
+
+/**
+ * \brief Release packets received via \ref swbus_rxq_wait_n().
+ *
+ * \param ents The received packets.
+ * \param n_ents # of received packets.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_rxq_release_n(const struct swbus_rxq_ent* ents,
+                                      size_t n_ents);
+
 /**
  * \brief Remove and release the front element from the selected receive queue.
  *
+ * The packet counts as received for \ref swbus_rxq_stats and tracing here,
+ * not when it was peeked.
+ *
+ * \param swb The swb handle.
+ *
  * \param queue The parent \ref pcqueue of the packet.
  *
  * \param ent The previously "peeked" element from \ref swbus_rxq_front(), \ref
@@ -412,7 +1051,71 @@ RCSW_API struct swbus_rxq_ent* swbus_rxq_timedwait(struct swbus* swb,
  *
  * \return \ref status_t.
  */
-RCSW_API status_t swbus_rxq_pop_front(struct pcqueue* queue,
+RCSW_API status_t swbus_rxq_pop_front(struct swbus* swb,
+                                      struct pcqueue* queue,
                                       struct swbus_rxq_ent * ent);
 
+/**
+ * \brief Get a snapshot of the latency histograms for packets with a PID.
+ *
+ * Packets are traced when they are received via \ref swbus_rxq_wait_n() or
+ * \ref swbus_rxq_pop_front(). Always fails unless \ref RCSW_CONFIG_SWBUS_TRACE is defined.
+ *
+ * \param swb The swb handle.
+ * \param pid The PID.
+ * \param stats The histograms to be filled.
+ *
+ * \return \ref status_t. ERROR if no packets with the PID have been traced.
+ */
+RCSW_API status_t swbus_trace_snapshot(const struct swbus* swb,
+                                       uint32_t pid,
+                                       struct swbus_trace_stats* stats);
+
+/**
+ * \brief Call a function with a snapshot of the latency histograms for each
+ * traced PID.
+ *
+ * \param swb The swb handle.
+ * \param cb Callback.
+ * \param arg Passed to the callback.
+ *
+ * \return The # of traced PIDs (0 unless \ref RCSW_CONFIG_SWBUS_TRACE is
+ * defined).
+ */
+RCSW_API size_t swbus_trace_foreach(const struct swbus* swb,
+                                    void (*cb)(const struct swbus_trace_stats*,
+                                               void*),
+                                    void* arg);
+
+/**
+ * \brief Report the latency histograms for each traced PID to stdout via \ref
+ * grind_hist_report().
+ *
+ * \param swb The swb handle.
+ */
+RCSW_API void swbus_trace_report(const struct swbus* swb);
+
+/**
+ * \brief Reset the latency histograms for all traced PIDs.
+ *
+ * \param swb The swb handle.
+ */
+RCSW_API void swbus_trace_reset(struct swbus* swb);
+
+/**
+ * \brief Get a consistent snapshot of the subscriber metadata for a bus.
+ *
+ * Takes the bus mutex, unless \ref RCSW_SWBUS_SEQMETA was passed, in which case
+ * it never blocks publishers/subscribers. With \ref RCSW_SWBUS_LOCKFREE, the
+ * publish counters are updated outside of the mutex/seqlock, so they may be
+ * slightly ahead of the rest of the snapshot.
+ *
+ * \param swb The swb handle.
+ *
+ * \param meta The metadata to be filled.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_meta_get(struct swbus* swb, struct swbus_meta* meta);
+
 END_C_DECLS
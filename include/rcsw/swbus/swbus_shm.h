@@ -0,0 +1,557 @@
+/**
+ * \file swbus_shm.h
+ * \ingroup swb
+ * \brief A \ref swbus whose buffer pools, receive queues, and subscriptions
+ * live in a POSIX shared memory segment, so that publishers and subscribers
+ * can be in different processes on the same host.
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <pthread.h>
+#include <time.h>
+
+#include "rcsw/rcsw.h"
+#include "rcsw/multithread/mpool.h"
+#include "rcsw/swbus/swbus.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief Magic # identifying an initialized \ref swbus_shm segment.
+ */
+#define RCSW_SWBUS_SHM_MAGIC 0x5357424DU
+
+/**
+ * \brief Version of the \ref swbus_shm segment layout. Processes built against
+ * different layouts refuse to attach to each other's segments.
+ */
+#define RCSW_SWBUS_SHM_VERSION 2
+
+/**
+ * \brief Max length of the name of a \ref swbus_shm segment, including the
+ * leading '/' and the NULL terminator.
+ */
+#define RCSW_SWBUS_SHM_MAX_NAMELEN 64
+
+/*******************************************************************************
+ * Type Definitions
+ ******************************************************************************/
+/**
+ * \brief A buffer handle: the offset of a packet buffer from the start of the
+ * shared memory segment, which (unlike a pointer) is the same in every process
+ * attached to the segment.
+ */
+typedef uint64_t swbus_shm_off_t;
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief \ref swbus_shm initialization parameters.
+ */
+struct swbus_shm_params {
+  /**
+   * The buffer pools to create in the segment. Only \ref mpool_params.elt_size
+   * and \ref mpool_params.max_elts are used.
+   */
+  struct mpool_params* pools;
+
+  /** # of buffer pools. */
+  size_t max_pools;
+
+  /** Max # of receive queues for the bus. */
+  size_t max_rxqs;
+
+  /** Max # of subscriptions (RXQ-pid pairs) for the bus. */
+  size_t max_subs;
+
+  /** Capacity of each receive queue. */
+  size_t rxq_size;
+
+  /**
+   * Configuration flags.
+   *
+   * Valid flags are:
+   *
+   * - \ref RCSW_NOALLOC_HANDLE
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+
+  /**
+   * Name for \ref swbus_shm instance. Used to assist with debugging if
+   * multiple SWB instances are active. Has no effect on SWB operation.
+   */
+  char name[RCSW_SWBUS_MAX_NAMELEN];
+};
+
+/**
+ * \brief A buffer pool in a \ref swbus_shm segment.
+ *
+ * Free chunks are kept on a lock-free stack linked by chunk index, and each
+ * chunk has a reference count, all in the segment itself, so that any attached
+ * process can allocate or release chunks.
+ */
+struct swbus_shm_pool {
+  /** Size of each chunk in bytes. */
+  uint64_t elt_size;
+
+  /** # of chunks in the pool. */
+  uint64_t max_elts;
+
+  /**
+   * Distance between chunks in bytes: \ref swbus_shm_pool.elt_size rounded up
+   * to \ref RCSW_CACHELINE_SIZE, so that chunks written by different
+   * processes never share a cache line.
+   */
+  uint64_t chunk_size;
+
+  /** Offset of the first chunk. */
+  swbus_shm_off_t chunks_off;
+
+  /** Offset of the per-chunk reference counts (uint32_t). */
+  swbus_shm_off_t refs_off;
+
+  /** Offset of the per-chunk free list links (uint32_t). */
+  swbus_shm_off_t next_off;
+
+  /**
+   * Top of the free list: the index of the first free chunk in the lower 32
+   * bits, and a generation count in the upper 32 bits to defeat ABA.
+   */
+  uint64_t free_head;
+
+  /** # of allocated chunks. */
+  uint64_t n_alloc;
+};
+
+/**
+ * \brief A receive queue entry as stored in the segment.
+ */
+struct swbus_shm_cell {
+  /**
+   * Sequence # of the cell, which tells producers and consumers whose turn it
+   * is to use the cell.
+   */
+  uint64_t seq;
+
+  /** Handle of the packet buffer. */
+  swbus_shm_off_t off;
+
+  /** Packet size in bytes. */
+  uint64_t pkt_size;
+
+  /** Packet ID. */
+  uint32_t pid;
+
+  /** Index of the buffer pool the packet buffer is in. */
+  uint32_t pool;
+};
+
+/**
+ * \brief A receive queue (RXQ) in a \ref swbus_shm segment.
+ *
+ * A bounded multi-producer multi-consumer ring, so that publishers in any
+ * process can push to it without a lock. Subscribers sleep on \ref
+ * swbus_shm_rxq.signal, which publishers bump after every push.
+ */
+struct swbus_shm_rxq {
+  /** Is the RXQ in use by some process? */
+  uint32_t in_use;
+
+  /** Index of the RXQ in the segment. */
+  uint32_t id;
+
+  /** Futex word, bumped whenever a packet is pushed to the RXQ. */
+  uint32_t signal;
+
+  /**
+   * # of subscribers sleeping on \ref swbus_shm_rxq.signal, so publishers can
+   * skip the wakeup syscall if there are none.
+   */
+  uint32_t n_waiters;
+
+  /** Capacity of the RXQ. */
+  uint64_t capacity;
+
+  /** Position of the next push. */
+  uint64_t enq_pos;
+
+  /** Position of the next pop. */
+  uint64_t deq_pos;
+
+  /** Offset of the RXQ cells (\ref swbus_shm_cell). */
+  swbus_shm_off_t cells_off;
+};
+
+/**
+ * \brief A subscription in a \ref swbus_shm segment (maps a PID to an RXQ).
+ *
+ * Subscriptions are kept sorted by PID and then by RXQ, as with \ref
+ * swbus_subtab.
+ */
+struct swbus_shm_sub {
+  /** ID of subscribed packet. */
+  uint32_t pid;
+
+  /** Index of the subscribed RXQ. */
+  uint32_t rxq;
+};
+
+/**
+ * \brief The header at the start of a \ref swbus_shm segment. Everything else
+ * in the segment is found through the offsets in it.
+ */
+struct swbus_shm_hdr {
+  /**
+   * \ref RCSW_SWBUS_SHM_MAGIC once the segment is initialized. Written last
+   * by the creator, so processes which attach wait until it is set.
+   */
+  uint32_t magic;
+
+  /** \ref RCSW_SWBUS_SHM_VERSION of the creator. */
+  uint32_t version;
+
+  /** Size of the segment in bytes. */
+  uint64_t size;
+
+  /**
+   * Process-shared lock which serializes subscription table updates against
+   * publishers fanning out. It is robust, so that a process which dies holding
+   * it does not wedge the segment: the next process to take it repairs the
+   * subscription table and carries on.
+   */
+  pthread_mutex_t lock;
+
+  /** # of buffer pools. */
+  uint32_t n_pools;
+
+  /** Max # of receive queues. */
+  uint32_t max_rxqs;
+
+  /** Max # of subscriptions. */
+  uint32_t max_subs;
+
+  /** # of active subscriptions. */
+  uint64_t n_subs;
+
+  /** # of active receive queues. */
+  uint64_t n_rxqs;
+
+  /** # of packets released to the bus. */
+  uint64_t n_published;
+
+  /** # of times an RXQ could not be notified of a packet. */
+  uint64_t n_notify_fails;
+
+  /** Offset of the buffer pools (\ref swbus_shm_pool). */
+  swbus_shm_off_t pools_off;
+
+  /** Offset of the receive queues (\ref swbus_shm_rxq). */
+  swbus_shm_off_t rxqs_off;
+
+  /** Offset of the subscription table (\ref swbus_shm_sub). */
+  swbus_shm_off_t subs_off;
+
+  /** Name of the bus instance. */
+  char name[RCSW_SWBUS_MAX_NAMELEN];
+};
+
+/**
+ * \brief A process's handle to a \ref swbus_shm segment.
+ *
+ * Each process creates or attaches to the segment with its own handle; the
+ * segment is mapped at a different address in each of them, which is why the
+ * segment only contains offsets.
+ */
+struct swbus_shm {
+  /** The mapped segment. */
+  struct swbus_shm_hdr* hdr;
+
+  /** Size of the mapping in bytes. */
+  size_t size;
+
+  /** File descriptor for the segment. */
+  int fd;
+
+  /**
+   * Configuration flags.
+   *
+   * Valid flags are:
+   *
+   * - \ref RCSW_NOALLOC_HANDLE
+   *
+   * All other flags are ignored.
+   */
+  uint32_t flags;
+
+  /** Name of the shared memory object. */
+  char shm_name[RCSW_SWBUS_SHM_MAX_NAMELEN];
+};
+
+/**
+ * \brief A packet received from a \ref swbus_shm RXQ.
+ */
+struct swbus_shm_rxq_ent {
+  /** Pointer to the packet buffer in the receiving process. */
+  dptr_t* data;
+
+  /** Handle of the packet buffer. */
+  swbus_shm_off_t off;
+
+  /** Received packet size in bytes. */
+  size_t pkt_size;
+
+  /** ID of received packet. */
+  uint32_t pid;
+
+  /** Index of the buffer pool the packet buffer is in. */
+  uint32_t pool;
+};
+
+/**
+ * \brief A reservation in a \ref swbus_shm segment which can later be used to
+ * publish some data without copying it.
+ */
+struct swbus_shm_rsrvn {
+  /** Pointer to the reserved buffer in the reserving process. */
+  dptr_t* data;
+
+  /** Handle of the reserved buffer. */
+  swbus_shm_off_t off;
+
+  /** Size of the reserved buffer in bytes. */
+  size_t pkt_size;
+
+  /** Index of the buffer pool the reserved buffer is in. */
+  uint32_t pool;
+};
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+/**
+ * \brief Get a pointer to the data for a buffer handle in the calling process.
+ */
+static inline dptr_t* swbus_shm_ptr(const struct swbus_shm* const swb,
+                                    swbus_shm_off_t off) {
+  return (dptr_t*)((uint8_t*)swb->hdr + off);
+}
+
+/**
+ * \brief Create a new shared memory segment and initialize a \ref swbus_shm in
+ * it.
+ *
+ * \param swb_in An application allocated handle for the bus. Can be NULL,
+ *               depending on \ref swbus_shm_params.flags.
+ *
+ * \param shm_name Name of the POSIX shared memory object, e.g. "/my-bus". It
+ *                 must not already exist.
+ *
+ * \param params The initialization parameters.
+ *
+ * \return The initialized bus, or NULL if an ERROR occurred.
+ */
+RCSW_API struct swbus_shm* swbus_shm_create(
+    struct swbus_shm* swb_in,
+    const char* shm_name,
+    const struct swbus_shm_params* params) RCSW_WUR;
+
+/**
+ * \brief Attach to a \ref swbus_shm created by another process (or this one)
+ * with \ref swbus_shm_create(), waiting for its creator to finish initializing
+ * it if needed.
+ *
+ * \param swb_in An application allocated handle for the bus. Can be NULL,
+ *               depending on \p flags.
+ *
+ * \param shm_name Name of the POSIX shared memory object.
+ *
+ * \param flags \ref RCSW_NOALLOC_HANDLE or \ref RCSW_NONE.
+ *
+ * \return The attached bus, or NULL if an ERROR occurred.
+ */
+RCSW_API struct swbus_shm* swbus_shm_open(struct swbus_shm* swb_in,
+                                          const char* shm_name,
+                                          uint32_t flags) RCSW_WUR;
+
+/**
+ * \brief Detach from a \ref swbus_shm. The segment itself persists until it is
+ * unlinked with \ref swbus_shm_unlink() and every process has detached.
+ */
+RCSW_API void swbus_shm_close(struct swbus_shm* swb);
+
+/**
+ * \brief Remove the shared memory object for a \ref swbus_shm, so that no new
+ * processes can attach to it.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_unlink(const char* shm_name);
+
+/**
+ * \brief Claim an unused receive queue in the segment for the calling
+ * process.
+ *
+ * \return The RXQ, or NULL if all RXQs are in use or an ERROR occurred.
+ */
+RCSW_API struct swbus_shm_rxq* swbus_shm_rxq_init(
+    struct swbus_shm* swb) RCSW_WUR;
+
+/**
+ * \brief Give up a receive queue: its subscriptions are removed and any
+ * packets left in it are released.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_rxq_destroy(struct swbus_shm* swb,
+                                        struct swbus_shm_rxq* rxq);
+
+/**
+ * \brief Subscribe a receive queue to a packet ID.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_subscribe(struct swbus_shm* swb,
+                                      struct swbus_shm_rxq* rxq,
+                                      uint32_t pid);
+
+/**
+ * \brief Unsubscribe a receive queue from a packet ID.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_unsubscribe(struct swbus_shm* swb,
+                                        struct swbus_shm_rxq* rxq,
+                                        uint32_t pid);
+
+/**
+ * \brief Publish a packet to the bus by copying it into a buffer in the
+ * segment.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_publish(struct swbus_shm* swb,
+                                    uint32_t pid,
+                                    size_t pkt_size,
+                                    const void* pkt);
+
+/**
+ * \brief Reserve a buffer in the segment which the application can fill in
+ * place and then publish with \ref swbus_shm_publish_release().
+ *
+ * Unlike \ref swbus_publish_reserve(), this does not wait for a buffer to
+ * become free, so that a stalled subscriber process can't block publishers
+ * forever.
+ *
+ * \param swb The bus handle.
+ * \param res The reservation (output parameter).
+ * \param pkt_size How many bytes to reserve.
+ *
+ * \return \ref status_t. Sets errno to ENOMEM if there are no buffers of at
+ * least \p pkt_size bytes free.
+ */
+RCSW_API status_t swbus_shm_publish_reserve(struct swbus_shm* swb,
+                                            struct swbus_shm_rsrvn* res,
+                                            size_t pkt_size);
+
+/**
+ * \brief Publish a reserved buffer to all subscribers without copying it.
+ *
+ * Subscribers receive the same buffer. Pushes to RXQs which are full fail
+ * rather than block, and are counted in \ref swbus_meta.n_notify_fails.
+ *
+ * \param swb The bus handle.
+ * \param pid The packet ID.
+ * \param res The reservation from \ref swbus_shm_publish_reserve(); it can't
+ *            be used again afterwards.
+ * \param pkt_size How many bytes of the reservation to publish.
+ *
+ * \return \ref status_t. ERROR if any subscriber could not be notified.
+ */
+RCSW_API status_t swbus_shm_publish_release(struct swbus_shm* swb,
+                                            uint32_t pid,
+                                            struct swbus_shm_rsrvn* res,
+                                            size_t pkt_size);
+
+/**
+ * \brief Remove the first packet from a receive queue, waiting (indefinitely)
+ * until there is one.
+ *
+ * The packet must be released with \ref swbus_shm_rxq_release() when you are
+ * finished with it.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_rxq_wait(struct swbus_shm* swb,
+                                     struct swbus_shm_rxq* rxq,
+                                     struct swbus_shm_rxq_ent* ent);
+
+/**
+ * \brief Remove the first packet from a receive queue, waiting until there is
+ * one or a timeout expires.
+ *
+ * \param swb The bus handle.
+ * \param rxq The receive queue.
+ * \param ent The received packet (output parameter).
+ * \param to A RELATIVE timeout.
+ *
+ * \return \ref status_t. Sets errno to ETIMEDOUT if the timeout expired.
+ */
+RCSW_API status_t swbus_shm_rxq_timedwait(struct swbus_shm* swb,
+                                          struct swbus_shm_rxq* rxq,
+                                          struct swbus_shm_rxq_ent* ent,
+                                          const struct timespec* to);
+
+/**
+ * \brief Remove the first packet from a receive queue if there is one,
+ * without waiting.
+ *
+ * \return \ref status_t. ERROR if the queue is empty.
+ */
+RCSW_API status_t swbus_shm_rxq_trypop(struct swbus_shm* swb,
+                                       struct swbus_shm_rxq* rxq,
+                                       struct swbus_shm_rxq_ent* ent);
+
+/**
+ * \brief Release a packet received from a receive queue, freeing its buffer
+ * once all subscribers have released it.
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_rxq_release(struct swbus_shm* swb,
+                                        const struct swbus_shm_rxq_ent* ent);
+
+/**
+ * \brief Get the # of packets in a receive queue.
+ */
+RCSW_API size_t swbus_shm_rxq_size(const struct swbus_shm_rxq* rxq) RCSW_PURE;
+
+/**
+ * \brief Get the # of buffers allocated from a buffer pool in the segment.
+ */
+RCSW_API size_t swbus_shm_pool_size(const struct swbus_shm* swb,
+                                    size_t pool) RCSW_PURE;
+
+/**
+ * \brief Get a snapshot of the metadata for the bus, as for \ref
+ * swbus_meta_get().
+ *
+ * \return \ref status_t.
+ */
+RCSW_API status_t swbus_shm_meta_get(const struct swbus_shm* swb,
+                                     struct swbus_meta* meta);
+
+END_C_DECLS
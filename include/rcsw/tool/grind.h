@@ -126,11 +126,25 @@
  */
 #define RCSW_GRIND_REPORT_HISTOGRAM (1 << (RCSW_MODFLAGS_START + 5))
 
+/**
+ * \brief Also report contention statistics for all registered locks in \ref
+ * grind_report_all(). See \ref grind_report_locks().
+ *
+ * Valid in any mode.
+ */
+#define RCSW_GRIND_REPORT_LOCKS (1 << (RCSW_MODFLAGS_START + 6))
+
 /**
  * \brief Max length of all grindee names.
  */
 #define RCSW_GRINDEE_NAMELEN 32
 
+/**
+ * \brief # of bins in a \ref grind_hist. The last bin holds all values >=
+ * 2^30 (~1 second, for nanosecond values).
+ */
+#define RCSW_GRIND_HIST_BINS 32
+
 /*******************************************************************************
  * Type Definitions
  ******************************************************************************/
@@ -240,6 +254,28 @@ struct grindee {
   } domain;
 };
 
+/**
+ * \brief A histogram of values in power-of-2 sized bins, which can be added to
+ * from multiple threads at once without locking.
+ *
+ * Bin 0 holds 0, and bin \c i > 0 holds values in [2^(i-1), 2^i). Unlike \ref
+ * grindee, no datapoints are kept, so it never fills up, and recording a value
+ * is cheap enough for hot paths.
+ */
+struct grind_hist {
+  /** # values in each bin. */
+  size_t   bins[RCSW_GRIND_HIST_BINS];
+
+  /** Total # values recorded. */
+  size_t   count;
+
+  /** Sum of all values recorded. */
+  uint64_t sum;
+
+  /** Largest value recorded. */
+  uint64_t max;
+};
+
 /** Grinder initialization parameters */
 struct grind_params {
   /**
@@ -309,6 +345,7 @@ struct grinder {
    * - \ref RCSW_ZALLOC
    * - \ref RCSW_GRIND_REPORT_DATAPOINTS
    * - \ref RCSW_GRIND_REPORT_HISTOGRAM
+   * - \ref RCSW_GRIND_REPORT_LOCKS
    * - \ref RCSW_GRIND_REPORT_AUTO
    * - \ref RCSW_GRIND_REPORT_REQ_FULL
    * - \ref RCSW_GRIND_RESET_AUTO
@@ -341,6 +378,8 @@ struct grinder {
 /*******************************************************************************
  * API Functions
  ******************************************************************************/
+BEGIN_C_DECLS
+
 /**
  * \brief Initialize a \ref grinder for statistics collection.
  *
@@ -424,6 +463,53 @@ void grind_report_all(const struct grinder * const the_grinder);
 status_t grind_report(const struct grinder * const the_grinder,
                       struct grindee *const fm);
 
+/**
+ * \brief Report contention statistics for all locks registered for profiling
+ * to stdout via \ref DPRINTF.
+ *
+ * Does nothing unless \ref RCSW_CONFIG_MT_LOCKPROF is defined. See \ref
+ * RCSW_LOCKPROF_REGISTER().
+ */
+void grind_report_locks(void);
+
+/**
+ * \brief Add a value to a \ref grind_hist. Thread safe.
+ */
+void grind_hist_record(struct grind_hist * const hist, uint64_t val);
+
+/**
+ * \brief Copy a \ref grind_hist which other threads may be recording to.
+ *
+ * Each field is read atomically, but values recorded during the copy may only
+ * be partially reflected.
+ */
+void grind_hist_snapshot(const struct grind_hist * const hist,
+                         struct grind_hist * const out);
+
+/**
+ * \brief Reset a \ref grind_hist. Values recorded concurrently may be lost.
+ */
+void grind_hist_reset(struct grind_hist * const hist);
+
+/**
+ * \brief Estimate a percentile of the values in a \ref grind_hist.
+ *
+ * \param hist The histogram.
+ * \param pct The percentile, in [0, 100].
+ *
+ * \return The upper bound of the bin the percentile falls in (clamped to the
+ * max recorded value), or 0 if the histogram is empty.
+ */
+uint64_t grind_hist_percentile(const struct grind_hist * const hist,
+                               double pct) RCSW_PURE;
+
+/**
+ * \brief Report a \ref grind_hist of nanosecond values to stdout via \ref
+ * DPRINTF.
+ */
+void grind_hist_report(const char * const name,
+                       const struct grind_hist * const hist);
+
 /**
  * \brief Report utilization results to stdout.
  *
@@ -516,3 +602,5 @@ size_t grind_sum_all(const struct grinder * const the_grinder);
  */
 double grind_get_utilization(struct grinder * the_grinder,
                              const char * const name);
+
+END_C_DECLS
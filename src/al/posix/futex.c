@@ -0,0 +1,111 @@
+/**
+ * \file futex.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/al/posix/futex.h"
+
+#include <sched.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "rcsw/al/clock.h"
+#include "rcsw/utils/time.h"
+
+BEGIN_C_DECLS
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+static status_t futex_wait_impl(uint32_t* const addr,
+                                uint32_t val,
+                                const struct timespec* const to,
+                                bool_t pshared) {
+#if defined(__linux__)
+  /*
+   * FUTEX_WAIT_BITSET takes an absolute timeout against CLOCK_MONOTONIC, which
+   * is what we want, so that callers looping on spurious wakeups don't have to
+   * recompute it every time.
+   */
+  long rc = syscall(SYS_futex,
+                    addr,
+                    pshared ? FUTEX_WAIT_BITSET : FUTEX_WAIT_BITSET_PRIVATE,
+                    val,
+                    to,
+                    NULL,
+                    FUTEX_BITSET_MATCH_ANY);
+  if (0 == rc || EAGAIN == errno || EINTR == errno) {
+    return OK;
+  }
+  return ERROR;
+#else
+  (void)pshared;
+  if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != val) {
+    return OK;
+  }
+  if (NULL != to) {
+    struct timespec now = clock_monotime();
+    if (time_ts_cmp(&now, to) >= 0) {
+      errno = ETIMEDOUT;
+      return ERROR;
+    }
+  }
+  sched_yield();
+  return OK;
+#endif
+} /* futex_wait_impl() */
+
+static status_t futex_wake_impl(uint32_t* const addr, int n, bool_t pshared) {
+#if defined(__linux__)
+  RCSW_CHECK(-1 != syscall(SYS_futex,
+                           addr,
+                           pshared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+                           n,
+                           NULL,
+                           NULL,
+                           0));
+  return OK;
+
+error:
+  return ERROR;
+#else
+  (void)addr;
+  (void)n;
+  (void)pshared;
+  return OK;
+#endif
+} /* futex_wake_impl() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+status_t futex_wait(uint32_t* const addr,
+                    uint32_t val,
+                    const struct timespec* const to) {
+  return futex_wait_impl(addr, val, to, false);
+} /* futex_wait() */
+
+status_t futex_wake(uint32_t* const addr, int n) {
+  return futex_wake_impl(addr, n, false);
+} /* futex_wake() */
+
+status_t futex_wait_shared(uint32_t* const addr,
+                           uint32_t val,
+                           const struct timespec* const to) {
+  return futex_wait_impl(addr, val, to, true);
+} /* futex_wait_shared() */
+
+status_t futex_wake_shared(uint32_t* const addr, int n) {
+  return futex_wake_impl(addr, n, true);
+} /* futex_wake_shared() */
+
+END_C_DECLS
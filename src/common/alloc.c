@@ -12,9 +12,34 @@
 #include "rcsw/common/alloc.h"
 #include "rcsw/common/flags.h"
 
+/*******************************************************************************
+ * Global Variables
+ ******************************************************************************/
+static struct rcsw_alloc_backend g_backend;
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+#if !defined(RCSW_CONFIG_NOALLOC)
+static void* rcsw_backend_alloc(size_t n_bytes) {
+  if (NULL != g_backend.alloc) {
+    return g_backend.alloc(g_backend.ctx, n_bytes);
+  }
+  return malloc(n_bytes);
+}
+#endif /* RCSW_CONFIG_NOALLOC */
+
 /*******************************************************************************
  * API Functions
  ******************************************************************************/
+void rcsw_alloc_backend_set(const struct rcsw_alloc_backend* backend) {
+  if (NULL != backend) {
+    g_backend = *backend;
+  } else {
+    memset(&g_backend, 0, sizeof(g_backend));
+  }
+} /* rcsw_alloc_backend_set() */
+
 void* rcsw_alloc(void* ptr, size_t n_bytes, RCSW_UNUSED uint32_t flags) {
   void* ret = NULL;
 
@@ -51,16 +76,23 @@ void* rcsw_alloc(void* ptr, size_t n_bytes, RCSW_UNUSED uint32_t flags) {
     ret = ptr;
   } else {
 #if defined(RCSW_CONFIG_ZALLOC)
-    ret = calloc(1, n_bytes);
+    if (NULL != g_backend.alloc) {
+      ret = rcsw_backend_alloc(n_bytes);
+      if (NULL != ret) {
+        memset(ret, 0, n_bytes);
+      }
+    } else {
+      ret = calloc(1, n_bytes);
+    }
 
 #else
-    ret = malloc(n_bytes);
+    ret = rcsw_backend_alloc(n_bytes);
 
     /*
      * Allow per-call override to get zeroed memory, as some modules rely on
      * that unconditionally (e.g., mpool).
      */
-    if (flags & RCSW_ZALLOC) {
+    if (NULL != ret && (flags & RCSW_ZALLOC)) {
       memset(ret, 0, n_bytes);
     }
 
@@ -72,6 +104,25 @@ void* rcsw_alloc(void* ptr, size_t n_bytes, RCSW_UNUSED uint32_t flags) {
   return ret;
 } /* rcsw_alloc() */
 
+void* rcsw_realloc(RCSW_UNUSED void* ptr,
+                   RCSW_UNUSED size_t old_bytes,
+                   RCSW_UNUSED size_t n_bytes) {
+#if defined(RCSW_CONFIG_NOALLOC)
+  /* memory allocation is disabled entirely */
+  return NULL;
+#else
+  if (NULL == g_backend.alloc) {
+    return realloc(ptr, n_bytes);
+  }
+  void* ret = g_backend.alloc(g_backend.ctx, n_bytes);
+  if (NULL != ret && NULL != ptr) {
+    memcpy(ret, ptr, RCSW_MIN(old_bytes, n_bytes));
+    g_backend.free(g_backend.ctx, ptr);
+  }
+  return ret;
+#endif /* RCSW_CONFIG_NOALLOC */
+} /* rcsw_realloc() */
+
 void rcsw_free(void* ptr, uint32_t flags) {
   RCSW_CHECK_PTR(ptr);
 
@@ -91,6 +142,8 @@ void rcsw_free(void* ptr, uint32_t flags) {
       (flags & RCSW_NOALLOC_DATA) ||
       (flags & RCSW_NOALLOC_META)) {
     return;
+  } else if (NULL != g_backend.free) {
+    g_backend.free(g_backend.ctx, ptr);
   } else {
     free(ptr);
   }
@@ -208,10 +208,10 @@ void csmatrix_destroy(struct csmatrix* const matrix) {
     for (size_t i = 0; i < matrix->n_cols; ++i) {
       llist_destroy(matrix->cols + i);
     } /* for(i..) */
-    free(matrix->cols);
+    rcsw_free(matrix->cols, RCSW_NONE);
   }
   if (matrix->csizes) {
-    free(matrix->csizes);
+    rcsw_free(matrix->csizes, RCSW_NONE);
   }
   /* if (matrix->nodes) { */
   /*     free(matrix->nodes); */
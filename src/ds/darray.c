@@ -46,12 +46,14 @@ static status_t darray_extend(struct darray* const arr, size_t size) {
     return ERROR;
   }
 
-  size_t old_size = size;
+  size_t old_size = arr->capacity;
   arr->capacity = size;
 
   /* use tmp var to preserve orignal list in case of failure */
   void* tmp = NULL;
-  tmp = realloc(arr->elements, arr->capacity * arr->elt_size);
+  tmp = rcsw_realloc(arr->elements,
+                     old_size * arr->elt_size,
+                     arr->capacity * arr->elt_size);
 
   RCSW_CHECK_PTR(tmp);
   arr->elements = tmp;
@@ -88,7 +90,9 @@ static status_t darray_shrink(struct darray* const arr, size_t size) {
   if (arr->capacity > 0) {
     ER_CHECK(!(arr->flags & RCSW_NOALLOC_DATA),
              "Cannot shrink array: RCSW_NOALLOC_DATA");
-    void* tmp = realloc(arr->elements, arr->capacity * arr->elt_size);
+    void* tmp = rcsw_realloc(arr->elements,
+                             old_size * arr->elt_size,
+                             arr->capacity * arr->elt_size);
     RCSW_CHECK_PTR(tmp);
     arr->elements = tmp;
     arr->current = RCSW_MIN(arr->capacity - 1, arr->current);
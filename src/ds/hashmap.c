@@ -26,6 +26,24 @@
  ******************************************************************************/
 BEGIN_C_DECLS
 
+/**
+ * \brief Start updating the statistics, if readers need to be fenced off.
+ */
+static void hashmap_stats_wr_enter(struct hashmap* const map) {
+  if (map->flags & RCSW_DS_HASHMAP_SEQSTATS) {
+    seqlock_wr_enter(&map->stats_sl);
+  }
+}
+
+/**
+ * \brief Finish updating the statistics started with hashmap_stats_wr_enter().
+ */
+static void hashmap_stats_wr_exit(struct hashmap* const map) {
+  if (map->flags & RCSW_DS_HASHMAP_SEQSTATS) {
+    seqlock_wr_exit(&map->stats_sl);
+  }
+}
+
 /**
  * \brief Get a bucket index from a reference to a bucket.
  *
@@ -179,6 +197,9 @@ struct hashmap* hashmap_init(struct hashmap* map_in,
   map->stats.n_collisions = 0;
   map->stats.n_adds = 0;
   map->stats.n_addfails = 0;
+  if (map->flags & RCSW_DS_HASHMAP_SEQSTATS) {
+    RCSW_CHECK(NULL != seqlock_init(&map->stats_sl, RCSW_NOALLOC_HANDLE));
+  }
   map->sort_thresh = params->sort_thresh;
   map->sorted = false;
   map->space.elements = NULL;
@@ -262,6 +283,9 @@ void hashmap_destroy(struct hashmap* map) {
 
   rcsw_free(map->space.elements, map->flags & RCSW_NOALLOC_DATA);
   rcsw_free(map->space.buckets, map->flags & RCSW_NOALLOC_META);
+  if (map->flags & RCSW_DS_HASHMAP_SEQSTATS) {
+    seqlock_destroy(&map->stats_sl);
+  }
   rcsw_free(map, map->flags & RCSW_NOALLOC_HANDLE);
 } /* hashmap_destroy() */
 
@@ -343,7 +367,9 @@ status_t hashmap_add(struct hashmap* const map,
       ER_DEBUG("Bucket %zu is full (%zu elements): cannot add new hashnode",
            bucket_index,
            bucket->current);
+      hashmap_stats_wr_enter(map);
       map->stats.n_addfails++;
+      hashmap_stats_wr_exit(map);
       return ERROR;
     }
     /* Loop through all buckets, starting from the one we originally hashed
@@ -365,7 +391,9 @@ status_t hashmap_add(struct hashmap* const map,
 
     if (!bucket) {
       ER_DEBUG("All buckets full: Cannot add new hashnode");
+      hashmap_stats_wr_enter(map);
       map->stats.n_addfails++;
+      hashmap_stats_wr_exit(map);
       return ERROR;
     }
     ER_DEBUG("Linear probing found bucket %d", i);
@@ -389,10 +417,12 @@ status_t hashmap_add(struct hashmap* const map,
 
   ER_CHECK(darray_insert(bucket, &node, bucket->current) == OK,
                 "could not append node to bucket");
+  hashmap_stats_wr_enter(map);
   map->stats.n_collisions += (bucket->current != 1); /* if not 1, wasn't 0 before
                                                         (COLLISION) */
   map->stats.n_nodes++;
   map->stats.n_adds++;
+  hashmap_stats_wr_exit(map);
 
   /*
    * Sort the hashmap if the following are met:
@@ -409,7 +439,9 @@ status_t hashmap_add(struct hashmap* const map,
   return OK;
 
 error:
+  hashmap_stats_wr_enter(map);
   ++map->stats.n_addfails;
+  hashmap_stats_wr_exit(map);
   return ERROR;
 } /* hashmap_add() */
 
@@ -453,7 +485,9 @@ status_t hashmap_remove(struct hashmap* const map, const void* const key) {
     return ERROR;
   }
 
+  hashmap_stats_wr_enter(map);
   map->stats.n_nodes--;
+  hashmap_stats_wr_exit(map);
   map->sorted = bucket->sorted;
 error:
   return OK;
@@ -486,8 +520,8 @@ status_t hashmap_gather(const struct hashmap* const map,
                         struct hashmap_stats* const stats) {
   RCSW_FPC_NV(ERROR, map != NULL, stats != NULL);
 
-  /* copy over all current stats */
-  *stats = map->stats;
+  /* copy over all current counters */
+  RCSW_CHECK(OK == hashmap_stats_snapshot(map, stats));
 
   stats->n_buckets = map->n_buckets;
   stats->collision_ratio = ((double)stats->n_collisions / (double)map->stats.n_adds);
@@ -511,8 +545,28 @@ status_t hashmap_gather(const struct hashmap* const map,
   stats->min_util = (double)min / map->space.buckets[0].max_elts;
 
   return OK;
+
+error:
+  return ERROR;
 } /* hashmap_gather() */
 
+status_t hashmap_stats_snapshot(const struct hashmap* const map,
+                                struct hashmap_stats* const stats) {
+  RCSW_FPC_NV(ERROR, map != NULL, stats != NULL);
+
+  struct hashmap_stats snap;
+  if (map->flags & RCSW_DS_HASHMAP_SEQSTATS) {
+    RCSW_SEQLOCK_READ(&map->stats_sl, snap, map->stats);
+  } else {
+    snap = map->stats;
+  }
+  stats->n_nodes = snap.n_nodes;
+  stats->n_adds = snap.n_adds;
+  stats->n_addfails = snap.n_addfails;
+  stats->n_collisions = snap.n_collisions;
+  return OK;
+} /* hashmap_stats_snapshot() */
+
 void hashmap_print(const struct hashmap* const map) {
   if (map == NULL) {
     DPRINTF(RCSW_ER_MODNAME " : < NULL >\n");
@@ -9,8 +9,16 @@
 /*******************************************************************************
  * Includes
  ******************************************************************************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include "rcsw/ds/rbuffer.h"
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #define RCSW_ER_MODID ekLOG4CL_DS_RBUFFER
 #define RCSW_ER_MODNAME "rcsw.ds.rbuffer"
 #include "rcsw/ds/ds.h"
@@ -24,10 +32,97 @@
   (((rb)->flags & RCSW_DS_RBUFFER_AS_FIFO) ? "FIFO" : "RBUFFER")
 
 /*******************************************************************************
- * API Functions
+ * Private Functions
  ******************************************************************************/
 BEGIN_C_DECLS
 
+/**
+ * \brief Round the # of elements in a ringbuffer up so that it occupies a whole
+ * # of pages, which is required in order to map it twice.
+ */
+static size_t rbuffer_mirror_elts(size_t max_elts,
+                                  RCSW_UNUSED size_t elt_size) {
+#if defined(__linux__)
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t a = page_size;
+  size_t b = elt_size;
+
+  /* gcd(page_size, elt_size) */
+  while (b != 0) {
+    size_t tmp = a % b;
+    a = b;
+    b = tmp;
+  } /* while() */
+
+  size_t granularity = page_size / a;
+  return ((max_elts + granularity - 1) / granularity) * granularity;
+#else
+  return max_elts;
+#endif
+} /* rbuffer_mirror_elts() */
+
+/**
+ * \brief Allocate \p n_bytes of anonymous memory and map it twice,
+ * back-to-back, so that accesses off the end of the first mapping land at the
+ * start of the buffer.
+ *
+ * \param n_bytes Size of the buffer; must be a multiple of the page size.
+ *
+ * \return The start of the first mapping, or NULL on error.
+ */
+static dptr_t* rbuffer_mirror_alloc(RCSW_UNUSED size_t n_bytes) {
+#if defined(__linux__)
+  uint8_t* base = MAP_FAILED;
+  int fd = memfd_create(RCSW_ER_MODNAME, MFD_CLOEXEC);
+  RCSW_CHECK(-1 != fd);
+  RCSW_CHECK(0 == ftruncate(fd, (off_t)n_bytes));
+
+  /* reserve a contiguous chunk of address space for both mappings */
+  base = mmap(NULL, 2 * n_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  RCSW_CHECK(MAP_FAILED != base);
+
+  RCSW_CHECK(base == mmap(base,
+                          n_bytes,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_FIXED,
+                          fd,
+                          0));
+  RCSW_CHECK(base + n_bytes == mmap(base + n_bytes,
+                                    n_bytes,
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_FIXED,
+                                    fd,
+                                    0));
+  close(fd);
+  return (dptr_t*)base;
+
+error:
+  if (MAP_FAILED != base) {
+    munmap(base, 2 * n_bytes);
+  }
+  if (-1 != fd) {
+    close(fd);
+  }
+  return NULL;
+#else
+  errno = ENOTSUP;
+  return NULL;
+#endif
+} /* rbuffer_mirror_alloc() */
+
+static void rbuffer_mirror_free(RCSW_UNUSED dptr_t* elements,
+                                RCSW_UNUSED size_t n_bytes) {
+#if defined(__linux__)
+  if (NULL != elements) {
+    munmap(elements, 2 * n_bytes);
+  }
+#endif
+} /* rbuffer_mirror_free() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+
 struct rbuffer* rbuffer_init(struct rbuffer* rb_in,
                              const struct rbuffer_params* const params) {
   RCSW_FPC_NV(NULL,
@@ -41,19 +136,26 @@ struct rbuffer* rbuffer_init(struct rbuffer* rb_in,
                                   params->flags & RCSW_NOALLOC_HANDLE);
   RCSW_CHECK_PTR(rb);
   rb->flags = params->flags;
+  rb->elements = NULL;
+  rb->elt_size = params->elt_size;
+  rb->max_elts = params->max_elts;
 
-  rb->elements = rcsw_alloc(params->elements,
-                            params->max_elts * params->elt_size,
-                            params->flags & RCSW_NOALLOC_DATA);
-
+  if (rb->flags & RCSW_DS_RBUFFER_MIRRORED) {
+    ER_CHECK(!(rb->flags & RCSW_NOALLOC_DATA),
+             "Cannot mirror application-allocated data");
+    rb->max_elts = rbuffer_mirror_elts(rb->max_elts, rb->elt_size);
+    rb->elements = rbuffer_mirror_alloc(rb->max_elts * rb->elt_size);
+  } else {
+    rb->elements = rcsw_alloc(params->elements,
+                              rb->max_elts * rb->elt_size,
+                              params->flags & RCSW_NOALLOC_DATA);
+  }
   RCSW_CHECK_PTR(rb->elements);
 
-  rb->elt_size = params->elt_size;
   rb->printe = params->printe;
   rb->cmpe = params->cmpe;
   rb->start = 0;
   rb->current = 0;
-  rb->max_elts = params->max_elts;
 
   ER_DEBUG("type=%s,max_elts=%zu,elt_size=%zu,flags=0x%08x",
            RCSW_DS_RBUFFER_TYPE(rb),
@@ -70,7 +172,11 @@ error:
 void rbuffer_destroy(struct rbuffer* rb) {
   RCSW_FPC_V(NULL != rb);
 
-  rcsw_free(rb->elements, rb->flags & RCSW_NOALLOC_DATA);
+  if (rb->flags & RCSW_DS_RBUFFER_MIRRORED) {
+    rbuffer_mirror_free(rb->elements, rb->max_elts * rb->elt_size);
+  } else {
+    rcsw_free(rb->elements, rb->flags & RCSW_NOALLOC_DATA);
+  }
   rcsw_free(rb, rb->flags & RCSW_NOALLOC_HANDLE);
 } /* rbuffer_destroy() */
 
@@ -154,6 +260,53 @@ int rbuffer_index_query(struct rbuffer* const rb, const void* const e) {
   return rval;
 } /* rbuffer_index_query() */
 
+void* rbuffer_rd_region(const struct rbuffer* const rb, size_t* const n_elts) {
+  RCSW_FPC_NV(NULL, rb != NULL, n_elts != NULL);
+
+  *n_elts = 0;
+  if (rbuffer_isempty(rb)) {
+    return NULL;
+  }
+  if (rb->flags & RCSW_DS_RBUFFER_MIRRORED) {
+    *n_elts = rb->current;
+  } else {
+    *n_elts = RCSW_MIN(rb->current, rb->max_elts - rb->start);
+  }
+  return rbuffer_data_get(rb, rb->start);
+} /* rbuffer_rd_region() */
+
+status_t rbuffer_rd_commit(struct rbuffer* const rb, size_t n_elts) {
+  RCSW_FPC_NV(ERROR, rb != NULL, n_elts <= rb->current);
+
+  rb->start = (rb->start + n_elts) % rb->max_elts;
+  rb->current -= n_elts;
+  return OK;
+} /* rbuffer_rd_commit() */
+
+void* rbuffer_wr_region(const struct rbuffer* const rb, size_t* const n_elts) {
+  RCSW_FPC_NV(NULL, rb != NULL, n_elts != NULL);
+
+  size_t end = (rb->start + rb->current) % rb->max_elts;
+
+  *n_elts = 0;
+  if (rbuffer_isfull(rb)) {
+    return NULL;
+  }
+  if (rb->flags & RCSW_DS_RBUFFER_MIRRORED) {
+    *n_elts = rb->max_elts - rb->current;
+  } else {
+    *n_elts = RCSW_MIN(rb->max_elts - rb->current, rb->max_elts - end);
+  }
+  return rbuffer_data_get(rb, end);
+} /* rbuffer_wr_region() */
+
+status_t rbuffer_wr_commit(struct rbuffer* const rb, size_t n_elts) {
+  RCSW_FPC_NV(ERROR, rb != NULL, n_elts <= rb->max_elts - rb->current);
+
+  rb->current += n_elts;
+  return OK;
+} /* rbuffer_wr_commit() */
+
 status_t rbuffer_clear(struct rbuffer* const rb) {
   RCSW_FPC_NV(ERROR, rb != NULL);
 
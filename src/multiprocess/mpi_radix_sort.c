@@ -104,18 +104,18 @@ void mpi_radix_sorter_destroy(struct mpi_radix_sorter* const sorter) {
   RCSW_FPC_V(NULL != sorter);
 
   if (sorter->prefix_sums) {
-    free(sorter->prefix_sums);
+    rcsw_free(sorter->prefix_sums, RCSW_NONE);
   }
   if (sorter->tmp_arr) {
-    free(sorter->tmp_arr);
+    rcsw_free(sorter->tmp_arr, RCSW_NONE);
   }
   if (sorter->cum_prefix_sums) {
-    free(sorter->cum_prefix_sums);
+    rcsw_free(sorter->cum_prefix_sums, RCSW_NONE);
   }
   if (sorter->data) {
-    free(sorter->data);
+    rcsw_free(sorter->data, RCSW_NONE);
   }
-  free(sorter);
+  rcsw_free(sorter, RCSW_NONE);
 } /* mpi_radix_sorter_destroy() */
 
 status_t mpi_radix_sorter_exec(struct mpi_radix_sorter* const sorter) {
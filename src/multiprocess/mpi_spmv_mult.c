@@ -116,16 +116,16 @@ void mpi_spmv_mult_destroy(struct mpi_spmv_mult* mult) {
       free(mult->row_owners);
     }
     if (mult->rank_alloc_elts && mult->mpi_rank == 0) {
-      free(mult->rank_alloc_elts);
+      rcsw_free(mult->rank_alloc_elts, RCSW_NONE);
     }
     if (mult->rank_alloc_rows && mult->mpi_rank == 0) {
-      free(mult->rank_alloc_rows);
+      rcsw_free(mult->rank_alloc_rows, RCSW_NONE);
     }
     if (mult->rank_alloc_row_prefix_sums && mult->mpi_rank == 0) {
-      free(mult->rank_alloc_row_prefix_sums);
+      rcsw_free(mult->rank_alloc_row_prefix_sums, RCSW_NONE);
     }
     if (mult->row_sizes && mult->mpi_rank == 0) {
-      free(mult->row_sizes);
+      rcsw_free(mult->row_sizes, RCSW_NONE);
     }
     if (mult->vector_in) {
       darray_destroy(mult->vector_in);
@@ -138,7 +138,7 @@ void mpi_spmv_mult_destroy(struct mpi_spmv_mult* mult) {
       csmatrix_destroy(mult->matrix);
     }
     MPI_Type_free(&mult->spmv_comm_type);
-    free(mult);
+    rcsw_free(mult, RCSW_NONE);
   }
   return;
 } /* mpi_spmv_mult_destroy() */
@@ -16,17 +16,33 @@
 #include "rcsw/multiprocess/procm.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <sched.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "mp", "procm")
+#define RCSW_ER_MODID ekLOG4CL_MULTIPROCESS
 #include "rcsw/er/client.h"
+#include "rcsw/common/alloc.h"
+#include "rcsw/common/fpc.h"
 
 /*******************************************************************************
  * Forward Declarations
  ******************************************************************************/
 BEGIN_C_DECLS
 
+static pid_t procm_vfork_exec(const struct procm_spawn_params* params,
+                              char* const* envp);
+static size_t procm_pool_fill(struct procm_pool* pool);
+static void procm_pool_drain(struct procm_slot* slot);
+static bool_t procm_pool_reap(struct procm_pool* pool,
+                              size_t idx,
+                              bool_t block);
+
 /*******************************************************************************
  * Functions
  ******************************************************************************/
@@ -92,4 +108,355 @@ pid_t procm_fork_exec(char** const cmd,
   }
 } /* procm_fork_exec() */
 
+pid_t procm_spawn(const struct procm_spawn_params* const params) {
+  RCSW_FPC_NV(-1, NULL != params, NULL != params->cmd, NULL != params->cmd[0]);
+
+  char* const* envp = (NULL != params->envp) ? params->envp : environ;
+
+  /* posix_spawn() can't change directory portably */
+  if (NULL != params->new_wd) {
+    return procm_vfork_exec(params, envp);
+  }
+
+  posix_spawn_file_actions_t actions;
+  int rc = posix_spawn_file_actions_init(&actions);
+  ER_CHECK(0 == rc, "Failed to init spawn actions: %s", strerror(rc));
+
+  int fds[] = { params->stdin_fd, params->stdout_fd, params->stderr_fd };
+  for (int i = 0; i < 3 && 0 == rc; ++i) {
+    if (-1 != fds[i] && i != fds[i]) {
+      rc = posix_spawn_file_actions_adddup2(&actions, fds[i], i);
+    }
+  } /* for(i..) */
+
+  pid_t pid = -1;
+  if (0 == rc) {
+    rc = posix_spawn(&pid, params->cmd[0], &actions, NULL, params->cmd, envp);
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  ER_CHECK(0 == rc, "Failed to spawn '%s': %s", params->cmd[0], strerror(rc));
+  return pid;
+
+error:
+  return -1;
+} /* procm_spawn() */
+
+/*******************************************************************************
+ * Process Pool
+ ******************************************************************************/
+struct procm_pool*
+procm_pool_init(struct procm_pool* const pool_in,
+                const struct procm_pool_params* const params) {
+  RCSW_FPC_NV(NULL, NULL != params, params->max_jobs > 0);
+
+  struct procm_pool* pool = rcsw_alloc(pool_in,
+                                       sizeof(struct procm_pool),
+                                       params->flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(pool);
+  pool->flags = params->flags;
+  pool->n_running = 0;
+  pool->done = params->done;
+  pool->done_arg = params->done_arg;
+  pool->max_procs = params->max_procs;
+  if (0 == pool->max_procs) {
+    pool->max_procs = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+
+  pool->slots = rcsw_alloc(NULL,
+                           sizeof(struct procm_slot) * pool->max_procs,
+                           RCSW_NONE);
+  pool->pfds = rcsw_alloc(NULL,
+                          sizeof(struct pollfd) * pool->max_procs,
+                          RCSW_NONE);
+  RCSW_CHECK_PTR(pool->slots);
+  RCSW_CHECK_PTR(pool->pfds);
+
+  struct fifo_params queue_params = {
+    .printe = NULL,
+    .elements = NULL,
+    .elt_size = sizeof(struct procm_job*),
+    .max_elts = params->max_jobs,
+    .flags = RCSW_NOALLOC_HANDLE
+  };
+  RCSW_CHECK_PTR(fifo_init(&pool->queue, &queue_params));
+
+  ER_DEBUG("max_procs=%zu max_jobs=%zu", pool->max_procs, params->max_jobs);
+  return pool;
+
+error:
+  if (NULL != pool) {
+    if (NULL != pool->slots) {
+      rcsw_free(pool->slots, RCSW_NONE);
+    }
+    if (NULL != pool->pfds) {
+      rcsw_free(pool->pfds, RCSW_NONE);
+    }
+    rcsw_free(pool, pool->flags & RCSW_NOALLOC_HANDLE);
+  }
+  return NULL;
+} /* procm_pool_init() */
+
+void procm_pool_destroy(struct procm_pool* const pool) {
+  RCSW_FPC_V(NULL != pool);
+
+  procm_pool_wait(pool);
+  fifo_destroy(&pool->queue);
+  rcsw_free(pool->slots, RCSW_NONE);
+  rcsw_free(pool->pfds, RCSW_NONE);
+  rcsw_free(pool, pool->flags & RCSW_NOALLOC_HANDLE);
+} /* procm_pool_destroy() */
+
+status_t procm_pool_submit(struct procm_pool* const pool,
+                           struct procm_job* const job) {
+  RCSW_FPC_NV(ERROR, NULL != pool, NULL != job, NULL != job->cmd);
+
+  /* the queue can only be full if all the slots are busy */
+  while (fifo_isfull(&pool->queue)) {
+    procm_pool_poll(pool, -1);
+  } /* while() */
+
+  job->pid = -1;
+  job->status = -1;
+  job->output_len = 0;
+  RCSW_CHECK(OK == fifo_add(&pool->queue, &job));
+  procm_pool_fill(pool);
+  return OK;
+
+error:
+  return ERROR;
+} /* procm_pool_submit() */
+
+size_t procm_pool_poll(struct procm_pool* const pool, int timeout_ms) {
+  RCSW_FPC_NV(0, NULL != pool);
+
+  size_t n_done = procm_pool_fill(pool);
+  do {
+    if (0 == pool->n_running) {
+      break;
+    }
+    /*
+     * Children which have closed their stdout can't be poll()ed, and are
+     * (almost always) about to exit, so only block in poll() briefly if there
+     * are any. If there is nothing else, block on one of them.
+     */
+    size_t n_fds = 0;
+    size_t n_eof = 0;
+    for (size_t i = 0; i < pool->n_running; ++i) {
+      if (-1 == pool->slots[i].fd) {
+        ++n_eof;
+        continue;
+      }
+      pool->pfds[n_fds].fd = pool->slots[i].fd;
+      pool->pfds[n_fds].events = POLLIN;
+      pool->pfds[n_fds].revents = 0;
+      ++n_fds;
+    } /* for(i..) */
+
+    if (0 == n_fds && -1 == timeout_ms) {
+      procm_pool_reap(pool, 0, true);
+      ++n_done;
+    } else {
+      int to = timeout_ms;
+      if (n_eof > 0 && (-1 == to || to > 1)) {
+        to = 1;
+      }
+      if (poll(pool->pfds, n_fds, to) > 0) {
+        for (size_t i = 0; i < pool->n_running; ++i) {
+          if (-1 != pool->slots[i].fd) {
+            procm_pool_drain(&pool->slots[i]);
+          }
+        } /* for(i..) */
+      }
+      for (size_t i = 0; i < pool->n_running;) {
+        if (-1 == pool->slots[i].fd && procm_pool_reap(pool, i, false)) {
+          ++n_done;
+        } else {
+          ++i;
+        }
+      } /* for(i..) */
+    }
+    n_done += procm_pool_fill(pool);
+  } while (0 == n_done && -1 == timeout_ms);
+  return n_done;
+} /* procm_pool_poll() */
+
+status_t procm_pool_wait(struct procm_pool* const pool) {
+  RCSW_FPC_NV(ERROR, NULL != pool);
+
+  while (procm_pool_pending(pool) > 0) {
+    procm_pool_poll(pool, -1);
+  } /* while() */
+  return OK;
+} /* procm_pool_wait() */
+
+/*******************************************************************************
+ * Static Functions
+ ******************************************************************************/
+static pid_t procm_vfork_exec(const struct procm_spawn_params* const params,
+                              char* const* const envp) {
+  const int fds[] = { params->stdin_fd, params->stdout_fd, params->stderr_fd };
+  /* shared with the child, since vfork() doesn't copy the address space */
+  volatile int err = 0;
+
+  pid_t pid = vfork();
+  if (0 == pid) {
+    for (int i = 0; i < 3; ++i) {
+      if (-1 != fds[i] && i != fds[i] && -1 == dup2(fds[i], i)) {
+        err = errno;
+        _exit(EXIT_FAILURE);
+      }
+    } /* for(i..) */
+    if (0 != chdir(params->new_wd)) {
+      err = errno;
+      _exit(EXIT_FAILURE);
+    }
+    execve(params->cmd[0], params->cmd, envp);
+    err = errno;
+    _exit(EXIT_FAILURE);
+  }
+  ER_CHECK(-1 != pid, "vfork() failed: %s", strerror(errno));
+
+  /* the child has exec()ed or exited by the time vfork() returns */
+  if (0 != err) {
+    waitpid(pid, NULL, 0);
+    ER_ERR("Failed to spawn '%s' in '%s': %s",
+           params->cmd[0],
+           params->new_wd,
+           strerror(err));
+    errno = err;
+    return -1;
+  }
+  return pid;
+
+error:
+  return -1;
+} /* procm_vfork_exec() */
+
+/**
+ * \brief Call the completion callback for a job.
+ */
+static void procm_pool_finish(struct procm_pool* const pool,
+                              struct procm_job* const job) {
+  if (NULL != pool->done) {
+    pool->done(job, pool->done_arg);
+  }
+} /* procm_pool_finish() */
+
+/**
+ * \brief Start a job, with its stdout connected to a pipe.
+ *
+ * \return \ref bool_t: true if the job is running, false if it could not be
+ * started (and has been finished).
+ */
+static bool_t procm_pool_start(struct procm_pool* const pool,
+                               struct procm_job* const job) {
+  int fds[2];
+
+  /* close-on-exec so other children don't hold the write end open */
+  ER_CHECK(0 == pipe2(fds, O_CLOEXEC), "pipe2() failed: %s", strerror(errno));
+
+  struct procm_spawn_params params = {
+    .cmd = job->cmd,
+    .envp = NULL,
+    .new_wd = job->new_wd,
+    .stdin_fd = -1,
+    .stdout_fd = fds[1],
+    .stderr_fd = -1
+  };
+  job->pid = procm_spawn(&params);
+  close(fds[1]);
+  if (-1 == job->pid) {
+    close(fds[0]);
+    goto error;
+  }
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  struct procm_slot* slot = &pool->slots[pool->n_running++];
+  slot->job = job;
+  slot->fd = fds[0];
+  return true;
+
+error:
+  job->status = -1;
+  procm_pool_finish(pool, job);
+  return false;
+} /* procm_pool_start() */
+
+/**
+ * \brief Start queued jobs until all slots are busy.
+ *
+ * \return # of jobs which could not be started (and so are finished).
+ */
+static size_t procm_pool_fill(struct procm_pool* const pool) {
+  size_t n_failed = 0;
+  while (pool->n_running < pool->max_procs && !fifo_isempty(&pool->queue)) {
+    struct procm_job* job;
+    fifo_remove(&pool->queue, &job);
+    if (!procm_pool_start(pool, job)) {
+      ++n_failed;
+    }
+  } /* while() */
+  return n_failed;
+} /* procm_pool_fill() */
+
+/**
+ * \brief Read everything currently available from a running job's pipe,
+ * closing it on EOF.
+ */
+static void procm_pool_drain(struct procm_slot* const slot) {
+  struct procm_job* job = slot->job;
+  char discard[4096];
+
+  while (true) {
+    char* buf = discard;
+    size_t len = sizeof(discard);
+    if (NULL != job->output && job->output_len < job->output_size) {
+      buf = job->output + job->output_len;
+      len = job->output_size - job->output_len;
+    }
+    ssize_t n = read(slot->fd, buf, len);
+    if (n > 0) {
+      if (buf != discard) {
+        job->output_len += (size_t)n;
+      }
+    } else if (0 == n || (EINTR != errno && EAGAIN != errno)) {
+      close(slot->fd);
+      slot->fd = -1;
+      return;
+    } else if (EAGAIN == errno) {
+      return;
+    }
+  } /* while() */
+} /* procm_pool_drain() */
+
+/**
+ * \brief Reap the child of a running job whose pipe has been closed, and
+ * finish the job.
+ *
+ * \param idx Index of the slot.
+ * \param block If true, wait for the child to exit.
+ *
+ * \return \ref bool_t: true if the child was reaped (and its slot is now
+ * free), false otherwise.
+ */
+static bool_t procm_pool_reap(struct procm_pool* const pool,
+                              size_t idx,
+                              bool_t block) {
+  struct procm_job* job = pool->slots[idx].job;
+  int status;
+  pid_t rc;
+
+  do {
+    rc = waitpid(job->pid, &status, block ? 0 : WNOHANG);
+  } while (-1 == rc && EINTR == errno);
+
+  if (0 == rc) {
+    return false;
+  }
+  job->status = (-1 == rc) ? -1 : status;
+  pool->slots[idx] = pool->slots[--pool->n_running];
+  procm_pool_finish(pool, job);
+  return true;
+} /* procm_pool_reap() */
+
 END_C_DECLS
@@ -0,0 +1,169 @@
+/**
+ * \file bcring.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/multithread/bcring.h"
+
+#include "rcsw/common/alloc.h"
+#include "rcsw/er/client.h"
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+static inline uint8_t* bcring_slot(const struct bcring* const ring,
+                                   size_t idx) {
+  return (uint8_t*)ring->elements + (idx % ring->max_elts) * ring->elt_size;
+}
+
+/**
+ * \brief Compute the index of the oldest element which some consumer has not
+ * finished reading.
+ */
+static size_t bcring_head_scan(const struct bcring* const ring, size_t tail) {
+  size_t head = tail;
+  for (size_t i = 0; i < ring->n_consumers; ++i) {
+    const struct bcring_consumer* consumer = &ring->consumers[i];
+
+    /*
+     * Acquire pairs with the release in bcring_remove(), so the consumer is
+     * done reading anything before it before we overwrite it.
+     */
+    size_t idx = __atomic_load_n(&consumer->cursor, __ATOMIC_ACQUIRE) /
+                 consumer->n_chunks;
+    head = RCSW_MIN(head, idx);
+  } /* for(i..) */
+  return head;
+} /* bcring_head_scan() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+struct bcring* bcring_init(struct bcring* ring_in,
+                           const struct bcring_params* const params) {
+  RCSW_FPC_NV(NULL,
+              NULL != params,
+              params->max_elts > 0,
+              params->elt_size > 0);
+
+  struct bcring* ring = rcsw_alloc(ring_in,
+                                   sizeof(struct bcring),
+                                   params->flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(ring);
+  ring->flags = params->flags;
+  ring->elt_size = params->elt_size;
+  ring->max_elts = params->max_elts;
+  ring->n_consumers = params->n_consumers;
+  ring->consumers = NULL;
+  memset(&ring->prod, 0, sizeof(ring->prod));
+
+  ring->elements = rcsw_alloc(params->elements,
+                              bcring_element_space(params->max_elts,
+                                                   params->elt_size),
+                              params->flags & (RCSW_NOALLOC_DATA |
+                                               RCSW_ZALLOC));
+  RCSW_CHECK_PTR(ring->elements);
+
+  if (ring->n_consumers > 0) {
+    ring->consumers = rcsw_alloc(params->meta,
+                                 bcring_meta_space(params->n_consumers),
+                                 params->flags & RCSW_NOALLOC_META);
+    RCSW_CHECK_PTR(ring->consumers);
+  }
+
+  for (size_t i = 0; i < ring->n_consumers; ++i) {
+    size_t chunk_size = (NULL != params->chunks) ? params->chunks[i] :
+                        params->elt_size;
+    RCSW_CHECK(chunk_size > 0);
+    RCSW_CHECK(0 == params->elt_size % chunk_size);
+
+    struct bcring_consumer* consumer = &ring->consumers[i];
+    memset(consumer, 0, sizeof(*consumer));
+    consumer->chunk_size = chunk_size;
+    consumer->n_chunks = params->elt_size / chunk_size;
+  } /* for(i..) */
+
+  return ring;
+
+error:
+  bcring_destroy(ring);
+  errno = EAGAIN;
+  return NULL;
+} /* bcring_init() */
+
+void bcring_destroy(struct bcring* ring) {
+  RCSW_FPC_V(NULL != ring);
+
+  rcsw_free(ring->consumers, ring->flags & RCSW_NOALLOC_META);
+  rcsw_free(ring->elements, ring->flags & RCSW_NOALLOC_DATA);
+  rcsw_free(ring, ring->flags & RCSW_NOALLOC_HANDLE);
+} /* bcring_destroy() */
+
+size_t bcring_size(struct bcring* const ring) {
+  RCSW_FPC_NV(0, NULL != ring);
+
+  size_t tail = ring->prod.tail;
+  ring->prod.head = bcring_head_scan(ring, tail);
+  return tail - ring->prod.head;
+} /* bcring_size() */
+
+status_t bcring_add(struct bcring* const ring, const void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != ring, NULL != e);
+
+  /* only the producer writes the tail, so no need for an atomic load */
+  size_t tail = ring->prod.tail;
+
+  if (RCSW_UNLIKELY(tail - ring->prod.head >= ring->max_elts)) {
+    ring->prod.head = bcring_head_scan(ring, tail);
+    if (tail - ring->prod.head >= ring->max_elts) {
+      errno = EAGAIN;
+      return ERROR;
+    }
+  }
+  memcpy(bcring_slot(ring, tail), e, ring->elt_size);
+  __atomic_store_n(&ring->prod.tail, tail + 1, __ATOMIC_RELEASE);
+  return OK;
+} /* bcring_add() */
+
+void* bcring_front(struct bcring* const ring, size_t id) {
+  RCSW_FPC_NV(NULL, NULL != ring, id < ring->n_consumers);
+
+  struct bcring_consumer* consumer = &ring->consumers[id];
+  size_t idx = consumer->cursor / consumer->n_chunks;
+
+  if (idx == consumer->cached) {
+    consumer->cached = __atomic_load_n(&ring->prod.tail, __ATOMIC_ACQUIRE);
+    if (idx == consumer->cached) {
+      return NULL;
+    }
+  }
+  return bcring_slot(ring, idx) +
+      (consumer->cursor % consumer->n_chunks) * consumer->chunk_size;
+} /* bcring_front() */
+
+status_t bcring_remove(struct bcring* const ring, size_t id, void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != ring, id < ring->n_consumers);
+
+  struct bcring_consumer* consumer = &ring->consumers[id];
+  void* chunk = bcring_front(ring, id);
+
+  if (RCSW_UNLIKELY(NULL == chunk)) {
+    errno = EAGAIN;
+    return ERROR;
+  }
+  if (NULL != e) {
+    memcpy(e, chunk, consumer->chunk_size);
+  }
+  __atomic_store_n(&consumer->cursor, consumer->cursor + 1, __ATOMIC_RELEASE);
+  return OK;
+} /* bcring_remove() */
+
+END_C_DECLS
@@ -11,16 +11,99 @@
  ******************************************************************************/
 #include "rcsw/multithread/bsem.h"
 
+#include <limits.h>
+#include <string.h>
+
+#include "rcsw/al/clock.h"
 #include "rcsw/er/client.h"
 #include "rcsw/common/fpc.h"
 #include "rcsw/rcsw.h"
 #include "rcsw/common/alloc.h"
+#include "rcsw/utils/time.h"
 
 /*******************************************************************************
- * API Functions
+ * Private Functions
  ******************************************************************************/
 BEGIN_C_DECLS
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+static bool_t bsem_trytake(struct bsem* const sem) {
+  uint32_t expected = 1;
+  return __atomic_compare_exchange_n(&sem->val,
+                                     &expected,
+                                     0,
+                                     false,
+                                     __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED);
+} /* bsem_trytake() */
+
+/**
+ * \brief Take the semaphore, spinning and then sleeping if it is not
+ * available.
+ *
+ * \param abs ABSOLUTE monotonic timeout, or NULL to wait forever.
+ */
+static status_t bsem_take(struct bsem* const sem,
+                          const struct timespec* const abs) {
+  if (RCSW_LIKELY(bsem_trytake(sem))) {
+    return OK;
+  }
+  uint32_t limit = futex_spin_limit(&sem->spin_est);
+  for (uint32_t i = 1; i <= limit; ++i) {
+    RCSW_CPU_RELAX();
+    if (1 == __atomic_load_n(&sem->val, __ATOMIC_RELAXED) && bsem_trytake(sem)) {
+      futex_spin_update(&sem->spin_est, i, true);
+      futex_stats_add(&sem->stats.n_spins, i);
+      return OK;
+    }
+  } /* for(i..) */
+  futex_spin_update(&sem->spin_est, limit, false);
+  futex_stats_add(&sem->stats.n_spins, limit);
+
+  /* pairs with the fence in bsem_give(), so one of us sees the other */
+  __atomic_fetch_add(&sem->n_waiters, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  status_t rstat = OK;
+  while (!bsem_trytake(sem)) {
+    futex_stats_add(&sem->stats.n_sleeps, 1);
+    if (OK != futex_wait(&sem->val, 0, abs)) {
+      rstat = ERROR;
+      break;
+    }
+  } /* while() */
+  __atomic_fetch_sub(&sem->n_waiters, 1, __ATOMIC_RELAXED);
+  return rstat;
+} /* bsem_take() */
+
+/**
+ * \brief Make the semaphore available, waking up to \p n waiters.
+ *
+ * \return \ref status_t. ERROR if the semaphore was already available.
+ */
+static status_t bsem_give(struct bsem* const sem, int n) {
+  uint32_t expected = 0;
+  RCSW_CHECK(__atomic_compare_exchange_n(&sem->val,
+                                         &expected,
+                                         1,
+                                         false,
+                                         __ATOMIC_RELEASE,
+                                         __ATOMIC_RELAXED));
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (0 != __atomic_load_n(&sem->n_waiters, __ATOMIC_RELAXED)) {
+    futex_stats_add(&sem->stats.n_wakeups, 1);
+    RCSW_CHECK(OK == futex_wake(&sem->val, n));
+  }
+  return OK;
+
+error:
+  return ERROR;
+} /* bsem_give() */
+#endif
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
 struct bsem* bsem_init(struct bsem* const sem_in, uint32_t flags) {
   struct bsem* sem = rcsw_alloc(sem_in,
                                 sizeof(struct bsem),
@@ -28,8 +111,14 @@ struct bsem* bsem_init(struct bsem* const sem_in, uint32_t flags) {
   RCSW_CHECK_PTR(sem);
   sem->flags = flags;
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  sem->n_waiters = 0;
+  sem->spin_est = 0;
+  memset(&sem->stats, 0, sizeof(struct futex_stats));
+#else
   RCSW_CHECK(NULL != mutex_init(&sem->mtx, RCSW_NOALLOC_HANDLE));
   RCSW_CHECK(NULL != condv_init(&sem->cv, RCSW_NOALLOC_HANDLE));
+#endif
   sem->val = 1;
   return sem;
 
@@ -41,33 +130,52 @@ error:
 void bsem_destroy(struct bsem* const sem) {
   RCSW_FPC_V(NULL != sem);
 
+#if !defined(RCSW_CONFIG_AL_FUTEX_SYNC)
   mutex_destroy(&sem->mtx);
   condv_destroy(&sem->cv);
+#endif
   rcsw_free(sem, sem->flags & RCSW_NOALLOC_HANDLE);
 } /* bsem_destroy() */
 
 status_t bsem_post(struct bsem* const sem) {
   RCSW_FPC_NV(ERROR, NULL != sem);
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  return bsem_give(sem, 1);
+#else
   RCSW_CHECK(OK == mutex_lock(&sem->mtx));
-  RCSW_CHECK(1 != sem->val);
+  if (1 == sem->val) {
+    mutex_unlock(&sem->mtx);
+    return ERROR;
+  }
 
   sem->val += 1;
 
   RCSW_CHECK(OK == condv_signal(&sem->cv));
   RCSW_CHECK(OK == mutex_unlock(&sem->mtx));
+  return OK;
 
 error:
   return ERROR;
+#endif
 } /* bsem_post() */
 
 status_t bsem_timedwait(struct bsem* const sem,
                         const struct timespec* const to) {
   RCSW_FPC_NV(ERROR, NULL != sem, NULL != to);
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  /* futex timeouts are against the monotonic clock */
+  struct timespec ts = clock_monotime();
+  time_ts_add(&ts, to);
+  return bsem_take(sem, &ts);
+#else
   RCSW_CHECK(OK == mutex_lock(&sem->mtx));
   while (0 == sem->val) {
-    condv_timedwait(&sem->cv, &sem->mtx, to);
+    if (OK != condv_timedwait(&sem->cv, &sem->mtx, to)) {
+      mutex_unlock(&sem->mtx);
+      return ERROR;
+    }
   }
   sem->val -= 1;
   RCSW_CHECK(OK == mutex_unlock(&sem->mtx));
@@ -75,11 +183,15 @@ status_t bsem_timedwait(struct bsem* const sem,
 
 error:
   return ERROR;
-} /* struct bsemimedwait() */
+#endif
+} /* bsem_timedwait() */
 
 status_t bsem_wait(struct bsem* const sem) {
   RCSW_FPC_NV(ERROR, NULL != sem);
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  return bsem_take(sem, NULL);
+#else
   RCSW_CHECK(OK == mutex_lock(&sem->mtx));
   while (0 == sem->val) {
     condv_wait(&sem->cv, &sem->mtx);
@@ -90,13 +202,20 @@ status_t bsem_wait(struct bsem* const sem) {
 
 error:
   return ERROR;
+#endif
 } /* bsem_wait() */
 
 status_t bsem_flush(struct bsem* const sem) {
   RCSW_FPC_NV(ERROR, NULL != sem);
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  return bsem_give(sem, INT_MAX);
+#else
   RCSW_CHECK(OK == mutex_lock(&sem->mtx));
-  RCSW_CHECK(1 != sem->val);
+  if (1 == sem->val) {
+    mutex_unlock(&sem->mtx);
+    return ERROR;
+  }
   sem->val += 1;
   RCSW_CHECK(OK == condv_broadcast(&sem->cv));
   RCSW_CHECK(OK == mutex_unlock(&sem->mtx));
@@ -104,6 +223,22 @@ status_t bsem_flush(struct bsem* const sem) {
 
 error:
   return ERROR;
+#endif
 } /* bsem_flush() */
 
+status_t bsem_stats_get(const struct bsem* const sem,
+                        struct futex_stats* stats) {
+  RCSW_FPC_NV(ERROR, NULL != sem, NULL != stats);
+
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  stats->n_spins = __atomic_load_n(&sem->stats.n_spins, __ATOMIC_RELAXED);
+  stats->n_sleeps = __atomic_load_n(&sem->stats.n_sleeps, __ATOMIC_RELAXED);
+  stats->n_wakeups = __atomic_load_n(&sem->stats.n_wakeups, __ATOMIC_RELAXED);
+  return OK;
+#else
+  memset(stats, 0, sizeof(struct futex_stats));
+  return ERROR;
+#endif
+} /* bsem_stats_get() */
+
 END_C_DECLS
@@ -11,16 +11,87 @@
  ******************************************************************************/
 #include "rcsw/multithread/condv.h"
 
+#include <limits.h>
+#include <string.h>
+
+#include "rcsw/al/clock.h"
 #include "rcsw/er/client.h"
 #include "rcsw/common/fpc.h"
 #include "rcsw/utils/time.h"
 #include "rcsw/common/alloc.h"
 
 /*******************************************************************************
- * API Functions
+ * Private Functions
  ******************************************************************************/
 BEGIN_C_DECLS
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+/**
+ * \brief Release the mutex, sleep until signaled, and re-acquire the mutex.
+ *
+ * \param abs ABSOLUTE monotonic timeout, or NULL to wait forever.
+ */
+static status_t condv_sleep(struct condv* const cv,
+                            struct mutex* const mtx,
+                            const struct timespec* const abs) {
+  /*
+   * Sample the sequence while we still hold the mutex: a signal sent after we
+   * release it changes the sequence, and the kernel won't let us sleep.
+   */
+  __atomic_fetch_add(&cv->n_waiters, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  uint32_t seq = __atomic_load_n(&cv->seq, __ATOMIC_RELAXED);
+
+  mutex_unlock(mtx);
+  futex_stats_add(&cv->stats.n_sleeps, 1);
+  status_t rstat = futex_wait(&cv->seq, seq, abs);
+  __atomic_fetch_sub(&cv->n_waiters, 1, __ATOMIC_RELAXED);
+  mutex_lock(mtx);
+  return rstat;
+} /* condv_sleep() */
+
+static status_t condv_wake(struct condv* const cv, int n) {
+  __atomic_fetch_add(&cv->seq, 1, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (0 != __atomic_load_n(&cv->n_waiters, __ATOMIC_RELAXED)) {
+    futex_stats_add(&cv->stats.n_wakeups, 1);
+    return futex_wake(&cv->seq, n);
+  }
+  return OK;
+} /* condv_wake() */
+#endif
+
+#if !defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+/*
+ * pthread_cond_[timed]wait() releases and re-acquires the mutex behind the
+ * back of mutex_[un]lock(), so account for that here, or time spent waiting
+ * would count as time held. How long re-acquiring it took is unknown, so it
+ * counts as uncontended.
+ */
+static void condv_prof_released(struct mutex* const mtx) {
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&mtx->prof)) {
+    lockprof_released(&mtx->prof);
+  }
+#else
+  (void)mtx;
+#endif
+} /* condv_prof_released() */
+
+static void condv_prof_acquired(struct mutex* const mtx) {
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&mtx->prof)) {
+    lockprof_acquired(&mtx->prof, false, 0, true);
+  }
+#else
+  (void)mtx;
+#endif
+} /* condv_prof_acquired() */
+#endif
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
 struct condv* condv_init(struct condv* const cv_in, uint32_t flags) {
   struct condv* cv = rcsw_alloc(cv_in,
                                 sizeof(struct condv),
@@ -28,7 +99,13 @@ struct condv* condv_init(struct condv* const cv_in, uint32_t flags) {
   RCSW_CHECK_PTR(cv);
   cv->flags = flags;
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  cv->seq = 0;
+  cv->n_waiters = 0;
+  memset(&cv->stats, 0, sizeof(struct futex_stats));
+#else
   RCSW_CHECK(0 == pthread_cond_init(&cv->impl, NULL));
+#endif
   return cv;
 
 error:
@@ -39,13 +116,19 @@ error:
 void condv_destroy(struct condv* const cv) {
   RCSW_FPC_V(NULL != cv);
 
+#if !defined(RCSW_CONFIG_AL_FUTEX_SYNC)
   pthread_cond_destroy(&cv->impl);
+#endif
   rcsw_free(cv, cv->flags & RCSW_NOALLOC_HANDLE);
 } /* condv_destroy() */
 
 status_t condv_signal(struct condv* const cv) {
   RCSW_FPC_NV(ERROR, NULL != cv);
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  RCSW_CHECK(OK == condv_wake(cv, 1));
+#else
   RCSW_CHECK(0 == pthread_cond_signal(&cv->impl));
+#endif
   return OK;
 
 error:
@@ -54,7 +137,14 @@ error:
 
 status_t condv_wait(struct condv* const cv, struct mutex* const mtx) {
   RCSW_FPC_NV(ERROR, NULL != cv);
-  RCSW_CHECK(0 == pthread_cond_wait(&cv->impl, &mtx->impl));
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  RCSW_CHECK(OK == condv_sleep(cv, mtx, NULL));
+#else
+  condv_prof_released(mtx);
+  int rc = pthread_cond_wait(&cv->impl, &mtx->impl);
+  condv_prof_acquired(mtx);
+  RCSW_CHECK(0 == rc);
+#endif
   return OK;
 
 error:
@@ -65,11 +155,21 @@ status_t condv_timedwait(struct condv* const cv,
                          struct mutex* const mtx,
                          const struct timespec* const to) {
   RCSW_FPC_NV(ERROR, NULL != cv, NULL != mtx, NULL != to);
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  /* futex timeouts are against the monotonic clock */
+  struct timespec ts = clock_monotime();
+  time_ts_add(&ts, to);
+  RCSW_CHECK(OK == condv_sleep(cv, mtx, &ts));
+#else
   struct timespec ts = { .tv_sec = 0, .tv_nsec = 0 };
 
   /* Get current time */
   RCSW_CHECK(OK == time_ts_make_abs(to, &ts));
-  RCSW_CHECK(0 == pthread_cond_timedwait(&cv->impl, &mtx->impl, &ts));
+  condv_prof_released(mtx);
+  int rc = pthread_cond_timedwait(&cv->impl, &mtx->impl, &ts);
+  condv_prof_acquired(mtx);
+  RCSW_CHECK(0 == rc);
+#endif
   return OK;
 
 error:
@@ -78,11 +178,29 @@ error:
 
 status_t condv_broadcast(struct condv* const cv) {
   RCSW_FPC_NV(ERROR, NULL != cv);
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  RCSW_CHECK(OK == condv_wake(cv, INT_MAX));
+#else
   RCSW_CHECK(0 == pthread_cond_broadcast(&cv->impl));
+#endif
   return OK;
 
 error:
   return ERROR;
 } /* condv_broadcast() */
 
+status_t condv_stats_get(const struct condv* cv, struct futex_stats* stats) {
+  RCSW_FPC_NV(ERROR, NULL != cv, NULL != stats);
+
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  stats->n_spins = 0;
+  stats->n_sleeps = __atomic_load_n(&cv->stats.n_sleeps, __ATOMIC_RELAXED);
+  stats->n_wakeups = __atomic_load_n(&cv->stats.n_wakeups, __ATOMIC_RELAXED);
+  return OK;
+#else
+  memset(stats, 0, sizeof(struct futex_stats));
+  return ERROR;
+#endif
+} /* condv_stats_get() */
+
 END_C_DECLS
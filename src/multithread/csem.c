@@ -11,6 +11,11 @@
  ******************************************************************************/
 #include "rcsw/multithread/csem.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include "rcsw/al/clock.h"
 #include "rcsw/common/fpc.h"
 #include "rcsw/er/client.h"
 #include "rcsw/rcsw.h"
@@ -19,10 +24,159 @@
 #include "rcsw/common/flags.h"
 
 /*******************************************************************************
- * API Functions
+ * Private Functions
  ******************************************************************************/
 BEGIN_C_DECLS
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+static bool_t csem_trydec(struct csem* const sem) {
+  uint32_t val = __atomic_load_n(&sem->val, __ATOMIC_RELAXED);
+  while (val > 0) {
+    if (__atomic_compare_exchange_n(&sem->val,
+                                    &val,
+                                    val - 1,
+                                    false,
+                                    __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED)) {
+      return true;
+    }
+  } /* while() */
+  return false;
+} /* csem_trydec() */
+
+/**
+ * \brief Take up to \p max from the semaphore with one CAS.
+ *
+ * \return The amount taken.
+ */
+static size_t csem_trydec_n(struct csem* const sem, size_t max) {
+  uint32_t val = __atomic_load_n(&sem->val, __ATOMIC_RELAXED);
+  while (val > 0) {
+    uint32_t n = (val < max) ? val : (uint32_t)max;
+    if (__atomic_compare_exchange_n(&sem->val,
+                                    &val,
+                                    val - n,
+                                    false,
+                                    __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED)) {
+      return n;
+    }
+  } /* while() */
+  return 0;
+} /* csem_trydec_n() */
+
+/**
+ * \brief Decrement the semaphore, spinning and then sleeping if it is 0.
+ *
+ * \param abs ABSOLUTE monotonic timeout, or NULL to wait forever.
+ */
+static status_t csem_acquire(struct csem* const sem,
+                             const struct timespec* const abs) {
+  if (RCSW_LIKELY(csem_trydec(sem))) {
+    return OK;
+  }
+  uint32_t limit = futex_spin_limit(&sem->spin_est);
+  for (uint32_t i = 1; i <= limit; ++i) {
+    RCSW_CPU_RELAX();
+    if (0 != __atomic_load_n(&sem->val, __ATOMIC_RELAXED) && csem_trydec(sem)) {
+      futex_spin_update(&sem->spin_est, i, true);
+      futex_stats_add(&sem->stats.n_spins, i);
+      return OK;
+    }
+  } /* for(i..) */
+  futex_spin_update(&sem->spin_est, limit, false);
+  futex_stats_add(&sem->stats.n_spins, limit);
+
+  /* pairs with the fence in csem_post(), so one of us sees the other */
+  __atomic_fetch_add(&sem->n_waiters, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  status_t rstat = OK;
+  while (!csem_trydec(sem)) {
+    futex_stats_add(&sem->stats.n_sleeps, 1);
+    if (OK != futex_wait(&sem->val, 0, abs)) {
+      rstat = ERROR;
+      break;
+    }
+  } /* while() */
+  __atomic_fetch_sub(&sem->n_waiters, 1, __ATOMIC_RELAXED);
+  return rstat;
+} /* csem_acquire() */
+#endif
+
+static status_t csem_wait_impl(struct csem* const sem) {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  RCSW_CHECK(OK == csem_acquire(sem, NULL));
+#else
+  RCSW_CHECK(0 == sem_wait(&sem->impl));
+#endif
+  return OK;
+
+error:
+  return ERROR;
+} /* csem_wait_impl() */
+
+static status_t csem_trywait_impl(struct csem* const sem) {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  if (!csem_trydec(sem)) {
+    errno = EAGAIN;
+    goto error;
+  }
+#else
+  RCSW_CHECK(0 == sem_trywait(&sem->impl));
+#endif
+  return OK;
+
+error:
+  return ERROR;
+} /* csem_trywait_impl() */
+
+static status_t csem_timedwait_impl(struct csem* const sem,
+                                    const struct timespec* const to) {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  /* futex timeouts are against the monotonic clock */
+  struct timespec ts = clock_monotime();
+  time_ts_add(&ts, to);
+  RCSW_CHECK(OK == csem_acquire(sem, &ts));
+#else
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = 0 };
+  RCSW_CHECK(OK == time_ts_make_abs(to, &ts));
+  RCSW_CHECK(0 == sem_timedwait(&sem->impl, &ts));
+#endif
+
+  return OK;
+
+error:
+  return ERROR;
+} /* csem_timedwait_impl() */
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+/**
+ * \brief Wait on a semaphore which is being profiled.
+ *
+ * \param to RELATIVE timeout, or NULL to wait forever.
+ */
+static status_t csem_wait_profiled(struct csem* const sem,
+                                   const struct timespec* const to) {
+  /* only timestamp the start if we actually have to wait */
+  if (OK == csem_trywait_impl(sem)) {
+    lockprof_acquired(&sem->prof, false, 0, false);
+    return OK;
+  }
+  uint64_t start = lockprof_now();
+  RCSW_CHECK(OK == ((NULL != to) ? csem_timedwait_impl(sem, to)
+                                 : csem_wait_impl(sem)));
+  lockprof_acquired(&sem->prof, true, start, false);
+  return OK;
+
+error:
+  return ERROR;
+} /* csem_wait_profiled() */
+#endif
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
 struct csem* csem_init(struct csem* const sem_in, size_t value, uint32_t flags) {
   struct csem* sem = rcsw_alloc(sem_in,
                                 sizeof(struct csem),
@@ -30,9 +184,20 @@ struct csem* csem_init(struct csem* const sem_in, size_t value, uint32_t flags)
 
   RCSW_CHECK_PTR(sem);
   sem->flags = flags;
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  lockprof_init(&sem->prof);
+#endif
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  RCSW_CHECK(value <= UINT32_MAX);
+  sem->val = (uint32_t)value;
+  sem->n_waiters = 0;
+  sem->spin_est = 0;
+  memset(&sem->stats, 0, sizeof(struct futex_stats));
+#else
   RCSW_CHECK(0 == sem_init(&sem->impl,
                            0, /* shared between threads */
                            (unsigned int)value));
+#endif
   return sem;
 
 error:
@@ -42,48 +207,130 @@ error:
 void csem_destroy(struct csem* sem) {
   RCSW_FPC_V(NULL != sem);
 
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  lockprof_unregister(&sem->prof);
+#endif
+#if !defined(RCSW_CONFIG_AL_FUTEX_SYNC)
   sem_destroy(&sem->impl);
+#endif
   rcsw_free(sem, sem->flags & RCSW_NOALLOC_HANDLE);
 } /* csem_destroy() */
 
 status_t csem_wait(struct csem* sem) {
   RCSW_FPC_NV(ERROR, NULL != sem);
-  RCSW_CHECK(0 == sem_wait(&sem->impl));
-  return OK;
 
-error:
-  return ERROR;
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&sem->prof)) {
+    return csem_wait_profiled(sem, NULL);
+  }
+#endif
+  return csem_wait_impl(sem);
 } /* csem_wait() */
 
 status_t csem_trywait(struct csem* sem) {
   RCSW_FPC_NV(ERROR, NULL != sem);
-  RCSW_CHECK(0 == sem_trywait(&sem->impl));
+
+  RCSW_CHECK(OK == csem_trywait_impl(sem));
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&sem->prof)) {
+    lockprof_acquired(&sem->prof, false, 0, false);
+  }
+#endif
   return OK;
 
 error:
   return ERROR;
-} /* csem_wait() */
+} /* csem_trywait() */
 
 status_t csem_timedwait(struct csem* const sem,
-                           const struct timespec* const to) {
+                        const struct timespec* const to) {
   RCSW_FPC_NV(ERROR, NULL != sem, NULL != to);
-  struct timespec ts = { .tv_sec = 0, .tv_nsec = 0 };
-  RCSW_CHECK(OK == time_ts_make_abs(to, &ts));
-  RCSW_CHECK(0 == sem_timedwait(&sem->impl, &ts));
 
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&sem->prof)) {
+    return csem_wait_profiled(sem, to);
+  }
+#endif
+  return csem_timedwait_impl(sem, to);
+} /* csem_timedwait() */
+
+status_t csem_post(struct csem* sem) {
+  RCSW_FPC_NV(ERROR, NULL != sem);
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  __atomic_fetch_add(&sem->val, 1, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (0 != __atomic_load_n(&sem->n_waiters, __ATOMIC_RELAXED)) {
+    futex_stats_add(&sem->stats.n_wakeups, 1);
+    RCSW_CHECK(OK == futex_wake(&sem->val, 1));
+  }
+#else
+  RCSW_CHECK(0 == sem_post(&sem->impl));
+#endif
   return OK;
 
 error:
   return ERROR;
-}
+} /* csem_post() */
 
-status_t csem_post(struct csem* sem) {
+status_t csem_post_n(struct csem* const sem, size_t n) {
   RCSW_FPC_NV(ERROR, NULL != sem);
-  RCSW_CHECK(0 == sem_post(&sem->impl));
+  if (0 == n) {
+    return OK;
+  }
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  RCSW_CHECK(n <= UINT32_MAX);
+  __atomic_fetch_add(&sem->val, (uint32_t)n, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (0 != __atomic_load_n(&sem->n_waiters, __ATOMIC_RELAXED)) {
+    futex_stats_add(&sem->stats.n_wakeups, 1);
+    RCSW_CHECK(OK == futex_wake(&sem->val, (n < INT_MAX) ? (int)n : INT_MAX));
+  }
+#else
+  for (size_t i = 0; i < n; ++i) {
+    RCSW_CHECK(0 == sem_post(&sem->impl));
+  } /* for(i..) */
+#endif
   return OK;
 
 error:
   return ERROR;
-} /* csem_post() */
+} /* csem_post_n() */
+
+size_t csem_trywait_n(struct csem* const sem, size_t max) {
+  RCSW_FPC_NV(0, NULL != sem);
+  if (0 == max) {
+    return 0;
+  }
+
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  size_t n = csem_trydec_n(sem, max);
+#else
+  size_t n = 0;
+  while (n < max && 0 == sem_trywait(&sem->impl)) {
+    ++n;
+  } /* while() */
+#endif
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (n > 0 && lockprof_enabled(&sem->prof)) {
+    lockprof_acquired(&sem->prof, false, 0, false);
+  }
+#endif
+  return n;
+} /* csem_trywait_n() */
+
+status_t csem_stats_get(const struct csem* sem, struct futex_stats* stats) {
+  RCSW_FPC_NV(ERROR, NULL != sem, NULL != stats);
+
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  stats->n_spins = __atomic_load_n(&sem->stats.n_spins, __ATOMIC_RELAXED);
+  stats->n_sleeps = __atomic_load_n(&sem->stats.n_sleeps, __ATOMIC_RELAXED);
+  stats->n_wakeups = __atomic_load_n(&sem->stats.n_wakeups, __ATOMIC_RELAXED);
+  return OK;
+#else
+  memset(stats, 0, sizeof(struct futex_stats));
+  return ERROR;
+#endif
+} /* csem_stats_get() */
 
 END_C_DECLS
@@ -0,0 +1,293 @@
+/**
+ * \file ebr.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/multithread/ebr.h"
+
+#include <errno.h>
+
+#define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "mt", "ebr")
+#define RCSW_ER_MODID ekLOG4CL_MT_EBR
+#include "rcsw/er/client.h"
+#include "rcsw/common/alloc.h"
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+static void ebr_reclaim_free(RCSW_UNUSED void* ctx, void* ptr) {
+  rcsw_free(ptr, RCSW_NONE);
+} /* ebr_reclaim_free() */
+
+static void ebr_reclaim_mpool(void* ctx, void* ptr) {
+  mpool_release((struct mpool*)ctx, ptr);
+} /* ebr_reclaim_mpool() */
+
+/**
+ * \brief Advance the global epoch, if every thread in a critical section has
+ * seen the current one.
+ *
+ * \return The global epoch after the attempt.
+ */
+static uint64_t ebr_epoch_advance(struct ebr* const the_ebr) {
+  uint64_t epoch = __atomic_load_n(&the_ebr->epoch, __ATOMIC_ACQUIRE);
+
+  /* pairs with the fence in ebr_enter() */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  for (size_t i = 0; i < the_ebr->max_threads; ++i) {
+    uint64_t local = __atomic_load_n(&the_ebr->recs[i].epoch,
+                                     __ATOMIC_ACQUIRE);
+    if (0 != local && local != epoch) {
+      return epoch;
+    }
+  } /* for(i..) */
+
+  /* failure just means someone else advanced it */
+  __atomic_compare_exchange_n(&the_ebr->epoch,
+                              &epoch,
+                              epoch + 1,
+                              false,
+                              __ATOMIC_ACQ_REL,
+                              __ATOMIC_ACQUIRE);
+  return __atomic_load_n(&the_ebr->epoch, __ATOMIC_ACQUIRE);
+} /* ebr_epoch_advance() */
+
+/**
+ * \brief Reclaim everything in a retire list which was retired at least 2
+ * epochs ago.
+ *
+ * \return # of objects reclaimed.
+ */
+static size_t ebr_rec_reclaim(struct ebr_rec* const rec, uint64_t epoch) {
+  size_t n_reclaimed = 0;
+
+  mutex_lock(&rec->mtx);
+  size_t kept = 0;
+  for (size_t i = 0; i < rec->n_retired; ++i) {
+    struct ebr_retired* ent = &rec->retired[i];
+    if (ent->epoch + 2 <= epoch) {
+      ent->reclaim(ent->ctx, ent->ptr);
+      ++n_reclaimed;
+    } else {
+      rec->retired[kept++] = *ent;
+    }
+  } /* for(i..) */
+  rec->n_retired = kept;
+  mutex_unlock(&rec->mtx);
+
+  return n_reclaimed;
+} /* ebr_rec_reclaim() */
+
+static void* ebr_reclaimer(void* arg) {
+  struct ebr* the_ebr = arg;
+
+  /* stop is only posted on destroy, so anything else is a timeout */
+  while (OK != csem_timedwait(&the_ebr->stop, &the_ebr->period)) {
+    ebr_reclaim(the_ebr);
+  } /* while() */
+  return NULL;
+} /* ebr_reclaimer() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+struct ebr* ebr_init(struct ebr* ebr_in, const struct ebr_params* params) {
+  RCSW_FPC_NV(NULL,
+              NULL != params,
+              params->max_threads > 0,
+              params->retire_max > 0);
+  RCSW_ER_MODULE_INIT();
+
+  struct ebr* the_ebr = rcsw_alloc(ebr_in,
+                                   sizeof(struct ebr),
+                                   params->flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(the_ebr);
+
+  /* reclaimer and sync started below, once everything else is set up */
+  the_ebr->flags = params->flags & ~RCSW_EBR_RECLAIMER;
+  the_ebr->epoch = 1;
+  the_ebr->max_threads = params->max_threads;
+  the_ebr->retire_max = params->retire_max;
+  the_ebr->period = params->period;
+  the_ebr->recs = NULL;
+  the_ebr->retired = NULL;
+
+  the_ebr->recs = rcsw_alloc(params->meta,
+                             ebr_meta_space(params->max_threads),
+                             params->flags & RCSW_NOALLOC_META);
+  RCSW_CHECK_PTR(the_ebr->recs);
+
+  the_ebr->retired = rcsw_alloc(params->elements,
+                                ebr_element_space(params->max_threads,
+                                                  params->retire_max),
+                                params->flags & RCSW_NOALLOC_DATA);
+  RCSW_CHECK_PTR(the_ebr->retired);
+
+  for (size_t i = 0; i < the_ebr->max_threads; ++i) {
+    struct ebr_rec* rec = &the_ebr->recs[i];
+    rec->epoch = 0;
+    rec->nesting = 0;
+    rec->in_use = 0;
+    rec->retired = the_ebr->retired + i * the_ebr->retire_max;
+    rec->n_retired = 0;
+    rec->ebr = the_ebr;
+    RCSW_CHECK(NULL != mutex_init(&rec->mtx, RCSW_NOALLOC_HANDLE));
+  } /* for(i..) */
+
+  if (params->flags & RCSW_EBR_RECLAIMER) {
+    RCSW_CHECK(NULL != csem_init(&the_ebr->stop, 0, RCSW_NOALLOC_HANDLE));
+    if (0 != pthread_create(&the_ebr->reclaimer,
+                            NULL,
+                            ebr_reclaimer,
+                            the_ebr)) {
+      csem_destroy(&the_ebr->stop);
+      goto error;
+    }
+    the_ebr->flags |= RCSW_EBR_RECLAIMER;
+  }
+
+  ER_DEBUG("max_threads=%zu retire_max=%zu flags=0x%08x",
+           the_ebr->max_threads,
+           the_ebr->retire_max,
+           the_ebr->flags);
+  return the_ebr;
+
+error:
+  ebr_destroy(the_ebr);
+  errno = EAGAIN;
+  return NULL;
+} /* ebr_init() */
+
+void ebr_destroy(struct ebr* the_ebr) {
+  RCSW_FPC_V(NULL != the_ebr);
+
+  if (the_ebr->flags & RCSW_EBR_RECLAIMER) {
+    csem_post(&the_ebr->stop);
+    pthread_join(the_ebr->reclaimer, NULL);
+    csem_destroy(&the_ebr->stop);
+  }
+
+  if (NULL != the_ebr->recs && NULL != the_ebr->retired) {
+    for (size_t i = 0; i < the_ebr->max_threads; ++i) {
+      /* no readers left, so everything can go */
+      ebr_rec_reclaim(&the_ebr->recs[i], UINT64_MAX);
+      mutex_destroy(&the_ebr->recs[i].mtx);
+    } /* for(i..) */
+  }
+  rcsw_free(the_ebr->retired, the_ebr->flags & RCSW_NOALLOC_DATA);
+  rcsw_free(the_ebr->recs, the_ebr->flags & RCSW_NOALLOC_META);
+  rcsw_free(the_ebr, the_ebr->flags & RCSW_NOALLOC_HANDLE);
+} /* ebr_destroy() */
+
+struct ebr_rec* ebr_register(struct ebr* the_ebr) {
+  RCSW_FPC_NV(NULL, NULL != the_ebr);
+
+  for (size_t i = 0; i < the_ebr->max_threads; ++i) {
+    struct ebr_rec* rec = &the_ebr->recs[i];
+    uint32_t expected = 0;
+    if (__atomic_compare_exchange_n(&rec->in_use,
+                                    &expected,
+                                    1,
+                                    false,
+                                    __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED)) {
+      rec->nesting = 0;
+      return rec;
+    }
+  } /* for(i..) */
+
+  ER_WARN("All %zu thread records in use", the_ebr->max_threads);
+  return NULL;
+} /* ebr_register() */
+
+void ebr_unregister(struct ebr_rec* rec) {
+  RCSW_FPC_V(NULL != rec, 0 == rec->nesting);
+
+  __atomic_store_n(&rec->epoch, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&rec->in_use, 0, __ATOMIC_RELEASE);
+} /* ebr_unregister() */
+
+status_t ebr_retire(struct ebr_rec* rec,
+                    void* ptr,
+                    void (*reclaim)(void* ctx, void* ptr),
+                    void* ctx) {
+  RCSW_FPC_NV(ERROR, NULL != rec, NULL != ptr, NULL != reclaim);
+
+  /* the object must be unlinked BEFORE we sample the epoch */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  struct ebr_retired ent = {
+    .ptr = ptr,
+    .reclaim = reclaim,
+    .ctx = ctx,
+    .epoch = __atomic_load_n(&rec->ebr->epoch, __ATOMIC_ACQUIRE)
+  };
+
+  RCSW_CHECK(OK == ebr_retire_reserve(rec));
+
+  /* only we add to the list, so there is still room */
+  mutex_lock(&rec->mtx);
+  rec->retired[rec->n_retired++] = ent;
+  mutex_unlock(&rec->mtx);
+  return OK;
+
+error:
+  return ERROR;
+} /* ebr_retire() */
+
+status_t ebr_retire_reserve(struct ebr_rec* rec) {
+  RCSW_FPC_NV(ERROR, NULL != rec);
+
+  /* a second check after reclaiming, if the retire list is full */
+  for (size_t i = 0; i < 2; ++i) {
+    if (__atomic_load_n(&rec->n_retired, __ATOMIC_RELAXED) <
+        rec->ebr->retire_max) {
+      return OK;
+    }
+    if (0 == i) {
+      /* twice: an object retired in the current epoch needs two advances */
+      ebr_reclaim(rec->ebr);
+      ebr_reclaim(rec->ebr);
+    }
+  } /* for(i..) */
+
+  ER_WARN("Retire list full: %zu objects waiting on readers",
+          rec->ebr->retire_max);
+  errno = ENOMEM;
+  return ERROR;
+} /* ebr_retire_reserve() */
+
+status_t ebr_retire_free(struct ebr_rec* rec, void* ptr) {
+  return ebr_retire(rec, ptr, ebr_reclaim_free, NULL);
+} /* ebr_retire_free() */
+
+status_t ebr_retire_mpool(struct ebr_rec* rec, struct mpool* pool, void* ptr) {
+  RCSW_FPC_NV(ERROR, NULL != pool);
+  return ebr_retire(rec, ptr, ebr_reclaim_mpool, pool);
+} /* ebr_retire_mpool() */
+
+size_t ebr_reclaim(struct ebr* the_ebr) {
+  RCSW_FPC_NV(0, NULL != the_ebr);
+
+  uint64_t epoch = ebr_epoch_advance(the_ebr);
+  size_t n_reclaimed = 0;
+
+  /* includes records of unregistered threads, which still can have objects */
+  for (size_t i = 0; i < the_ebr->max_threads; ++i) {
+    struct ebr_rec* rec = &the_ebr->recs[i];
+    if (0 != __atomic_load_n(&rec->n_retired, __ATOMIC_RELAXED)) {
+      n_reclaimed += ebr_rec_reclaim(rec, epoch);
+    }
+  } /* for(i..) */
+  return n_reclaimed;
+} /* ebr_reclaim() */
+
+END_C_DECLS
@@ -0,0 +1,183 @@
+/**
+ * \file lockprof.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/multithread/lockprof.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "rcsw/common/fpc.h"
+#include "rcsw/er/client.h"
+
+/*******************************************************************************
+ * Global Variables
+ ******************************************************************************/
+/*
+ * The registry. A raw pthread mutex rather than a \ref mutex, so that it is not
+ * profiled itself.
+ */
+static pthread_mutex_t g_registry_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct lockprof* g_registry;
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+static void lockprof_max_update(uint64_t* const max, uint64_t val) {
+  uint64_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+  while (val > cur &&
+         !__atomic_compare_exchange_n(max,
+                                      &cur,
+                                      val,
+                                      true,
+                                      __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+  } /* while() */
+} /* lockprof_max_update() */
+
+static void lockprof_snapshot(const struct lockprof* const prof,
+                              struct lockprof_stats* const stats) {
+  const struct lockprof_stats* src = &prof->stats;
+  stats->n_acquires = __atomic_load_n(&src->n_acquires, __ATOMIC_RELAXED);
+  stats->n_contended = __atomic_load_n(&src->n_contended, __ATOMIC_RELAXED);
+  stats->wait_total = __atomic_load_n(&src->wait_total, __ATOMIC_RELAXED);
+  stats->wait_max = __atomic_load_n(&src->wait_max, __ATOMIC_RELAXED);
+  stats->hold_total = __atomic_load_n(&src->hold_total, __ATOMIC_RELAXED);
+  stats->hold_max = __atomic_load_n(&src->hold_max, __ATOMIC_RELAXED);
+} /* lockprof_snapshot() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+void lockprof_acquired(struct lockprof* const prof,
+                       bool_t contended,
+                       uint64_t start,
+                       bool_t exclusive) {
+  struct lockprof_stats* stats = &prof->stats;
+
+  __atomic_fetch_add(&stats->n_acquires, 1, __ATOMIC_RELAXED);
+  if (!contended && !exclusive) {
+    return; /* nothing to time */
+  }
+  uint64_t now = lockprof_now();
+  if (contended) {
+    uint64_t wait = now - start;
+    __atomic_fetch_add(&stats->n_contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->wait_total, wait, __ATOMIC_RELAXED);
+    lockprof_max_update(&stats->wait_max, wait);
+  }
+  if (exclusive) {
+    prof->acquired_at = now;
+  }
+} /* lockprof_acquired() */
+
+void lockprof_released(struct lockprof* const prof) {
+  /* registered while held, so we don't know when it was acquired */
+  if (0 == prof->acquired_at) {
+    return;
+  }
+  uint64_t hold = lockprof_now() - prof->acquired_at;
+  prof->acquired_at = 0;
+
+  __atomic_fetch_add(&prof->stats.hold_total, hold, __ATOMIC_RELAXED);
+  lockprof_max_update(&prof->stats.hold_max, hold);
+} /* lockprof_released() */
+
+status_t lockprof_register(struct lockprof* const prof,
+                           const char* const name) {
+  RCSW_FPC_NV(ERROR, NULL != prof, NULL != name, '\0' != name[0]);
+  RCSW_CHECK(!lockprof_enabled(prof));
+
+  memset(&prof->stats, 0, sizeof(struct lockprof_stats));
+  prof->acquired_at = 0;
+
+  pthread_mutex_lock(&g_registry_mtx);
+  strncpy(prof->name, name, RCSW_LOCKPROF_NAMELEN - 1);
+  prof->name[RCSW_LOCKPROF_NAMELEN - 1] = '\0';
+  prof->next = g_registry;
+  g_registry = prof;
+  pthread_mutex_unlock(&g_registry_mtx);
+  return OK;
+
+error:
+  return ERROR;
+} /* lockprof_register() */
+
+void lockprof_unregister(struct lockprof* const prof) {
+  RCSW_FPC_V(NULL != prof);
+
+  if (!lockprof_enabled(prof)) {
+    return;
+  }
+  pthread_mutex_lock(&g_registry_mtx);
+  struct lockprof** curr = &g_registry;
+  while (NULL != *curr && prof != *curr) {
+    curr = &(*curr)->next;
+  } /* while() */
+  if (NULL != *curr) {
+    *curr = prof->next;
+  }
+  prof->name[0] = '\0';
+  prof->next = NULL;
+  pthread_mutex_unlock(&g_registry_mtx);
+} /* lockprof_unregister() */
+
+status_t lockprof_lookup(const char* const name,
+                         struct lockprof_stats* const stats) {
+  RCSW_FPC_NV(ERROR, NULL != name, NULL != stats);
+
+  status_t rstat = ERROR;
+  pthread_mutex_lock(&g_registry_mtx);
+  for (struct lockprof* curr = g_registry; NULL != curr; curr = curr->next) {
+    if (0 == strncmp(curr->name, name, RCSW_LOCKPROF_NAMELEN - 1)) {
+      lockprof_snapshot(curr, stats);
+      rstat = OK;
+      break;
+    }
+  } /* for(curr..) */
+  pthread_mutex_unlock(&g_registry_mtx);
+  return rstat;
+} /* lockprof_lookup() */
+
+size_t lockprof_foreach(void (*cb)(const char* name,
+                                   const struct lockprof_stats* stats,
+                                   void* arg),
+                        void* arg) {
+  RCSW_FPC_NV(0, NULL != cb);
+
+  size_t n_locks = 0;
+  pthread_mutex_lock(&g_registry_mtx);
+  for (struct lockprof* curr = g_registry; NULL != curr; curr = curr->next) {
+    struct lockprof_stats stats;
+    lockprof_snapshot(curr, &stats);
+    cb(curr->name, &stats, arg);
+    ++n_locks;
+  } /* for(curr..) */
+  pthread_mutex_unlock(&g_registry_mtx);
+  return n_locks;
+} /* lockprof_foreach() */
+
+void lockprof_reset_all(void) {
+  pthread_mutex_lock(&g_registry_mtx);
+  for (struct lockprof* curr = g_registry; NULL != curr; curr = curr->next) {
+    struct lockprof_stats* stats = &curr->stats;
+    __atomic_store_n(&stats->n_acquires, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->n_contended, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->wait_total, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->wait_max, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->hold_total, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->hold_max, 0, __ATOMIC_RELAXED);
+  } /* for(curr..) */
+  pthread_mutex_unlock(&g_registry_mtx);
+} /* lockprof_reset_all() */
+
+END_C_DECLS
@@ -11,17 +11,397 @@
  ******************************************************************************/
 #include "rcsw/multithread/mpool.h"
 
+#include <limits.h>
+
 #define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "mt", "mpool")
 #define RCSW_ER_MODID ekLOG4CL_MT_MPOOL
 #include "rcsw/er/client.h"
 #include "rcsw/common/fpc.h"
 #include "rcsw/rcsw.h"
 #include "rcsw/common/alloc.h"
+#include "rcsw/al/clock.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/utils/time.h"
+#include "rcsw/multithread/threadm.h"
+
+BEGIN_C_DECLS
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+static inline void* mpool_chunk(const struct mpool* const the_pool,
+                                size_t idx) {
+  return (uint8_t*)the_pool->elements + idx * the_pool->elt_size;
+}
+
+static void mpool_magazine_lock(struct mpool_magazine* const mag) {
+  while (__atomic_exchange_n(&mag->lock, 1, __ATOMIC_ACQUIRE)) {
+    RCSW_CPU_RELAX();
+  } /* while() */
+}
+
+static void mpool_magazine_unlock(struct mpool_magazine* const mag) {
+  __atomic_store_n(&mag->lock, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Pop up to \p max chunks off the lock-free free stack with a single
+ * CAS.
+ *
+ * \return The # of chunks popped.
+ */
+static size_t mpool_stack_pop(struct mpool* const the_pool,
+                              uint32_t* const out,
+                              size_t max) {
+  uint64_t top = __atomic_load_n(&the_pool->free_top, __ATOMIC_ACQUIRE);
+
+  while (true) {
+    uint32_t cur = (uint32_t)top;
+    size_t n = 0;
+
+    /*
+     * The links read here might be stale if another thread pops/pushes these
+     * chunks concurrently, but then the tag in the top will have changed, and
+     * the CAS will fail.
+     */
+    while (n < max && 0 != cur) {
+      out[n++] = cur - 1;
+      cur = __atomic_load_n(&the_pool->slots[cur - 1].next, __ATOMIC_RELAXED);
+    } /* while() */
+    if (0 == n) {
+      return 0;
+    }
+    uint64_t new_top = (((top >> 32) + 1) << 32) | cur;
+    if (__atomic_compare_exchange_n(&the_pool->free_top,
+                                    &top,
+                                    new_top,
+                                    true,
+                                    __ATOMIC_ACQUIRE,
+                                    __ATOMIC_ACQUIRE)) {
+      return n;
+    }
+  } /* while() */
+} /* mpool_stack_pop() */
+
+/**
+ * \brief Push \p n chunks onto the lock-free free stack with a single CAS.
+ */
+static void mpool_stack_push(struct mpool* const the_pool,
+                             const uint32_t* const idxs,
+                             size_t n) {
+  if (0 == n) {
+    return;
+  }
+  /* chain them together first, so they go on in one shot */
+  for (size_t i = 0; i < n - 1; ++i) {
+    __atomic_store_n(&the_pool->slots[idxs[i]].next,
+                     idxs[i + 1] + 1,
+                     __ATOMIC_RELAXED);
+  } /* for(i..) */
+
+  uint64_t top = __atomic_load_n(&the_pool->free_top, __ATOMIC_RELAXED);
+  uint64_t new_top;
+  do {
+    __atomic_store_n(&the_pool->slots[idxs[n - 1]].next,
+                     (uint32_t)top,
+                     __ATOMIC_RELAXED);
+    new_top = (((top >> 32) + 1) << 32) | (idxs[0] + 1);
+  } while (!__atomic_compare_exchange_n(&the_pool->free_top,
+                                        &top,
+                                        new_top,
+                                        true,
+                                        __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+} /* mpool_stack_push() */
+
+/**
+ * \brief Wake up all threads waiting for a free chunk, if there are any.
+ */
+static void mpool_lf_wake(struct mpool* const the_pool) {
+  __atomic_add_fetch(&the_pool->lf.seq, 1, __ATOMIC_RELEASE);
+  futex_wake(&the_pool->lf.seq, INT_MAX);
+}
+
+/**
+ * \brief Return all chunks in a magazine to the free stack. Called when a
+ * thread exits, and when someone is waiting for a free chunk.
+ */
+static void mpool_magazine_flush(void* const arg) {
+  struct mpool_magazine* mag = arg;
+
+  mpool_magazine_lock(mag);
+  mpool_stack_push(mag->pool, mag->slots, mag->count);
+  mag->count = 0;
+  mpool_magazine_unlock(mag);
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&mag->pool->lf.waiters, __ATOMIC_RELAXED)) {
+    mpool_lf_wake(mag->pool);
+  }
+} /* mpool_magazine_flush() */
+
+/**
+ * \brief Get the calling thread's magazine, creating it if this is the first
+ * time the thread has used the pool.
+ *
+ * \return The magazine, or NULL if it could not be allocated.
+ */
+static struct mpool_magazine* mpool_magazine_get(struct mpool* const the_pool) {
+  struct mpool_magazine* mag = pthread_getspecific(the_pool->lf.key);
+  if (RCSW_LIKELY(NULL != mag)) {
+    return mag;
+  }
+  mag = rcsw_alloc(NULL, sizeof(struct mpool_magazine), RCSW_ZALLOC);
+  RCSW_CHECK_PTR(mag);
+  mag->pool = the_pool;
+
+  mag->next = __atomic_load_n(&the_pool->lf.magazines, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&the_pool->lf.magazines,
+                                      &mag->next,
+                                      mag,
+                                      true,
+                                      __ATOMIC_RELEASE,
+                                      __ATOMIC_RELAXED)) {
+  } /* while() */
+  RCSW_CHECK(0 == pthread_setspecific(the_pool->lf.key, mag));
+  return mag;
+
+error:
+  return NULL;
+} /* mpool_magazine_get() */
+
+/**
+ * \brief Take up to half a magazine worth of free chunks from other threads'
+ * magazines. Only called when the free stack is empty.
+ *
+ * \return The # of chunks stolen.
+ */
+static size_t mpool_magazine_steal(struct mpool* const the_pool,
+                                   const struct mpool_magazine* const self,
+                                   uint32_t* const out) {
+  size_t n = 0;
+  struct mpool_magazine* mag = __atomic_load_n(&the_pool->lf.magazines,
+                                               __ATOMIC_ACQUIRE);
+  for (; NULL != mag && n < RCSW_MPOOL_MAGAZINE_SIZE / 2; mag = mag->next) {
+    if (mag == self || 0 == __atomic_load_n(&mag->count, __ATOMIC_RELAXED)) {
+      continue;
+    }
+    mpool_magazine_lock(mag);
+    while (mag->count > 0 && n < RCSW_MPOOL_MAGAZINE_SIZE / 2) {
+      out[n++] = mag->slots[--mag->count];
+    } /* while() */
+    mpool_magazine_unlock(mag);
+  } /* for(mag..) */
+  return n;
+} /* mpool_magazine_steal() */
+
+/**
+ * \brief Get a free chunk in \ref RCSW_MPOOL_LOCKFREE mode, waiting until \p
+ * deadline (if non-NULL) if there aren't any.
+ *
+ * \return The chunk index, or -1 on timeout/error.
+ */
+static long mpool_lf_req(struct mpool* const the_pool,
+                         const struct timespec* const deadline) {
+  struct mpool_magazine* mag = mpool_magazine_get(the_pool);
+  uint32_t refill[RCSW_MPOOL_MAGAZINE_SIZE / 2];
+  uint32_t idx;
+
+  RCSW_CHECK_PTR(mag);
+
+  /* fast path: this thread has a free chunk cached */
+  mpool_magazine_lock(mag);
+  if (RCSW_LIKELY(mag->count > 0)) {
+    idx = mag->slots[--mag->count];
+    mpool_magazine_unlock(mag);
+    goto done;
+  }
+  mpool_magazine_unlock(mag);
+
+  while (true) {
+    uint32_t seq = __atomic_load_n(&the_pool->lf.seq, __ATOMIC_ACQUIRE);
+    size_t n = mpool_stack_pop(the_pool, refill, RCSW_ARRAY_ELTS(refill));
+    if (0 == n) {
+      /*
+       * Announce we are about to wait before the last look around, so that
+       * anyone freeing a chunk after this either sees us or we see the chunk.
+       */
+      __atomic_add_fetch(&the_pool->lf.waiters, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+      n = mpool_stack_pop(the_pool, refill, RCSW_ARRAY_ELTS(refill));
+      if (0 == n) {
+        n = mpool_magazine_steal(the_pool, mag, refill);
+      }
+      status_t rval = OK;
+      if (0 == n) {
+        rval = futex_wait(&the_pool->lf.seq, seq, deadline);
+      }
+      __atomic_sub_fetch(&the_pool->lf.waiters, 1, __ATOMIC_RELAXED);
+      if (0 == n) {
+        if (OK != rval) {
+          return -1;
+        }
+        if (NULL != deadline) {
+          struct timespec now = clock_monotime();
+          if (time_ts_cmp(&now, deadline) >= 0) {
+            errno = ETIMEDOUT;
+            return -1;
+          }
+        }
+        continue;
+      }
+    }
+    /* keep one, cache the rest */
+    idx = refill[--n];
+    mpool_magazine_lock(mag);
+    for (size_t i = 0; i < n; ++i) {
+      mag->slots[mag->count++] = refill[i];
+    } /* for(i..) */
+    mpool_magazine_unlock(mag);
+    break;
+  } /* while() */
+
+done:
+  __atomic_store_n(&mag->n_out, mag->n_out + 1, __ATOMIC_RELAXED);
+  return idx;
+
+error:
+  return -1;
+} /* mpool_lf_req() */
+
+/**
+ * \brief Return a chunk whose refcount has reached 0 to the calling thread's
+ * magazine in \ref RCSW_MPOOL_LOCKFREE mode.
+ */
+static status_t mpool_lf_free(struct mpool* const the_pool, size_t idx) {
+  struct mpool_magazine* mag = mpool_magazine_get(the_pool);
+  RCSW_CHECK_PTR(mag);
+
+  mpool_magazine_lock(mag);
+  if (mag->count == RCSW_MPOOL_MAGAZINE_SIZE) {
+    /* full--give half back to everyone else */
+    mag->count -= RCSW_MPOOL_MAGAZINE_SIZE / 2;
+    mpool_stack_push(the_pool,
+                     mag->slots + mag->count,
+                     RCSW_MPOOL_MAGAZINE_SIZE / 2);
+  }
+  mag->slots[mag->count++] = (uint32_t)idx;
+  mpool_magazine_unlock(mag);
+  __atomic_store_n(&mag->n_out, mag->n_out - 1, __ATOMIC_RELAXED);
+
+  /*
+   * Pairs with the fence in mpool_lf_req(): if someone is waiting, they might
+   * not have seen the chunk we just cached, so hand over everything we have.
+   */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (RCSW_UNLIKELY(__atomic_load_n(&the_pool->lf.waiters, __ATOMIC_RELAXED))) {
+    mpool_magazine_flush(mag);
+  }
+  return OK;
+
+error:
+  return ERROR;
+} /* mpool_lf_free() */
+
+static void mpool_lf_destroy(struct mpool* const the_pool) {
+  pthread_key_delete(the_pool->lf.key);
+
+  struct mpool_magazine* mag = the_pool->lf.magazines;
+  while (NULL != mag) {
+    struct mpool_magazine* next = mag->next;
+    rcsw_free(mag, RCSW_NONE);
+    mag = next;
+  } /* while() */
+} /* mpool_lf_destroy() */
+
+/**
+ * \brief Allocate the chunks for \ref RCSW_MPOOL_NUMA on a NUMA node.
+ *
+ * \param node Index of the node, or -1 for the current node.
+ *
+ * \return The chunks, or NULL if an error occurred.
+ */
+static dptr_t* mpool_numa_alloc(const struct mpool* const the_pool, int node) {
+  /* too big for the stack */
+  struct threadm_topology* topo = rcsw_alloc(NULL,
+                                             sizeof(struct threadm_topology),
+                                             RCSW_NONE);
+  RCSW_CHECK_PTR(topo);
+  RCSW_CHECK(OK == threadm_topology_discover(topo));
+
+  size_t idx = (-1 == node) ? threadm_node_current(topo) : (size_t)node;
+  ER_CHECK(idx < topo->n_nodes, "Bad NUMA node %d", node);
+  dptr_t* elements = threadm_numa_alloc(topo,
+                                        idx,
+                                        the_pool->max_elts *
+                                        the_pool->elt_size);
+  RCSW_CHECK_PTR(elements);
+  ER_DEBUG("Placed %zu chunks on NUMA node %zu",
+           the_pool->max_elts,
+           topo->nodes[idx].id);
+  rcsw_free(topo, RCSW_NONE);
+  return elements;
+
+error:
+  if (NULL != topo) {
+    rcsw_free(topo, RCSW_NONE);
+  }
+  return NULL;
+} /* mpool_numa_alloc() */
+
+/**
+ * \brief Take a chunk off the free stack in the default mode. The caller must
+ * already hold a token from \ref mpool.slots_avail, so there is guaranteed to
+ * be one.
+ */
+static size_t mpool_stack_claim(struct mpool* const the_pool) {
+  uint32_t idx;
+
+  /* can only come up empty if we race with a release still pushing */
+  while (0 == mpool_stack_pop(the_pool, &idx, 1)) {
+    RCSW_CPU_RELAX();
+  } /* while() */
+  __atomic_add_fetch(&the_pool->n_alloc, 1, __ATOMIC_RELAXED);
+  return idx;
+} /* mpool_stack_claim() */
+
+/**
+ * \brief Mark a chunk which was just taken off the free list as allocated,
+ * with one reference.
+ */
+static void* mpool_slot_alloc(struct mpool* const the_pool, size_t idx) {
+  struct mpool_slot* slot = &the_pool->slots[idx];
+
+  __atomic_store_n(&slot->refs, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->state, MPOOL_SLOT_ALLOC, __ATOMIC_RELEASE);
+
+  ER_DEBUG("Got buffer %p,idx=%zu", mpool_chunk(the_pool, idx), idx);
+  return mpool_chunk(the_pool, idx);
+} /* mpool_slot_alloc() */
+
+/**
+ * \brief Get the slot for a chunk handed out by the pool.
+ *
+ * \return The slot, or NULL if \p ptr is not a currently allocated chunk from
+ * the pool.
+ */
+static struct mpool_slot* mpool_slot_get(struct mpool* const the_pool,
+                                         const void* const ptr) {
+  int idx = mpool_ref_query(the_pool, ptr);
+  if (-1 == idx) {
+    return NULL;
+  }
+  struct mpool_slot* slot = &the_pool->slots[idx];
+  if (MPOOL_SLOT_ALLOC != __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return slot;
+} /* mpool_slot_get() */
 
 /*******************************************************************************
  * API Functions
  ******************************************************************************/
-BEGIN_C_DECLS
 
 struct mpool* mpool_init(struct mpool* const pool_in,
                          const struct mpool_params* const params) {
@@ -37,61 +417,57 @@ struct mpool* mpool_init(struct mpool* const pool_in,
   the_pool->flags = params->flags;
   the_pool->elt_size = params->elt_size;
   the_pool->max_elts = params->max_elts;
-  the_pool->flags = params->flags;
+  the_pool->elements = NULL;
+  the_pool->slots = NULL;
+  the_pool->n_alloc = 0;
+  the_pool->waiting_valid = false;
+  memset(&the_pool->lf, 0, sizeof(the_pool->lf));
 
   ER_INFO("Init memory pool: max_elts=%zu,elt_size=%zu",
           the_pool->max_elts,
           the_pool->elt_size);
 
+  /* chunk indices have to fit in the free stack links */
+  RCSW_CHECK(the_pool->max_elts < UINT32_MAX);
+
   /* allocate space for pool elements */
-  the_pool->elements = rcsw_alloc(params->elements,
-                                  params->max_elts * params->elt_size,
-                                  params->flags & RCSW_NOALLOC_DATA);
+  if (the_pool->flags & RCSW_NOALLOC_DATA) {
+    the_pool->flags &= ~(uint32_t)RCSW_MPOOL_NUMA;
+  }
+  if (the_pool->flags & RCSW_MPOOL_NUMA) {
+    the_pool->elements = mpool_numa_alloc(the_pool, params->numa_node);
+  } else {
+    the_pool->elements = rcsw_alloc(params->elements,
+                                    params->max_elts * params->elt_size,
+                                    params->flags & RCSW_NOALLOC_DATA);
+  }
   RCSW_CHECK_PTR(the_pool->elements);
 
-  /* allocate space for free/alloc list nodes */
-  the_pool->nodes = rcsw_alloc(params->meta,
-                               llist_meta_space(params->max_elts) * 2,
+  /* allocate space for per-chunk state */
+  the_pool->slots = rcsw_alloc(params->meta,
+                               mpool_meta_space(params->max_elts),
                                params->flags & RCSW_NOALLOC_META);
-  RCSW_CHECK_PTR(the_pool->nodes);
-
-  struct llist_params llist_params = {
-    .max_elts = (int)params->max_elts,
-    .elt_size = params->elt_size,
-    .cmpe = NULL,
-    .meta = (dptr_t*)the_pool->nodes,
-    .flags = RCSW_DS_LLIST_DB_DISOWN | RCSW_DS_LLIST_DB_PTR |
-             RCSW_NOALLOC_HANDLE | RCSW_NOALLOC_META,
-  };
-
-  /* initialize free/alloc lists */
-  RCSW_CHECK_PTR(llist_init(&the_pool->free, &llist_params));
-  for (size_t i = 0; i < the_pool->max_elts; ++i) {
-    RCSW_CHECK(OK == llist_append(&the_pool->free,
-                                  (uint8_t*)the_pool->elements + i * the_pool->elt_size));
-
-  } /* for() */
-  size_t n_bytes = llist_meta_space(params->max_elts);
-
-  /*
-   * Spurious cast alignment warning: the target and destination pointers are
-   * of the same alignment, we just need to convert to 1-byte alignment to get
-   * the math to work.
-   */
-  llist_params.meta = (void*)((uint8_t*)the_pool->nodes + n_bytes);
-  RCSW_CHECK_PTR(llist_init(&the_pool->alloc, &llist_params));
-
-  /* initialize reference counting */
-  the_pool->refs = rcsw_alloc(NULL,
-                              params->max_elts * sizeof(int),
-                              RCSW_ZALLOC);
-  RCSW_CHECK_PTR(the_pool->refs);
+  RCSW_CHECK_PTR(the_pool->slots);
 
-  /* initialize locks */
-  RCSW_CHECK_PTR(csem_init(&the_pool->slots_avail,
-                           the_pool->max_elts,
-                           RCSW_NOALLOC_HANDLE));
-  RCSW_CHECK_PTR(mutex_init(&the_pool->mutex, RCSW_NOALLOC_HANDLE));
+  /* all chunks start out free, on the free stack in order */
+  for (size_t i = 0; i < the_pool->max_elts; ++i) {
+    the_pool->slots[i].refs = 0;
+    the_pool->slots[i].state = MPOOL_SLOT_FREE;
+    the_pool->slots[i].next = (i + 1 < the_pool->max_elts) ? (uint32_t)(i + 2)
+                              : 0;
+  } /* for(i..) */
+  the_pool->free_top = 1;
+
+  /* initialize waiting */
+  if (the_pool->flags & RCSW_MPOOL_LOCKFREE) {
+    RCSW_CHECK(0 == pthread_key_create(&the_pool->lf.key,
+                                       mpool_magazine_flush));
+  } else {
+    RCSW_CHECK_PTR(csem_init(&the_pool->slots_avail,
+                             the_pool->max_elts,
+                             RCSW_NOALLOC_HANDLE));
+  }
+  the_pool->waiting_valid = true;
 
   return the_pool;
 
@@ -104,49 +480,68 @@ error:
 void mpool_destroy(struct mpool* const the_pool) {
   RCSW_FPC_V(NULL != the_pool);
 
-  csem_destroy(&the_pool->slots_avail);
-  mutex_destroy(&the_pool->mutex);
-
-  llist_destroy(&the_pool->free);
-  llist_destroy(&the_pool->alloc);
-
-  rcsw_free(the_pool->elements, the_pool->flags & RCSW_NOALLOC_DATA);
-  rcsw_free(the_pool->nodes, the_pool->flags & RCSW_NOALLOC_META);
+  if (the_pool->waiting_valid) {
+    if (the_pool->flags & RCSW_MPOOL_LOCKFREE) {
+      mpool_lf_destroy(the_pool);
+    } else {
+      csem_destroy(&the_pool->slots_avail);
+    }
+  }
 
-  rcsw_free(the_pool->refs, RCSW_NONE);
+  if (NULL != the_pool->elements) {
+    if (the_pool->flags & RCSW_MPOOL_NUMA) {
+      threadm_numa_free(the_pool->elements,
+                        the_pool->max_elts * the_pool->elt_size);
+    } else {
+      rcsw_free(the_pool->elements, the_pool->flags & RCSW_NOALLOC_DATA);
+    }
+  }
+  if (NULL != the_pool->slots) {
+    rcsw_free(the_pool->slots, the_pool->flags & RCSW_NOALLOC_META);
+  }
   rcsw_free(the_pool, the_pool->flags & RCSW_NOALLOC_HANDLE);
 } /* mpool_destroy() */
 
+size_t mpool_size(const struct mpool* const pool) {
+  RCSW_FPC_NV(0, NULL != pool);
+
+  if (!(pool->flags & RCSW_MPOOL_LOCKFREE)) {
+    return __atomic_load_n(&pool->n_alloc, __ATOMIC_RELAXED);
+  }
+  size_t n = 0;
+  const struct mpool_magazine* mag = __atomic_load_n(&pool->lf.magazines,
+                                                     __ATOMIC_ACQUIRE);
+  for (; NULL != mag; mag = mag->next) {
+    n += __atomic_load_n(&mag->n_out, __ATOMIC_RELAXED);
+  } /* for(mag..) */
+  return n;
+} /* mpool_size() */
+
+bool_t mpool_isfull(const struct mpool* const pool) {
+  RCSW_FPC_NV(false, NULL != pool);
+  return pool->max_elts == mpool_size(pool);
+} /* mpool_isfull() */
+
+bool_t mpool_isempty(const struct mpool* const pool) {
+  RCSW_FPC_NV(false, NULL != pool);
+  return 0 == mpool_size(pool);
+} /* mpool_isempty() */
+
 void* mpool_req(struct mpool* const the_pool) {
   RCSW_FPC_NV(NULL, NULL != the_pool);
 
-  void* ptr = NULL;
-  ER_DEBUG("Wait for buffer to become available: n_free=%zu,n_alloc=%zu",
-           llist_size(&the_pool->free),
-           llist_size(&the_pool->alloc));
+  if (the_pool->flags & RCSW_MPOOL_LOCKFREE) {
+    long idx = mpool_lf_req(the_pool, NULL);
+    return (idx >= 0) ? mpool_slot_alloc(the_pool, (size_t)idx) : NULL;
+  }
+
+  ER_DEBUG("Wait for buffer to become available: n_alloc=%zu",
+           mpool_size(the_pool));
 
   /* wait for an entry to become available */
   csem_wait(&the_pool->slots_avail);
-  mutex_lock(&the_pool->mutex);
-
-  /* get the entry from free list and add to allocated list */
-  ptr = the_pool->free.first->data;
-  llist_remove(&the_pool->free, the_pool->free.first->data);
-  llist_append(&the_pool->alloc, ptr);
-
-  /* One more THING using this chunk */
-  size_t idx = (size_t)((uint8_t*)ptr - (uint8_t*)the_pool->elements) / the_pool->elt_size;
-  the_pool->refs[idx]++;
 
-  mutex_unlock(&the_pool->mutex);
-
-  ER_DEBUG("Got buffer %p,ref_count=%d, n_free=%zu,n_alloc=%zu",
-           ptr,
-           the_pool->refs[idx],
-           llist_size(&the_pool->free),
-           llist_size(&the_pool->alloc));
-
-  return ptr;
+  return mpool_slot_alloc(the_pool, mpool_stack_claim(the_pool));
 } /* mpool_req() */
 
 status_t mpool_timedreq(struct mpool* const the_pool,
@@ -154,33 +549,27 @@ status_t mpool_timedreq(struct mpool* const the_pool,
                         void** chunk) {
   RCSW_FPC_NV(ERROR, NULL != the_pool, NULL != to);
 
-  ER_DEBUG("Wait for buffer to become available: n_free=%zu,n_alloc=%zu",
-           llist_size(&the_pool->free),
-           llist_size(&the_pool->alloc));
-  /* wait for an entry to become available */
-  RCSW_CHECK(OK == csem_timedwait(&the_pool->slots_avail, to));
-  mutex_lock(&the_pool->mutex);
-
-  /* Remove the entry from free list and add to allocated list */
-  dptr_t* ptr = (dptr_t*)the_pool->free.first->data;
-  llist_remove(&the_pool->free, ptr);
-  llist_append(&the_pool->alloc, ptr);
-
-  /* One more THING using this chunk */
-  size_t idx = (size_t)((uint8_t*)ptr - (uint8_t*)the_pool->elements) / the_pool->elt_size;
-  the_pool->refs[idx]++;
+  size_t idx;
+  if (the_pool->flags & RCSW_MPOOL_LOCKFREE) {
+    struct timespec deadline = clock_monotime();
+    time_ts_add(&deadline, to);
+
+    long ret = mpool_lf_req(the_pool, &deadline);
+    RCSW_CHECK(ret >= 0);
+    idx = (size_t)ret;
+  } else {
+    ER_DEBUG("Wait for buffer to become available: n_alloc=%zu",
+             mpool_size(the_pool));
+
+    /* wait for an entry to become available */
+    RCSW_CHECK(OK == csem_timedwait(&the_pool->slots_avail, to));
+    idx = mpool_stack_claim(the_pool);
+  }
 
+  void* ptr = mpool_slot_alloc(the_pool, idx);
   if (NULL != chunk) {
-    *chunk = (dptr_t*)ptr;
+    *chunk = ptr;
   }
-
-  mutex_unlock(&the_pool->mutex);
-
-  ER_DEBUG("Got buffer %p,ref_count=%d, n_free=%zu,n_alloc=%zu",
-           ptr,
-           the_pool->refs[idx],
-           llist_size(&the_pool->free),
-           llist_size(&the_pool->alloc));
   return OK;
 
 error:
@@ -192,39 +581,44 @@ status_t mpool_release(struct mpool* const the_pool, void* const ptr) {
 
   ER_DEBUG("Attempting release of buf=%p", ptr);
 
-  int index = mpool_ref_query(the_pool, ptr);
-  ER_CHECK(-1 != index,
-           "Buffer %p not found", ptr);
-
-  mutex_lock(&the_pool->mutex);
+  struct mpool_slot* slot = mpool_slot_get(the_pool, ptr);
+  ER_CHECK(NULL != slot, "Buffer %p not found", ptr);
 
   /*
    * One less person using this chunk. The reference count may have been
-   * decreased to 0 by a call to mpool_ref_remove(), so use RCSW_MAX() so stay
-   * non-negative.
+   * decreased to 0 by a call to mpool_ref_remove(), so anything <= 0 means it
+   * is free.
    */
-  the_pool->refs[index] = RCSW_MAX(0, the_pool->refs[index] - 1);
+  int refs = __atomic_sub_fetch(&slot->refs, 1, __ATOMIC_ACQ_REL);
 
   /* Someone else is still using this chunk--don't free it yet */
-  if (the_pool->refs[index] > 0) {
-    mutex_unlock(&the_pool->mutex);
-    ER_DEBUG("Buffer %p,idx=%d not ready for release: refcount=%d",
-             ptr,
-             index,
-             the_pool->refs[index]);
-
+  if (refs > 0) {
+    ER_DEBUG("Buffer %p not ready for release: refcount=%d", ptr, refs);
     return OK;
   }
-  llist_remove(&the_pool->alloc, ptr);
-  llist_append(&the_pool->free, ptr);
-  csem_post(&the_pool->slots_avail);
 
-  mutex_unlock(&the_pool->mutex);
+  /* only one of any racing releasers gets to actually free it */
+  uint8_t state = MPOOL_SLOT_ALLOC;
+  ER_CHECK(__atomic_compare_exchange_n(&slot->state,
+                                       &state,
+                                       MPOOL_SLOT_FREE,
+                                       false,
+                                       __ATOMIC_ACQ_REL,
+                                       __ATOMIC_RELAXED),
+           "Buffer %p already released",
+           ptr);
+  __atomic_store_n(&slot->refs, 0, __ATOMIC_RELAXED);
+
+  uint32_t idx = (uint32_t)(slot - the_pool->slots);
+  if (the_pool->flags & RCSW_MPOOL_LOCKFREE) {
+    RCSW_CHECK(OK == mpool_lf_free(the_pool, idx));
+  } else {
+    __atomic_sub_fetch(&the_pool->n_alloc, 1, __ATOMIC_RELAXED);
+    mpool_stack_push(the_pool, &idx, 1);
+    csem_post(&the_pool->slots_avail);
+  }
 
-  ER_DEBUG("Released buffer %p, n_free=%zu,n_alloc=%zu",
-           ptr,
-           llist_size(&the_pool->free),
-           llist_size(&the_pool->alloc));
+  ER_DEBUG("Released buffer %p, n_alloc=%zu", ptr, mpool_size(the_pool));
 
   return OK;
 
@@ -236,59 +630,51 @@ error:
 status_t mpool_ref_add(struct mpool* const the_pool, const void* const ptr) {
   RCSW_FPC_NV(ERROR, NULL != the_pool, NULL != ptr);
 
-  status_t rstat = ERROR;
-  mutex_lock(&the_pool->mutex);
-  int index = mpool_ref_query(the_pool, ptr);
-  ER_CHECK(-1 != index, "Buffer %p not found", ptr);
-
-  the_pool->refs[index]++;
-  ER_DEBUG("%s: buffer %p new refcount=%d",
-           __FUNCTION__,
-           ptr,
-           the_pool->refs[index]);
+  struct mpool_slot* slot = mpool_slot_get(the_pool, ptr);
+  ER_CHECK(NULL != slot, "Buffer %p not found", ptr);
 
-  rstat = OK;
+  RCSW_UNUSED int refs = __atomic_add_fetch(&slot->refs,
+                                            1,
+                                            __ATOMIC_ACQ_REL);
+  ER_DEBUG("%s: buffer %p new refcount=%d", __FUNCTION__, ptr, refs);
+  return OK;
 
 error:
-  mutex_unlock(&the_pool->mutex);
-  return rstat;
+  return ERROR;
 } /* mpool_ref_add() */
 
 status_t mpool_ref_remove(struct mpool* const the_pool,
                           const void* const ptr) {
   RCSW_FPC_NV(ERROR, NULL != the_pool, NULL != ptr);
 
-  status_t rstat = ERROR;
-  mutex_lock(&the_pool->mutex);
-  int index = mpool_ref_query(the_pool, ptr);
-  ER_CHECK(-1 != index, "Buffer %p not found", ptr);
+  struct mpool_slot* slot = mpool_slot_get(the_pool, ptr);
+  ER_CHECK(NULL != slot, "Buffer %p not found", ptr);
 
-  the_pool->refs[index]--;
-  ER_DEBUG("%s: buffer %p new refcount=%d",
-           __FUNCTION__,
-           ptr,
-           the_pool->refs[index]);
-
-  rstat = OK;
+  RCSW_UNUSED int refs = __atomic_sub_fetch(&slot->refs,
+                                            1,
+                                            __ATOMIC_ACQ_REL);
+  ER_DEBUG("%s: buffer %p new refcount=%d", __FUNCTION__, ptr, refs);
+  return OK;
 
 error:
-  mutex_unlock(&the_pool->mutex);
-  return rstat;
+  return ERROR;
 } /* mpool_ref_remove() */
 
 int mpool_ref_query(struct mpool* const the_pool, const void* const ptr) {
   RCSW_FPC_NV(-1, NULL != the_pool, NULL != ptr);
 
   /*
-   * If this is not true, then ptr did not come from this pool. Note that we
-   * don't query the alloc llist--we are not necessarily protected by a mutex
-   * here, and the llist can be modified elsewhere.
+   * If this is not true, then ptr did not come from this pool, or does not
+   * point to the start of a chunk.
    */
-  size_t memsize = mpool_element_space(the_pool->elt_size, the_pool->max_elts);
+  const uint8_t* start = (const uint8_t*)the_pool->elements;
   RCSW_CHECK(RCSW_IS_BETWEENHO((const uint8_t*)ptr,
-                               (uint8_t*)the_pool->elements,
-                               (uint8_t*)the_pool->elements + memsize));
-  return (int)((size_t)((const uint8_t*)ptr - (uint8_t*)the_pool->elements)) / (int)the_pool->elt_size;
+                               start,
+                               start + the_pool->max_elts * the_pool->elt_size));
+
+  size_t offset = (size_t)((const uint8_t*)ptr - start);
+  RCSW_CHECK(0 == offset % the_pool->elt_size);
+  return (int)(offset / the_pool->elt_size);
 
 error:
   return -1;
@@ -301,9 +687,10 @@ size_t mpool_ref_count(struct mpool* const the_pool, const void* const ptr) {
    * If this is not true, then ptr did not come from this pool, or has not
    * yet been allocated.
    */
-  int idx = mpool_ref_query(the_pool, ptr);
-  RCSW_CHECK(-1 != idx);
-  return (size_t)the_pool->refs[idx];
+  struct mpool_slot* slot = mpool_slot_get(the_pool, ptr);
+  RCSW_CHECK(NULL != slot);
+
+  return (size_t)RCSW_MAX(0, __atomic_load_n(&slot->refs, __ATOMIC_RELAXED));
 
 error:
   return 0;
@@ -11,16 +11,100 @@
  ******************************************************************************/
 #include "rcsw/multithread/mutex.h"
 
+#include <string.h>
+
 #include "rcsw/common/fpc.h"
 #include "rcsw/er/client.h"
 #include "rcsw/common/alloc.h"
 #include "rcsw/common/flags.h"
 
 /*******************************************************************************
- * API Functions
+ * Constant Definitions
+ ******************************************************************************/
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+/*
+ * Lock word states, per Drepper's "Futexes Are Tricky". Unlocking only needs
+ * to make a system call in the CONTENDED state.
+ */
+#define MUTEX_UNLOCKED 0
+#define MUTEX_LOCKED 1
+#define MUTEX_CONTENDED 2
+#endif
+
+/*******************************************************************************
+ * Private Functions
  ******************************************************************************/
 BEGIN_C_DECLS
 
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+static bool_t mutex_trylock(struct mutex* const mutex) {
+  uint32_t expected = MUTEX_UNLOCKED;
+  return __atomic_compare_exchange_n(&mutex->word,
+                                     &expected,
+                                     MUTEX_LOCKED,
+                                     false,
+                                     __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED);
+} /* mutex_trylock() */
+
+static void mutex_lock_slow(struct mutex* const mutex) {
+  uint32_t limit = futex_spin_limit(&mutex->spin_est);
+
+  /* spin a little first: the holder may be about to release it */
+  for (uint32_t i = 1; i <= limit; ++i) {
+    RCSW_CPU_RELAX();
+    if (MUTEX_UNLOCKED == __atomic_load_n(&mutex->word, __ATOMIC_RELAXED) &&
+        mutex_trylock(mutex)) {
+      futex_spin_update(&mutex->spin_est, i, true);
+      futex_stats_add(&mutex->stats.n_spins, i);
+      return;
+    }
+  } /* for(i..) */
+  futex_spin_update(&mutex->spin_est, limit, false);
+  futex_stats_add(&mutex->stats.n_spins, limit);
+
+  /*
+   * We don't know if we are the only waiter, so we always have to acquire it in
+   * the CONTENDED state, so that the unlock will wake up anyone else.
+   */
+  while (MUTEX_UNLOCKED != __atomic_exchange_n(&mutex->word,
+                                               MUTEX_CONTENDED,
+                                               __ATOMIC_ACQUIRE)) {
+    futex_stats_add(&mutex->stats.n_sleeps, 1);
+    futex_wait(&mutex->word, MUTEX_CONTENDED, NULL);
+  } /* while() */
+} /* mutex_lock_slow() */
+#endif
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+static status_t mutex_lock_profiled(struct mutex* const mutex) {
+  /* only timestamp the start if we actually have to wait */
+  uint64_t start = 0;
+  bool_t contended = false;
+
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  if (!mutex_trylock(mutex)) {
+    contended = true;
+    start = lockprof_now();
+    mutex_lock_slow(mutex);
+  }
+#else
+  if (0 != pthread_mutex_trylock(&mutex->impl)) {
+    contended = true;
+    start = lockprof_now();
+    if (0 != pthread_mutex_lock(&mutex->impl)) {
+      return ERROR;
+    }
+  }
+#endif
+  lockprof_acquired(&mutex->prof, contended, start, true);
+  return OK;
+} /* mutex_lock_profiled() */
+#endif
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
 struct mutex* mutex_init(struct mutex* mutex_in, uint32_t flags) {
   struct mutex* mutex = rcsw_alloc(mutex_in,
                                    sizeof(struct mutex),
@@ -28,7 +112,16 @@ struct mutex* mutex_init(struct mutex* mutex_in, uint32_t flags) {
 
   RCSW_CHECK_PTR(mutex);
   mutex->flags = flags;
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  lockprof_init(&mutex->prof);
+#endif
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  mutex->word = MUTEX_UNLOCKED;
+  mutex->spin_est = 0;
+  memset(&mutex->stats, 0, sizeof(struct futex_stats));
+#else
   RCSW_CHECK(0 == pthread_mutex_init(&mutex->impl, NULL));
+#endif
   return mutex;
 
 error:
@@ -39,27 +132,76 @@ error:
 void mutex_destroy(struct mutex* mutex) {
   RCSW_FPC_V(NULL != mutex);
 
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  lockprof_unregister(&mutex->prof);
+#endif
+#if !defined(RCSW_CONFIG_AL_FUTEX_SYNC)
   pthread_mutex_destroy(&mutex->impl);
+#endif
   rcsw_free(mutex, mutex->flags & RCSW_NOALLOC_HANDLE);
 } /* mutex_destroy() */
 
 status_t mutex_lock(struct mutex* mutex) {
   RCSW_FPC_NV(ERROR, NULL != mutex);
 
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&mutex->prof)) {
+    return mutex_lock_profiled(mutex);
+  }
+#endif
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  if (RCSW_UNLIKELY(!mutex_trylock(mutex))) {
+    mutex_lock_slow(mutex);
+  }
+  return OK;
+#else
   RCSW_CHECK(0 == pthread_mutex_lock(&mutex->impl));
   return OK;
 
 error:
   return ERROR;
+#endif
 } /* mutex_lock() */
 
 status_t mutex_unlock(struct mutex* mutex) {
   RCSW_FPC_NV(ERROR, NULL != mutex);
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&mutex->prof)) {
+    lockprof_released(&mutex->prof);
+  }
+#endif
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  if (MUTEX_CONTENDED == __atomic_exchange_n(&mutex->word,
+                                             MUTEX_UNLOCKED,
+                                             __ATOMIC_RELEASE)) {
+    futex_stats_add(&mutex->stats.n_wakeups, 1);
+    futex_wake(&mutex->word, 1);
+  }
+  return OK;
+#else
   RCSW_CHECK(0 == pthread_mutex_unlock(&mutex->impl));
   return OK;
 
 error:
   return ERROR;
+#endif
 } /* mutex_unlock() */
 
+status_t mutex_stats_get(const struct mutex* mutex,
+                         struct futex_stats* stats) {
+  RCSW_FPC_NV(ERROR, NULL != mutex, NULL != stats);
+
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  stats->n_spins = __atomic_load_n(&mutex->stats.n_spins, __ATOMIC_RELAXED);
+  stats->n_sleeps = __atomic_load_n(&mutex->stats.n_sleeps, __ATOMIC_RELAXED);
+  stats->n_wakeups = __atomic_load_n(&mutex->stats.n_wakeups,
+                                     __ATOMIC_RELAXED);
+  return OK;
+#else
+  memset(stats, 0, sizeof(struct futex_stats));
+  return ERROR;
+#endif
+} /* mutex_stats_get() */
+
 END_C_DECLS
@@ -38,6 +38,16 @@ static status_t omp_radix_sorter_step(struct omp_radix_sorter* const sorter,
                                       int digit);
 static void
 omp_radix_sorter_first_touch_alloc(struct omp_radix_sorter* const sorter);
+static status_t
+omp_radix_sorter_numa_alloc(struct omp_radix_sorter* const sorter);
+static void
+omp_radix_sorter_numa_free(struct omp_radix_sorter* const sorter);
+
+/**
+ * \brief Get the # of bytes of bin storage each thread needs.
+ */
+static size_t
+omp_radix_sorter_bin_space(const struct omp_radix_sorter* const sorter);
 
 BEGIN_C_DECLS
 
@@ -60,6 +70,11 @@ omp_radix_sorter_init(const struct omp_radix_sorter_params* const params) {
   sorter->chunk_size = sorter->n_elts / sorter->n_threads;
   sorter->cum_prefix_sums = NULL;
   sorter->data = NULL;
+  sorter->bins = NULL;
+  sorter->topo = NULL;
+  sorter->cpus = NULL;
+  sorter->bin_space = NULL;
+  sorter->flags = params->flags;
 
   /*
    * Allocate memory. Make the FIFOs use a contiguous chunk of memory, rather
@@ -69,17 +84,28 @@ omp_radix_sorter_init(const struct omp_radix_sorter_params* const params) {
                             sizeof(struct fifo) * sorter->n_threads * sorter->base,
                             RCSW_NONE);
   RCSW_CHECK_PTR(sorter->bins);
-  sorter->data = rcsw_alloc(NULL,
-                            sizeof(size_t) * sorter->n_elts,
-                            RCSW_NONE);
-  RCSW_CHECK_PTR(sorter->data);
 
   struct fifo_params impl_params = { .elt_size = sizeof(size_t),
                                    .max_elts = sorter->chunk_size,
                                    .elements = NULL,
                                    .flags = RCSW_NOALLOC_HANDLE };
+  if (sorter->flags & RCSW_OMP_RADIX_SORTER_NUMA) {
+    RCSW_CHECK(OK == omp_radix_sorter_numa_alloc(sorter));
+    impl_params.flags |= RCSW_NOALLOC_DATA;
+  } else {
+    sorter->data = rcsw_alloc(NULL,
+                              sizeof(size_t) * sorter->n_elts,
+                              RCSW_NONE);
+    RCSW_CHECK_PTR(sorter->data);
+  }
+
   for (size_t i = 0; i < sorter->n_threads; ++i) {
     for (size_t j = 0; j < sorter->base; ++j) {
+      if (sorter->flags & RCSW_OMP_RADIX_SORTER_NUMA) {
+        impl_params.elements = (dptr_t*)((uint8_t*)sorter->bin_space[i] +
+                                         j * omp_radix_sorter_bin_space(sorter) /
+                                         sorter->base);
+      }
       RCSW_CHECK(NULL !=
                  fifo_init(&sorter->bins[i * sorter->base + j], &impl_params));
     } /* for(j..) */
@@ -90,7 +116,10 @@ omp_radix_sorter_init(const struct omp_radix_sorter_params* const params) {
                                        RCSW_NONE);
   RCSW_CHECK_PTR(sorter->cum_prefix_sums);
 
-  /* perform first touch allocation */
+  /*
+   * Perform first touch allocation. With NUMA placement the pages already have
+   * a home node, but this also pins the threads.
+   */
   omp_radix_sorter_first_touch_alloc(sorter);
 
   /* Now you can copy the data in and still get good memory page locality */
@@ -117,15 +146,17 @@ void omp_radix_sorter_destroy(struct omp_radix_sorter* const sorter) {
     for (size_t i = 0; i < sorter->base * sorter->n_threads; ++i) {
       fifo_destroy(&sorter->bins[i]);
     } /* for(i..) */
-    free(sorter->bins);
+    rcsw_free(sorter->bins, RCSW_NONE);
   }
   if (sorter->cum_prefix_sums) {
-    free(sorter->cum_prefix_sums);
+    rcsw_free(sorter->cum_prefix_sums, RCSW_NONE);
   }
-  if (sorter->data) {
-    free(sorter->data);
+  if (sorter->flags & RCSW_OMP_RADIX_SORTER_NUMA) {
+    omp_radix_sorter_numa_free(sorter);
+  } else if (sorter->data) {
+    rcsw_free(sorter->data, RCSW_NONE);
   }
-  free(sorter);
+  rcsw_free(sorter, RCSW_NONE);
 } /* omp_radix_sorter_destroy() */
 
 status_t omp_radix_sorter_exec(struct omp_radix_sorter* const sorter) {
@@ -217,10 +248,107 @@ static status_t omp_radix_sorter_step(struct omp_radix_sorter* const sorter,
 
 static void
 omp_radix_sorter_first_touch_alloc(struct omp_radix_sorter* const sorter) {
-#pragma omp parallel for num_threads(sorter->n_threads)
+  /*
+   * OpenMP keeps the same threads around between parallel regions, so pinning
+   * them once here sticks for the sort.
+   */
+  if (sorter->flags & RCSW_OMP_RADIX_SORTER_NUMA) {
+#pragma omp parallel num_threads(sorter->n_threads)
+    {
+      size_t cpu = sorter->cpus[omp_get_thread_num()];
+      if (OK != threadm_core_lock(pthread_self(), cpu)) {
+        ER_WARN("Failed to pin thread %d to CPU %zu",
+                omp_get_thread_num(),
+                cpu);
+      }
+    }
+  }
+
+#pragma omp parallel for num_threads(sorter->n_threads) schedule(static)
   for (size_t i = 0; i < sorter->n_elts; ++i) {
     sorter->data[i] = 0;
   } /* for(i..) */
 } /* omp_radix_sorter_first_touch_alloc() */
 
+/**
+ * \brief Allocate the data array and each thread's bin storage for \ref
+ * RCSW_OMP_RADIX_SORTER_NUMA, with each thread's chunk of the data and its bins
+ * on the node of the CPU it will be pinned to.
+ */
+static status_t
+omp_radix_sorter_numa_alloc(struct omp_radix_sorter* const sorter) {
+  sorter->topo = rcsw_alloc(NULL, sizeof(struct threadm_topology), RCSW_NONE);
+  RCSW_CHECK_PTR(sorter->topo);
+  RCSW_CHECK(OK == threadm_topology_discover(sorter->topo));
+
+  sorter->cpus = rcsw_alloc(NULL,
+                            sizeof(size_t) * sorter->n_threads,
+                            RCSW_NONE);
+  RCSW_CHECK_PTR(sorter->cpus);
+  RCSW_CHECK(sorter->n_threads == threadm_cpus_spread(sorter->topo,
+                                                      sorter->cpus,
+                                                      sorter->n_threads));
+
+  sorter->bin_space = rcsw_alloc(NULL,
+                                 sizeof(dptr_t*) * sorter->n_threads,
+                                 RCSW_NONE);
+  RCSW_CHECK_PTR(sorter->bin_space);
+  for (size_t i = 0; i < sorter->n_threads; ++i) {
+    sorter->bin_space[i] = NULL;
+  } /* for(i..) */
+
+  sorter->data = threadm_numa_alloc(
+      sorter->topo,
+      (size_t)threadm_cpu_node(sorter->topo, sorter->cpus[0]),
+      sizeof(size_t) * sorter->n_elts);
+  RCSW_CHECK_PTR(sorter->data);
+
+  for (size_t i = 0; i < sorter->n_threads; ++i) {
+    size_t node = (size_t)threadm_cpu_node(sorter->topo, sorter->cpus[i]);
+    size_t start = i * sorter->chunk_size;
+    size_t end = (i + 1 == sorter->n_threads) ? sorter->n_elts
+                 : start + sorter->chunk_size;
+    if (OK != threadm_numa_bind(sorter->topo,
+                                node,
+                                sorter->data + start,
+                                sizeof(size_t) * (end - start))) {
+      ER_DEBUG("Failed to bind chunk %zu to node %zu", i, node);
+    }
+    sorter->bin_space[i] = threadm_numa_alloc(
+        sorter->topo, node, omp_radix_sorter_bin_space(sorter));
+    RCSW_CHECK_PTR(sorter->bin_space[i]);
+  } /* for(i..) */
+  return OK;
+
+error:
+  return ERROR;
+} /* omp_radix_sorter_numa_alloc() */
+
+static void
+omp_radix_sorter_numa_free(struct omp_radix_sorter* const sorter) {
+  if (sorter->bin_space) {
+    for (size_t i = 0; i < sorter->n_threads; ++i) {
+      if (sorter->bin_space[i]) {
+        threadm_numa_free(sorter->bin_space[i],
+                          omp_radix_sorter_bin_space(sorter));
+      }
+    } /* for(i..) */
+    rcsw_free(sorter->bin_space, RCSW_NONE);
+  }
+  if (sorter->data) {
+    threadm_numa_free(sorter->data, sizeof(size_t) * sorter->n_elts);
+  }
+  if (sorter->cpus) {
+    rcsw_free(sorter->cpus, RCSW_NONE);
+  }
+  if (sorter->topo) {
+    rcsw_free(sorter->topo, RCSW_NONE);
+  }
+} /* omp_radix_sorter_numa_free() */
+
+static size_t
+omp_radix_sorter_bin_space(const struct omp_radix_sorter* const sorter) {
+  return sorter->base * fifo_element_space(sorter->chunk_size, sizeof(size_t));
+} /* omp_radix_sorter_bin_space() */
+
 END_C_DECLS
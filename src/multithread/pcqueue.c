@@ -16,10 +16,300 @@
 #include "rcsw/common/alloc.h"
 
 /*******************************************************************************
- * API Functions
+ * Private Functions
  ******************************************************************************/
 BEGIN_C_DECLS
 
+static inline void* pcqueue_mpmc_slot(const struct pcqueue_mpmc* const ring,
+                                      size_t idx) {
+  return (uint8_t*)ring->elements + idx * ring->elt_size;
+}
+
+static status_t pcqueue_mpmc_init(struct pcqueue_mpmc* const ring,
+                                  const struct pcqueue_params* const params) {
+  ring->elt_size = params->elt_size;
+  ring->max_elts = params->max_elts;
+  ring->enq_pos = 0;
+  ring->deq_pos = 0;
+  ring->seqs = NULL;
+
+  ring->elements = rcsw_alloc(params->elements,
+                              fifo_element_space(params->max_elts,
+                                                 params->elt_size),
+                              params->flags & (RCSW_NOALLOC_DATA |
+                                               RCSW_ZALLOC));
+  RCSW_CHECK_PTR(ring->elements);
+
+  ring->seqs = rcsw_alloc(NULL, ring->max_elts * sizeof(size_t), RCSW_NONE);
+  RCSW_CHECK_PTR(ring->seqs);
+
+  for (size_t i = 0; i < ring->max_elts; ++i) {
+    ring->seqs[i] = i;
+  } /* for(i..) */
+  return OK;
+
+error:
+  return ERROR;
+} /* pcqueue_mpmc_init() */
+
+static void pcqueue_mpmc_destroy(struct pcqueue_mpmc* const ring,
+                                 uint32_t flags) {
+  rcsw_free(ring->seqs, RCSW_NONE);
+  rcsw_free(ring->elements, flags & RCSW_NOALLOC_DATA);
+} /* pcqueue_mpmc_destroy() */
+
+/**
+ * \brief Claim the next position for writing, fill it, and publish it.
+ *
+ * \return \c false if the ring was full.
+ */
+static bool_t pcqueue_mpmc_enqueue(struct pcqueue_mpmc* const ring,
+                                   const void* const e) {
+  size_t pos = __atomic_load_n(&ring->enq_pos, __ATOMIC_RELAXED);
+  size_t idx;
+
+  while (true) {
+    idx = pos % ring->max_elts;
+    size_t seq = __atomic_load_n(&ring->seqs[idx], __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (0 == diff) {
+      if (__atomic_compare_exchange_n(&ring->enq_pos,
+                                      &pos,
+                                      pos + 1,
+                                      true,
+                                      __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* slot still holds the element from the previous lap */
+      return false;
+    } else {
+      pos = __atomic_load_n(&ring->enq_pos, __ATOMIC_RELAXED);
+    }
+  } /* while() */
+
+  memcpy(pcqueue_mpmc_slot(ring, idx), e, ring->elt_size);
+  __atomic_store_n(&ring->seqs[idx], pos + 1, __ATOMIC_RELEASE);
+  return true;
+} /* pcqueue_mpmc_enqueue() */
+
+/**
+ * \brief Claim \p n consecutive positions for writing at once, then fill and
+ * publish each of them, so that no other producer's elements end up between
+ * them.
+ *
+ * Unlike \ref pcqueue_mpmc_enqueue() the positions are claimed without
+ * checking that they are free first. The caller must hold \p n tokens from
+ * \ref pcqueue.slots_avail, which makes the slots free, or about to be once
+ * the consumers which claimed them on the previous lap finish emptying them.
+ */
+static void pcqueue_mpmc_enqueue_n(struct pcqueue_mpmc* const ring,
+                                   const uint8_t* const elts,
+                                   size_t n) {
+  size_t pos = __atomic_fetch_add(&ring->enq_pos, n, __ATOMIC_RELAXED);
+
+  for (size_t i = 0; i < n; ++i, ++pos) {
+    size_t idx = pos % ring->max_elts;
+    while (__atomic_load_n(&ring->seqs[idx], __ATOMIC_ACQUIRE) != pos) {
+      RCSW_CPU_RELAX();
+    } /* while() */
+    memcpy(pcqueue_mpmc_slot(ring, idx),
+           elts + i * ring->elt_size,
+           ring->elt_size);
+    __atomic_store_n(&ring->seqs[idx], pos + 1, __ATOMIC_RELEASE);
+  } /* for(i..) */
+} /* pcqueue_mpmc_enqueue_n() */
+
+/**
+ * \brief Claim the next position for reading, empty it, and release it for the
+ * next lap.
+ *
+ * \return \c false if the ring was empty.
+ */
+static bool_t pcqueue_mpmc_dequeue(struct pcqueue_mpmc* const ring,
+                                   void* const e) {
+  size_t pos = __atomic_load_n(&ring->deq_pos, __ATOMIC_RELAXED);
+  size_t idx;
+
+  while (true) {
+    idx = pos % ring->max_elts;
+    size_t seq = __atomic_load_n(&ring->seqs[idx], __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+    if (0 == diff) {
+      if (__atomic_compare_exchange_n(&ring->deq_pos,
+                                      &pos,
+                                      pos + 1,
+                                      true,
+                                      __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* slot not yet filled by the producer which claimed it */
+      return false;
+    } else {
+      pos = __atomic_load_n(&ring->deq_pos, __ATOMIC_RELAXED);
+    }
+  } /* while() */
+
+  if (NULL != e) {
+    memcpy(e, pcqueue_mpmc_slot(ring, idx), ring->elt_size);
+  }
+  __atomic_store_n(&ring->seqs[idx], pos + ring->max_elts, __ATOMIC_RELEASE);
+  return true;
+} /* pcqueue_mpmc_dequeue() */
+
+static void* pcqueue_mpmc_front(const struct pcqueue_mpmc* const ring) {
+  size_t pos = __atomic_load_n(&ring->deq_pos, __ATOMIC_ACQUIRE);
+  size_t idx = pos % ring->max_elts;
+
+  if (__atomic_load_n(&ring->seqs[idx], __ATOMIC_ACQUIRE) != pos + 1) {
+    return NULL;
+  }
+  return pcqueue_mpmc_slot(ring, idx);
+} /* pcqueue_mpmc_front() */
+
+/**
+ * \brief Add an element to the underlying storage. The caller must already
+ * hold a token from \ref pcqueue.slots_avail.
+ */
+static status_t pcqueue_add(struct pcqueue* const queue, const void* const e) {
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    /*
+     * The semaphore guarantees that there is a free slot, but the consumer
+     * which claimed it might not have finished emptying it yet.
+     */
+    while (!pcqueue_mpmc_enqueue(&queue->mpmc, e)) {
+      RCSW_CPU_RELAX();
+    } /* while() */
+    return OK;
+  }
+
+  mutex_lock(&queue->mutex);
+  status_t rval = fifo_add(&queue->fifo, e);
+  mutex_unlock(&queue->mutex);
+  return rval;
+} /* pcqueue_add() */
+
+/**
+ * \brief Remove an element from the underlying storage. The caller must
+ * already hold a token from \ref pcqueue.slots_inuse.
+ */
+static status_t pcqueue_remove(struct pcqueue* const queue, void* const e) {
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    /*
+     * The semaphore guarantees that there is an element, but the producer
+     * which claimed its slot might not have finished filling it yet.
+     */
+    while (!pcqueue_mpmc_dequeue(&queue->mpmc, e)) {
+      RCSW_CPU_RELAX();
+    } /* while() */
+    return OK;
+  }
+
+  mutex_lock(&queue->mutex);
+  status_t rval = fifo_remove(&queue->fifo, e);
+  mutex_unlock(&queue->mutex);
+  return rval;
+} /* pcqueue_remove() */
+
+/**
+ * \brief Get the front element in the underlying storage. The caller must
+ * already hold a token from \ref pcqueue.slots_inuse.
+ */
+static void* pcqueue_front(struct pcqueue* const queue) {
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    void* ret = NULL;
+
+    /* the slot at the front might not have been filled yet */
+    while (NULL == (ret = pcqueue_mpmc_front(&queue->mpmc))) {
+      RCSW_CPU_RELAX();
+    } /* while() */
+    return ret;
+  }
+  mutex_lock(&queue->mutex);
+  void* ret = fifo_front(&queue->fifo);
+  mutex_unlock(&queue->mutex);
+  return ret;
+} /* pcqueue_front() */
+
+/**
+ * \brief Get the front element in the underlying storage if there is one,
+ * without touching either semaphore.
+ *
+ * \return The front element, or NULL if the queue is empty (or the front
+ * element is still being filled, for \ref RCSW_PCQUEUE_MPMC).
+ */
+static void* pcqueue_tryfront(struct pcqueue* const queue) {
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    return pcqueue_mpmc_front(&queue->mpmc);
+  }
+  void* ret = NULL;
+  mutex_lock(&queue->mutex);
+  if (!fifo_isempty(&queue->fifo)) {
+    ret = fifo_front(&queue->fifo);
+  }
+  mutex_unlock(&queue->mutex);
+  return ret;
+} /* pcqueue_tryfront() */
+
+static size_t pcqueue_elt_size(const struct pcqueue* const queue) {
+  return (queue->flags & RCSW_PCQUEUE_MPMC) ? queue->mpmc.elt_size :
+      queue->fifo.elt_size;
+} /* pcqueue_elt_size() */
+
+/**
+ * \brief Add \p n consecutive elements to the underlying storage, taking the
+ * mutex (or claiming positions in the ring) only once. The caller must already
+ * hold \p n tokens from \ref pcqueue.slots_avail.
+ */
+static void pcqueue_add_n(struct pcqueue* const queue,
+                          const uint8_t* const elts,
+                          size_t n) {
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    pcqueue_mpmc_enqueue_n(&queue->mpmc, elts, n);
+    return;
+  }
+
+  size_t elt_size = pcqueue_elt_size(queue);
+  mutex_lock(&queue->mutex);
+  for (size_t i = 0; i < n; ++i) {
+    fifo_add(&queue->fifo, elts + i * elt_size);
+  } /* for(i..) */
+  mutex_unlock(&queue->mutex);
+} /* pcqueue_add_n() */
+
+/**
+ * \brief Remove \p n elements from the underlying storage, taking the mutex (if
+ * applicable) only once. The caller must already hold \p n tokens from \ref
+ * pcqueue.slots_inuse.
+ */
+static void pcqueue_remove_n(struct pcqueue* const queue,
+                             uint8_t* const out,
+                             size_t n) {
+  size_t elt_size = pcqueue_elt_size(queue);
+
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    for (size_t i = 0; i < n; ++i) {
+      pcqueue_remove(queue, (NULL != out) ? out + i * elt_size : NULL);
+    } /* for(i..) */
+    return;
+  }
+
+  mutex_lock(&queue->mutex);
+  for (size_t i = 0; i < n; ++i) {
+    fifo_remove(&queue->fifo, (NULL != out) ? out + i * elt_size : NULL);
+  } /* for(i..) */
+  mutex_unlock(&queue->mutex);
+} /* pcqueue_remove_n() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+
 struct pcqueue* pcqueue_init(struct pcqueue* queue_in,
                              const struct pcqueue_params* const params) {
   RCSW_FPC_NV(NULL, NULL != params, params->max_elts > 0, params->elt_size > 0);
@@ -32,22 +322,26 @@ struct pcqueue* pcqueue_init(struct pcqueue* queue_in,
 
   queue->flags = params->flags;
 
-  /* create FIFO */
-  struct fifo_params impl_params = { .max_elts = params->max_elts,
-                                     .printe = NULL,
-                                     .elt_size = params->elt_size,
-                                     .elements = params->elements,
-                                     .flags = params->flags };
-  impl_params.flags |= RCSW_NOALLOC_HANDLE;
-
-  RCSW_CHECK(NULL != fifo_init(&queue->fifo, &impl_params));
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    RCSW_CHECK(OK == pcqueue_mpmc_init(&queue->mpmc, params));
+  } else {
+    /* create FIFO */
+    struct fifo_params impl_params = { .max_elts = params->max_elts,
+                                       .printe = NULL,
+                                       .elt_size = params->elt_size,
+                                       .elements = params->elements,
+                                       .flags = params->flags };
+    impl_params.flags |= RCSW_NOALLOC_HANDLE;
+
+    RCSW_CHECK(NULL != fifo_init(&queue->fifo, &impl_params));
+    RCSW_CHECK_PTR(mutex_init(&queue->mutex, RCSW_NOALLOC_HANDLE));
+  }
 
   /* all slots available initially */
   RCSW_CHECK_PTR(csem_init(&queue->slots_avail,
                            params->max_elts,
                            RCSW_NOALLOC_HANDLE));
   RCSW_CHECK_PTR(csem_init(&queue->slots_inuse, 0, RCSW_NOALLOC_HANDLE));
-  RCSW_CHECK_PTR(mutex_init(&queue->mutex, RCSW_NOALLOC_HANDLE));
   return queue;
 
 error:
@@ -59,9 +353,13 @@ error:
 void pcqueue_destroy(struct pcqueue* const queue) {
   RCSW_FPC_V(NULL != queue);
 
-  fifo_destroy(&queue->fifo);
+  if (queue->flags & RCSW_PCQUEUE_MPMC) {
+    pcqueue_mpmc_destroy(&queue->mpmc, queue->flags);
+  } else {
+    fifo_destroy(&queue->fifo);
+    mutex_destroy(&queue->mutex);
+  }
 
-  mutex_destroy(&queue->mutex);
   csem_destroy(&queue->slots_avail);
   csem_destroy(&queue->slots_inuse);
 
@@ -73,9 +371,7 @@ status_t pcqueue_push(struct pcqueue* const queue, const void* const e) {
 
   csem_wait(&queue->slots_avail);
 
-  mutex_lock(&queue->mutex);
-  status_t rval = fifo_add(&queue->fifo, e);
-  mutex_unlock(&queue->mutex);
+  status_t rval = pcqueue_add(queue, e);
 
   if (OK == rval) {
     csem_post(&queue->slots_inuse);
@@ -89,9 +385,7 @@ status_t pcqueue_pop(struct pcqueue* const queue, void* const e) {
 
   csem_wait(&queue->slots_inuse);
 
-  mutex_lock(&queue->mutex);
-  status_t rval = fifo_remove(&queue->fifo, e);
-  mutex_unlock(&queue->mutex);
+  status_t rval = pcqueue_remove(queue, e);
 
   if (OK == rval) {
     csem_post(&queue->slots_avail);
@@ -100,6 +394,136 @@ status_t pcqueue_pop(struct pcqueue* const queue, void* const e) {
   return rval;
 } /* pcqueue_pop() */
 
+status_t pcqueue_trypush(struct pcqueue* const queue, const void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != e);
+
+  if (OK != csem_trywait(&queue->slots_avail)) {
+    errno = EAGAIN;
+    return ERROR;
+  }
+  status_t rval = pcqueue_add(queue, e);
+
+  if (OK == rval) {
+    csem_post(&queue->slots_inuse);
+  }
+  return rval;
+} /* pcqueue_trypush() */
+
+status_t pcqueue_trypop(struct pcqueue* const queue, void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue);
+
+  if (OK != csem_trywait(&queue->slots_inuse)) {
+    errno = EAGAIN;
+    return ERROR;
+  }
+  status_t rval = pcqueue_remove(queue, e);
+
+  if (OK == rval) {
+    csem_post(&queue->slots_avail);
+  }
+  return rval;
+} /* pcqueue_trypop() */
+
+status_t pcqueue_trypeek(struct pcqueue* const queue, void** const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != e);
+
+  if (NULL == (*e = pcqueue_tryfront(queue))) {
+    errno = EAGAIN;
+    return ERROR;
+  }
+  return OK;
+} /* pcqueue_trypeek() */
+
+status_t pcqueue_tryreplace(struct pcqueue* const queue,
+                            const void* const e,
+                            bool_t (*match)(const void* elt, const void* e),
+                            void* const old) {
+  RCSW_FPC_NV(ERROR,
+              NULL != queue,
+              NULL != e,
+              NULL != match,
+              !(queue->flags & RCSW_PCQUEUE_MPMC));
+  struct rbuffer* rb = &queue->fifo.rb;
+  status_t rval = ERROR;
+
+  mutex_lock(&queue->mutex);
+
+  /* newest first */
+  for (size_t i = rb->current; i > 0; --i) {
+    void* elt = rbuffer_data_get(rb, rb->start + i - 1);
+    if (match(elt, e)) {
+      if (NULL != old) {
+        memcpy(old, elt, queue->fifo.elt_size);
+      }
+      memcpy(elt, e, queue->fifo.elt_size);
+      rval = OK;
+      break;
+    }
+  } /* for(i..) */
+  mutex_unlock(&queue->mutex);
+
+  if (OK != rval) {
+    errno = ENOENT;
+  }
+  return rval;
+} /* pcqueue_tryreplace() */
+
+status_t pcqueue_push_n(struct pcqueue* const queue,
+                        const void* const elts,
+                        size_t n) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != elts);
+
+  size_t elt_size = pcqueue_elt_size(queue);
+  size_t done = 0;
+
+  while (done < n) {
+    /* wait for one slot, then grab as many more as are free right now */
+    RCSW_CHECK(OK == csem_wait(&queue->slots_avail));
+    size_t chunk = 1 + csem_trywait_n(&queue->slots_avail, n - done - 1);
+
+    pcqueue_add_n(queue, (const uint8_t*)elts + done * elt_size, chunk);
+    csem_post_n(&queue->slots_inuse, chunk);
+    done += chunk;
+  } /* while() */
+  return OK;
+
+error:
+  return ERROR;
+} /* pcqueue_push_n() */
+
+status_t pcqueue_pop_n(struct pcqueue* const queue,
+                       void* const out,
+                       size_t max,
+                       size_t* const got) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != got, max > 0);
+
+  *got = 0;
+  RCSW_CHECK(OK == csem_wait(&queue->slots_inuse));
+  size_t n = 1 + csem_trywait_n(&queue->slots_inuse, max - 1);
+
+  pcqueue_remove_n(queue, out, n);
+  csem_post_n(&queue->slots_avail, n);
+  *got = n;
+  return OK;
+
+error:
+  return ERROR;
+} /* pcqueue_pop_n() */
+
+status_t pcqueue_drain(struct pcqueue* const queue,
+                       void* const out,
+                       size_t max,
+                       size_t* const got) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != got);
+
+  *got = csem_trywait_n(&queue->slots_inuse, max);
+  if (*got > 0) {
+    pcqueue_remove_n(queue, out, *got);
+    csem_post_n(&queue->slots_avail, *got);
+  }
+  return OK;
+} /* pcqueue_drain() */
+
 status_t pcqueue_timedpop(struct pcqueue* const queue,
                             const struct timespec* const to,
                             void* const e) {
@@ -107,16 +531,7 @@ status_t pcqueue_timedpop(struct pcqueue* const queue,
 
   RCSW_CHECK(OK == csem_timedwait(&queue->slots_inuse, to));
 
-  mutex_lock(&queue->mutex);
-
-  /*
-   * We don't use a CHECK() macro here because we need to make sure we unlock
-   * the mutex, and we can't do that AND have the csem_timedwait() call above
-   * also use a CHECK() macro, because in one case the mutex is locked when the
-   * check is called and in one it isn't.
-   */
-  status_t rval = fifo_remove(&queue->fifo, e);
-  mutex_unlock(&queue->mutex);
+  status_t rval = pcqueue_remove(queue, e);
   csem_post(&queue->slots_avail);
 
   return rval;
@@ -130,13 +545,13 @@ status_t pcqueue_timedpeek(struct pcqueue* const queue,
                            void** const e) {
   RCSW_FPC_NV(ERROR, NULL != queue, NULL != to, NULL != e);
 
+  /* fast path: don't touch the semaphore if there is something to see */
+  if (NULL != (*e = pcqueue_tryfront(queue))) {
+    return OK;
+  }
   RCSW_CHECK(OK == csem_timedwait(&queue->slots_inuse, to));
 
-  mutex_lock(&queue->mutex);
-
-  *e = fifo_front(&queue->fifo);
-
-  mutex_unlock(&queue->mutex);
+  *e = pcqueue_front(queue);
   csem_post(&queue->slots_inuse);
 
   return OK;
@@ -150,12 +565,13 @@ status_t pcqueue_peek(struct pcqueue* const queue,
                       void** const e) {
   RCSW_FPC_NV(ERROR, NULL != queue, NULL != e);
 
+  /* fast path: don't touch the semaphore if there is something to see */
+  if (NULL != (*e = pcqueue_tryfront(queue))) {
+    return OK;
+  }
   csem_wait(&queue->slots_inuse);
-  mutex_lock(&queue->mutex);
 
-  *e = fifo_front(&queue->fifo);
-
-  mutex_unlock(&queue->mutex);
+  *e = pcqueue_front(queue);
   csem_post(&queue->slots_inuse);
 
   return OK;
@@ -11,6 +11,9 @@
  ******************************************************************************/
 #include "rcsw/multithread/rdwrlock.h"
 
+#include <limits.h>
+#include <string.h>
+
 #define RCSW_ER_MODID ekLOG4CL_MT_RDWRLOCK
 #define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "mt", "rdwrl")
 #include "rcsw/er/client.h"
@@ -18,22 +21,81 @@
 #include "rcsw/rcsw.h"
 #include "rcsw/common/alloc.h"
 #include "rcsw/common/flags.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/al/clock.h"
+#include "rcsw/utils/time.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief # of times a revoking writer polls for readers to drain before going
+ * to sleep.
+ */
+#define RDWRL_SPIN_MAX 256
+
+/*******************************************************************************
+ * Global Variables
+ ******************************************************************************/
+/** The reader counter index for the calling thread. */
+static __thread uint32_t tl_stripe = UINT32_MAX;
+
+/** Round robin assignment of threads to reader counters. */
+static uint32_t g_next_stripe;
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+/** Set if the calling thread had to wait while acquiring a lock. */
+static __thread bool_t tl_contended;
+
+/** When the calling thread first found it had to wait, if it did. */
+static __thread uint64_t tl_wait_start;
+
+/*
+ * Only timestamp the start if we actually have to wait, so uncontended
+ * acquires never read the clock.
+ */
+static inline void rdwrl_contended(void) {
+  if (!tl_contended) {
+    tl_contended = true;
+    tl_wait_start = lockprof_now();
+  }
+} /* rdwrl_contended() */
+#define RDWRL_CONTENDED() rdwrl_contended()
+#else
+#define RDWRL_CONTENDED()
+#endif
 
 /*******************************************************************************
  * Private Functions
  ******************************************************************************/
 BEGIN_C_DECLS
 
+/**
+ * \brief Wait on one of the internal semaphores, noting if we had to block.
+ *
+ * \param to RELATIVE timeout, or NULL to wait forever.
+ */
+static status_t rdwrl_sem_wait(struct csem* const sem,
+                               const struct timespec* const to) {
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (OK == csem_trywait(sem)) {
+    return OK;
+  }
+  RDWRL_CONTENDED();
+#endif
+  return (NULL != to) ? csem_timedwait(sem, to) : csem_wait(sem);
+} /* rdwrl_sem_wait() */
+
 static void rdwrl_wr_exit(struct rdwrlock* const rdwr) {
   csem_post(&rdwr->access); /* release exclusive access to resource */
 } /* rdwrl_wr_exit() */
 
 static void rdwrl_wr_enter(struct rdwrlock* const rdwr) {
   /* get a place in line (ensure fairness) */
-  csem_wait(&rdwr->order);
+  rdwrl_sem_wait(&rdwr->order, NULL);
 
   /* request exclusive access to resource */
-  csem_wait(&rdwr->access);
+  rdwrl_sem_wait(&rdwr->access, NULL);
 
   /* we have gotten served, so release our place in line */
   csem_post(&rdwr->order);
@@ -44,10 +106,10 @@ static status_t rdwrl_wr_timed_enter(struct rdwrlock* const rdwr,
   status_t rval = ERROR;
 
   /* get a place in line (ensure fairness) */
-  csem_timedwait(&rdwr->order, to);
+  rdwrl_sem_wait(&rdwr->order, to);
 
   /* request exclusive access to resource */
-  RCSW_CHECK(OK == csem_timedwait(&rdwr->access, to));
+  RCSW_CHECK(OK == rdwrl_sem_wait(&rdwr->access, to));
   rval = OK;
 
 error:
@@ -74,15 +136,15 @@ static void rdwrl_rd_exit(struct rdwrlock* const rdwr) {
 
 static void rdwrl_rd_enter(struct rdwrlock* rdwr) {
   /* get a place in line (ensure fairness) */
-  csem_wait(&rdwr->order);
+  rdwrl_sem_wait(&rdwr->order, NULL);
 
   /* we are going to modify the readers counter */
-  csem_wait(&rdwr->read);
+  rdwrl_sem_wait(&rdwr->read, NULL);
 
   /* if we are the first reader */
   if (0 == rdwr->n_readers) {
     /* request exclusive access for readers */
-    csem_wait(&rdwr->access);
+    rdwrl_sem_wait(&rdwr->access, NULL);
   }
   ++rdwr->n_readers; /* 1 more reader */
 
@@ -98,15 +160,15 @@ static status_t rdwrl_rd_timed_enter(struct rdwrlock* const rdwr,
   status_t rval = ERROR;
 
   /* get a place in line (ensure fairness) */
-  csem_wait(&rdwr->order);
+  rdwrl_sem_wait(&rdwr->order, NULL);
 
   /* we are going to modify the readers counter */
-  csem_wait(&rdwr->read);
+  rdwrl_sem_wait(&rdwr->read, NULL);
 
   /* if we are the first reader */
   if (0 == rdwr->n_readers) {
     /* request exclusive access for readers */
-    RCSW_CHECK(OK == csem_timedwait(&rdwr->access, to));
+    RCSW_CHECK(OK == rdwrl_sem_wait(&rdwr->access, to));
   }
   ++rdwr->n_readers; /* 1 more reader */
   rval = OK;
@@ -120,6 +182,202 @@ error:
   return rval;
 } /* struct rdwrl_rd_timed_enter() */
 
+/*
+ * Reader-biased mode. Readers and writers synchronize Dekker-style: a reader
+ * bumps its counter and then checks \ref rdwrlock.wr_active, and a writer sets
+ * \ref rdwrlock.wr_active and then sums the counters. All four operations are
+ * sequentially consistent, so at least one of them sees the other.
+ */
+static struct rdwrl_stripe* rdwrl_stripe_get(struct rdwrlock* const rdwr) {
+  if (RCSW_UNLIKELY(UINT32_MAX == tl_stripe)) {
+    tl_stripe = __atomic_fetch_add(&g_next_stripe, 1, __ATOMIC_RELAXED) %
+                RCSW_RDWRLOCK_STRIPES;
+  }
+  return &rdwr->stripes[tl_stripe];
+} /* rdwrl_stripe_get() */
+
+static void rdwrl_bias_rd_exit(struct rdwrlock* const rdwr) {
+  __atomic_sub_fetch(&rdwrl_stripe_get(rdwr)->n_readers, 1, __ATOMIC_SEQ_CST);
+
+  /* a writer might be waiting on us to drain */
+  if (RCSW_UNLIKELY(__atomic_load_n(&rdwr->wr_active, __ATOMIC_SEQ_CST))) {
+    __atomic_add_fetch(&rdwr->drain_seq, 1, __ATOMIC_RELEASE);
+    futex_wake(&rdwr->drain_seq, 1);
+  }
+} /* rdwrl_bias_rd_exit() */
+
+static bool_t rdwrl_bias_rd_tryenter(struct rdwrlock* const rdwr) {
+  __atomic_add_fetch(&rdwrl_stripe_get(rdwr)->n_readers, 1, __ATOMIC_SEQ_CST);
+
+  if (RCSW_LIKELY(!__atomic_load_n(&rdwr->wr_active, __ATOMIC_SEQ_CST))) {
+    return true;
+  }
+  /* a writer has revoked the bias: back out */
+  rdwrl_bias_rd_exit(rdwr);
+  return false;
+} /* rdwrl_bias_rd_tryenter() */
+
+static status_t rdwrl_bias_rd_enter(struct rdwrlock* const rdwr,
+                                    const struct timespec* const to) {
+  if (RCSW_LIKELY(rdwrl_bias_rd_tryenter(rdwr))) {
+    return OK;
+  }
+  RDWRL_CONTENDED();
+  struct timespec deadline;
+  if (NULL != to) {
+    deadline = clock_monotime();
+    time_ts_add(&deadline, to);
+  }
+
+  /* get a place in line (ensure fairness) */
+  if (NULL != to) {
+    RCSW_CHECK(OK == rdwrl_sem_wait(&rdwr->order, to));
+  } else {
+    rdwrl_sem_wait(&rdwr->order, NULL);
+  }
+
+  /*
+   * No new writer can revoke the bias while we hold our place in line, so we
+   * only have to wait for the current one (if any) to finish.
+   */
+  status_t rval = OK;
+  while (true) {
+    uint32_t seq = __atomic_load_n(&rdwr->wr_seq, __ATOMIC_ACQUIRE);
+    if (!__atomic_load_n(&rdwr->wr_active, __ATOMIC_ACQUIRE) &&
+        rdwrl_bias_rd_tryenter(rdwr)) {
+      break;
+    }
+    if (ERROR == futex_wait(&rdwr->wr_seq,
+                            seq,
+                            (NULL != to) ? &deadline : NULL)) {
+      rval = ERROR;
+      break;
+    }
+  } /* while() */
+
+  /* we have gotten served, so release our place in line */
+  csem_post(&rdwr->order);
+  return rval;
+
+error:
+  return ERROR;
+} /* rdwrl_bias_rd_enter() */
+
+static void rdwrl_bias_restore(struct rdwrlock* const rdwr) {
+  __atomic_store_n(&rdwr->wr_active, 0, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&rdwr->wr_seq, 1, __ATOMIC_RELEASE);
+  futex_wake(&rdwr->wr_seq, INT_MAX);
+} /* rdwrl_bias_restore() */
+
+static status_t rdwrl_bias_revoke(struct rdwrlock* const rdwr,
+                                  const struct timespec* const deadline) {
+  __atomic_store_n(&rdwr->wr_active, 1, __ATOMIC_SEQ_CST);
+
+  /* wait for the readers already inside to drain */
+  size_t spins = 0;
+  while (true) {
+    uint32_t seq = __atomic_load_n(&rdwr->drain_seq, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (0 == rdwrl_n_readers(rdwr)) {
+      return OK;
+    }
+    RDWRL_CONTENDED();
+    if (spins < RDWRL_SPIN_MAX) {
+      ++spins;
+      RCSW_CPU_RELAX();
+      continue;
+    }
+    if (ERROR == futex_wait(&rdwr->drain_seq, seq, deadline)) {
+      /* let any readers which queued up behind us in */
+      rdwrl_bias_restore(rdwr);
+      return ERROR;
+    }
+  } /* while() */
+} /* rdwrl_bias_revoke() */
+
+static void rdwrl_bias_wr_exit(struct rdwrlock* const rdwr) {
+  rdwrl_bias_restore(rdwr);
+  csem_post(&rdwr->access); /* release exclusive access to resource */
+} /* rdwrl_bias_wr_exit() */
+
+static status_t rdwrl_bias_wr_enter(struct rdwrlock* const rdwr,
+                                    const struct timespec* const to) {
+  struct timespec deadline;
+  if (NULL != to) {
+    deadline = clock_monotime();
+    time_ts_add(&deadline, to);
+  }
+
+  /* get a place in line (ensure fairness) */
+  if (NULL != to) {
+    RCSW_CHECK(OK == rdwrl_sem_wait(&rdwr->order, to));
+  } else {
+    rdwrl_sem_wait(&rdwr->order, NULL);
+  }
+
+  /* request exclusive access to resource among writers */
+  status_t rval = rdwrl_sem_wait(&rdwr->access, to);
+
+  /* revoke the bias and wait out the readers */
+  if (OK == rval) {
+    rval = rdwrl_bias_revoke(rdwr, (NULL != to) ? &deadline : NULL);
+    if (OK != rval) {
+      csem_post(&rdwr->access);
+    }
+  }
+
+  /* we have gotten served, so release our place in line */
+  csem_post(&rdwr->order);
+  return rval;
+
+error:
+  return ERROR;
+} /* rdwrl_bias_wr_enter() */
+
+static void rdwrl_req_impl(struct rdwrlock* const rdwr,
+                           enum rdwrlock_scope scope) {
+  bool_t bias = rdwr->flags & RCSW_RDWRLOCK_RDBIAS;
+  switch (scope) {
+    case ekSCOPE_RD:
+      if (bias) {
+        rdwrl_bias_rd_enter(rdwr, NULL);
+      } else {
+        rdwrl_rd_enter(rdwr);
+      }
+      break;
+    case ekSCOPE_WR:
+      if (bias) {
+        rdwrl_bias_wr_enter(rdwr, NULL);
+      } else {
+        rdwrl_wr_enter(rdwr);
+      }
+      break;
+    default:
+      ER_SENTINEL("Bad privilege scope '%d' on enter", scope);
+  } /* switch() */
+error:
+  return;
+} /* rdwrl_req_impl() */
+
+static status_t rdwrl_timedreq_impl(struct rdwrlock* const rdwr,
+                                    enum rdwrlock_scope scope,
+                                    const struct timespec* const to) {
+  bool_t bias = rdwr->flags & RCSW_RDWRLOCK_RDBIAS;
+  switch (scope) {
+    case ekSCOPE_RD:
+      return bias ? rdwrl_bias_rd_enter(rdwr, to)
+                  : rdwrl_rd_timed_enter(rdwr, to);
+    case ekSCOPE_WR:
+      return bias ? rdwrl_bias_wr_enter(rdwr, to)
+                  : rdwrl_wr_timed_enter(rdwr, to);
+    default:
+      ER_SENTINEL("Bad privilege scope '%d' on enter", scope);
+  } /* switch() */
+
+error:
+  return ERROR;
+} /* rdwrl_timedreq_impl() */
+
 /*******************************************************************************
  * API Functions
  ******************************************************************************/
@@ -132,6 +390,13 @@ struct rdwrlock* rdwrl_init(struct rdwrlock* const rdwr_in, uint32_t flags) {
   rdwr->flags = flags;
 
   rdwr->n_readers = 0;
+  memset(rdwr->stripes, 0, sizeof(rdwr->stripes));
+  rdwr->wr_active = 0;
+  rdwr->wr_seq = 0;
+  rdwr->drain_seq = 0;
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  lockprof_init(&rdwr->prof);
+#endif
   RCSW_CHECK(NULL != csem_init(&rdwr->order, 1, RCSW_NOALLOC_HANDLE));
   RCSW_CHECK(NULL != csem_init(&rdwr->access, 1, RCSW_NOALLOC_HANDLE));
   RCSW_CHECK(NULL != csem_init(&rdwr->read, 1, RCSW_NOALLOC_HANDLE));
@@ -146,6 +411,9 @@ error:
 void rdwrl_destroy(struct rdwrlock* const rdwr) {
   RCSW_FPC_V(NULL != rdwr);
 
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  lockprof_unregister(&rdwr->prof);
+#endif
   csem_destroy(&rdwr->order);
   csem_destroy(&rdwr->access);
   csem_destroy(&rdwr->read);
@@ -156,29 +424,43 @@ void rdwrl_destroy(struct rdwrlock* const rdwr) {
 void rdwrl_req(struct rdwrlock *const rdwr, enum rdwrlock_scope scope) {
   RCSW_FPC_V(NULL != rdwr);
 
-  switch (scope) {
-    case ekSCOPE_RD:
-      rdwrl_rd_enter(rdwr);
-      break;
-    case ekSCOPE_WR:
-      rdwrl_wr_enter(rdwr);
-      break;
-    default:
-      ER_SENTINEL("Bad privilege scope '%d' on enter", scope);
-  } /* switch() */
-error:
-  return;
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&rdwr->prof)) {
+    tl_contended = false;
+    rdwrl_req_impl(rdwr, scope);
+    lockprof_acquired(&rdwr->prof,
+                      tl_contended,
+                      tl_wait_start,
+                      ekSCOPE_WR == scope);
+    return;
+  }
+#endif
+  rdwrl_req_impl(rdwr, scope);
 } /* rdwrl_req() */
 
 void rdwrl_exit(struct rdwrlock *const rdwr, enum rdwrlock_scope scope) {
   RCSW_FPC_V(NULL != rdwr);
 
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (ekSCOPE_WR == scope && lockprof_enabled(&rdwr->prof)) {
+    lockprof_released(&rdwr->prof);
+  }
+#endif
+  bool_t bias = rdwr->flags & RCSW_RDWRLOCK_RDBIAS;
   switch (scope) {
     case ekSCOPE_RD:
-      rdwrl_rd_exit(rdwr);
+      if (bias) {
+        rdwrl_bias_rd_exit(rdwr);
+      } else {
+        rdwrl_rd_exit(rdwr);
+      }
       break;
     case ekSCOPE_WR:
-      rdwrl_wr_exit(rdwr);
+      if (bias) {
+        rdwrl_bias_wr_exit(rdwr);
+      } else {
+        rdwrl_wr_exit(rdwr);
+      }
       break;
     default:
       ER_SENTINEL("Bad privilege scope '%d' on exit", scope);
@@ -192,18 +474,20 @@ status_t rdwrl_timedreq(struct rdwrlock *const rdwr,
                         const struct timespec* const to) {
   RCSW_FPC_NV(ERROR, NULL != rdwr, NULL != to);
 
-  switch (scope) {
-    case ekSCOPE_RD:
-      return rdwrl_rd_timed_enter(rdwr, to);
-      break;
-    case ekSCOPE_WR:
-      return rdwrl_wr_timed_enter(rdwr, to);
-    default:
-      ER_SENTINEL("Bad privilege scope '%d' on enter", scope);
-  } /* switch() */
-
-error:
-  return ERROR;
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  if (lockprof_enabled(&rdwr->prof)) {
+    tl_contended = false;
+    status_t rstat = rdwrl_timedreq_impl(rdwr, scope, to);
+    if (OK == rstat) {
+      lockprof_acquired(&rdwr->prof,
+                        tl_contended,
+                        tl_wait_start,
+                        ekSCOPE_WR == scope);
+    }
+    return rstat;
+  }
+#endif
+  return rdwrl_timedreq_impl(rdwr, scope, to);
 } /* rdwrl_timedreq() */
 
 END_C_DECLS
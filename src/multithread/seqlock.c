@@ -0,0 +1,101 @@
+/**
+ * \file seqlock.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/multithread/seqlock.h"
+
+#include <string.h>
+
+#include "rcsw/er/client.h"
+#include "rcsw/common/alloc.h"
+#include "rcsw/common/flags.h"
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+struct seqlock* seqlock_init(struct seqlock* sl_in, uint32_t flags) {
+  struct seqlock* sl = rcsw_alloc(sl_in,
+                                  sizeof(struct seqlock),
+                                  flags & RCSW_NOALLOC_HANDLE);
+
+  RCSW_CHECK_PTR(sl);
+  sl->flags = flags;
+  sl->seq = 0;
+  RCSW_CHECK(NULL != mutex_init(&sl->mtx, RCSW_NOALLOC_HANDLE));
+  return sl;
+
+error:
+  seqlock_destroy(sl);
+  return NULL;
+} /* seqlock_init() */
+
+void seqlock_destroy(struct seqlock* sl) {
+  RCSW_FPC_V(NULL != sl);
+
+  mutex_destroy(&sl->mtx);
+  rcsw_free(sl, sl->flags & RCSW_NOALLOC_HANDLE);
+} /* seqlock_destroy() */
+
+status_t seqlock_wr_enter(struct seqlock* sl) {
+  RCSW_FPC_NV(ERROR, NULL != sl);
+
+  RCSW_CHECK(OK == mutex_lock(&sl->mtx));
+
+  /*
+   * Make seq odd BEFORE any writes to the protected state become visible, so
+   * readers which see any of them will retry.
+   */
+  __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return OK;
+
+error:
+  return ERROR;
+} /* seqlock_wr_enter() */
+
+status_t seqlock_wr_exit(struct seqlock* sl) {
+  RCSW_FPC_NV(ERROR, NULL != sl);
+
+  /* publish all writes to the protected state along with the even seq */
+  __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+  return mutex_unlock(&sl->mtx);
+} /* seqlock_wr_exit() */
+
+status_t seqlock_read(const struct seqlock* sl,
+                      void* dst,
+                      const void* src,
+                      size_t n_bytes) {
+  RCSW_FPC_NV(ERROR, NULL != sl, NULL != dst, NULL != src);
+
+  uint32_t seq;
+  do {
+    seq = seqlock_rd_begin(sl);
+    memcpy(dst, src, n_bytes);
+  } while (seqlock_rd_retry(sl, seq));
+  return OK;
+} /* seqlock_read() */
+
+status_t seqlock_write(struct seqlock* sl,
+                       void* dst,
+                       const void* src,
+                       size_t n_bytes) {
+  RCSW_FPC_NV(ERROR, NULL != sl, NULL != dst, NULL != src);
+
+  RCSW_CHECK(OK == seqlock_wr_enter(sl));
+  memcpy(dst, src, n_bytes);
+  return seqlock_wr_exit(sl);
+
+error:
+  return ERROR;
+} /* seqlock_write() */
+
+END_C_DECLS
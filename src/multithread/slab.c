@@ -0,0 +1,416 @@
+/**
+ * \file slab.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/multithread/slab.h"
+
+#define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "mt", "slab")
+#define RCSW_ER_MODID ekLOG4CL_MT_SLAB
+#include "rcsw/er/client.h"
+#include "rcsw/common/fpc.h"
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/**
+ * \brief Per-thread cache of free chunks, with \ref RCSW_SLAB_CACHE. Carved
+ * out of the slab itself; see \ref slab_cache_space().
+ */
+struct slab_cache {
+  struct slab* slab;
+  size_t counts[RCSW_SLAB_MAX_CLASSES];
+  void* chunks[][RCSW_SLAB_CACHE_SIZE];
+};
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+static inline bool_t slab_is_pow2(size_t val) {
+  return 0 != val && 0 == (val & (val - 1));
+}
+
+/**
+ * \brief Get the page a chunk lives in.
+ *
+ * \return The page, or NULL if \p ptr is not in a page which has been handed
+ * out to a size class.
+ */
+static struct slab_page* slab_page_of(const struct slab* const the_slab,
+                                      const void* const ptr) {
+  if (!slab_owns(the_slab, ptr)) {
+    return NULL;
+  }
+  size_t offset = (size_t)((const uint8_t*)ptr - (uint8_t*)the_slab->arena);
+  struct slab_page* page = &the_slab->pages[offset / the_slab->page_size];
+
+  return (NULL != __atomic_load_n(&page->cls, __ATOMIC_ACQUIRE)) ? page : NULL;
+} /* slab_page_of() */
+
+/**
+ * \brief Hand the next unused page in the arena to a size class. Class mutex
+ * must be held.
+ *
+ * \return The new page, or NULL if the slab can't grow any more.
+ */
+static struct slab_page* slab_page_grow(struct slab* const the_slab,
+                                        struct slab_class* const cls) {
+  /* other classes might be growing at the same time */
+  size_t idx = __atomic_load_n(&the_slab->n_pages, __ATOMIC_RELAXED);
+  do {
+    if (idx >= the_slab->max_pages) {
+      ER_DEBUG("Cannot grow size class %zu: all %zu pages in use",
+               cls->size,
+               the_slab->max_pages);
+      return NULL;
+    }
+  } while (!__atomic_compare_exchange_n(&the_slab->n_pages,
+                                        &idx,
+                                        idx + 1,
+                                        true,
+                                        __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED));
+
+  /* chunks at the start of the page, then their mpool metadata */
+  uint8_t* base = (uint8_t*)the_slab->arena + idx * the_slab->page_size;
+  struct mpool_params params = {
+    .meta = (dptr_t*)(base + cls->per_page * cls->size),
+    .elements = (dptr_t*)base,
+    .elt_size = cls->size,
+    .max_elts = cls->per_page,
+    .flags = RCSW_NOALLOC_HANDLE | RCSW_NOALLOC_DATA | RCSW_NOALLOC_META
+  };
+  struct slab_page* page = &the_slab->pages[idx];
+  RCSW_CHECK_PTR(mpool_init(&page->pool, &params));
+
+  page->next = cls->pages;
+  cls->pages = page;
+  __atomic_store_n(&page->cls, cls, __ATOMIC_RELEASE);
+
+  ER_DEBUG("Size class %zu grew to page %zu", cls->size, idx);
+  return page;
+
+error:
+  return NULL;
+} /* slab_page_grow() */
+
+/**
+ * \brief Get a free chunk from a size class's pages, growing the class if
+ * needed. Class mutex must be held.
+ *
+ * \return The chunk, or NULL if there are no free chunks and the class can't
+ * grow (errno set to ENOMEM).
+ */
+static void* slab_class_req(struct slab* const the_slab,
+                            struct slab_class* const cls) {
+  struct slab_page* page = __atomic_load_n(&cls->hint, __ATOMIC_RELAXED);
+
+  if (NULL == page || mpool_isfull(&page->pool)) {
+    for (page = cls->pages; NULL != page; page = page->next) {
+      if (!mpool_isfull(&page->pool)) {
+        break;
+      }
+    } /* for(page..) */
+
+    if (NULL == page) {
+      page = slab_page_grow(the_slab, cls);
+    }
+    if (NULL == page) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    __atomic_store_n(&cls->hint, page, __ATOMIC_RELAXED);
+  }
+  /*
+   * Chunks are only taken out of the page with the class mutex held, so this
+   * won't block.
+   */
+  return mpool_req(&page->pool);
+} /* slab_class_req() */
+
+static void* slab_chunk_get(struct slab* const the_slab,
+                            struct slab_class* const cls) {
+  mutex_lock(&cls->mtx);
+  void* chunk = slab_class_req(the_slab, cls);
+  mutex_unlock(&cls->mtx);
+  return chunk;
+} /* slab_chunk_get() */
+
+/**
+ * \brief Return a chunk to its page.
+ */
+static status_t slab_chunk_put(struct slab* const the_slab,
+                               struct slab_page* const page,
+                               void* const ptr) {
+  RCSW_CHECK(OK == mpool_release(&page->pool, ptr));
+
+  /* the page now has space, so point the next allocation at it */
+  __atomic_store_n(&page->cls->hint, page, __ATOMIC_RELAXED);
+  return OK;
+
+error:
+  return ERROR;
+} /* slab_chunk_put() */
+
+/**
+ * \brief Return all chunks in a per-thread cache to the slab, and then the
+ * cache itself. Called when a thread exits.
+ */
+static void slab_cache_flush(void* const arg) {
+  struct slab_cache* cache = arg;
+  struct slab* the_slab = cache->slab;
+
+  for (size_t i = 0; i < the_slab->n_classes; ++i) {
+    while (cache->counts[i] > 0) {
+      void* chunk = cache->chunks[i][--cache->counts[i]];
+      slab_chunk_put(the_slab, slab_page_of(the_slab, chunk), chunk);
+    } /* while() */
+  } /* for(i..) */
+  slab_chunk_put(the_slab, slab_page_of(the_slab, cache), cache);
+} /* slab_cache_flush() */
+
+/**
+ * \brief Get the calling thread's cache, creating it if this is the first time
+ * the thread has used the slab.
+ *
+ * \return The cache, or NULL if it could not be allocated.
+ */
+static struct slab_cache* slab_cache_get(struct slab* const the_slab) {
+  struct slab_cache* cache = pthread_getspecific(the_slab->key);
+  if (RCSW_LIKELY(NULL != cache)) {
+    return cache;
+  }
+  size_t idx = slab_class_idx(the_slab, slab_cache_space(the_slab->n_classes));
+  cache = slab_chunk_get(the_slab, &the_slab->classes[idx]);
+  RCSW_CHECK_PTR(cache);
+
+  memset(cache, 0, sizeof(struct slab_cache));
+  cache->slab = the_slab;
+  if (0 != pthread_setspecific(the_slab->key, cache)) {
+    slab_chunk_put(the_slab, slab_page_of(the_slab, cache), cache);
+    return NULL;
+  }
+  return cache;
+
+error:
+  return NULL;
+} /* slab_cache_get() */
+
+static void* slab_backend_alloc(void* const ctx, size_t n_bytes) {
+  struct slab* the_slab = ctx;
+  void* ptr = NULL;
+
+  if (slab_class_idx(the_slab, n_bytes) < the_slab->n_classes) {
+    ptr = slab_alloc(the_slab, n_bytes);
+  }
+  /* too big, or out of space */
+  return (NULL != ptr) ? ptr : malloc(n_bytes);
+} /* slab_backend_alloc() */
+
+static void slab_backend_free(void* const ctx, void* const ptr) {
+  struct slab* the_slab = ctx;
+
+  if (slab_owns(the_slab, ptr)) {
+    slab_free(the_slab, ptr);
+  } else {
+    free(ptr);
+  }
+} /* slab_backend_free() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+struct slab* slab_init(struct slab* const slab_in,
+                       const struct slab_params* const params) {
+  RCSW_FPC_NV(NULL,
+              NULL != params,
+              params->max_pages > 0,
+              params->min_size >= sizeof(void*),
+              params->max_size >= params->min_size,
+              slab_is_pow2(params->min_size),
+              slab_is_pow2(params->max_size));
+  RCSW_ER_MODULE_INIT();
+
+  struct slab* the_slab = rcsw_alloc(slab_in,
+                                     sizeof(struct slab),
+                                     params->flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(the_slab);
+
+  /* set once the thread-specific data key is created */
+  the_slab->flags = params->flags & ~(uint32_t)RCSW_SLAB_CACHE;
+  the_slab->page_size = params->page_size;
+  the_slab->max_pages = params->max_pages;
+  the_slab->n_pages = 0;
+  the_slab->n_classes = 0;
+  the_slab->arena = NULL;
+  the_slab->pages = NULL;
+  the_slab->min_shift = (size_t)__builtin_ctzl(params->min_size);
+
+  size_t n_classes = (size_t)__builtin_ctzl(params->max_size) -
+                     the_slab->min_shift + 1;
+  ER_CHECK(n_classes <= RCSW_SLAB_MAX_CLASSES,
+           "Too many size classes: %zu > %d",
+           n_classes,
+           RCSW_SLAB_MAX_CLASSES);
+
+  ER_INFO("Init slab: %zu size classes in [%zu,%zu],page_size=%zu,max_pages=%zu",
+          n_classes,
+          params->min_size,
+          params->max_size,
+          params->page_size,
+          params->max_pages);
+
+  the_slab->arena = rcsw_alloc(params->arena,
+                               slab_arena_space(params->max_pages,
+                                                params->page_size),
+                               params->flags & RCSW_NOALLOC_DATA);
+  RCSW_CHECK_PTR(the_slab->arena);
+
+  the_slab->pages = rcsw_alloc(params->meta,
+                               slab_meta_space(params->max_pages),
+                               params->flags & RCSW_NOALLOC_META);
+  RCSW_CHECK_PTR(the_slab->pages);
+  memset(the_slab->pages, 0, slab_meta_space(params->max_pages));
+
+  for (size_t i = 0; i < n_classes; ++i) {
+    struct slab_class* cls = &the_slab->classes[i];
+    cls->size = (size_t)1 << (the_slab->min_shift + i);
+    cls->per_page = the_slab->page_size /
+                    (cls->size + sizeof(struct mpool_slot));
+    cls->pages = NULL;
+    cls->hint = NULL;
+    ER_CHECK(cls->per_page > 0,
+             "Page size %zu too small for size class %zu",
+             the_slab->page_size,
+             cls->size);
+
+    RCSW_CHECK_PTR(mutex_init(&cls->mtx, RCSW_NOALLOC_HANDLE));
+    the_slab->n_classes = i + 1;
+  } /* for(i..) */
+
+  if (params->flags & RCSW_SLAB_CACHE) {
+    ER_CHECK(slab_class_idx(the_slab,
+                            slab_cache_space(n_classes)) < n_classes,
+             "Per-thread caches do not fit in largest size class");
+    RCSW_CHECK(0 == pthread_key_create(&the_slab->key, slab_cache_flush));
+    the_slab->flags |= RCSW_SLAB_CACHE;
+  }
+  return the_slab;
+
+error:
+  slab_destroy(the_slab);
+  errno = EAGAIN;
+  return NULL;
+} /* slab_init() */
+
+void slab_destroy(struct slab* const the_slab) {
+  RCSW_FPC_V(NULL != the_slab);
+
+  /* per-thread caches live in the arena, so nothing else to free */
+  if (the_slab->flags & RCSW_SLAB_CACHE) {
+    pthread_key_delete(the_slab->key);
+  }
+  for (size_t i = 0; i < the_slab->n_pages; ++i) {
+    if (NULL != the_slab->pages[i].cls) {
+      mpool_destroy(&the_slab->pages[i].pool);
+    }
+  } /* for(i..) */
+  for (size_t i = 0; i < the_slab->n_classes; ++i) {
+    mutex_destroy(&the_slab->classes[i].mtx);
+  } /* for(i..) */
+
+  rcsw_free(the_slab->pages, the_slab->flags & RCSW_NOALLOC_META);
+  rcsw_free(the_slab->arena, the_slab->flags & RCSW_NOALLOC_DATA);
+  rcsw_free(the_slab, the_slab->flags & RCSW_NOALLOC_HANDLE);
+} /* slab_destroy() */
+
+void* slab_alloc(struct slab* const the_slab, size_t n_bytes) {
+  RCSW_FPC_NV(NULL, NULL != the_slab, n_bytes > 0);
+
+  size_t idx = slab_class_idx(the_slab, n_bytes);
+  if (RCSW_UNLIKELY(idx >= the_slab->n_classes)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  struct slab_class* cls = &the_slab->classes[idx];
+  struct slab_cache* cache = NULL;
+
+  if (the_slab->flags & RCSW_SLAB_CACHE) {
+    cache = slab_cache_get(the_slab);
+  }
+  if (NULL == cache) {
+    return slab_chunk_get(the_slab, cls);
+  }
+
+  /* fast path: this thread has a free chunk cached */
+  if (RCSW_LIKELY(cache->counts[idx] > 0)) {
+    return cache->chunks[idx][--cache->counts[idx]];
+  }
+
+  /* refill half a cache's worth with one trip to the class */
+  mutex_lock(&cls->mtx);
+  while (cache->counts[idx] < RCSW_SLAB_CACHE_SIZE / 2) {
+    void* chunk = slab_class_req(the_slab, cls);
+    if (NULL == chunk) {
+      break;
+    }
+    cache->chunks[idx][cache->counts[idx]++] = chunk;
+  } /* while() */
+  mutex_unlock(&cls->mtx);
+
+  if (0 == cache->counts[idx]) {
+    return NULL;
+  }
+  return cache->chunks[idx][--cache->counts[idx]];
+} /* slab_alloc() */
+
+status_t slab_free(struct slab* const the_slab, void* const ptr) {
+  RCSW_FPC_NV(ERROR, NULL != the_slab, NULL != ptr);
+
+  struct slab_page* page = slab_page_of(the_slab, ptr);
+  ER_CHECK(NULL != page, "Chunk %p not from slab", ptr);
+  ER_CHECK(-1 != mpool_ref_query(&page->pool, ptr),
+           "Chunk %p not at start of chunk in page",
+           ptr);
+
+  struct slab_cache* cache = NULL;
+  if (the_slab->flags & RCSW_SLAB_CACHE) {
+    cache = slab_cache_get(the_slab);
+  }
+  if (NULL == cache) {
+    return slab_chunk_put(the_slab, page, ptr);
+  }
+
+  size_t idx = (size_t)(page->cls - the_slab->classes);
+  if (cache->counts[idx] == RCSW_SLAB_CACHE_SIZE) {
+    /* full--give half back to everyone else */
+    for (size_t i = 0; i < RCSW_SLAB_CACHE_SIZE / 2; ++i) {
+      void* chunk = cache->chunks[idx][--cache->counts[idx]];
+      slab_chunk_put(the_slab, slab_page_of(the_slab, chunk), chunk);
+    } /* for(i..) */
+  }
+  cache->chunks[idx][cache->counts[idx]++] = ptr;
+  return OK;
+
+error:
+  return ERROR;
+} /* slab_free() */
+
+void slab_backend_init(struct slab* const the_slab,
+                       struct rcsw_alloc_backend* const backend) {
+  RCSW_FPC_V(NULL != the_slab, NULL != backend);
+
+  backend->alloc = slab_backend_alloc;
+  backend->free = slab_backend_free;
+  backend->ctx = the_slab;
+} /* slab_backend_init() */
+
+END_C_DECLS
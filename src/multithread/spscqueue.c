@@ -0,0 +1,255 @@
+/**
+ * \file spscqueue.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/multithread/spscqueue.h"
+
+#include <sched.h>
+
+#include "rcsw/al/clock.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/common/alloc.h"
+#include "rcsw/er/client.h"
+#include "rcsw/utils/time.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/**
+ * \brief # of times to spin waiting for the other side before
+ * yielding/sleeping.
+ */
+#define SPSCQUEUE_SPIN_MAX 256
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+static inline void* spscqueue_slot(const struct spscqueue* const queue,
+                                   size_t idx) {
+  return (uint8_t*)queue->elements + (idx % queue->max_elts) * queue->elt_size;
+}
+
+static bool_t spscqueue_can_push(struct spscqueue* const queue) {
+  size_t tail = __atomic_load_n(&queue->prod.idx, __ATOMIC_RELAXED);
+  if (tail - queue->prod.cached < queue->max_elts) {
+    return true;
+  }
+  queue->prod.cached = __atomic_load_n(&queue->cons.idx, __ATOMIC_ACQUIRE);
+  return tail - queue->prod.cached < queue->max_elts;
+}
+
+static bool_t spscqueue_can_pop(struct spscqueue* const queue) {
+  size_t head = __atomic_load_n(&queue->cons.idx, __ATOMIC_RELAXED);
+  if (head != queue->cons.cached) {
+    return true;
+  }
+  queue->cons.cached = __atomic_load_n(&queue->prod.idx, __ATOMIC_ACQUIRE);
+  return head != queue->cons.cached;
+}
+
+/**
+ * \brief Wake the other side if it is sleeping waiting on \p end to make
+ * progress.
+ */
+static void spscqueue_wake(struct spscqueue* const queue,
+                           struct spscqueue_end* const end) {
+  if (!(queue->flags & RCSW_SPSCQUEUE_FUTEX)) {
+    return;
+  }
+  /*
+   * Pairs with the fence in spscqueue_wait(): either we see the waiter's flag,
+   * or it sees the index we just published and doesn't go to sleep.
+   */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&end->waiting, __ATOMIC_RELAXED)) {
+    __atomic_add_fetch(&end->seq, 1, __ATOMIC_RELEASE);
+    futex_wake(&end->seq, 1);
+  }
+}
+
+/**
+ * \brief Wait (once) for \p end to make progress so that \p ready() becomes
+ * true. Spins for a while first, then yields or sleeps.
+ *
+ * \return \ref status_t. Sets errno to ETIMEDOUT if \p deadline has passed.
+ */
+static status_t spscqueue_wait(struct spscqueue* const queue,
+                               struct spscqueue_end* const end,
+                               bool_t (*ready)(struct spscqueue*),
+                               size_t* const spins,
+                               const struct timespec* const deadline) {
+  if (*spins < SPSCQUEUE_SPIN_MAX) {
+    ++(*spins);
+    RCSW_CPU_RELAX();
+    return OK;
+  }
+  if (NULL != deadline) {
+    struct timespec now = clock_monotime();
+    if (time_ts_cmp(&now, deadline) >= 0) {
+      errno = ETIMEDOUT;
+      return ERROR;
+    }
+  }
+  if (!(queue->flags & RCSW_SPSCQUEUE_FUTEX)) {
+    sched_yield();
+    return OK;
+  }
+
+  uint32_t seq = __atomic_load_n(&end->seq, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&end->waiting, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  status_t rval = OK;
+  if (!ready(queue)) {
+    rval = futex_wait(&end->seq, seq, deadline);
+  }
+  __atomic_store_n(&end->waiting, 0, __ATOMIC_RELAXED);
+  return rval;
+}
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+struct spscqueue* spscqueue_init(struct spscqueue* queue_in,
+                                 const struct spscqueue_params* const params) {
+  RCSW_FPC_NV(NULL, NULL != params, params->max_elts > 0, params->elt_size > 0);
+
+  struct spscqueue* queue = rcsw_alloc(queue_in,
+                                       sizeof(struct spscqueue),
+                                       params->flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(queue);
+  queue->flags = params->flags;
+  queue->elt_size = params->elt_size;
+  queue->max_elts = params->max_elts;
+
+  queue->elements = rcsw_alloc(params->elements,
+                               spscqueue_element_space(params->max_elts,
+                                                       params->elt_size),
+                               params->flags & (RCSW_NOALLOC_DATA |
+                                                RCSW_ZALLOC));
+  RCSW_CHECK_PTR(queue->elements);
+
+  memset(&queue->prod, 0, sizeof(queue->prod));
+  memset(&queue->cons, 0, sizeof(queue->cons));
+  return queue;
+
+error:
+  spscqueue_destroy(queue);
+  errno = EAGAIN;
+  return NULL;
+} /* spscqueue_init() */
+
+void spscqueue_destroy(struct spscqueue* queue) {
+  RCSW_FPC_V(NULL != queue);
+
+  rcsw_free(queue->elements, queue->flags & RCSW_NOALLOC_DATA);
+  rcsw_free(queue, queue->flags & RCSW_NOALLOC_HANDLE);
+} /* spscqueue_destroy() */
+
+status_t spscqueue_trypush(struct spscqueue* const queue, const void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != e);
+
+  if (RCSW_UNLIKELY(!spscqueue_can_push(queue))) {
+    errno = EAGAIN;
+    return ERROR;
+  }
+  size_t tail = queue->prod.idx;
+  memcpy(spscqueue_slot(queue, tail), e, queue->elt_size);
+  __atomic_store_n(&queue->prod.idx, tail + 1, __ATOMIC_RELEASE);
+
+  spscqueue_wake(queue, &queue->prod);
+  return OK;
+} /* spscqueue_trypush() */
+
+status_t spscqueue_push(struct spscqueue* const queue, const void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != e);
+
+  size_t spins = 0;
+  while (OK != spscqueue_trypush(queue, e)) {
+    RCSW_CHECK(OK == spscqueue_wait(queue,
+                                    &queue->cons,
+                                    spscqueue_can_push,
+                                    &spins,
+                                    NULL));
+  } /* while() */
+  return OK;
+
+error:
+  return ERROR;
+} /* spscqueue_push() */
+
+status_t spscqueue_trypop(struct spscqueue* const queue, void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue);
+
+  if (RCSW_UNLIKELY(!spscqueue_can_pop(queue))) {
+    errno = EAGAIN;
+    return ERROR;
+  }
+  size_t head = queue->cons.idx;
+  if (NULL != e) {
+    memcpy(e, spscqueue_slot(queue, head), queue->elt_size);
+  }
+  __atomic_store_n(&queue->cons.idx, head + 1, __ATOMIC_RELEASE);
+
+  spscqueue_wake(queue, &queue->cons);
+  return OK;
+} /* spscqueue_trypop() */
+
+status_t spscqueue_pop(struct spscqueue* const queue, void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue);
+
+  size_t spins = 0;
+  while (OK != spscqueue_trypop(queue, e)) {
+    RCSW_CHECK(OK == spscqueue_wait(queue,
+                                    &queue->prod,
+                                    spscqueue_can_pop,
+                                    &spins,
+                                    NULL));
+  } /* while() */
+  return OK;
+
+error:
+  return ERROR;
+} /* spscqueue_pop() */
+
+status_t spscqueue_timedpop(struct spscqueue* const queue,
+                            const struct timespec* const to,
+                            void* const e) {
+  RCSW_FPC_NV(ERROR, NULL != queue, NULL != to);
+
+  struct timespec deadline = clock_monotime();
+  time_ts_add(&deadline, to);
+
+  size_t spins = 0;
+  while (OK != spscqueue_trypop(queue, e)) {
+    RCSW_CHECK(OK == spscqueue_wait(queue,
+                                    &queue->prod,
+                                    spscqueue_can_pop,
+                                    &spins,
+                                    &deadline));
+  } /* while() */
+  return OK;
+
+error:
+  return ERROR;
+} /* spscqueue_timedpop() */
+
+void* spscqueue_front(struct spscqueue* const queue) {
+  RCSW_FPC_NV(NULL, NULL != queue);
+
+  if (!spscqueue_can_pop(queue)) {
+    return NULL;
+  }
+  return spscqueue_slot(queue, queue->cons.idx);
+} /* spscqueue_front() */
+
+END_C_DECLS
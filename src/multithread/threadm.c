@@ -14,10 +14,76 @@
 #endif
 #include "rcsw/multithread/threadm.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "mt", "threadm")
+#define RCSW_ER_MODID ekLOG4CL_MT_THREADM
+#include "rcsw/er/client.h"
 #include "rcsw/rcsw.h"
+#include "rcsw/common/alloc.h"
+#include "rcsw/common/fpc.h"
+#include "rcsw/al/clock.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/utils/time.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/* How long threads waiting on a group sleep before looking for tasks again */
+#define THREADM_WAIT_NS 100000
+
+/* Chunks per worker parallel_for() aims for when no grain size is given */
+#define THREADM_CHUNKS_PER_WORKER 8
+
+/* Size of the node mask passed to mbind(); node IDs must be less than this */
+#define THREADM_NODEMASK_BITS 1024
+
+/* # of bits in each word of a node mask */
+#define THREADM_NODEMASK_WORD_BITS (8 * sizeof(unsigned long))
+
+/* # of CPUs which can be represented in both a cpu_set_t and a topology */
+#define THREADM_AFFINITY_CPUS \
+  ((size_t)RCSW_MIN(CPU_SETSIZE, RCSW_THREADM_MAX_CPUS))
+
+/*******************************************************************************
+ * Structure Definitions
+ ******************************************************************************/
+/* A threadm_pool_parallel_for() call */
+struct threadm_pfor {
+  struct threadm_pool* pool;
+  struct threadm_group group;
+  void (*fn)(size_t lo, size_t hi, void* arg);
+  void* arg;
+  size_t grain;
+};
+
+/* Part of a threadm_pool_parallel_for() range split off as a task */
+struct threadm_pfor_task {
+  struct threadm_task task;
+  struct threadm_pfor* pfor;
+  size_t lo;
+  size_t hi;
+};
+
+/*******************************************************************************
+ * Global Variables
+ ******************************************************************************/
+/* The worker the calling thread is, if it is a pool worker */
+static __thread struct threadm_worker* tl_worker;
 
 /*******************************************************************************
  * Forward Declarations
@@ -25,7 +91,357 @@
 BEGIN_C_DECLS
 
 /*******************************************************************************
- * Functions
+ * Private Functions
+ ******************************************************************************/
+static void threadm_bitset_set(uint64_t* set, size_t bit) {
+  set[bit / 64] |= UINT64_C(1) << (bit % 64);
+} /* threadm_bitset_set() */
+
+static bool_t threadm_bitset_test(const uint64_t* set, size_t bit) {
+  return (set[bit / 64] >> (bit % 64)) & 1;
+} /* threadm_bitset_test() */
+
+/**
+ * \brief Parse a sysfs CPU list (e.g., "0-3,8,10-11") into a bitset. CPUs with
+ * IDs past \ref RCSW_THREADM_MAX_CPUS are ignored.
+ */
+static void threadm_cpulist_parse(const char* str, uint64_t* set) {
+  while (*str != '\0' && *str != '\n') {
+    char* end = NULL;
+    size_t lo = strtoul(str, &end, 10);
+    size_t hi = lo;
+    if (end == str) {
+      return;
+    }
+    if ('-' == *end) {
+      str = end + 1;
+      hi = strtoul(str, &end, 10);
+    }
+    for (size_t cpu = lo; cpu <= hi && cpu < RCSW_THREADM_MAX_CPUS; ++cpu) {
+      threadm_bitset_set(set, cpu);
+    } /* for(cpu..) */
+    str = (',' == *end) ? end + 1 : end;
+  } /* while() */
+} /* threadm_cpulist_parse() */
+
+/**
+ * \brief Read a CPU list from a sysfs file into a bitset.
+ */
+static status_t threadm_cpulist_read(const char* path, uint64_t* set) {
+  char buf[4096];
+  FILE* f = fopen(path, "r");
+  if (NULL == f) {
+    return ERROR;
+  }
+  char* line = fgets(buf, sizeof(buf), f);
+  fclose(f);
+  if (NULL == line) {
+    return ERROR;
+  }
+  threadm_cpulist_parse(line, set);
+  return OK;
+} /* threadm_cpulist_read() */
+
+static void threadm_topology_add(struct threadm_topology* topo,
+                                 size_t id,
+                                 const uint64_t* cpus,
+                                 const uint64_t* usable) {
+  struct threadm_numa_node* node = &topo->nodes[topo->n_nodes];
+  node->id = id;
+  node->n_cpus = 0;
+  for (size_t i = 0; i < RCSW_THREADM_MAX_CPUS / 64; ++i) {
+    node->cpus[i] = cpus[i] & usable[i];
+    node->n_cpus += (size_t)__builtin_popcountll(node->cpus[i]);
+  } /* for(i..) */
+
+  /* no point in keeping nodes we can't run on (e.g., memory-only nodes) */
+  if (node->n_cpus > 0) {
+    topo->n_nodes++;
+  }
+} /* threadm_topology_add() */
+
+static int threadm_numa_node_cmp(const void* a, const void* b) {
+  size_t id1 = ((const struct threadm_numa_node*)a)->id;
+  size_t id2 = ((const struct threadm_numa_node*)b)->id;
+  return (id1 > id2) - (id1 < id2);
+} /* threadm_numa_node_cmp() */
+
+static status_t threadm_deque_push(struct threadm_deque* deque,
+                                   struct threadm_task* task) {
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+  if ((size_t)(bottom - top) > deque->mask) {
+    return ERROR;
+  }
+  __atomic_store_n(&deque->tasks[bottom & deque->mask],
+                   task,
+                   __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+  return OK;
+} /* threadm_deque_push() */
+
+static struct threadm_task* threadm_deque_take(struct threadm_deque* deque) {
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+  if (top > bottom) {
+    /* empty */
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  struct threadm_task* task = __atomic_load_n(&deque->tasks[bottom &
+                                                            deque->mask],
+                                              __ATOMIC_RELAXED);
+  if (top == bottom) {
+    /* last task: race thieves for it */
+    if (!__atomic_compare_exchange_n(&deque->top,
+                                     &top,
+                                     top + 1,
+                                     false,
+                                     __ATOMIC_SEQ_CST,
+                                     __ATOMIC_RELAXED)) {
+      task = NULL;
+    }
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+  }
+  return task;
+} /* threadm_deque_take() */
+
+static struct threadm_task* threadm_deque_steal(struct threadm_deque* deque) {
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+  if (top >= bottom) {
+    return NULL;
+  }
+  struct threadm_task* task = __atomic_load_n(&deque->tasks[top & deque->mask],
+                                              __ATOMIC_RELAXED);
+  if (!__atomic_compare_exchange_n(&deque->top,
+                                   &top,
+                                   top + 1,
+                                   false,
+                                   __ATOMIC_SEQ_CST,
+                                   __ATOMIC_RELAXED)) {
+    /* lost the race to another thief or the owner */
+    return NULL;
+  }
+  return task;
+} /* threadm_deque_steal() */
+
+static bool_t threadm_deque_isempty(const struct threadm_deque* deque) {
+  return __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) <=
+      __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+} /* threadm_deque_isempty() */
+
+/**
+ * \brief Wake up an idle worker after making a task available.
+ */
+static void threadm_pool_notify(struct threadm_pool* pool) {
+  __atomic_fetch_add(&pool->events, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&pool->n_sleepers, __ATOMIC_SEQ_CST) > 0) {
+    futex_wake(&pool->events, 1);
+  }
+} /* threadm_pool_notify() */
+
+static void threadm_task_run(struct threadm_task* task) {
+  /* the task can free itself */
+  struct threadm_group* group = task->group;
+
+  task->fn(task->arg);
+  if (NULL != group &&
+      1 == __atomic_fetch_sub(&group->n_pending, 1, __ATOMIC_ACQ_REL)) {
+    futex_wake(&group->n_pending, INT_MAX);
+  }
+} /* threadm_task_run() */
+
+/**
+ * \brief Find a task to run: from the calling worker's own deque, then from
+ * the queue of tasks submitted from outside the pool, then by stealing from a
+ * randomly chosen worker.
+ */
+static struct threadm_task* threadm_pool_find(struct threadm_pool* pool,
+                                              struct threadm_worker* self) {
+  struct threadm_task* task = NULL;
+
+  if (NULL != self && NULL != (task = threadm_deque_take(&self->deque))) {
+    return task;
+  }
+  if (OK == pcqueue_trypop(&pool->queue, &task)) {
+    return task;
+  }
+
+  size_t start = 0;
+  if (NULL != self) {
+    /* xorshift */
+    self->rng ^= self->rng << 13;
+    self->rng ^= self->rng >> 7;
+    self->rng ^= self->rng << 17;
+    start = self->rng % pool->n_workers;
+  }
+  for (size_t i = 0; i < pool->n_workers; ++i) {
+    struct threadm_worker* victim = &pool->workers[(start + i) %
+                                                   pool->n_workers];
+    if (victim == self) {
+      continue;
+    }
+    if (NULL != (task = threadm_deque_steal(&victim->deque))) {
+      if (NULL != self) {
+        self->n_steals++;
+      }
+      return task;
+    }
+  } /* for(i..) */
+  return NULL;
+} /* threadm_pool_find() */
+
+static bool_t threadm_pool_run_one(struct threadm_pool* pool,
+                                   struct threadm_worker* self) {
+  struct threadm_task* task = threadm_pool_find(pool, self);
+  if (NULL == task) {
+    return false;
+  }
+  threadm_task_run(task);
+  if (NULL != self) {
+    self->n_executed++;
+  }
+  return true;
+} /* threadm_pool_run_one() */
+
+static void* threadm_worker_main(void* arg) {
+  struct threadm_worker* self = arg;
+  struct threadm_pool* pool = self->pool;
+  tl_worker = self;
+
+  for (;;) {
+    if (threadm_pool_run_one(pool, self)) {
+      continue;
+    }
+    /*
+     * Read the event count before looking for tasks one last time: if a task
+     * is submitted after we look, the count will have changed and the wait
+     * returns immediately.
+     */
+    uint32_t events = __atomic_load_n(&pool->events, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    if (threadm_pool_run_one(pool, self)) {
+      continue;
+    }
+    __atomic_fetch_add(&pool->n_sleepers, 1, __ATOMIC_SEQ_CST);
+    futex_wait(&pool->events, events, NULL);
+    __atomic_fetch_sub(&pool->n_sleepers, 1, __ATOMIC_RELAXED);
+  } /* for(;;) */
+  return NULL;
+} /* threadm_worker_main() */
+
+/**
+ * \brief Pin the workers to cores spread across the NUMA nodes.
+ */
+static status_t threadm_pool_pin(struct threadm_pool* pool,
+                                 size_t core_offset) {
+  size_t n_cpus = core_offset + pool->n_workers;
+  struct threadm_topology* topo = rcsw_alloc(NULL, sizeof(*topo), RCSW_NONE);
+  size_t* cpus = rcsw_alloc(NULL, n_cpus * sizeof(size_t), RCSW_NONE);
+  RCSW_CHECK_PTR(topo);
+  RCSW_CHECK_PTR(cpus);
+  RCSW_CHECK(OK == threadm_topology_discover(topo));
+  RCSW_CHECK(n_cpus == threadm_cpus_spread(topo, cpus, n_cpus));
+
+  for (size_t i = 0; i < pool->n_workers; ++i) {
+    size_t core = cpus[core_offset + i];
+    ER_CHECK(OK == threadm_core_lock(pool->workers[i].thread, core),
+             "Failed to pin worker %zu to core %zu",
+             i,
+             core);
+    ER_DEBUG("Pinned worker %zu to core %zu on node %d",
+             i,
+             core,
+             threadm_cpu_node(topo, core));
+  } /* for(i..) */
+  rcsw_free(cpus, RCSW_NONE);
+  rcsw_free(topo, RCSW_NONE);
+  return OK;
+
+error:
+  if (NULL != cpus) {
+    rcsw_free(cpus, RCSW_NONE);
+  }
+  if (NULL != topo) {
+    rcsw_free(topo, RCSW_NONE);
+  }
+  return ERROR;
+} /* threadm_pool_pin() */
+
+static size_t threadm_n_cores(void) {
+  cpu_set_t allowed;
+  if (0 != sched_getaffinity(0, sizeof(allowed), &allowed)) {
+    return 1;
+  }
+  return (size_t)RCSW_MAX(CPU_COUNT(&allowed), 1);
+} /* threadm_n_cores() */
+
+static void threadm_pfor_run(struct threadm_pfor* pfor, size_t lo, size_t hi);
+
+static void threadm_pfor_task_run(void* arg) {
+  struct threadm_pfor_task* ptask = arg;
+  struct threadm_pfor* pfor = ptask->pfor;
+  size_t lo = ptask->lo;
+  size_t hi = ptask->hi;
+
+  rcsw_free(ptask, RCSW_NONE);
+  threadm_pfor_run(pfor, lo, hi);
+} /* threadm_pfor_task_run() */
+
+/**
+ * \brief Is anyone taking work handed off by the calling thread? If its
+ * previous hand-offs are still queued, splitting again would only create
+ * tasks it ends up running itself.
+ */
+static bool_t threadm_pfor_hungry(const struct threadm_pool* pool) {
+  if (NULL != tl_worker && tl_worker->pool == pool) {
+    return threadm_deque_isempty(&tl_worker->deque);
+  }
+  return pcqueue_isempty(&pool->queue);
+} /* threadm_pfor_hungry() */
+
+/**
+ * \brief Run the part [lo, hi) of a parallel_for() range, handing off the
+ * upper half of what is left whenever other threads are hungry for work.
+ */
+static void threadm_pfor_run(struct threadm_pfor* pfor, size_t lo, size_t hi) {
+  while (hi - lo > pfor->grain) {
+    if (hi - lo >= 2 * pfor->grain && threadm_pfor_hungry(pfor->pool)) {
+      struct threadm_pfor_task* ptask = rcsw_alloc(NULL,
+                                                   sizeof(*ptask),
+                                                   RCSW_NONE);
+      if (NULL != ptask) {
+        size_t mid = lo + (hi - lo) / 2;
+        ptask->task.fn = threadm_pfor_task_run;
+        ptask->task.arg = ptask;
+        ptask->pfor = pfor;
+        ptask->lo = mid;
+        ptask->hi = hi;
+        hi = mid;
+        threadm_pool_submit(pfor->pool, &pfor->group, &ptask->task);
+        continue;
+      }
+    }
+    pfor->fn(lo, lo + pfor->grain, pfor->arg);
+    lo += pfor->grain;
+  } /* while() */
+  if (lo < hi) {
+    pfor->fn(lo, hi, pfor->arg);
+  }
+} /* threadm_pfor_run() */
+
+/*******************************************************************************
+ * API Functions
  ******************************************************************************/
 status_t threadm_core_lock(pthread_t thread, size_t core) {
   cpu_set_t cpuset;
@@ -39,4 +455,401 @@ error:
   return ERROR;
 } /* threadm_core_lock() */
 
+status_t threadm_topology_discover(struct threadm_topology* topo) {
+  RCSW_FPC_NV(ERROR, NULL != topo);
+  uint64_t usable[RCSW_THREADM_MAX_CPUS / 64] = {0};
+  uint64_t cpus[RCSW_THREADM_MAX_CPUS / 64];
+
+  memset(topo, 0, sizeof(*topo));
+  for (size_t i = 0; i < RCSW_THREADM_MAX_CPUS; ++i) {
+    topo->cpu_node[i] = -1;
+  } /* for(i..) */
+
+  /* CPUs we are allowed to run on, which are also online */
+  cpu_set_t allowed;
+  RCSW_CHECK(0 == sched_getaffinity(0, sizeof(allowed), &allowed));
+  for (size_t i = 0; i < THREADM_AFFINITY_CPUS; ++i) {
+    if (CPU_ISSET(i, &allowed)) {
+      threadm_bitset_set(usable, i);
+    }
+  } /* for(i..) */
+  memset(cpus, 0, sizeof(cpus));
+  if (OK == threadm_cpulist_read("/sys/devices/system/cpu/online", cpus)) {
+    for (size_t i = 0; i < RCSW_THREADM_MAX_CPUS / 64; ++i) {
+      usable[i] &= cpus[i];
+    } /* for(i..) */
+  }
+
+#if defined(__linux__)
+  DIR* dir = opendir("/sys/devices/system/node");
+  struct dirent* ent = NULL;
+  while (NULL != dir && NULL != (ent = readdir(dir)) &&
+         topo->n_nodes < RCSW_THREADM_MAX_NODES) {
+    size_t id = 0;
+    char extra = '\0';
+    if (1 != sscanf(ent->d_name, "node%zu%c", &id, &extra)) {
+      continue;
+    }
+    char path[PATH_MAX];
+    snprintf(path,
+             sizeof(path),
+             "/sys/devices/system/node/%s/cpulist",
+             ent->d_name);
+    memset(cpus, 0, sizeof(cpus));
+    if (OK == threadm_cpulist_read(path, cpus)) {
+      threadm_topology_add(topo, id, cpus, usable);
+    }
+  } /* while() */
+  if (NULL != dir) {
+    closedir(dir);
+  }
+  qsort(topo->nodes,
+        topo->n_nodes,
+        sizeof(struct threadm_numa_node),
+        threadm_numa_node_cmp);
+#endif
+
+  if (0 == topo->n_nodes) {
+    /* no NUMA information: one node with everything */
+    threadm_topology_add(topo, 0, usable, usable);
+  }
+  for (size_t i = 0; i < topo->n_nodes; ++i) {
+    for (size_t cpu = 0; cpu < RCSW_THREADM_MAX_CPUS; ++cpu) {
+      if (threadm_bitset_test(topo->nodes[i].cpus, cpu)) {
+        topo->cpu_node[cpu] = (int16_t)i;
+      }
+    } /* for(cpu..) */
+    topo->n_cpus += topo->nodes[i].n_cpus;
+  } /* for(i..) */
+  ER_CHECK(topo->n_cpus > 0, "No usable CPUs found");
+
+  ER_DEBUG("Found %zu NUMA nodes with %zu usable CPUs",
+           topo->n_nodes,
+           topo->n_cpus);
+  return OK;
+
+error:
+  return ERROR;
+} /* threadm_topology_discover() */
+
+int threadm_cpu_node(const struct threadm_topology* topo, size_t cpu) {
+  RCSW_FPC_NV(-1, NULL != topo);
+  if (cpu >= RCSW_THREADM_MAX_CPUS) {
+    return -1;
+  }
+  return topo->cpu_node[cpu];
+} /* threadm_cpu_node() */
+
+size_t threadm_node_current(const struct threadm_topology* topo) {
+  RCSW_FPC_NV(0, NULL != topo);
+  int cpu = sched_getcpu();
+  int node = (cpu >= 0) ? threadm_cpu_node(topo, (size_t)cpu) : -1;
+  return (node >= 0) ? (size_t)node : 0;
+} /* threadm_node_current() */
+
+status_t threadm_node_lock(pthread_t thread,
+                           const struct threadm_topology* topo,
+                           size_t node) {
+  RCSW_FPC_NV(ERROR, NULL != topo, node < topo->n_nodes);
+  cpu_set_t cpuset;
+
+  CPU_ZERO(&cpuset);
+  for (size_t cpu = 0; cpu < THREADM_AFFINITY_CPUS; ++cpu) {
+    if (threadm_bitset_test(topo->nodes[node].cpus, cpu)) {
+      CPU_SET(cpu, &cpuset);
+    }
+  } /* for(cpu..) */
+  RCSW_CHECK(0 == pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset));
+  return OK;
+
+error:
+  return ERROR;
+} /* threadm_node_lock() */
+
+size_t threadm_cpus_spread(const struct threadm_topology* topo,
+                           size_t* cpus,
+                           size_t n_cpus) {
+  RCSW_FPC_NV(0, NULL != topo, NULL != cpus);
+  if (0 == topo->n_cpus) {
+    return 0;
+  }
+  /* where to continue looking for the next CPU on each node */
+  size_t next[RCSW_THREADM_MAX_NODES] = {0};
+  size_t n = 0;
+
+  while (n < n_cpus) {
+    bool_t found = false;
+    for (size_t i = 0; i < topo->n_nodes && n < n_cpus; ++i) {
+      while (next[i] < RCSW_THREADM_MAX_CPUS &&
+             !threadm_bitset_test(topo->nodes[i].cpus, next[i])) {
+        ++next[i];
+      } /* while() */
+      if (next[i] < RCSW_THREADM_MAX_CPUS) {
+        cpus[n++] = next[i]++;
+        found = true;
+      }
+    } /* for(i..) */
+
+    /* used every CPU; start over */
+    if (!found) {
+      memset(next, 0, sizeof(next));
+    }
+  } /* while() */
+  return n;
+} /* threadm_cpus_spread() */
+
+void* threadm_numa_alloc(const struct threadm_topology* topo,
+                         size_t node,
+                         size_t size) {
+  RCSW_FPC_NV(NULL, NULL != topo, node < topo->n_nodes, size > 0);
+
+  void* ptr = mmap(NULL,
+                   size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1,
+                   0);
+  ER_CHECK(MAP_FAILED != ptr, "Failed to map %zu bytes", size);
+
+  if (OK != threadm_numa_bind(topo, node, ptr, size)) {
+    ER_DEBUG("Failed to bind %zu bytes to node %zu: using default placement",
+             size,
+             topo->nodes[node].id);
+  }
+  return ptr;
+
+error:
+  return NULL;
+} /* threadm_numa_alloc() */
+
+void threadm_numa_free(void* ptr, size_t size) {
+  RCSW_FPC_V(NULL != ptr);
+  munmap(ptr, size);
+} /* threadm_numa_free() */
+
+status_t threadm_numa_bind(const struct threadm_topology* topo,
+                           size_t node,
+                           void* addr,
+                           size_t len) {
+  RCSW_FPC_NV(ERROR, NULL != topo, node < topo->n_nodes, NULL != addr);
+#if defined(__linux__)
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)addr + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)addr + len) & ~(page - 1);
+  if (start >= end) {
+    return OK;
+  }
+
+  unsigned long mask[THREADM_NODEMASK_BITS / THREADM_NODEMASK_WORD_BITS] = {0};
+  size_t id = topo->nodes[node].id;
+  ER_CHECK(id < THREADM_NODEMASK_BITS, "Node ID %zu too large", id);
+  mask[id / THREADM_NODEMASK_WORD_BITS] |= 1UL << (id %
+                                                   THREADM_NODEMASK_WORD_BITS);
+
+  /* preferred rather than bound, so faults can't fail if the node is full */
+  RCSW_CHECK(0 == syscall(SYS_mbind,
+                          (void*)start,
+                          end - start,
+                          MPOL_PREFERRED,
+                          mask,
+                          THREADM_NODEMASK_BITS,
+                          0));
+  return OK;
+
+error:
+  return ERROR;
+#else
+  (void)len;
+  return ERROR;
+#endif
+} /* threadm_numa_bind() */
+
+struct threadm_pool* threadm_pool_init(
+    struct threadm_pool* pool_in,
+    const struct threadm_pool_params* params) {
+  RCSW_FPC_NV(NULL,
+              NULL != params,
+              params->deque_size > 0,
+              params->queue_size > 0);
+  RCSW_ER_MODULE_INIT();
+
+  struct threadm_pool* pool = rcsw_alloc(pool_in,
+                                         sizeof(struct threadm_pool),
+                                         params->flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(pool);
+  pool->flags = params->flags;
+  pool->events = 0;
+  pool->n_sleepers = 0;
+  pool->stop = 0;
+  pool->n_workers = (0 == params->n_threads) ? threadm_n_cores()
+                                             : params->n_threads;
+  pool->workers = NULL;
+
+  struct pcqueue_params qparams = {
+    .elt_size = sizeof(struct threadm_task*),
+    .max_elts = params->queue_size,
+    .flags = RCSW_NOALLOC_HANDLE | RCSW_PCQUEUE_MPMC
+  };
+  if (NULL == pcqueue_init(&pool->queue, &qparams)) {
+    ER_ERR("Failed to initialize task queue");
+    rcsw_free(pool, pool->flags & RCSW_NOALLOC_HANDLE);
+    return NULL;
+  }
+
+  size_t deque_size = 1;
+  while (deque_size < params->deque_size) {
+    deque_size <<= 1;
+  } /* while() */
+
+  pool->workers = rcsw_alloc(NULL,
+                             pool->n_workers * sizeof(struct threadm_worker),
+                             RCSW_ZALLOC);
+  RCSW_CHECK_PTR(pool->workers);
+  for (size_t i = 0; i < pool->n_workers; ++i) {
+    struct threadm_worker* worker = &pool->workers[i];
+    worker->pool = pool;
+    worker->index = i;
+    worker->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+    worker->deque.mask = deque_size - 1;
+    worker->deque.tasks = rcsw_alloc(NULL,
+                                     deque_size * sizeof(struct threadm_task*),
+                                     RCSW_ZALLOC);
+    RCSW_CHECK_PTR(worker->deque.tasks);
+  } /* for(i..) */
+
+  for (size_t i = 0; i < pool->n_workers; ++i) {
+    struct threadm_worker* worker = &pool->workers[i];
+    if (0 != pthread_create(&worker->thread,
+                            NULL,
+                            threadm_worker_main,
+                            worker)) {
+      ER_ERR("Failed to start worker %zu", i);
+      goto error;
+    }
+  } /* for(i..) */
+
+  if (pool->flags & RCSW_THREADM_POOL_PIN) {
+    RCSW_CHECK(OK == threadm_pool_pin(pool, params->core_offset));
+  }
+  ER_DEBUG("Initialized thread pool: n_workers=%zu, deque_size=%zu, "
+           "queue_size=%zu, flags=0x%08x",
+           pool->n_workers,
+           deque_size,
+           params->queue_size,
+           pool->flags);
+  return pool;
+
+error:
+  threadm_pool_destroy(pool);
+  return NULL;
+} /* threadm_pool_init() */
+
+void threadm_pool_destroy(struct threadm_pool* pool) {
+  RCSW_FPC_V(NULL != pool);
+
+  __atomic_store_n(&pool->stop, 1, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&pool->events, 1, __ATOMIC_SEQ_CST);
+  futex_wake(&pool->events, INT_MAX);
+
+  if (NULL != pool->workers) {
+    for (size_t i = 0; i < pool->n_workers; ++i) {
+      /* workers which failed to start are still zeroed */
+      if (0 != pool->workers[i].thread) {
+        pthread_join(pool->workers[i].thread, NULL);
+      }
+    } /* for(i..) */
+    for (size_t i = 0; i < pool->n_workers; ++i) {
+      if (NULL != pool->workers[i].deque.tasks) {
+        rcsw_free(pool->workers[i].deque.tasks, RCSW_NONE);
+      }
+    } /* for(i..) */
+    rcsw_free(pool->workers, RCSW_NONE);
+  }
+  pcqueue_destroy(&pool->queue);
+  rcsw_free(pool, pool->flags & RCSW_NOALLOC_HANDLE);
+} /* threadm_pool_destroy() */
+
+status_t threadm_pool_submit(struct threadm_pool* pool,
+                             struct threadm_group* group,
+                             struct threadm_task* task) {
+  RCSW_FPC_NV(ERROR, NULL != pool, NULL != task, NULL != task->fn);
+
+  task->group = group;
+  if (NULL != group) {
+    __atomic_fetch_add(&group->n_pending, 1, __ATOMIC_RELAXED);
+  }
+
+  struct threadm_worker* self = tl_worker;
+  status_t rstat = ERROR;
+  if (NULL != self && self->pool == pool) {
+    rstat = threadm_deque_push(&self->deque, task);
+  } else {
+    rstat = pcqueue_trypush(&pool->queue, &task);
+  }
+
+  if (OK == rstat) {
+    threadm_pool_notify(pool);
+  } else {
+    /* no room: run it ourselves rather than block */
+    ER_TRACE("Task queue full: running task %p inline", (void*)task);
+    threadm_task_run(task);
+  }
+  return OK;
+} /* threadm_pool_submit() */
+
+status_t threadm_pool_wait(struct threadm_pool* pool,
+                           struct threadm_group* group) {
+  RCSW_FPC_NV(ERROR, NULL != pool, NULL != group);
+  struct threadm_worker* self = (NULL != tl_worker && tl_worker->pool == pool)
+                                ? tl_worker
+                                : NULL;
+
+  for (;;) {
+    uint32_t pending = __atomic_load_n(&group->n_pending, __ATOMIC_ACQUIRE);
+    if (0 == pending) {
+      return OK;
+    }
+    if (threadm_pool_run_one(pool, self)) {
+      continue;
+    }
+    /*
+     * The remaining tasks are running on other threads. Sleep until the last
+     * one finishes, waking up periodically in case they submit more tasks
+     * that no one else is free to run.
+     */
+    struct timespec abs = clock_monotime();
+    struct timespec to = {.tv_sec = 0, .tv_nsec = THREADM_WAIT_NS};
+    time_ts_add(&abs, &to);
+    if (OK != futex_wait(&group->n_pending, pending, &abs) &&
+        ETIMEDOUT != errno) {
+      return ERROR;
+    }
+  } /* for(;;) */
+} /* threadm_pool_wait() */
+
+status_t threadm_pool_parallel_for(struct threadm_pool* pool,
+                                   size_t begin,
+                                   size_t end,
+                                   size_t grain,
+                                   void (*fn)(size_t lo, size_t hi, void* arg),
+                                   void* arg) {
+  RCSW_FPC_NV(ERROR, NULL != pool, NULL != fn, begin <= end);
+
+  if (0 == grain) {
+    grain = (end - begin) / (pool->n_workers * THREADM_CHUNKS_PER_WORKER);
+    grain = RCSW_MAX(grain, (size_t)1);
+  }
+  struct threadm_pfor pfor = {
+    .pool = pool,
+    .group = {.n_pending = 0},
+    .fn = fn,
+    .arg = arg,
+    .grain = grain
+  };
+
+  /* the calling thread works on the range too */
+  threadm_pfor_run(&pfor, begin, end);
+  return threadm_pool_wait(pool, &pfor.group);
+} /* threadm_pool_parallel_for() */
+
 END_C_DECLS
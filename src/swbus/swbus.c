@@ -11,60 +11,1090 @@
  ******************************************************************************/
 #include "rcsw/swbus/swbus.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+
 #define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "swb")
 #define RCSW_ER_MODID ekLOG4CL_SWBUS
 #include "rcsw/er/client.h"
 #include "rcsw/common/fpc.h"
 #include "rcsw/common/alloc.h"
+#include "rcsw/al/clock.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/utils/time.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/*
+ * # of old subscription tables each thread can have waiting to be freed with
+ * RCSW_SWBUS_LOCKFREE.
+ */
+#define RCSW_SWBUS_RETIRE_MAX 8
+
+/* Atomically raise a statistic to at least a value */
+#define SWBUS_STAT_MAX_UPDATE(max, val)                                 \
+  do {                                                                  \
+    __typeof__(*(max)) cur = __atomic_load_n((max), __ATOMIC_RELAXED);  \
+    while ((val) > cur &&                                               \
+           !__atomic_compare_exchange_n((max),                          \
+                                        &cur,                           \
+                                        (val),                          \
+                                        true,                           \
+                                        __ATOMIC_RELAXED,               \
+                                        __ATOMIC_RELAXED)) {            \
+    }                                                                   \
+  } while (0)
 
 /*******************************************************************************
  * Private Functions
  ******************************************************************************/
+static struct swbus_rxq_info* swbus_rxq_info_get(const struct swbus* swb,
+                                                 const struct pcqueue* queue) {
+  if (queue < swb->rxqs || queue >= swb->rxqs + swb->max_rxqs) {
+    return NULL;
+  }
+  return &swb->rxq_infos[queue - swb->rxqs];
+} /* swbus_rxq_info_get() */
+
+/**
+ * \brief Get a timestamp for delivery latency measurement/tracing, in
+ * nanoseconds, or 0 if neither is enabled.
+ */
+static uint64_t swbus_now(const struct swbus* swb) {
+  bool_t traced = false;
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  traced = true;
+#endif
+  if (!traced && !(swb->flags & RCSW_SWBUS_LATENCY)) {
+    return 0;
+  }
+  struct timespec now = clock_monotime();
+  return time_ts2monons(&now);
+} /* swbus_now() */
+
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+/**
+ * \brief Get the latency histograms for a PID, claiming a free slot for it if
+ * \p claim is true and it does not have one.
+ *
+ * \return The slot, or NULL if the PID has no slot and could not get one.
+ */
+static struct swbus_trace* swbus_trace_get(const struct swbus* swb,
+                                           uint32_t pid,
+                                           bool_t claim) {
+  size_t start = (pid * 2654435761U) % RCSW_SWBUS_TRACE_MAX_PIDS;
+
+  for (size_t i = 0; i < RCSW_SWBUS_TRACE_MAX_PIDS; ++i) {
+    struct swbus_trace* trace = &swb->traces[(start + i) %
+                                             RCSW_SWBUS_TRACE_MAX_PIDS];
+    uint32_t state = __atomic_load_n(&trace->state, __ATOMIC_ACQUIRE);
+
+    if (0 == state) {
+      if (!claim) {
+        return NULL;
+      }
+      if (__atomic_compare_exchange_n(&trace->state,
+                                      &state,
+                                      1,
+                                      false,
+                                      __ATOMIC_ACQUIRE,
+                                      __ATOMIC_ACQUIRE)) {
+        trace->stats.pid = pid;
+        __atomic_store_n(&trace->state, 2, __ATOMIC_RELEASE);
+        return trace;
+      }
+    }
+    /* another thread is claiming the slot; wait to see which PID it gets */
+    while (1 == state) {
+      RCSW_CPU_RELAX();
+      state = __atomic_load_n(&trace->state, __ATOMIC_ACQUIRE);
+    } /* while() */
+
+    if (pid == trace->stats.pid) {
+      return trace;
+    }
+  } /* for(i..) */
+  return NULL;
+} /* swbus_trace_get() */
+
+/**
+ * \brief Record the latencies for a received packet in the histograms for its
+ * PID.
+ */
+static void swbus_trace_record(struct swbus* swb,
+                               const struct swbus_rxq_ent* ent) {
+  struct swbus_trace* trace = swbus_trace_get(swb, ent->pid, true);
+  if (NULL == trace) {
+    return;
+  }
+  grind_hist_record(&trace->stats.queue, ent->dequeued_at - ent->released_at);
+
+  /* manually created reservations do not have to be timestamped */
+  if (0 != ent->reserved_at && ent->reserved_at <= ent->released_at) {
+    grind_hist_record(&trace->stats.publish,
+                      ent->released_at - ent->reserved_at);
+    grind_hist_record(&trace->stats.total,
+                      ent->dequeued_at - ent->reserved_at);
+  }
+} /* swbus_trace_record() */
+#endif
+
+/**
+ * \brief Report the latency histograms for a single traced PID.
+ */
+static void swbus_trace_report_pid(const struct swbus_trace_stats* stats,
+                                   RCSW_UNUSED void* arg) {
+  char name[RCSW_GRINDEE_NAMELEN];
+  snprintf(name, sizeof(name), "PID %u publish", stats->pid);
+  grind_hist_report(name, &stats->publish);
+  snprintf(name, sizeof(name), "PID %u queue", stats->pid);
+  grind_hist_report(name, &stats->queue);
+  snprintf(name, sizeof(name), "PID %u total", stats->pid);
+  grind_hist_report(name, &stats->total);
+} /* swbus_trace_report_pid() */
+
+/**
+ * \brief Account for the delivery latency of packets received from an RXQ.
+ */
+static void swbus_rxq_received(struct swbus* swb,
+                               struct pcqueue* queue,
+                               struct swbus_rxq_ent* ents,
+                               size_t n_ents) {
+  struct swbus_rxq_info* info = swbus_rxq_info_get(swb, queue);
+  uint64_t now = swbus_now(swb);
+  if (NULL == info || 0 == now) {
+    return;
+  }
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  for (size_t i = 0; i < n_ents; ++i) {
+    ents[i].dequeued_at = now;
+    if (0 != ents[i].released_at) {
+      swbus_trace_record(swb, &ents[i]);
+    }
+  } /* for(i..) */
+#endif
+  if (!(swb->flags & RCSW_SWBUS_LATENCY)) {
+    return;
+  }
+  struct swbus_rxq_stats* stats = &info->stats;
+  uint64_t total = 0;
+  uint64_t max = 0;
+  size_t n_measured = 0;
+  for (size_t i = 0; i < n_ents; ++i) {
+    /* published before latency measurement was enabled */
+    if (0 == ents[i].released_at) {
+      continue;
+    }
+    uint64_t latency = now - ents[i].released_at;
+    total += latency;
+    max = RCSW_MAX(max, latency);
+    ++n_measured;
+  } /* for(i..) */
+
+  __atomic_fetch_add(&stats->n_delivered, n_measured, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats->latency_total, total, __ATOMIC_RELAXED);
+  SWBUS_STAT_MAX_UPDATE(&stats->latency_max, max);
+} /* swbus_rxq_received() */
+
+static bool_t swbus_rxq_ent_match(const void* elt, const void* e) {
+  return ((const struct swbus_rxq_ent*)elt)->pid ==
+      ((const struct swbus_rxq_ent*)e)->pid;
+} /* swbus_rxq_ent_match() */
+
+/**
+ * \brief Push a packet to an RXQ without waiting for space, according to the
+ * RXQ's overflow policy. The reference to the packet's buffer for the RXQ must
+ * already have been added, and is removed if the packet is dropped.
+ *
+ * \param n_drops Incremented by the # of packets dropped: the packet itself,
+ *                or packets removed from the RXQ to make space for it.
+ *
+ * \return TRUE if the packet was added to the RXQ, FALSE if it was dropped.
+ */
+static bool_t swbus_rxq_trypush(struct pcqueue* queue,
+                                enum swbus_rxq_policy policy,
+                                const struct swbus_rxq_ent* ent,
+                                size_t* n_drops) {
+  struct swbus_rxq_ent old;
+
+  if (ekSWBUS_RXQ_CONFLATE == policy &&
+      OK == pcqueue_tryreplace(queue, ent, swbus_rxq_ent_match, &old)) {
+    mpool_release(old.bp, old.data);
+    ++*n_drops;
+    return true;
+  }
+  while (OK != pcqueue_trypush(queue, ent)) {
+    if (ekSWBUS_RXQ_DROP_OLDEST != policy) {
+      mpool_ref_remove(ent->bp, ent->data);
+      ++*n_drops;
+      return false;
+    }
+    /* the subscriber may have made space itself in the meantime */
+    if (OK == pcqueue_trypop(queue, &old)) {
+      mpool_release(old.bp, old.data);
+      ++*n_drops;
+    }
+  } /* while() */
+  return true;
+} /* swbus_rxq_trypush() */
+
+/**
+ * \brief Wake up anyone waiting on the set an RXQ belongs to, after pushing
+ * packets to the RXQ.
+ */
+static void swbus_rxq_set_signal(struct swbus_rxq_info* info) {
+  if (NULL == __atomic_load_n(&info->set, __ATOMIC_RELAXED)) {
+    return;
+  }
+  /*
+   * Announce ourselves before re-reading the set, so that removing the RXQ
+   * from the set either makes us see NULL or waits for us to finish.
+   */
+  __atomic_fetch_add(&info->n_signalers, 1, __ATOMIC_SEQ_CST);
+  struct swbus_rxq_set* set = __atomic_load_n(&info->set, __ATOMIC_SEQ_CST);
+  if (NULL != set) {
+    __atomic_fetch_add(&set->events, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&set->n_waiters, __ATOMIC_SEQ_CST) > 0) {
+      futex_wake(&set->events, INT_MAX);
+    }
+  }
+  __atomic_fetch_sub(&info->n_signalers, 1, __ATOMIC_RELEASE);
+} /* swbus_rxq_set_signal() */
+
+/**
+ * \brief Remove an RXQ from whatever set it is in. Called with the bus mutex
+ * held.
+ */
+static void swbus_rxq_set_unlink(struct swbus_rxq_set* set,
+                                 struct swbus_rxq_info* info,
+                                 size_t index) {
+  __atomic_store_n(&info->set, NULL, __ATOMIC_SEQ_CST);
+
+  /* publishers which saw the set before we cleared it */
+  while (0 != __atomic_load_n(&info->n_signalers, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  } /* while() */
+  __atomic_fetch_and(&set->members[index / 64],
+                     ~(UINT64_C(1) << (index % 64)),
+                     __ATOMIC_RELAXED);
+  set->n_members--;
+} /* swbus_rxq_set_unlink() */
+
+/**
+ * \brief Find up to \p max_ready non-empty RXQs in a set, starting after the
+ * last one found by the previous scan.
+ */
+static size_t swbus_rxq_set_scan(struct swbus_rxq_set* set,
+                                 struct pcqueue** ready,
+                                 size_t max_ready) {
+  struct swbus* swb = set->swb;
+  size_t start = __atomic_load_n(&set->next, __ATOMIC_RELAXED) % swb->max_rxqs;
+  size_t n_ready = 0;
+  size_t last = start;
+
+  for (size_t i = 0; i < swb->max_rxqs && n_ready < max_ready; ++i) {
+    size_t index = (start + i) % swb->max_rxqs;
+    uint64_t word = __atomic_load_n(&set->members[index / 64],
+                                    __ATOMIC_RELAXED);
+    if (!(word & (UINT64_C(1) << (index % 64)))) {
+      continue;
+    }
+    if (!pcqueue_isempty(swb->rxqs + index)) {
+      ready[n_ready++] = swb->rxqs + index;
+      last = index;
+    }
+  } /* for(i..) */
+
+  if (n_ready > 0) {
+    __atomic_store_n(&set->next, last + 1, __ATOMIC_RELAXED);
+  }
+  return n_ready;
+} /* swbus_rxq_set_scan() */
+
+static status_t swbus_rxq_set_wait_impl(struct swbus_rxq_set* set,
+                                        struct pcqueue** ready,
+                                        size_t max_ready,
+                                        size_t* n_ready,
+                                        const struct timespec* abs) {
+  for (;;) {
+    /*
+     * Read the event count before checking the RXQs: if a packet arrives
+     * after the check, the count will have changed and the wait returns
+     * immediately.
+     */
+    uint32_t events = __atomic_load_n(&set->events, __ATOMIC_SEQ_CST);
+    *n_ready = swbus_rxq_set_scan(set, ready, max_ready);
+    if (*n_ready > 0) {
+      return OK;
+    }
+    __atomic_fetch_add(&set->n_waiters, 1, __ATOMIC_SEQ_CST);
+    status_t wstat = futex_wait(&set->events, events, abs);
+    __atomic_fetch_sub(&set->n_waiters, 1, __ATOMIC_RELAXED);
 
+    if (OK != wstat) {
+      if (ETIMEDOUT != errno) {
+        return ERROR;
+      }
+      *n_ready = swbus_rxq_set_scan(set, ready, max_ready);
+      if (0 == *n_ready) {
+        errno = ETIMEDOUT;
+        return ERROR;
+      }
+      return OK;
+    }
+  } /* for(;;) */
+} /* swbus_rxq_set_wait_impl() */
+
+/**
+ * \brief Push a run of packets with the same PID to a subscribed RXQ.
+ */
 static status_t swbus_subscriber_notify(struct swbus* swb,
-                                        struct mpool* bp,
-                                        struct swbus_sub* sub,
-                                        struct swbus_rxq_ent* rxq_ent) {
+                                        const struct swbus_sub* sub,
+                                        const struct swbus_rxq_ent* ents,
+                                        size_t n_ents) {
   RCSW_FPC_NV(ERROR,
               NULL != swb,
-              NULL != bp,
               NULL != sub,
               NULL != sub->subscriber,
-              NULL != rxq_ent);
+              NULL != ents);
+  struct swbus_rxq_info* info = swbus_rxq_info_get(swb, sub->subscriber);
+  enum swbus_rxq_policy policy = __atomic_load_n(&info->policy,
+                                                 __ATOMIC_RELAXED);
 
-  ER_TRACE("Notifying RXQ %zu subscribed to PID %d/0x%x on bus '%s', pending=%zu",
+  ER_TRACE("Notifying RXQ %zu subscribed to PID %d/0x%x on bus '%s', "
+           "pending=%zu, n_ents=%zu",
            sub->subscriber - swb->rxqs,
            sub->pid,
            sub->pid,
            swb->name,
-           pcqueue_size(sub->subscriber));
+           pcqueue_size(sub->subscriber),
+           n_ents);
 
-  /* Add entry to subscriber receive queue */
-  if (OK == pcqueue_push(sub->subscriber, rxq_ent)) {
-    /*
-     * Add a reference. This is not done during the reserve step as no
-     * one is actually using the memory at that time.
-     */
-    RCSW_CHECK(OK == mpool_ref_add(bp, rxq_ent->data));
+  /*
+   * Add a reference. This is not done during the reserve step as no one is
+   * actually using the memory at that time. It has to be done before the entry
+   * is visible to the subscriber, so that the subscriber can't release the
+   * chunk out from under us.
+   */
+  size_t n_refs = 0;
+  for (; n_refs < n_ents; ++n_refs) {
+    RCSW_CHECK(OK == mpool_ref_add(ents[n_refs].bp, ents[n_refs].data));
+  } /* for(n_refs..) */
+
+  size_t n_pushed = 0;
+  size_t n_drops = 0;
+  if (ekSWBUS_RXQ_BLOCK == policy) {
+    /* Add entries to subscriber receive queue, taking its lock once */
+    status_t rstat = (1 == n_ents) ? pcqueue_push(sub->subscriber, ents)
+                                   : pcqueue_push_n(sub->subscriber,
+                                                    ents,
+                                                    n_ents);
+    RCSW_CHECK(OK == rstat);
+    n_pushed = n_ents;
+  } else {
+    for (size_t i = 0; i < n_ents; ++i) {
+      n_pushed += swbus_rxq_trypush(sub->subscriber,
+                                    policy,
+                                    ents + i,
+                                    &n_drops);
+    } /* for(i..) */
   }
 
+  __atomic_fetch_add(&info->stats.n_enqueued, n_pushed, __ATOMIC_RELAXED);
+  if (n_drops > 0) {
+    ER_DEBUG("Dropped %zu packets for RXQ %zu subscribed to PID %d/0x%x on "
+             "bus '%s'",
+             n_drops,
+             sub->subscriber - swb->rxqs,
+             sub->pid,
+             sub->pid,
+             swb->name);
+    __atomic_fetch_add(&info->stats.n_drops, n_drops, __ATOMIC_RELAXED);
+  }
+  size_t size = pcqueue_size(sub->subscriber);
+  SWBUS_STAT_MAX_UPDATE(&info->stats.hwm, size);
+  if (n_pushed > 0) {
+    swbus_rxq_set_signal(info);
+  }
   return OK;
 
 error:
+  for (size_t i = 0; i < n_refs; ++i) {
+    mpool_ref_remove(ents[i].bp, ents[i].data);
+  } /* for(i..) */
   return ERROR;
 } /* swbus_subscriber_notify() */
 
-static int swbus_sub_cmp(const void* a, const void* b) {
-  const struct swbus_sub* s1 = a;
-  const struct swbus_sub* s2 = b;
-  if (s1->pid < s2->pid) {
-    return -1;
-  } else if (s1->pid > s2->pid) {
-    return 1;
+static int swbus_sub_cmp(const struct swbus_sub* s1,
+                         const struct swbus_sub* s2) {
+  if (s1->pid != s2->pid) {
+    return (s1->pid < s2->pid) ? -1 : 1;
+  }
+  if (s1->subscriber != s2->subscriber) {
+    return (s1->subscriber < s2->subscriber) ? -1 : 1;
+  }
+  return 0;
+} /* swbus_sub_cmp() */
+
+/*
+ * Get the index of the first subscription not less than the key. Subscribers to
+ * a given PID are contiguous starting from there, so a key with a NULL
+ * subscriber finds all of them.
+ */
+static size_t swbus_sub_lbound(const struct swbus_subtab* tab,
+                               const struct swbus_sub* key) {
+  size_t low = 0;
+  size_t high = tab->n_subs;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (swbus_sub_cmp(&tab->subs[mid], key) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  } /* while() */
+  return low;
+} /* swbus_sub_lbound() */
+
+static size_t swbus_subtab_space(size_t n_subs) {
+  return sizeof(struct swbus_subtab) + n_subs * sizeof(struct swbus_sub);
+} /* swbus_subtab_space() */
+
+/**
+ * \brief Get the calling thread's epoch record for a bus with \ref
+ * RCSW_SWBUS_LOCKFREE, registering the thread if needed. The record is released
+ * when the thread exits.
+ */
+static struct ebr_rec* swbus_ebr_rec(struct swbus* swb) {
+  struct ebr_rec* rec = pthread_getspecific(swb->ebr_key);
+  if (RCSW_LIKELY(NULL != rec)) {
+    return rec;
+  }
+  rec = ebr_register(&swb->ebr);
+  ER_CHECK(NULL != rec,
+           "Too many threads using bus '%s' (max=%zu)",
+           swb->name,
+           swb->ebr.max_threads);
+  if (0 != pthread_setspecific(swb->ebr_key, rec)) {
+    ebr_unregister(rec);
+    return NULL;
+  }
+  return rec;
+
+error:
+  return NULL;
+} /* swbus_ebr_rec() */
+
+static void swbus_ebr_rec_release(void* rec) {
+  ebr_unregister(rec);
+} /* swbus_ebr_rec_release() */
+
+/**
+ * \brief Insert (\p sub non-NULL) or remove (\p sub NULL) the subscription at
+ * index \p i in the subscription table. The bus mutex must be held.
+ *
+ * With \ref RCSW_SWBUS_LOCKFREE the table is copied, the copy is published,
+ * and the old table is freed once no publisher can be reading it anymore.
+ */
+static status_t swbus_subtab_update(struct swbus* swb,
+                                    size_t i,
+                                    const struct swbus_sub* sub) {
+  struct swbus_subtab* old = swb->subtab;
+  size_t n_subs = (NULL != sub) ? old->n_subs + 1 : old->n_subs - 1;
+  size_t n_tail = (NULL != sub) ? old->n_subs - i : old->n_subs - i - 1;
+
+  if (!(swb->flags & RCSW_SWBUS_LOCKFREE)) {
+    if (NULL != sub) {
+      memmove(old->subs + i + 1, old->subs + i, n_tail * sizeof(*sub));
+      old->subs[i] = *sub;
+    } else {
+      memmove(old->subs + i, old->subs + i + 1, n_tail * sizeof(*sub));
+    }
+    old->n_subs = n_subs;
+    return OK;
+  }
+
+  /*
+   * Make room to retire the old table before publishing the new one, rather
+   * than waiting for it afterwards: a publisher blocked on a full RXQ stays in
+   * its critical section, possibly until we drain that RXQ ourselves.
+   */
+  struct ebr_rec* rec = swbus_ebr_rec(swb);
+  RCSW_CHECK_PTR(rec);
+  ER_CHECK(OK == ebr_retire_reserve(rec),
+           "Cannot retire subscription table on bus '%s': publishers stuck",
+           swb->name);
+  struct swbus_subtab* tab = rcsw_alloc(NULL,
+                                        swbus_subtab_space(n_subs),
+                                        RCSW_NONE);
+  RCSW_CHECK_PTR(tab);
+  tab->n_subs = n_subs;
+  memcpy(tab->subs, old->subs, i * sizeof(struct swbus_sub));
+  if (NULL != sub) {
+    tab->subs[i] = *sub;
+    memcpy(tab->subs + i + 1, old->subs + i, n_tail * sizeof(*sub));
   } else {
-    return (int)(s1->subscriber - s2->subscriber);
+    memcpy(tab->subs + i, old->subs + i + 1, n_tail * sizeof(*sub));
+  }
+  __atomic_store_n(&swb->subtab, tab, __ATOMIC_RELEASE);
+
+  /* can't fail: there is room on our retire list */
+  ebr_retire_free(rec, old);
+  return OK;
+
+error:
+  return ERROR;
+} /* swbus_subtab_update() */
+
+static int swbus_u32_cmp(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+} /* swbus_u32_cmp() */
+
+static int swbus_wsub_mask_cmp(const void* a, const void* b) {
+  const struct swbus_wsub* w1 = a;
+  const struct swbus_wsub* w2 = b;
+  if (w1->mask != w2->mask) {
+    return (w1->mask < w2->mask) ? -1 : 1;
   }
-} /* swbus_sub_ent_cmp() */
+  return (w1->lo > w2->lo) - (w1->lo < w2->lo);
+} /* swbus_wsub_mask_cmp() */
+
+/**
+ * \brief Get the index of the last element of a sorted array which is <= the
+ * key, or \p n if there is none.
+ */
+static size_t swbus_u32_floor(const uint32_t* arr, size_t n, uint32_t key) {
+  size_t low = 0;
+  size_t high = n;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (arr[mid] <= key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  } /* while() */
+  return (0 == low) ? n : low - 1;
+} /* swbus_u32_floor() */
+
+static void swbus_wsub_make_range(struct swbus_wsub* wsub,
+                                  struct pcqueue* queue,
+                                  uint32_t lo,
+                                  uint32_t hi) {
+  wsub->lo = lo;
+  wsub->hi = hi;
+  wsub->mask = 0;
+  wsub->subscriber = queue;
+} /* swbus_wsub_make_range() */
+
+static void swbus_wsub_make_mask(struct swbus_wsub* wsub,
+                                 struct pcqueue* queue,
+                                 uint32_t value,
+                                 uint32_t mask) {
+  uint32_t inv = ~mask;
+
+  /* the don't care bits are all at the bottom, so this is just a range */
+  if (0 == (inv & (inv + 1))) {
+    swbus_wsub_make_range(wsub, queue, value & mask, (value & mask) | inv);
+    return;
+  }
+  wsub->lo = value & mask;
+  wsub->hi = wsub->lo;
+  wsub->mask = mask;
+  wsub->subscriber = queue;
+} /* swbus_wsub_make_mask() */
+
+static bool_t swbus_wsub_eq(const struct swbus_wsub* w1,
+                            const struct swbus_wsub* w2) {
+  return w1->lo == w2->lo && w1->hi == w2->hi && w1->mask == w2->mask &&
+      w1->subscriber == w2->subscriber;
+} /* swbus_wsub_eq() */
+
+/**
+ * \brief # 64-bit words in a bitset of RXQ indices.
+ */
+static size_t swbus_wild_words(const struct swbus* swb) {
+  return (swb->max_rxqs + 63) / 64;
+} /* swbus_wild_words() */
+
+static void swbus_bitset_set(uint64_t* set, size_t bit) {
+  set[bit / 64] |= (uint64_t)1 << (bit % 64);
+} /* swbus_bitset_set() */
+
+static bool_t swbus_bitset_test(const uint64_t* set, size_t bit) {
+  return (set[bit / 64] >> (bit % 64)) & 1;
+} /* swbus_bitset_test() */
+
+/**
+ * \brief Build the routing table for the wildcard subscriptions of a bus. The
+ * bus mutex must be held.
+ *
+ * \return The table, or NULL if an error occurred.
+ */
+static struct swbus_routes* swbus_routes_build(const struct swbus* swb) {
+  size_t n_words = swbus_wild_words(swb);
+  size_t n_ranges = 0;
+  size_t n_mvals = 0;
+  for (size_t i = 0; i < swb->n_wsubs; ++i) {
+    n_ranges += (0 == swb->wsubs[i].mask);
+  } /* for(i..) */
+  n_mvals = swb->n_wsubs - n_ranges;
+
+  /* each range can split at most 2 segments */
+  size_t max_segs = 1 + 2 * n_ranges;
+  size_t space = sizeof(struct swbus_routes) +
+                 (max_segs + n_mvals) * n_words * sizeof(uint64_t) +
+                 (n_mvals + 1) * sizeof(size_t) +
+                 (max_segs + 2 * n_mvals) * sizeof(uint32_t);
+  struct swbus_routes* routes = rcsw_alloc(NULL, space, RCSW_ZALLOC);
+  struct swbus_wsub* msubs = NULL;
+  RCSW_CHECK_PTR(routes);
+
+  routes->n_words = n_words;
+  routes->seg_sets = routes->data;
+  routes->mval_sets = routes->seg_sets + max_segs * n_words;
+  routes->mask_start = (size_t*)(routes->mval_sets + n_mvals * n_words);
+  routes->seg_lo = (uint32_t*)(routes->mask_start + n_mvals + 1);
+  routes->masks = routes->seg_lo + max_segs;
+  routes->mvals = routes->masks + n_mvals;
+
+  /* segment boundaries: the start of each range and just past its end */
+  size_t n_bounds = 0;
+  routes->seg_lo[n_bounds++] = 0;
+  for (size_t i = 0; i < swb->n_wsubs; ++i) {
+    const struct swbus_wsub* wsub = &swb->wsubs[i];
+    if (0 != wsub->mask) {
+      continue;
+    }
+    routes->seg_lo[n_bounds++] = wsub->lo;
+    if (UINT32_MAX != wsub->hi) {
+      routes->seg_lo[n_bounds++] = wsub->hi + 1;
+    }
+  } /* for(i..) */
+  qsort(routes->seg_lo, n_bounds, sizeof(uint32_t), swbus_u32_cmp);
+
+  /*
+   * Fill in the RXQs for each segment, merging it into the previous one if
+   * they are the same.
+   */
+  for (size_t i = 0; i < n_bounds; ++i) {
+    if (i > 0 && routes->seg_lo[i] == routes->seg_lo[i - 1]) {
+      continue;
+    }
+    uint32_t lo = routes->seg_lo[i];
+    uint64_t* set = routes->seg_sets + routes->n_segs * n_words;
+    for (size_t j = 0; j < swb->n_wsubs; ++j) {
+      const struct swbus_wsub* wsub = &swb->wsubs[j];
+      if (0 == wsub->mask && wsub->lo <= lo && lo <= wsub->hi) {
+        swbus_bitset_set(set, (size_t)(wsub->subscriber - swb->rxqs));
+      }
+    } /* for(j..) */
+    if (routes->n_segs > 0 &&
+        0 == memcmp(set - n_words, set, n_words * sizeof(uint64_t))) {
+      memset(set, 0, n_words * sizeof(uint64_t));
+      continue;
+    }
+    routes->seg_lo[routes->n_segs++] = lo;
+  } /* for(i..) */
+
+  /* group the masks, and the values for each mask */
+  if (n_mvals > 0) {
+    msubs = rcsw_alloc(NULL, n_mvals * sizeof(struct swbus_wsub), RCSW_NONE);
+    RCSW_CHECK_PTR(msubs);
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < swb->n_wsubs; ++i) {
+    if (0 != swb->wsubs[i].mask) {
+      msubs[n++] = swb->wsubs[i];
+    }
+  } /* for(i..) */
+  if (n_mvals > 0) {
+    qsort(msubs, n_mvals, sizeof(struct swbus_wsub), swbus_wsub_mask_cmp);
+  }
+
+  n = 0;
+  for (size_t i = 0; i < n_mvals; ++i) {
+    if (0 == i || msubs[i].mask != msubs[i - 1].mask) {
+      routes->masks[routes->n_masks] = msubs[i].mask;
+      routes->mask_start[routes->n_masks++] = n;
+    }
+    if (0 == i || msubs[i].mask != msubs[i - 1].mask ||
+        msubs[i].lo != msubs[i - 1].lo) {
+      routes->mvals[n++] = msubs[i].lo;
+    }
+    swbus_bitset_set(routes->mval_sets + (n - 1) * n_words,
+                     (size_t)(msubs[i].subscriber - swb->rxqs));
+  } /* for(i..) */
+  routes->mask_start[routes->n_masks] = n;
+
+  if (NULL != msubs) {
+    rcsw_free(msubs, RCSW_NONE);
+  }
+  return routes;
+
+error:
+  if (NULL != routes) {
+    rcsw_free(routes, RCSW_NONE);
+  }
+  return NULL;
+} /* swbus_routes_build() */
+
+/**
+ * \brief Get the set of RXQs with a wildcard subscription matching a PID.
+ */
+static void swbus_routes_match(const struct swbus_routes* routes,
+                               uint32_t pid,
+                               uint64_t* set) {
+  size_t n_words = routes->n_words;
+  memset(set, 0, n_words * sizeof(uint64_t));
+
+  if (routes->n_segs > 0) {
+    const uint64_t* seg = routes->seg_sets +
+                          swbus_u32_floor(routes->seg_lo, routes->n_segs, pid) *
+                          n_words;
+    for (size_t w = 0; w < n_words; ++w) {
+      set[w] |= seg[w];
+    } /* for(w..) */
+  }
+  for (size_t i = 0; i < routes->n_masks; ++i) {
+    size_t start = routes->mask_start[i];
+    size_t n = routes->mask_start[i + 1] - start;
+    uint32_t key = pid & routes->masks[i];
+    size_t j = swbus_u32_floor(routes->mvals + start, n, key);
+    if (j == n || routes->mvals[start + j] != key) {
+      continue;
+    }
+    const uint64_t* mset = routes->mval_sets + (start + j) * n_words;
+    for (size_t w = 0; w < n_words; ++w) {
+      set[w] |= mset[w];
+    } /* for(w..) */
+  } /* for(i..) */
+} /* swbus_routes_match() */
+
+/**
+ * \brief Push a run of packets with the same PID to all RXQs subscribed to it,
+ * exactly or via a wildcard. Each RXQ gets the packets once.
+ *
+ * \param wild Scratch space for the RXQs subscribed to the PID via a wildcard
+ *             (see \ref swbus.wild).
+ *
+ * \return # of packets which could not be pushed to an RXQ, summed over RXQs.
+ */
+static size_t swbus_subtab_notify(struct swbus* swb,
+                                  const struct swbus_subtab* tab,
+                                  const struct swbus_routes* routes,
+                                  uint64_t* wild,
+                                  const struct swbus_rxq_ent* ents,
+                                  size_t n_ents) {
+  struct swbus_sub key = { .pid = ents[0].pid, .subscriber = NULL };
+  size_t count = 0;
+  size_t fails = 0;
+  size_t n_words = (NULL != routes) ? routes->n_words : 1;
+
+  if (NULL != routes) {
+    swbus_routes_match(routes, key.pid, wild);
+  }
+
+  /* exact subscribers, then wildcard subscribers */
+  size_t i = swbus_sub_lbound(tab, &key);
+  size_t bit = 0;
+  while (true) {
+    struct swbus_sub sub = key;
+    if (i < tab->n_subs && key.pid == tab->subs[i].pid) {
+      sub = tab->subs[i++];
+      if (NULL != routes &&
+          swbus_bitset_test(wild, (size_t)(sub.subscriber - swb->rxqs))) {
+        continue;
+      }
+    } else if (NULL != routes && bit < n_words * 64) {
+      if (0 == wild[bit / 64] >> (bit % 64)) {
+        bit = (bit / 64 + 1) * 64;
+        continue;
+      }
+      bit += (size_t)__builtin_ctzll(wild[bit / 64] >> (bit % 64));
+      sub.subscriber = swb->rxqs + bit++;
+    } else {
+      break;
+    }
+
+    if (OK == swbus_subscriber_notify(swb, &sub, ents, n_ents)) {
+      ++count;
+    } else {
+      ER_WARN("Failed to notify RXQ %zu subscribed to PID %d/0x%x on bus '%s'",
+              sub.subscriber - swb->rxqs,
+              sub.pid,
+              sub.pid,
+              swb->name);
+      fails += n_ents;
+    }
+  } /* while() */
+
+  ER_DEBUG("Notified %zu subscribers subscribed to PID %d/0x%x on bus '%s' "
+           "of %zu packets",
+           count,
+           key.pid,
+           key.pid,
+           swb->name,
+           n_ents);
+  return fails;
+} /* swbus_subtab_notify() */
+
+/*
+ * All writers of the metadata hold the bus mutex, so without
+ * RCSW_SWBUS_SEQMETA there is nothing more to do.
+ */
+static void swbus_meta_wr_enter(struct swbus* swb) {
+  if (swb->flags & RCSW_SWBUS_SEQMETA) {
+    seqlock_wr_enter(&swb->meta_sl);
+  }
+} /* swbus_meta_wr_enter() */
+
+static void swbus_meta_wr_exit(struct swbus* swb) {
+  if (swb->flags & RCSW_SWBUS_SEQMETA) {
+    seqlock_wr_exit(&swb->meta_sl);
+  }
+} /* swbus_meta_wr_exit() */
+
+/**
+ * \brief Add (\p add true) or remove a wildcard subscription and rebuild the
+ * routing table. The bus mutex must be held.
+ *
+ * With \ref RCSW_SWBUS_LOCKFREE the new table is published, and the old table
+ * is freed once no publisher can be reading it anymore.
+ */
+static status_t swbus_wsub_update(struct swbus* swb,
+                                  const struct swbus_wsub* wsub,
+                                  bool_t add) {
+  size_t i = 0;
+  for (; i < swb->n_wsubs; ++i) {
+    if (swbus_wsub_eq(&swb->wsubs[i], wsub)) {
+      break;
+    }
+  } /* for(i..) */
+  ER_CHECK(add == (i == swb->n_wsubs),
+           "Wildcard subscription of RXQ %zu to [0x%x, 0x%x]/0x%x on bus '%s' "
+           "%s",
+           wsub->subscriber - swb->rxqs,
+           wsub->lo,
+           wsub->hi,
+           wsub->mask,
+           swb->name,
+           add ? "exists" : "does not exist");
+  ER_CHECK(!add || swb->n_wsubs < swb->max_subs,
+           "Wildcard subscription table on bus '%s' full",
+           swb->name);
+
+  struct ebr_rec* rec = NULL;
+  if (swb->flags & RCSW_SWBUS_LOCKFREE) {
+    rec = swbus_ebr_rec(swb);
+    RCSW_CHECK_PTR(rec);
+    /* see swbus_subtab_update() */
+    ER_CHECK(OK == ebr_retire_reserve(rec),
+             "Cannot retire routing table on bus '%s': publishers stuck",
+             swb->name);
+  }
+
+  if (add) {
+    swb->wsubs[swb->n_wsubs++] = *wsub;
+  } else {
+    swb->wsubs[i] = swb->wsubs[--swb->n_wsubs];
+  }
+
+  struct swbus_routes* routes = NULL;
+  if (swb->n_wsubs > 0 && NULL == (routes = swbus_routes_build(swb))) {
+    /* undo */
+    if (add) {
+      --swb->n_wsubs;
+    } else {
+      swb->wsubs[swb->n_wsubs++] = swb->wsubs[i];
+      swb->wsubs[i] = *wsub;
+    }
+    goto error;
+  }
+
+  struct swbus_routes* old = swb->routes;
+  if (swb->flags & RCSW_SWBUS_LOCKFREE) {
+    __atomic_store_n(&swb->routes, routes, __ATOMIC_RELEASE);
+    if (NULL != old) {
+      /* can't fail: there is room on our retire list */
+      ebr_retire_free(rec, old);
+    }
+  } else {
+    swb->routes = routes;
+    if (NULL != old) {
+      rcsw_free(old, RCSW_NONE);
+    }
+  }
+  return OK;
+
+error:
+  return ERROR;
+} /* swbus_wsub_update() */
+
+/**
+ * \brief Add (\p add true) or remove a wildcard subscription, taking the bus
+ * mutex.
+ */
+static status_t swbus_wsub_subscribe(struct swbus* swb,
+                                     const struct swbus_wsub* wsub,
+                                     bool_t add) {
+  mutex_lock(&swb->mutex);
+  ER_CHECK(NULL != swbus_rxq_info_get(swb, wsub->subscriber),
+           "Failed to update wildcard subscription of RXQ %p on bus '%s': RXQ "
+           "does not belong to bus",
+           (void*)wsub->subscriber,
+           swb->name);
+  RCSW_CHECK(OK == swbus_wsub_update(swb, wsub, add));
+
+  swbus_meta_wr_enter(swb);
+  if (add) {
+    swb->meta.n_subs++;
+  } else {
+    swb->meta.n_subs--;
+  }
+  swbus_meta_wr_exit(swb);
+  ER_DEBUG("%s RXQ %zu %s [0x%x, 0x%x]/0x%x on bus '%s'",
+           add ? "Subscribed" : "Unsubscribed",
+           wsub->subscriber - swb->rxqs,
+           add ? "to" : "from",
+           wsub->lo,
+           wsub->hi,
+           wsub->mask,
+           swb->name);
+  mutex_unlock(&swb->mutex);
+  return OK;
+
+error:
+  mutex_unlock(&swb->mutex);
+  return ERROR;
+} /* swbus_wsub_subscribe() */
+
+/**
+ * \brief Reserve a buffer for a packet in the first buffer pool large enough
+ * to contain it which has free space.
+ */
+static status_t swbus_reserve(struct swbus* swb,
+                              struct swbus_rsrvn* res,
+                              size_t pkt_size) {
+  for (size_t i = 0; i < swb->n_pools; i++) {
+    struct mpool* pool = &swb->pools[i];
+
+    /* can't use this buffer pool--buffers are too small or pool is full */
+    if (pool->elt_size < pkt_size || mpool_isfull(pool)) {
+      ER_TRACE("Skipping buffer pool %zu in reservation search: buf_size=%zu, "
+               "pkt_size=%zu, full=%d",
+               i,
+               pool->elt_size,
+               pkt_size,
+               mpool_isfull(pool));
+      continue;
+    }
+    dptr_t* space = mpool_req(pool);
+    if (NULL != space) {
+      res->data = space;
+      res->bp = pool;
+      res->pkt_size = pkt_size;
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+      res->reserved_at = swbus_now(swb);
+#endif
+      return OK;
+    }
+  } /*  for(i...) */
+
+  /* no free buffer big enough found */
+  ER_DEBUG("Failed to reserve %zu byte buffer on bus '%s'",
+           pkt_size,
+           swb->name);
+  return ERROR;
+} /* swbus_reserve() */
+
+/**
+ * \brief Release a batch of reserved packets to the bus, taking the bus
+ * mutex/sync lock once for all of them, and looking up subscribers once per run
+ * of packets with the same PID.
+ *
+ * Buffer references for the packets are always dropped, even on ERROR.
+ */
+static status_t swbus_release_n(struct swbus* swb,
+                                const struct swbus_rxq_ent* ents,
+                                size_t n_ents) {
+  status_t rstat = OK;
+  struct ebr_rec* rec = NULL;
+  const struct swbus_subtab* tab = NULL;
+  const struct swbus_routes* routes = NULL;
+  uint64_t* wild = swb->wild;
+
+  if (swb->flags & RCSW_SWBUS_LOCKFREE) {
+    rec = swbus_ebr_rec(swb);
+    if (NULL == rec) {
+      for (size_t i = 0; i < n_ents; ++i) {
+        mpool_release(ents[i].bp, ents[i].data);
+      } /* for(i..) */
+      return ERROR;
+    }
+    ebr_enter(rec);
+    wild += (size_t)(rec - swb->ebr.recs) * swbus_wild_words(swb);
+    tab = __atomic_load_n(&swb->subtab, __ATOMIC_ACQUIRE);
+    routes = __atomic_load_n(&swb->routes, __ATOMIC_ACQUIRE);
+  } else {
+    mutex_lock(&swb->mutex);
+    tab = swb->subtab;
+    routes = swb->routes;
+  }
+  ER_TRACE("Releasing %zu published packets on bus '%s'", n_ents, swb->name);
+
+  /* Keep application threads from servicing until all subscribers notified */
+  if (!(swb->flags & RCSW_SWBUS_ASYNC)) {
+    rdwrl_req(&swb->syncl, ekSCOPE_WR);
+  }
+
+  size_t fails = 0;
+  for (size_t i = 0; i < n_ents;) {
+    size_t n_run = 1;
+    while (i + n_run < n_ents && ents[i + n_run].pid == ents[i].pid) {
+      ++n_run;
+    } /* while() */
+    fails += swbus_subtab_notify(swb, tab, routes, wild, ents + i, n_run);
+    i += n_run;
+  } /* for(i..) */
+  rstat = (0 == fails) ? OK : ERROR;
+
+  if (swb->flags & RCSW_SWBUS_LOCKFREE) {
+    __atomic_fetch_add(&swb->meta.n_published, n_ents, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&swb->meta.n_notify_fails, fails, __ATOMIC_RELAXED);
+  } else {
+    swbus_meta_wr_enter(swb);
+    swb->meta.n_published += n_ents;
+    swb->meta.n_notify_fails += fails;
+    swbus_meta_wr_exit(swb);
+  }
+
+  /*
+   * Unconditional call. If the reference count is currently 0 (i.e. no one
+   * was subscribed to the packet ID), then it will be released.
+   */
+  for (size_t i = 0; i < n_ents; ++i) {
+    if (OK != mpool_release(ents[i].bp, ents[i].data)) {
+      rstat = ERROR;
+    }
+  } /* for(i..) */
+
+  /* all users counted now */
+  if (!(swb->flags & RCSW_SWBUS_ASYNC)) {
+    rdwrl_exit(&swb->syncl, ekSCOPE_WR);
+  }
+  if (swb->flags & RCSW_SWBUS_LOCKFREE) {
+    ebr_exit(rec);
+  } else {
+    mutex_unlock(&swb->mutex);
+  }
+  return rstat;
+} /* swbus_release_n() */
 
 /*******************************************************************************
  * API Functions
@@ -81,31 +1111,55 @@ struct swbus* swbus_init(struct swbus* swb_in,
                                  params->flags & RCSW_NOALLOC_HANDLE);
 
   RCSW_CHECK_PTR(swb);
+
+  /* everything swbus_destroy() looks at, in case we fail part way through */
+  swb->flags = params->flags;
+  memset(&swb->meta, 0, sizeof(swb->meta));
+  swb->n_pools = 0;
+  swb->pools = NULL;
+  swb->rxqs = NULL;
+  swb->rxq_infos = NULL;
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  swb->traces = NULL;
+#endif
+  swb->subtab = NULL;
+  swb->wsubs = NULL;
+  swb->n_wsubs = 0;
+  swb->routes = NULL;
+  swb->wild = NULL;
+  swb->meta_sl_valid = false;
+  swb->ebr_valid = false;
+  swb->ebr_key_valid = false;
+
   RCSW_CHECK_PTR(mutex_init(&swb->mutex, RCSW_NOALLOC_HANDLE));
-  RCSW_CHECK_PTR(rdwrl_init(&swb->syncl, RCSW_NOALLOC_HANDLE));
+  RCSW_CHECK_PTR(rdwrl_init(&swb->syncl,
+                             RCSW_NOALLOC_HANDLE | RCSW_RDWRLOCK_RDBIAS));
 
   strncpy(swb->name, params->name, RCSW_SWBUS_MAX_NAMELEN);
   ER_DEBUG("Initializing SWB instance '%s'", swb->name);
 
-  swb->flags = params->flags;
-  swb->n_rxqs = 0;
-  swb->n_pools = params->max_pools;
+  if (swb->flags & RCSW_SWBUS_SEQMETA) {
+    RCSW_CHECK_PTR(seqlock_init(&swb->meta_sl, RCSW_NOALLOC_HANDLE));
+    swb->meta_sl_valid = true;
+  }
   swb->max_rxqs = params->max_rxqs;
   swb->max_subs = params->max_subs;
 
-  ER_DEBUG("Initializing %zu buffer pools", swb->n_pools);
+  ER_DEBUG("Initializing %zu buffer pools", params->max_pools);
 
   /* initialize buffer pools */
   swb->pools = rcsw_alloc(NULL,
-                          swb->n_pools * sizeof(struct mpool),
+                          params->max_pools * sizeof(struct mpool),
                           RCSW_NONE);
 
   RCSW_CHECK_PTR(swb->pools);
 
-  for (size_t i = 0; i < swb->n_pools; i++) {
+  /* only count pools once they are initialized, so destroy skips the rest */
+  for (size_t i = 0; i < params->max_pools; i++) {
     params->pools[i].flags |= RCSW_NOALLOC_HANDLE;
     RCSW_CHECK_PTR(mpool_init(&swb->pools[i],
                               &params->pools[i]));
+    ++swb->n_pools;
   } /* for() */
 
   ER_DEBUG("Allocating %zu receive queues, %zu max subscribers/queue",
@@ -118,14 +1172,44 @@ struct swbus* swbus_init(struct swbus* swb_in,
                          RCSW_NONE);
 
   RCSW_CHECK_PTR(swb->rxqs);
-
-  /* Initialize subscriber list */
-  struct llist_params llparams = { .max_elts = (int)swb->max_subs,
-    .elt_size = sizeof(struct swbus_sub),
-    .cmpe = swbus_sub_cmp,
-    .flags = RCSW_DS_SORTED };
-  swb->subscribers = llist_init(NULL, &llparams);
-  RCSW_CHECK_PTR(swb->subscribers);
+  swb->rxq_infos = rcsw_alloc(NULL,
+                              swb->max_rxqs * sizeof(struct swbus_rxq_info),
+                              RCSW_NONE);
+  RCSW_CHECK_PTR(swb->rxq_infos);
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  swb->traces = rcsw_alloc(NULL,
+                           sizeof(struct swbus_trace) *
+                           RCSW_SWBUS_TRACE_MAX_PIDS,
+                           RCSW_ZALLOC);
+  RCSW_CHECK_PTR(swb->traces);
+#endif
+
+  /* Initialize subscription table */
+  if (swb->flags & RCSW_SWBUS_LOCKFREE) {
+    struct ebr_params eparams = { .max_threads = params->max_threads,
+      .retire_max = RCSW_SWBUS_RETIRE_MAX,
+      .flags = RCSW_NOALLOC_HANDLE };
+    RCSW_CHECK_PTR(ebr_init(&swb->ebr, &eparams));
+    swb->ebr_valid = true;
+    RCSW_CHECK(0 == pthread_key_create(&swb->ebr_key, swbus_ebr_rec_release));
+    swb->ebr_key_valid = true;
+    swb->subtab = rcsw_alloc(NULL, swbus_subtab_space(0), RCSW_NONE);
+  } else {
+    swb->subtab = rcsw_alloc(NULL,
+                             swbus_subtab_space(swb->max_subs),
+                             RCSW_NONE);
+  }
+  RCSW_CHECK_PTR(swb->subtab);
+  swb->subtab->n_subs = 0;
+  swb->wsubs = rcsw_alloc(NULL,
+                          swb->max_subs * sizeof(struct swbus_wsub),
+                          RCSW_NONE);
+  RCSW_CHECK_PTR(swb->wsubs);
+  size_t n_wild = (swb->flags & RCSW_SWBUS_LOCKFREE) ? swb->ebr.max_threads : 1;
+  swb->wild = rcsw_alloc(NULL,
+                         n_wild * swbus_wild_words(swb) * sizeof(uint64_t),
+                         RCSW_NONE);
+  RCSW_CHECK_PTR(swb->wild);
 
   ER_DEBUG("Initialization complete for SWB instance '%s'", swb->name);
   return swb;
@@ -145,13 +1229,40 @@ void swbus_destroy(struct swbus* swb) {
     rcsw_free(swb->pools, RCSW_NONE);
   }
   if (swb->rxqs) {
-    for (size_t i = 0; i < swb->n_rxqs; ++i) {
+    for (size_t i = 0; i < swb->meta.n_rxqs; ++i) {
       pcqueue_destroy(&swb->rxqs[i]);
     } /* for(i..) */
     rcsw_free(swb->rxqs, RCSW_NONE);
   }
-  if (swb->subscribers) {
-    llist_destroy(swb->subscribers);
+  if (swb->rxq_infos) {
+    rcsw_free(swb->rxq_infos, RCSW_NONE);
+  }
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  if (swb->traces) {
+    rcsw_free(swb->traces, RCSW_NONE);
+  }
+#endif
+  /* no thread can be using the bus anymore */
+  if (swb->ebr_key_valid) {
+    pthread_key_delete(swb->ebr_key);
+  }
+  if (swb->ebr_valid) {
+    ebr_destroy(&swb->ebr);
+  }
+  if (swb->subtab) {
+    rcsw_free(swb->subtab, RCSW_NONE);
+  }
+  if (swb->wsubs) {
+    rcsw_free(swb->wsubs, RCSW_NONE);
+  }
+  if (swb->routes) {
+    rcsw_free(swb->routes, RCSW_NONE);
+  }
+  if (swb->wild) {
+    rcsw_free(swb->wild, RCSW_NONE);
+  }
+  if (swb->meta_sl_valid) {
+    seqlock_destroy(&swb->meta_sl);
   }
   rcsw_free(swb, swb->flags & RCSW_NOALLOC_HANDLE);
 } /* swbus_destroy() */
@@ -199,35 +1310,73 @@ status_t swbus_publish_reserve(struct swbus* swb,
   RCSW_FPC_NV(ERROR, NULL != swb, NULL != res, pkt_size > 0);
 
   ER_DEBUG("Reserving %zu byte buffer on bus '%s'", pkt_size, swb->name);
+  return swbus_reserve(swb, res, pkt_size);
+} /* swbus_publish_reserve() */
 
+status_t swbus_publish_batch(struct swbus* swb,
+                             const uint32_t* pids,
+                             const size_t* pkt_sizes,
+                             const void* const* pkts,
+                             size_t n_pkts) {
+  RCSW_FPC_NV(ERROR,
+              NULL != swb,
+              NULL != pids,
+              NULL != pkt_sizes,
+              NULL != pkts);
 
-  for (size_t i = 0; i < swb->n_pools; i++) {
-    struct mpool* pool = &swb->pools[i];
+  ER_DEBUG("Publishing %zu packets to bus '%s'", n_pkts, swb->name);
 
-    /* can't use this buffer pool--buffers are too small or pool is full */
-    if (pool->elt_size < pkt_size || mpool_isfull(pool)) {
-      ER_TRACE("Skipping buffer pool %zu in reservation search: buf_size=%zu, "
-               "pkt_size=%zu, full=%d",
-               i,
-               pool->elt_size,
-               pkt_size,
-               mpool_isfull(pool));
-      continue;
-    }
-    dptr_t* space = mpool_req(pool);
-    if (NULL != space) {
-      res->data = space;
-      res->bp = swb->pools + i;
-      return OK;
-    }
-  } /*  for(i...) */
+  struct swbus_rxq_ent ents[RCSW_SWBUS_BATCH_MAX];
+  struct swbus_rsrvn res = { .data = NULL, .pkt_size = 0, .bp = NULL };
+  status_t rstat = OK;
 
-  /* no free buffer big enough found */
-  ER_DEBUG("Failed to reserve %zu byte buffer on bus '%s'",
-           pkt_size,
-           swb->name);
-  return ERROR;
-} /* swbus_publish_reserve() */
+  for (size_t done = 0; done < n_pkts && OK == rstat;) {
+    size_t n_chunk = RCSW_MIN(n_pkts - done, (size_t)RCSW_SWBUS_BATCH_MAX);
+    size_t n_rsvd = 0;
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+    /* one timestamp for the whole chunk, which is reserved all at once */
+    uint64_t reserved_at = swbus_now(swb);
+#endif
+
+    for (; n_rsvd < n_chunk; ++n_rsvd) {
+      size_t i = done + n_rsvd;
+
+      /* bursts are usually the same size, so try the last pool first */
+      if (NULL == res.bp || res.pkt_size != pkt_sizes[i] ||
+          mpool_isfull(res.bp) || NULL == (res.data = mpool_req(res.bp))) {
+        if (0 == pkt_sizes[i] || OK != swbus_reserve(swb, &res, pkt_sizes[i])) {
+          ER_WARN("Failed to reserve buffer for packet %zu/%zu in batch on "
+                  "bus '%s'",
+                  i,
+                  n_pkts,
+                  swb->name);
+          rstat = ERROR;
+          break;
+        }
+      }
+      memcpy(res.data, pkts[i], pkt_sizes[i]);
+      ents[n_rsvd].data = res.data;
+      ents[n_rsvd].bp = res.bp;
+      ents[n_rsvd].pkt_size = pkt_sizes[i];
+      ents[n_rsvd].pid = pids[i];
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+      ents[n_rsvd].reserved_at = reserved_at;
+#endif
+    } /* for(n_rsvd..) */
+
+    uint64_t now = swbus_now(swb);
+    for (size_t i = 0; i < n_rsvd; ++i) {
+      ents[i].released_at = now;
+    } /* for(i..) */
+
+    /* publish everything before a packet we could not reserve space for */
+    if (n_rsvd > 0 && OK != swbus_release_n(swb, ents, n_rsvd)) {
+      rstat = ERROR;
+    }
+    done += n_rsvd;
+  } /* for(done..) */
+  return rstat;
+} /* swbus_publish_batch() */
 
 status_t swbus_publish_release(struct swbus* swb,
                                uint32_t pid,
@@ -237,71 +1386,22 @@ status_t swbus_publish_release(struct swbus* swb,
               NULL != swb,
               NULL != res,
               pkt_size > 0);
-  status_t rstat = OK;
   struct swbus_rxq_ent rxq_entry;
 
   rxq_entry.data = res->data;
   rxq_entry.bp = res->bp;
   rxq_entry.pkt_size = pkt_size;
   rxq_entry.pid = pid;
+  rxq_entry.released_at = swbus_now(swb);
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  rxq_entry.reserved_at = res->reserved_at;
+#endif
 
-  mutex_lock(&swb->mutex);
   ER_TRACE("Releasing published data for PID=%d/0x%x on bus '%s'",
            pid,
            pid,
            swb->name);
-
-  /* Keep application threads from servicing until all subscribers notified */
-  if (!(swb->flags & RCSW_SWBUS_ASYNC)) {
-    rdwrl_req(&swb->syncl, ekSCOPE_WR);
-  }
-
-  ER_TRACE("Check %zu total subscribers on bus '%s'",
-           llist_size(swb->subscribers),
-           swb->name);
-  size_t count = 0;
-  LLIST_FOREACH(swb->subscribers, next, node) {
-    struct swbus_sub* sub = (struct swbus_sub*)node->data;
-    if (pid == sub->pid) {
-      if (OK == swbus_subscriber_notify(swb, res->bp, sub, &rxq_entry)) {
-        ++count;
-      } else {
-        ER_WARN("Failed to notify RXQ %zu subscribed to PID %d/0x%x on bus '%s'",
-                sub->subscriber - swb->rxqs,
-                sub->pid,
-                sub->pid,
-                swb->name);
-
-        rstat = ERROR;
-      }
-
-    } else {
-      ER_TRACE("Skip notifying subscriber: PID mismatch: %d/0x%x != %d/0x%x ",
-               sub->pid,
-               sub->pid,
-               pid,
-               pid);
-    }
-  } /* LLIST_FOREACH() */
-
-  ER_DEBUG("Notified %zu subscribers subscribed to PID %d/0x%x on bus '%s'",
-           count,
-           pid,
-           pid,
-           swb->name);
-  /*
-   * Unconditional call. If the reference count is currently 0 (i.e. no one
-   * was subscribed to the packet ID), then it will be released.
-   */
-  RCSW_CHECK(OK == mpool_release(res->bp, res->data));
-
-error:
-  /* all users counted now */
-  if (!(swb->flags & RCSW_SWBUS_ASYNC)) {
-    rdwrl_exit(&swb->syncl, ekSCOPE_WR);
-  }
-  mutex_unlock(&swb->mutex);
-  return rstat;
+  return swbus_release_n(swb, &rxq_entry, 1);
 } /* swbus_publish_release() */
 
 struct pcqueue*
@@ -309,11 +1409,11 @@ swbus_rxq_init(struct swbus* swb, void* buf_p, uint32_t n_entries) {
   RCSW_FPC_NV(NULL, swb != NULL);
 
   mutex_lock(&(swb->mutex));
-  ER_DEBUG("Attempting allocation of RXQ %zu", swb->n_rxqs);
+  ER_DEBUG("Attempting allocation of RXQ %zu", swb->meta.n_rxqs);
 
   /* If max number rxqs has not been reached then allocate one */
-  ER_CHECK(swb->n_rxqs < swb->max_rxqs, "No available RXQs");
-  struct pcqueue* rxq = swb->rxqs + swb->n_rxqs;
+  ER_CHECK(swb->meta.n_rxqs < swb->max_rxqs, "No available RXQs");
+  struct pcqueue* rxq = swb->rxqs + swb->meta.n_rxqs;
 
   /* create FIFO */
   struct pcqueue_params params = { .elt_size = sizeof(struct swbus_rxq_ent),
@@ -322,8 +1422,13 @@ swbus_rxq_init(struct swbus* swb, void* buf_p, uint32_t n_entries) {
     .flags = RCSW_NOALLOC_HANDLE };
   params.flags |= (buf_p != NULL) ? RCSW_NOALLOC_DATA : RCSW_NONE;
   RCSW_CHECK(NULL != pcqueue_init(rxq, &params));
+  struct swbus_rxq_info* info = swbus_rxq_info_get(swb, rxq);
+  memset(info, 0, sizeof(*info));
+  info->policy = ekSWBUS_RXQ_BLOCK;
 
-  swb->n_rxqs++;
+  swbus_meta_wr_enter(swb);
+  swb->meta.n_rxqs++;
+  swbus_meta_wr_exit(swb);
   mutex_unlock(&swb->mutex);
   return rxq;
 
@@ -332,15 +1437,199 @@ error:
   return NULL;
 } /* swbus_rxq_init() */
 
+status_t swbus_rxq_policy_set(struct swbus* swb,
+                              struct pcqueue* queue,
+                              enum swbus_rxq_policy policy) {
+  RCSW_FPC_NV(ERROR,
+              NULL != swb,
+              NULL != queue,
+              policy <= ekSWBUS_RXQ_CONFLATE);
+  struct swbus_rxq_info* info = swbus_rxq_info_get(swb, queue);
+  ER_CHECK(NULL != info,
+           "RXQ %p does not belong to bus '%s'",
+           (void*)queue,
+           swb->name);
+
+  /* publishers can be reading it without the mutex with RCSW_SWBUS_LOCKFREE */
+  __atomic_store_n(&info->policy, policy, __ATOMIC_RELAXED);
+  ER_DEBUG("Set overflow policy for RXQ %zu on bus '%s' to %d",
+           queue - swb->rxqs,
+           swb->name,
+           policy);
+  return OK;
+
+error:
+  return ERROR;
+} /* swbus_rxq_policy_set() */
+
+status_t swbus_rxq_stats_get(struct swbus* swb,
+                             struct pcqueue* queue,
+                             struct swbus_rxq_stats* stats) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != queue, NULL != stats);
+  struct swbus_rxq_info* info = swbus_rxq_info_get(swb, queue);
+  ER_CHECK(NULL != info,
+           "RXQ %p does not belong to bus '%s'",
+           (void*)queue,
+           swb->name);
+
+  const struct swbus_rxq_stats* src = &info->stats;
+  stats->n_enqueued = __atomic_load_n(&src->n_enqueued, __ATOMIC_RELAXED);
+  stats->n_drops = __atomic_load_n(&src->n_drops, __ATOMIC_RELAXED);
+  stats->hwm = __atomic_load_n(&src->hwm, __ATOMIC_RELAXED);
+  stats->n_delivered = __atomic_load_n(&src->n_delivered, __ATOMIC_RELAXED);
+  stats->latency_total = __atomic_load_n(&src->latency_total,
+                                         __ATOMIC_RELAXED);
+  stats->latency_max = __atomic_load_n(&src->latency_max, __ATOMIC_RELAXED);
+  return OK;
+
+error:
+  return ERROR;
+} /* swbus_rxq_stats_get() */
+
+struct swbus_rxq_set* swbus_rxq_set_init(struct swbus* swb,
+                                         struct swbus_rxq_set* set_in,
+                                         uint32_t flags) {
+  RCSW_FPC_NV(NULL, NULL != swb);
+
+  struct swbus_rxq_set* set = rcsw_alloc(set_in,
+                                         sizeof(struct swbus_rxq_set),
+                                         flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(set);
+  set->swb = swb;
+  set->flags = flags;
+  set->n_members = 0;
+  set->next = 0;
+  set->events = 0;
+  set->n_waiters = 0;
+  set->members = rcsw_alloc(NULL,
+                            (swb->max_rxqs + 63) / 64 * sizeof(uint64_t),
+                            RCSW_ZALLOC);
+  RCSW_CHECK_PTR(set->members);
+  ER_DEBUG("Initialized RXQ set on bus '%s'", swb->name);
+  return set;
+
+error:
+  if (NULL != set) {
+    rcsw_free(set, set->flags & RCSW_NOALLOC_HANDLE);
+  }
+  return NULL;
+} /* swbus_rxq_set_init() */
+
+void swbus_rxq_set_destroy(struct swbus_rxq_set* set) {
+  RCSW_FPC_V(NULL != set);
+  struct swbus* swb = set->swb;
+
+  mutex_lock(&swb->mutex);
+  for (size_t i = 0; i < swb->max_rxqs; ++i) {
+    if (set->members[i / 64] & (UINT64_C(1) << (i % 64))) {
+      swbus_rxq_set_unlink(set, &swb->rxq_infos[i], i);
+    }
+  } /* for(i..) */
+  mutex_unlock(&swb->mutex);
+
+  rcsw_free(set->members, RCSW_NONE);
+  rcsw_free(set, set->flags & RCSW_NOALLOC_HANDLE);
+} /* swbus_rxq_set_destroy() */
+
+status_t swbus_rxq_set_add(struct swbus_rxq_set* set, struct pcqueue* queue) {
+  RCSW_FPC_NV(ERROR, NULL != set, NULL != queue);
+  struct swbus* swb = set->swb;
+
+  mutex_lock(&swb->mutex);
+  struct swbus_rxq_info* info = swbus_rxq_info_get(swb, queue);
+  ER_CHECK(NULL != info && (size_t)(queue - swb->rxqs) < swb->meta.n_rxqs,
+           "RXQ %p does not belong to bus '%s'",
+           (void*)queue,
+           swb->name);
+  ER_CHECK(NULL == info->set,
+           "RXQ %zu on bus '%s' already belongs to a set",
+           queue - swb->rxqs,
+           swb->name);
+
+  size_t index = (size_t)(queue - swb->rxqs);
+  __atomic_fetch_or(&set->members[index / 64],
+                    UINT64_C(1) << (index % 64),
+                    __ATOMIC_RELAXED);
+  set->n_members++;
+
+  /* after the RXQ is a member, so waiters see it when they are woken */
+  __atomic_store_n(&info->set, set, __ATOMIC_SEQ_CST);
+  ER_DEBUG("Added RXQ %zu on bus '%s' to set", index, swb->name);
+  mutex_unlock(&swb->mutex);
+  return OK;
+
+error:
+  mutex_unlock(&swb->mutex);
+  return ERROR;
+} /* swbus_rxq_set_add() */
+
+status_t swbus_rxq_set_remove(struct swbus_rxq_set* set,
+                              struct pcqueue* queue) {
+  RCSW_FPC_NV(ERROR, NULL != set, NULL != queue);
+  struct swbus* swb = set->swb;
+
+  mutex_lock(&swb->mutex);
+  struct swbus_rxq_info* info = swbus_rxq_info_get(swb, queue);
+  ER_CHECK(NULL != info && set == info->set,
+           "RXQ %p on bus '%s' does not belong to set",
+           (void*)queue,
+           swb->name);
+  swbus_rxq_set_unlink(set, info, (size_t)(queue - swb->rxqs));
+  ER_DEBUG("Removed RXQ %zu on bus '%s' from set",
+           queue - swb->rxqs,
+           swb->name);
+  mutex_unlock(&swb->mutex);
+  return OK;
+
+error:
+  mutex_unlock(&swb->mutex);
+  return ERROR;
+} /* swbus_rxq_set_remove() */
+
+status_t swbus_rxq_set_wait(struct swbus_rxq_set* set,
+                            struct pcqueue** ready,
+                            size_t max_ready,
+                            size_t* n_ready) {
+  RCSW_FPC_NV(ERROR,
+              NULL != set,
+              NULL != ready,
+              max_ready > 0,
+              NULL != n_ready);
+  return swbus_rxq_set_wait_impl(set, ready, max_ready, n_ready, NULL);
+} /* swbus_rxq_set_wait() */
+
+status_t swbus_rxq_set_timedwait(struct swbus_rxq_set* set,
+                                 struct pcqueue** ready,
+                                 size_t max_ready,
+                                 size_t* n_ready,
+                                 const struct timespec* to) {
+  RCSW_FPC_NV(ERROR,
+              NULL != set,
+              NULL != ready,
+              max_ready > 0,
+              NULL != n_ready,
+              NULL != to);
+  struct timespec abs = clock_monotime();
+  time_ts_add(&abs, to);
+  return swbus_rxq_set_wait_impl(set, ready, max_ready, n_ready, &abs);
+} /* swbus_rxq_set_timedwait() */
+
 status_t swbus_subscribe(struct swbus* swb,
                          struct pcqueue* queue,
                          uint32_t pid) {
   RCSW_FPC_NV(ERROR, swb != NULL, queue != NULL);
 
   mutex_lock(&swb->mutex);
-  ER_CHECK(llist_size(swb->subscribers) < swb->max_subs,
+  ER_CHECK(NULL != swbus_rxq_info_get(swb, queue),
+           "Failed to subscribe RXQ %p to PID %d/0x%x on bus '%s': RXQ does "
+           "not belong to bus",
+           (void*)queue,
+           pid,
+           pid,
+           swb->name);
+  ER_CHECK(swb->subtab->n_subs < swb->max_subs,
            "Failed to subscribe RXQ %zu to PID %d/0x%x on bus '%s': "
-           "subscription list full",
+           "subscription table full",
            queue - swb->rxqs,
            pid,
            pid,
@@ -348,14 +1637,19 @@ status_t swbus_subscribe(struct swbus* swb,
 
   /* find index for insertion of new subscription */
   struct swbus_sub sub = { .pid = pid, .subscriber = queue };
-  ER_CHECK(NULL == llist_data_query(swb->subscribers, &sub),
+  size_t i = swbus_sub_lbound(swb->subtab, &sub);
+  ER_CHECK(i == swb->subtab->n_subs ||
+           0 != swbus_sub_cmp(&swb->subtab->subs[i], &sub),
            "Failed to subscribe RXQ %zu to PID %d/0x%x on bus '%s': subscription "
            "exists ",
            queue - swb->rxqs,
            pid,
            pid,
            swb->name);
-  RCSW_CHECK(OK == llist_append(swb->subscribers, &sub));
+  RCSW_CHECK(OK == swbus_subtab_update(swb, i, &sub));
+  swbus_meta_wr_enter(swb);
+  swb->meta.n_subs++;
+  swbus_meta_wr_exit(swb);
   ER_DEBUG("Subscribed RXQ %zu to PID %d/0x%x on bus '%s'",
            queue - swb->rxqs,
            pid,
@@ -376,17 +1670,21 @@ status_t swbus_unsubscribe(struct swbus* swb,
   status_t rstat = ERROR;
   mutex_lock(&swb->mutex);
 
-  /* find index for insertion of new subscription */
+  /* find the subscription to remove */
   struct swbus_sub sub = { .pid = pid, .subscriber = queue };
-  struct llist_node* node = llist_node_query(swb->subscribers, &sub);
-  ER_CHECK(NULL != node,
+  size_t i = swbus_sub_lbound(swb->subtab, &sub);
+  ER_CHECK(i < swb->subtab->n_subs &&
+           0 == swbus_sub_cmp(&swb->subtab->subs[i], &sub),
            "Could not unsubscribe RXQ %zu from PID %d/0x%x on bus '%s': no "
            "such subscription",
            queue - swb->rxqs,
            pid,
            pid,
            swb->name);
-  RCSW_CHECK(OK == llist_delete(swb->subscribers, node, NULL));
+  RCSW_CHECK(OK == swbus_subtab_update(swb, i, NULL));
+  swbus_meta_wr_enter(swb);
+  swb->meta.n_subs--;
+  swbus_meta_wr_exit(swb);
   rstat = OK;
 
 error:
@@ -394,6 +1692,46 @@ error:
   return rstat;
 } /* swbus_unsubscribe() */
 
+status_t swbus_subscribe_range(struct swbus* swb,
+                               struct pcqueue* queue,
+                               uint32_t lo,
+                               uint32_t hi) {
+  RCSW_FPC_NV(ERROR, swb != NULL, queue != NULL, lo <= hi);
+  struct swbus_wsub wsub;
+  swbus_wsub_make_range(&wsub, queue, lo, hi);
+  return swbus_wsub_subscribe(swb, &wsub, true);
+} /* swbus_subscribe_range() */
+
+status_t swbus_subscribe_mask(struct swbus* swb,
+                              struct pcqueue* queue,
+                              uint32_t value,
+                              uint32_t mask) {
+  RCSW_FPC_NV(ERROR, swb != NULL, queue != NULL);
+  struct swbus_wsub wsub;
+  swbus_wsub_make_mask(&wsub, queue, value, mask);
+  return swbus_wsub_subscribe(swb, &wsub, true);
+} /* swbus_subscribe_mask() */
+
+status_t swbus_unsubscribe_range(struct swbus* swb,
+                                 struct pcqueue* queue,
+                                 uint32_t lo,
+                                 uint32_t hi) {
+  RCSW_FPC_NV(ERROR, swb != NULL, queue != NULL, lo <= hi);
+  struct swbus_wsub wsub;
+  swbus_wsub_make_range(&wsub, queue, lo, hi);
+  return swbus_wsub_subscribe(swb, &wsub, false);
+} /* swbus_unsubscribe_range() */
+
+status_t swbus_unsubscribe_mask(struct swbus* swb,
+                                struct pcqueue* queue,
+                                uint32_t value,
+                                uint32_t mask) {
+  RCSW_FPC_NV(ERROR, swb != NULL, queue != NULL);
+  struct swbus_wsub wsub;
+  swbus_wsub_make_mask(&wsub, queue, value, mask);
+  return swbus_wsub_subscribe(swb, &wsub, false);
+} /* swbus_unsubscribe_mask() */
+
 struct swbus_rxq_ent* swbus_rxq_wait(struct swbus* swb,
                                      struct pcqueue* queue) {
   RCSW_FPC_NV(NULL, NULL != swb, NULL != queue);
@@ -439,9 +1777,50 @@ error:
   return ent;
 } /* swbus_rxq_timedwait() */
 
-status_t swbus_rxq_pop_front(struct pcqueue* queue,
+status_t swbus_rxq_wait_n(struct swbus* swb,
+                          struct pcqueue* queue,
+                          struct swbus_rxq_ent* ents,
+                          size_t max,
+                          size_t* got) {
+  RCSW_FPC_NV(ERROR,
+              NULL != swb,
+              NULL != queue,
+              NULL != ents,
+              max > 0,
+              NULL != got);
+
+  RCSW_CHECK(OK == pcqueue_pop_n(queue, ents, max, got));
+
+  /* wait for the publish of the last packet we got to finish; see above */
+  if (!(swb->flags & RCSW_SWBUS_ASYNC)) {
+    rdwrl_req(&swb->syncl, ekSCOPE_RD);
+    rdwrl_exit(&swb->syncl, ekSCOPE_RD);
+  }
+  swbus_rxq_received(swb, queue, ents, *got);
+  return OK;
+
+error:
+  *got = 0;
+  return ERROR;
+} /* swbus_rxq_wait_n() */
+
+status_t swbus_rxq_release_n(const struct swbus_rxq_ent* ents, size_t n_ents) {
+  RCSW_FPC_NV(ERROR, NULL != ents);
+  status_t rstat = OK;
+
+  for (size_t i = 0; i < n_ents; ++i) {
+    /* If the application did not use the release() function directly. */
+    if (NULL != ents[i].bp && OK != mpool_release(ents[i].bp, ents[i].data)) {
+      rstat = ERROR;
+    }
+  } /* for(i..) */
+  return rstat;
+} /* swbus_rxq_release_n() */
+
+status_t swbus_rxq_pop_front(struct swbus* swb,
+                             struct pcqueue* queue,
                              struct swbus_rxq_ent* ent) {
-  RCSW_FPC_NV(ERROR, NULL != queue, NULL != ent);
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != queue, NULL != ent);
 
   /* If the application did not use the release() function directly. */
   if (ent->bp) {
@@ -454,15 +1833,105 @@ status_t swbus_rxq_pop_front(struct pcqueue* queue,
 
   /*
    * Assuming the application has already done whatever it needs to with the
-   * front item.
+   * front item. It may have been peeked more than once, so it only counts as
+   * received now that it is gone from the queue.
    */
-  RCSW_CHECK(OK == pcqueue_pop(queue, NULL));
+  struct swbus_rxq_ent popped;
+  RCSW_CHECK(OK == pcqueue_pop(queue, &popped));
+  swbus_rxq_received(swb, queue, &popped, 1);
   return OK;
 
 error:
   return ERROR;
 } /* swbus_rxq_pop_front() */
 
+status_t swbus_meta_get(struct swbus* swb, struct swbus_meta* meta) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != meta);
+
+  if (swb->flags & RCSW_SWBUS_SEQMETA) {
+    RCSW_SEQLOCK_READ(&swb->meta_sl, *meta, swb->meta);
+  } else {
+    mutex_lock(&swb->mutex);
+    *meta = swb->meta;
+    mutex_unlock(&swb->mutex);
+  }
+  if (swb->flags & RCSW_SWBUS_LOCKFREE) {
+    /* updated by publishers outside of the mutex/seqlock */
+    meta->n_published = __atomic_load_n(&swb->meta.n_published,
+                                        __ATOMIC_RELAXED);
+    meta->n_notify_fails = __atomic_load_n(&swb->meta.n_notify_fails,
+                                           __ATOMIC_RELAXED);
+  }
+  return OK;
+} /* swbus_meta_get() */
+
+status_t swbus_trace_snapshot(const struct swbus* swb,
+                              uint32_t pid,
+                              struct swbus_trace_stats* stats) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != stats);
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  const struct swbus_trace* trace = swbus_trace_get(swb, pid, false);
+  RCSW_CHECK_PTR(trace);
+
+  stats->pid = pid;
+  grind_hist_snapshot(&trace->stats.publish, &stats->publish);
+  grind_hist_snapshot(&trace->stats.queue, &stats->queue);
+  grind_hist_snapshot(&trace->stats.total, &stats->total);
+  return OK;
+
+error:
+  return ERROR;
+#else
+  (void)pid;
+  return ERROR;
+#endif
+} /* swbus_trace_snapshot() */
+
+size_t swbus_trace_foreach(const struct swbus* swb,
+                           void (*cb)(const struct swbus_trace_stats*, void*),
+                           void* arg) {
+  RCSW_FPC_NV(0, NULL != swb, NULL != cb);
+  size_t count = 0;
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  for (size_t i = 0; i < RCSW_SWBUS_TRACE_MAX_PIDS; ++i) {
+    const struct swbus_trace* trace = &swb->traces[i];
+    if (2 != __atomic_load_n(&trace->state, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    struct swbus_trace_stats stats;
+    RCSW_CHECK(OK == swbus_trace_snapshot(swb, trace->stats.pid, &stats));
+    cb(&stats, arg);
+    ++count;
+  } /* for(i..) */
+
+error:
+#else
+  (void)arg;
+#endif
+  return count;
+} /* swbus_trace_foreach() */
+
+void swbus_trace_report(const struct swbus* swb) {
+  RCSW_FPC_V(NULL != swb);
+
+  DPRINTF("----------------------------------------\n");
+  DPRINTF("          SWBUS PACKET LATENCY          \n");
+  DPRINTF("----------------------------------------\n");
+  size_t n_pids = swbus_trace_foreach(swb, swbus_trace_report_pid, NULL);
+  DPRINTF("\n%zu PID(s) traced on bus '%s'\n\n", n_pids, swb->name);
+} /* swbus_trace_report() */
+
+void swbus_trace_reset(struct swbus* swb) {
+  RCSW_FPC_V(NULL != swb);
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  for (size_t i = 0; i < RCSW_SWBUS_TRACE_MAX_PIDS; ++i) {
+    grind_hist_reset(&swb->traces[i].stats.publish);
+    grind_hist_reset(&swb->traces[i].stats.queue);
+    grind_hist_reset(&swb->traces[i].stats.total);
+  } /* for(i..) */
+#endif
+} /* swbus_trace_reset() */
+
 struct swbus_rxq_ent* swbus_rxq_front(struct pcqueue *const queue) {
   RCSW_FPC_NV(NULL, queue != NULL);
   struct swbus_rxq_ent* ent = NULL;
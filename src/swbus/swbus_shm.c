@@ -0,0 +1,929 @@
+/**
+ * \file swbus_shm.c
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "rcsw/swbus/swbus_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RCSW_ER_MODNAME RCSW_ER_MODNAME_BUILDER("rcsw", "swb")
+#define RCSW_ER_MODID ekLOG4CL_SWBUS
+#include "rcsw/er/client.h"
+#include "rcsw/al/clock.h"
+#include "rcsw/al/futex.h"
+#include "rcsw/common/fpc.h"
+#include "rcsw/common/alloc.h"
+#include "rcsw/utils/time.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+/* Everything in the segment is aligned to this, to keep atomics off of each
+ * other's cache lines. */
+#define RCSW_SWBUS_SHM_ALIGN RCSW_CACHELINE_SIZE
+
+/* Marks the end of a buffer pool free list */
+#define RCSW_SWBUS_SHM_NIL UINT32_MAX
+
+/* How long swbus_shm_open() waits for the creator to initialize the segment */
+#define RCSW_SWBUS_SHM_OPEN_TRIES 1000
+
+/*******************************************************************************
+ * Private Functions
+ ******************************************************************************/
+static size_t swbus_shm_align(size_t off) {
+  return (off + RCSW_SWBUS_SHM_ALIGN - 1) & ~(size_t)(RCSW_SWBUS_SHM_ALIGN - 1);
+} /* swbus_shm_align() */
+
+static struct swbus_shm_pool* swbus_shm_pools(const struct swbus_shm* swb) {
+  return (struct swbus_shm_pool*)swbus_shm_ptr(swb, swb->hdr->pools_off);
+} /* swbus_shm_pools() */
+
+static struct swbus_shm_rxq* swbus_shm_rxqs(const struct swbus_shm* swb) {
+  return (struct swbus_shm_rxq*)swbus_shm_ptr(swb, swb->hdr->rxqs_off);
+} /* swbus_shm_rxqs() */
+
+static struct swbus_shm_sub* swbus_shm_subs(const struct swbus_shm* swb) {
+  return (struct swbus_shm_sub*)swbus_shm_ptr(swb, swb->hdr->subs_off);
+} /* swbus_shm_subs() */
+
+/*
+ * Lay out the segment after the header, filling in the offsets in the header,
+ * the pools, and the RXQs if they are non-NULL. Returns the total size.
+ */
+static size_t swbus_shm_layout(const struct swbus_shm_params* params,
+                               struct swbus_shm_hdr* hdr,
+                               struct swbus_shm_pool* pools,
+                               struct swbus_shm_rxq* rxqs) {
+  size_t off = swbus_shm_align(sizeof(struct swbus_shm_hdr));
+
+  if (NULL != hdr) {
+    hdr->pools_off = off;
+  }
+  off = swbus_shm_align(off +
+                        params->max_pools * sizeof(struct swbus_shm_pool));
+
+  if (NULL != hdr) {
+    hdr->rxqs_off = off;
+  }
+  off = swbus_shm_align(off +
+                        params->max_rxqs * sizeof(struct swbus_shm_rxq));
+
+  if (NULL != hdr) {
+    hdr->subs_off = off;
+  }
+  off = swbus_shm_align(off +
+                        params->max_subs * sizeof(struct swbus_shm_sub));
+
+  for (size_t i = 0; i < params->max_rxqs; ++i) {
+    if (NULL != rxqs) {
+      rxqs[i].cells_off = off;
+    }
+    off = swbus_shm_align(off +
+                          params->rxq_size * sizeof(struct swbus_shm_cell));
+  } /* for(i..) */
+
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    size_t n_elts = params->pools[i].max_elts;
+    if (NULL != pools) {
+      pools[i].refs_off = off;
+    }
+    off = swbus_shm_align(off + n_elts * sizeof(uint32_t));
+    if (NULL != pools) {
+      pools[i].next_off = off;
+    }
+    off = swbus_shm_align(off + n_elts * sizeof(uint32_t));
+    if (NULL != pools) {
+      pools[i].chunks_off = off;
+    }
+    off += n_elts * swbus_shm_align(params->pools[i].elt_size);
+  } /* for(i..) */
+  return off;
+} /* swbus_shm_layout() */
+
+/*
+ * Make the state protected by the lock valid again after its owner died while
+ * holding it. Subscriptions are inserted and removed by shifting the table
+ * with memmove(), so a partial update can leave duplicate (or torn) entries:
+ * keep only entries which are in order and refer to RXQs in use. The update
+ * which was in progress may be lost.
+ */
+static void swbus_shm_repair(struct swbus_shm* swb) {
+  struct swbus_shm_hdr* hdr = swb->hdr;
+  struct swbus_shm_sub* subs = swbus_shm_subs(swb);
+  struct swbus_shm_rxq* rxqs = swbus_shm_rxqs(swb);
+  size_t n_subs = 0;
+  size_t n_rxqs = 0;
+
+  for (size_t i = 0; i < hdr->max_rxqs; ++i) {
+    n_rxqs += (rxqs[i].in_use) ? 1 : 0;
+  } /* for(i..) */
+
+  for (size_t i = 0; i < hdr->n_subs && i < hdr->max_subs; ++i) {
+    struct swbus_shm_sub sub = subs[i];
+    const struct swbus_shm_sub* prev = (n_subs > 0) ? &subs[n_subs - 1] : NULL;
+    if (sub.rxq >= hdr->max_rxqs || !rxqs[sub.rxq].in_use) {
+      continue;
+    }
+    if (NULL != prev &&
+        (prev->pid > sub.pid ||
+         (prev->pid == sub.pid && prev->rxq >= sub.rxq))) {
+      continue;
+    }
+    subs[n_subs++] = sub;
+  } /* for(i..) */
+
+  ER_WARN("Repaired bus '%s' after a process died holding its lock: "
+          "%zu subscriptions, %zu RXQs",
+          hdr->name,
+          n_subs,
+          n_rxqs);
+  hdr->n_subs = n_subs;
+  hdr->n_rxqs = n_rxqs;
+} /* swbus_shm_repair() */
+
+/*
+ * The lock serializing subscription table updates against publishers. It is
+ * robust, so if a process dies holding it, the next process to take it gets
+ * EOWNERDEAD instead of waiting forever, and repairs whatever the dead process
+ * left half done.
+ */
+static void swbus_shm_lock(struct swbus_shm* swb) {
+  if (EOWNERDEAD == pthread_mutex_lock(&swb->hdr->lock)) {
+    swbus_shm_repair(swb);
+    pthread_mutex_consistent(&swb->hdr->lock);
+  }
+} /* swbus_shm_lock() */
+
+static void swbus_shm_unlock(struct swbus_shm* swb) {
+  pthread_mutex_unlock(&swb->hdr->lock);
+} /* swbus_shm_unlock() */
+
+static status_t swbus_shm_lock_init(struct swbus_shm* swb) {
+  pthread_mutexattr_t attr;
+  ER_CHECK(0 == pthread_mutexattr_init(&attr),
+           "Failed to initialize lock attributes for bus '%s'",
+           swb->hdr->name);
+  int rc = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  if (0 == rc) {
+    rc = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  }
+  if (0 == rc) {
+    rc = pthread_mutex_init(&swb->hdr->lock, &attr);
+  }
+  pthread_mutexattr_destroy(&attr);
+  ER_CHECK(0 == rc,
+           "Failed to initialize lock for bus '%s': %s",
+           swb->hdr->name,
+           strerror(rc));
+  return OK;
+
+error:
+  return ERROR;
+} /* swbus_shm_lock_init() */
+
+static status_t swbus_shm_chunk_alloc(struct swbus_shm* swb,
+                                      size_t pool_idx,
+                                      swbus_shm_off_t* off) {
+  struct swbus_shm_pool* pool = &swbus_shm_pools(swb)[pool_idx];
+  uint32_t* next = (uint32_t*)swbus_shm_ptr(swb, pool->next_off);
+  uint32_t* refs = (uint32_t*)swbus_shm_ptr(swb, pool->refs_off);
+
+  uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+  uint32_t idx;
+  uint64_t new_head;
+  do {
+    idx = (uint32_t)head;
+    if (RCSW_SWBUS_SHM_NIL == idx) {
+      return ERROR;
+    }
+    /*
+     * This may read a stale link if another process pops idx first, but then
+     * the generation count in the head will have changed and the CAS fails.
+     */
+    uint32_t nxt = __atomic_load_n(&next[idx], __ATOMIC_RELAXED);
+    new_head = (((head >> 32) + 1) << 32) | nxt;
+  } while (!__atomic_compare_exchange_n(&pool->free_head,
+                                        &head,
+                                        new_head,
+                                        true,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE));
+
+  /* the caller's reference */
+  __atomic_store_n(&refs[idx], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&pool->n_alloc, 1, __ATOMIC_RELAXED);
+  *off = pool->chunks_off + idx * pool->chunk_size;
+  return OK;
+} /* swbus_shm_chunk_alloc() */
+
+static void swbus_shm_chunk_free(struct swbus_shm* swb,
+                                 struct swbus_shm_pool* pool,
+                                 uint32_t idx) {
+  uint32_t* next = (uint32_t*)swbus_shm_ptr(swb, pool->next_off);
+
+  __atomic_fetch_sub(&pool->n_alloc, 1, __ATOMIC_RELAXED);
+  uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED);
+  uint64_t new_head;
+  do {
+    __atomic_store_n(&next[idx], (uint32_t)head, __ATOMIC_RELAXED);
+    new_head = (((head >> 32) + 1) << 32) | idx;
+  } while (!__atomic_compare_exchange_n(&pool->free_head,
+                                        &head,
+                                        new_head,
+                                        true,
+                                        __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+} /* swbus_shm_chunk_free() */
+
+static uint32_t* swbus_shm_chunk_ref(struct swbus_shm* swb,
+                                     size_t pool_idx,
+                                     swbus_shm_off_t off,
+                                     uint32_t* idx) {
+  struct swbus_shm_pool* pool = &swbus_shm_pools(swb)[pool_idx];
+  *idx = (uint32_t)((off - pool->chunks_off) / pool->chunk_size);
+  return &((uint32_t*)swbus_shm_ptr(swb, pool->refs_off))[*idx];
+} /* swbus_shm_chunk_ref() */
+
+static void swbus_shm_ref_add(struct swbus_shm* swb,
+                              size_t pool_idx,
+                              swbus_shm_off_t off) {
+  uint32_t idx;
+  __atomic_fetch_add(swbus_shm_chunk_ref(swb, pool_idx, off, &idx),
+                     1,
+                     __ATOMIC_RELAXED);
+} /* swbus_shm_ref_add() */
+
+/*
+ * Drop a reference to a chunk, freeing it if it was the last one. The release
+ * ordering makes all uses of the chunk by this process happen before whoever
+ * allocates it next reuses it.
+ */
+static void swbus_shm_ref_remove(struct swbus_shm* swb,
+                                 size_t pool_idx,
+                                 swbus_shm_off_t off) {
+  uint32_t idx;
+  uint32_t* ref = swbus_shm_chunk_ref(swb, pool_idx, off, &idx);
+  if (1 == __atomic_fetch_sub(ref, 1, __ATOMIC_ACQ_REL)) {
+    swbus_shm_chunk_free(swb, &swbus_shm_pools(swb)[pool_idx], idx);
+  }
+} /* swbus_shm_ref_remove() */
+
+/*
+ * Push to an RXQ. Each cell's sequence # is equal to the position of the next
+ * push which can use it when it is free, and one more than that when it is
+ * full, so producers and consumers claim positions with a CAS and then wait
+ * for nobody.
+ */
+static status_t swbus_shm_rxq_push(struct swbus_shm* swb,
+                                   struct swbus_shm_rxq* rxq,
+                                   const struct swbus_shm_cell* ent) {
+  struct swbus_shm_cell* cells = (struct swbus_shm_cell*)swbus_shm_ptr(
+      swb, rxq->cells_off);
+  uint64_t pos = __atomic_load_n(&rxq->enq_pos, __ATOMIC_RELAXED);
+  struct swbus_shm_cell* cell;
+
+  for (;;) {
+    cell = &cells[pos % rxq->capacity];
+    uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    int64_t diff = (int64_t)(seq - pos);
+    if (0 == diff) {
+      if (__atomic_compare_exchange_n(&rxq->enq_pos,
+                                      &pos,
+                                      pos + 1,
+                                      true,
+                                      __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* full */
+      return ERROR;
+    } else {
+      pos = __atomic_load_n(&rxq->enq_pos, __ATOMIC_RELAXED);
+    }
+  } /* for(;;) */
+
+  cell->off = ent->off;
+  cell->pkt_size = ent->pkt_size;
+  cell->pid = ent->pid;
+  cell->pool = ent->pool;
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+  /*
+   * Pairs with the waiter incrementing n_waiters before sampling signal: either
+   * we see the waiter, or the waiter sees the new signal value (and the futex
+   * wait returns immediately).
+   */
+  __atomic_fetch_add(&rxq->signal, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&rxq->n_waiters, __ATOMIC_SEQ_CST) > 0) {
+    futex_wake_shared(&rxq->signal, INT_MAX);
+  }
+  return OK;
+} /* swbus_shm_rxq_push() */
+
+static status_t swbus_shm_rxq_pop(struct swbus_shm* swb,
+                                  struct swbus_shm_rxq* rxq,
+                                  struct swbus_shm_rxq_ent* ent) {
+  struct swbus_shm_cell* cells = (struct swbus_shm_cell*)swbus_shm_ptr(
+      swb, rxq->cells_off);
+  uint64_t pos = __atomic_load_n(&rxq->deq_pos, __ATOMIC_RELAXED);
+  struct swbus_shm_cell* cell;
+
+  for (;;) {
+    cell = &cells[pos % rxq->capacity];
+    uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    int64_t diff = (int64_t)(seq - (pos + 1));
+    if (0 == diff) {
+      if (__atomic_compare_exchange_n(&rxq->deq_pos,
+                                      &pos,
+                                      pos + 1,
+                                      true,
+                                      __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* empty */
+      return ERROR;
+    } else {
+      pos = __atomic_load_n(&rxq->deq_pos, __ATOMIC_RELAXED);
+    }
+  } /* for(;;) */
+
+  ent->off = cell->off;
+  ent->pkt_size = cell->pkt_size;
+  ent->pid = cell->pid;
+  ent->pool = cell->pool;
+  ent->data = swbus_shm_ptr(swb, ent->off);
+  __atomic_store_n(&cell->seq, pos + rxq->capacity, __ATOMIC_RELEASE);
+  return OK;
+} /* swbus_shm_rxq_pop() */
+
+static status_t swbus_shm_rxq_wait_impl(struct swbus_shm* swb,
+                                        struct swbus_shm_rxq* rxq,
+                                        struct swbus_shm_rxq_ent* ent,
+                                        const struct timespec* abs) {
+  for (;;) {
+    if (OK == swbus_shm_rxq_pop(swb, rxq, ent)) {
+      return OK;
+    }
+    __atomic_fetch_add(&rxq->n_waiters, 1, __ATOMIC_SEQ_CST);
+    uint32_t signal = __atomic_load_n(&rxq->signal, __ATOMIC_SEQ_CST);
+    status_t rstat = swbus_shm_rxq_pop(swb, rxq, ent);
+    status_t wstat = OK;
+    if (OK != rstat) {
+      wstat = futex_wait_shared(&rxq->signal, signal, abs);
+    }
+    __atomic_fetch_sub(&rxq->n_waiters, 1, __ATOMIC_RELAXED);
+
+    if (OK == rstat) {
+      return OK;
+    }
+    if (OK != wstat) {
+      return (ETIMEDOUT == errno) ? swbus_shm_rxq_pop(swb, rxq, ent) : ERROR;
+    }
+  } /* for(;;) */
+} /* swbus_shm_rxq_wait_impl() */
+
+/*
+ * Get the index of the first subscription not less than (pid, rxq). Called
+ * with the lock held.
+ */
+static size_t swbus_shm_sub_lbound(const struct swbus_shm* swb,
+                                   uint32_t pid,
+                                   uint32_t rxq) {
+  const struct swbus_shm_sub* subs = swbus_shm_subs(swb);
+  size_t low = 0;
+  size_t high = swb->hdr->n_subs;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (subs[mid].pid < pid || (subs[mid].pid == pid && subs[mid].rxq < rxq)) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  } /* while() */
+  return low;
+} /* swbus_shm_sub_lbound() */
+
+static struct swbus_shm* swbus_shm_handle_init(struct swbus_shm* swb_in,
+                                               const char* shm_name,
+                                               uint32_t flags) {
+  struct swbus_shm* swb = rcsw_alloc(swb_in,
+                                     sizeof(struct swbus_shm),
+                                     flags & RCSW_NOALLOC_HANDLE);
+  RCSW_CHECK_PTR(swb);
+  swb->flags = flags;
+  swb->hdr = NULL;
+  swb->size = 0;
+  swb->fd = -1;
+  strncpy(swb->shm_name, shm_name, RCSW_SWBUS_SHM_MAX_NAMELEN - 1);
+  swb->shm_name[RCSW_SWBUS_SHM_MAX_NAMELEN - 1] = '\0';
+  return swb;
+
+error:
+  return NULL;
+} /* swbus_shm_handle_init() */
+
+static status_t swbus_shm_map(struct swbus_shm* swb, size_t size) {
+  void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, swb->fd, 0);
+  ER_CHECK(MAP_FAILED != base,
+           "Failed to map segment '%s': %s",
+           swb->shm_name,
+           strerror(errno));
+  swb->hdr = (struct swbus_shm_hdr*)base;
+  swb->size = size;
+  return OK;
+
+error:
+  return ERROR;
+} /* swbus_shm_map() */
+
+/*******************************************************************************
+ * API Functions
+ ******************************************************************************/
+BEGIN_C_DECLS
+
+struct swbus_shm* swbus_shm_create(struct swbus_shm* swb_in,
+                                   const char* shm_name,
+                                   const struct swbus_shm_params* params) {
+  RCSW_FPC_NV(NULL,
+              NULL != shm_name,
+              NULL != params,
+              NULL != params->pools,
+              params->max_pools > 0,
+              params->max_rxqs > 0,
+              params->rxq_size > 0,
+              strlen(shm_name) < RCSW_SWBUS_SHM_MAX_NAMELEN);
+  RCSW_ER_MODULE_INIT();
+
+  bool_t created = false;
+  struct swbus_shm* swb = swbus_shm_handle_init(swb_in,
+                                                shm_name,
+                                                params->flags);
+  RCSW_CHECK_PTR(swb);
+
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    ER_CHECK(params->pools[i].elt_size > 0 &&
+             params->pools[i].max_elts > 0 &&
+             params->pools[i].max_elts < RCSW_SWBUS_SHM_NIL,
+             "Bad size for buffer pool %zu",
+             i);
+  } /* for(i..) */
+
+  swb->fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  ER_CHECK(-1 != swb->fd,
+           "Failed to create segment '%s': %s",
+           shm_name,
+           strerror(errno));
+  created = true;
+
+  size_t size = swbus_shm_layout(params, NULL, NULL, NULL);
+  ER_DEBUG("Creating %zu byte segment '%s' for SWB instance '%s'",
+           size,
+           shm_name,
+           params->name);
+  ER_CHECK(0 == ftruncate(swb->fd, (off_t)size),
+           "Failed to size segment '%s': %s",
+           shm_name,
+           strerror(errno));
+  RCSW_CHECK(OK == swbus_shm_map(swb, size));
+
+  /* the segment is zero-filled by ftruncate() */
+  struct swbus_shm_hdr* hdr = swb->hdr;
+  hdr->version = RCSW_SWBUS_SHM_VERSION;
+  hdr->size = size;
+  hdr->n_pools = (uint32_t)params->max_pools;
+  hdr->max_rxqs = (uint32_t)params->max_rxqs;
+  hdr->max_subs = (uint32_t)params->max_subs;
+  strncpy(hdr->name, params->name, RCSW_SWBUS_MAX_NAMELEN);
+  RCSW_CHECK(OK == swbus_shm_lock_init(swb));
+
+  /* header offsets first, so we can find the pools and RXQs to fill in */
+  swbus_shm_layout(params, hdr, NULL, NULL);
+  struct swbus_shm_pool* pools = swbus_shm_pools(swb);
+  struct swbus_shm_rxq* rxqs = swbus_shm_rxqs(swb);
+  swbus_shm_layout(params, hdr, pools, rxqs);
+
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    pools[i].elt_size = params->pools[i].elt_size;
+    pools[i].max_elts = params->pools[i].max_elts;
+    pools[i].chunk_size = swbus_shm_align(params->pools[i].elt_size);
+
+    /* all chunks start out free, in order */
+    uint32_t* next = (uint32_t*)swbus_shm_ptr(swb, pools[i].next_off);
+    for (size_t j = 0; j < pools[i].max_elts; ++j) {
+      next[j] = (j + 1 < pools[i].max_elts) ? (uint32_t)(j + 1)
+                                             : RCSW_SWBUS_SHM_NIL;
+    } /* for(j..) */
+    pools[i].free_head = 0;
+  } /* for(i..) */
+
+  for (size_t i = 0; i < params->max_rxqs; ++i) {
+    rxqs[i].id = (uint32_t)i;
+    rxqs[i].capacity = params->rxq_size;
+    struct swbus_shm_cell* cells = (struct swbus_shm_cell*)swbus_shm_ptr(
+        swb, rxqs[i].cells_off);
+    for (size_t j = 0; j < params->rxq_size; ++j) {
+      cells[j].seq = j;
+    } /* for(j..) */
+  } /* for(i..) */
+
+  /* publish the segment to processes waiting in swbus_shm_open() */
+  __atomic_store_n(&hdr->magic, RCSW_SWBUS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  ER_DEBUG("Initialization complete for SWB instance '%s'", hdr->name);
+  return swb;
+
+error:
+  if (created) {
+    shm_unlink(shm_name);
+  }
+  swbus_shm_close(swb);
+  return NULL;
+} /* swbus_shm_create() */
+
+struct swbus_shm* swbus_shm_open(struct swbus_shm* swb_in,
+                                 const char* shm_name,
+                                 uint32_t flags) {
+  RCSW_FPC_NV(NULL,
+              NULL != shm_name,
+              strlen(shm_name) < RCSW_SWBUS_SHM_MAX_NAMELEN);
+  RCSW_ER_MODULE_INIT();
+
+  struct swbus_shm* swb = swbus_shm_handle_init(swb_in, shm_name, flags);
+  RCSW_CHECK_PTR(swb);
+
+  swb->fd = shm_open(shm_name, O_RDWR, 0);
+  ER_CHECK(-1 != swb->fd,
+           "Failed to open segment '%s': %s",
+           shm_name,
+           strerror(errno));
+
+  /*
+   * The creator might not have sized/initialized the segment yet. It can't
+   * take long, so just poll.
+   */
+  struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000000 };
+  struct stat st;
+  size_t tries = 0;
+  for (;;) {
+    ER_CHECK(0 == fstat(swb->fd, &st),
+             "Failed to stat segment '%s': %s",
+             shm_name,
+             strerror(errno));
+    if ((size_t)st.st_size >= sizeof(struct swbus_shm_hdr)) {
+      break;
+    }
+    ER_CHECK(++tries < RCSW_SWBUS_SHM_OPEN_TRIES,
+             "Segment '%s' was never sized",
+             shm_name);
+    nanosleep(&delay, NULL);
+  } /* for(;;) */
+  RCSW_CHECK(OK == swbus_shm_map(swb, (size_t)st.st_size));
+
+  while (RCSW_SWBUS_SHM_MAGIC != __atomic_load_n(&swb->hdr->magic,
+                                                 __ATOMIC_ACQUIRE)) {
+    ER_CHECK(++tries < RCSW_SWBUS_SHM_OPEN_TRIES,
+             "Segment '%s' was never initialized",
+             shm_name);
+    nanosleep(&delay, NULL);
+  } /* while() */
+
+  ER_CHECK(RCSW_SWBUS_SHM_VERSION == swb->hdr->version,
+           "Segment '%s' has layout version %u, expected %u",
+           shm_name,
+           swb->hdr->version,
+           RCSW_SWBUS_SHM_VERSION);
+  ER_CHECK(swb->hdr->size == swb->size,
+           "Segment '%s' has size %zu, expected %zu",
+           shm_name,
+           swb->size,
+           (size_t)swb->hdr->size);
+
+  ER_DEBUG("Attached to SWB instance '%s' in segment '%s'",
+           swb->hdr->name,
+           shm_name);
+  return swb;
+
+error:
+  swbus_shm_close(swb);
+  return NULL;
+} /* swbus_shm_open() */
+
+void swbus_shm_close(struct swbus_shm* swb) {
+  RCSW_FPC_V(NULL != swb);
+
+  if (NULL != swb->hdr) {
+    munmap(swb->hdr, swb->size);
+  }
+  if (-1 != swb->fd) {
+    close(swb->fd);
+  }
+  rcsw_free(swb, swb->flags & RCSW_NOALLOC_HANDLE);
+} /* swbus_shm_close() */
+
+status_t swbus_shm_unlink(const char* shm_name) {
+  RCSW_FPC_NV(ERROR, NULL != shm_name);
+
+  return (0 == shm_unlink(shm_name)) ? OK : ERROR;
+} /* swbus_shm_unlink() */
+
+struct swbus_shm_rxq* swbus_shm_rxq_init(struct swbus_shm* swb) {
+  RCSW_FPC_NV(NULL, NULL != swb);
+
+  struct swbus_shm_rxq* rxqs = swbus_shm_rxqs(swb);
+  struct swbus_shm_rxq* rxq = NULL;
+
+  swbus_shm_lock(swb);
+  for (size_t i = 0; i < swb->hdr->max_rxqs; ++i) {
+    if (!rxqs[i].in_use) {
+      rxq = &rxqs[i];
+      rxq->in_use = true;
+      swb->hdr->n_rxqs++;
+      break;
+    }
+  } /* for(i..) */
+  swbus_shm_unlock(swb);
+
+  ER_CHECK(NULL != rxq,
+           "Failed to create RXQ on bus '%s': all %u in use",
+           swb->hdr->name,
+           swb->hdr->max_rxqs);
+  ER_DEBUG("Created RXQ %u on bus '%s'", rxq->id, swb->hdr->name);
+  return rxq;
+
+error:
+  return NULL;
+} /* swbus_shm_rxq_init() */
+
+status_t swbus_shm_rxq_destroy(struct swbus_shm* swb,
+                               struct swbus_shm_rxq* rxq) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != rxq, rxq->in_use);
+
+  /* no publisher can push to the RXQ after this */
+  swbus_shm_lock(swb);
+  struct swbus_shm_sub* subs = swbus_shm_subs(swb);
+  size_t n_subs = 0;
+  for (size_t i = 0; i < swb->hdr->n_subs; ++i) {
+    if (subs[i].rxq != rxq->id) {
+      subs[n_subs++] = subs[i];
+    }
+  } /* for(i..) */
+  swb->hdr->n_subs = n_subs;
+  swbus_shm_unlock(swb);
+
+  struct swbus_shm_rxq_ent ent;
+  while (OK == swbus_shm_rxq_pop(swb, rxq, &ent)) {
+    swbus_shm_ref_remove(swb, ent.pool, ent.off);
+  } /* while() */
+
+  swbus_shm_lock(swb);
+  rxq->in_use = false;
+  swb->hdr->n_rxqs--;
+  swbus_shm_unlock(swb);
+  return OK;
+} /* swbus_shm_rxq_destroy() */
+
+status_t swbus_shm_subscribe(struct swbus_shm* swb,
+                             struct swbus_shm_rxq* rxq,
+                             uint32_t pid) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != rxq, rxq->in_use);
+
+  swbus_shm_lock(swb);
+  struct swbus_shm_hdr* hdr = swb->hdr;
+  struct swbus_shm_sub* subs = swbus_shm_subs(swb);
+  ER_CHECK(hdr->n_subs < hdr->max_subs,
+           "Failed to subscribe RXQ %u to PID %d/0x%x on bus '%s': "
+           "subscription table full",
+           rxq->id,
+           pid,
+           pid,
+           hdr->name);
+
+  size_t i = swbus_shm_sub_lbound(swb, pid, rxq->id);
+  ER_CHECK(i == hdr->n_subs || subs[i].pid != pid || subs[i].rxq != rxq->id,
+           "Failed to subscribe RXQ %u to PID %d/0x%x on bus '%s': "
+           "subscription exists",
+           rxq->id,
+           pid,
+           pid,
+           hdr->name);
+  memmove(subs + i + 1, subs + i, (hdr->n_subs - i) * sizeof(*subs));
+  subs[i].pid = pid;
+  subs[i].rxq = rxq->id;
+  hdr->n_subs++;
+  swbus_shm_unlock(swb);
+
+  ER_DEBUG("Subscribed RXQ %u to PID %d/0x%x on bus '%s'",
+           rxq->id,
+           pid,
+           pid,
+           hdr->name);
+  return OK;
+
+error:
+  swbus_shm_unlock(swb);
+  return ERROR;
+} /* swbus_shm_subscribe() */
+
+status_t swbus_shm_unsubscribe(struct swbus_shm* swb,
+                               struct swbus_shm_rxq* rxq,
+                               uint32_t pid) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != rxq);
+
+  swbus_shm_lock(swb);
+  struct swbus_shm_hdr* hdr = swb->hdr;
+  struct swbus_shm_sub* subs = swbus_shm_subs(swb);
+  size_t i = swbus_shm_sub_lbound(swb, pid, rxq->id);
+  ER_CHECK(i < hdr->n_subs && subs[i].pid == pid && subs[i].rxq == rxq->id,
+           "Failed to unsubscribe RXQ %u from PID %d/0x%x on bus '%s': no "
+           "such subscription",
+           rxq->id,
+           pid,
+           pid,
+           hdr->name);
+  memmove(subs + i, subs + i + 1, (hdr->n_subs - i - 1) * sizeof(*subs));
+  hdr->n_subs--;
+  swbus_shm_unlock(swb);
+  return OK;
+
+error:
+  swbus_shm_unlock(swb);
+  return ERROR;
+} /* swbus_shm_unsubscribe() */
+
+status_t swbus_shm_publish(struct swbus_shm* swb,
+                           uint32_t pid,
+                           size_t pkt_size,
+                           const void* pkt) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != pkt);
+
+  struct swbus_shm_rsrvn res;
+  RCSW_CHECK(OK == swbus_shm_publish_reserve(swb, &res, pkt_size));
+  memcpy(res.data, pkt, pkt_size);
+  return swbus_shm_publish_release(swb, pid, &res, pkt_size);
+
+error:
+  return ERROR;
+} /* swbus_shm_publish() */
+
+status_t swbus_shm_publish_reserve(struct swbus_shm* swb,
+                                   struct swbus_shm_rsrvn* res,
+                                   size_t pkt_size) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != res, pkt_size > 0);
+
+  struct swbus_shm_pool* pools = swbus_shm_pools(swb);
+
+  /* smallest pool the packet fits in first, as with swbus_publish_reserve() */
+  for (size_t i = 0; i < swb->hdr->n_pools; ++i) {
+    if (pools[i].elt_size < pkt_size) {
+      continue;
+    }
+    if (OK == swbus_shm_chunk_alloc(swb, i, &res->off)) {
+      res->pool = (uint32_t)i;
+      res->pkt_size = pools[i].elt_size;
+      res->data = swbus_shm_ptr(swb, res->off);
+      return OK;
+    }
+  } /* for(i..) */
+
+  ER_WARN("Failed to reserve %zu bytes on bus '%s': no free buffers",
+          pkt_size,
+          swb->hdr->name);
+  errno = ENOMEM;
+  return ERROR;
+} /* swbus_shm_publish_reserve() */
+
+status_t swbus_shm_publish_release(struct swbus_shm* swb,
+                                   uint32_t pid,
+                                   struct swbus_shm_rsrvn* res,
+                                   size_t pkt_size) {
+  RCSW_FPC_NV(ERROR,
+              NULL != swb,
+              NULL != res,
+              NULL != res->data,
+              pkt_size <= res->pkt_size);
+
+  struct swbus_shm_hdr* hdr = swb->hdr;
+  struct swbus_shm_sub* subs = swbus_shm_subs(swb);
+  struct swbus_shm_rxq* rxqs = swbus_shm_rxqs(swb);
+  struct swbus_shm_cell ent = {
+    .off = res->off,
+    .pkt_size = pkt_size,
+    .pid = pid,
+    .pool = res->pool
+  };
+  size_t n_fails = 0;
+
+  swbus_shm_lock(swb);
+  for (size_t i = swbus_shm_sub_lbound(swb, pid, 0);
+       i < hdr->n_subs && subs[i].pid == pid;
+       ++i) {
+    /* before the entry is visible, so the subscriber can't free the chunk */
+    swbus_shm_ref_add(swb, ent.pool, ent.off);
+    if (OK != swbus_shm_rxq_push(swb, &rxqs[subs[i].rxq], &ent)) {
+      ER_WARN("Failed to notify RXQ %u of PID %d/0x%x on bus '%s': RXQ full",
+              subs[i].rxq,
+              pid,
+              pid,
+              hdr->name);
+      swbus_shm_ref_remove(swb, ent.pool, ent.off);
+      ++n_fails;
+    }
+  } /* for(i..) */
+  swbus_shm_unlock(swb);
+
+  __atomic_fetch_add(&hdr->n_published, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&hdr->n_notify_fails, n_fails, __ATOMIC_RELAXED);
+
+  /* drop the reservation's reference; frees the chunk if nobody subscribed */
+  swbus_shm_ref_remove(swb, res->pool, res->off);
+  res->data = NULL;
+  return (0 == n_fails) ? OK : ERROR;
+} /* swbus_shm_publish_release() */
+
+status_t swbus_shm_rxq_wait(struct swbus_shm* swb,
+                            struct swbus_shm_rxq* rxq,
+                            struct swbus_shm_rxq_ent* ent) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != rxq, NULL != ent);
+
+  return swbus_shm_rxq_wait_impl(swb, rxq, ent, NULL);
+} /* swbus_shm_rxq_wait() */
+
+status_t swbus_shm_rxq_timedwait(struct swbus_shm* swb,
+                                 struct swbus_shm_rxq* rxq,
+                                 struct swbus_shm_rxq_ent* ent,
+                                 const struct timespec* to) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != rxq, NULL != ent, NULL != to);
+
+  /* futex timeouts are against the monotonic clock */
+  struct timespec abs = clock_monotime();
+  time_ts_add(&abs, to);
+  return swbus_shm_rxq_wait_impl(swb, rxq, ent, &abs);
+} /* swbus_shm_rxq_timedwait() */
+
+status_t swbus_shm_rxq_trypop(struct swbus_shm* swb,
+                              struct swbus_shm_rxq* rxq,
+                              struct swbus_shm_rxq_ent* ent) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != rxq, NULL != ent);
+
+  return swbus_shm_rxq_pop(swb, rxq, ent);
+} /* swbus_shm_rxq_trypop() */
+
+status_t swbus_shm_rxq_release(struct swbus_shm* swb,
+                               const struct swbus_shm_rxq_ent* ent) {
+  RCSW_FPC_NV(ERROR,
+              NULL != swb,
+              NULL != ent,
+              ent->pool < swb->hdr->n_pools);
+
+  swbus_shm_ref_remove(swb, ent->pool, ent->off);
+  return OK;
+} /* swbus_shm_rxq_release() */
+
+size_t swbus_shm_rxq_size(const struct swbus_shm_rxq* rxq) {
+  RCSW_FPC_NV(0, NULL != rxq);
+
+  uint64_t deq = __atomic_load_n(&rxq->deq_pos, __ATOMIC_RELAXED);
+  uint64_t enq = __atomic_load_n(&rxq->enq_pos, __ATOMIC_RELAXED);
+  return (enq > deq) ? (size_t)(enq - deq) : 0;
+} /* swbus_shm_rxq_size() */
+
+size_t swbus_shm_pool_size(const struct swbus_shm* swb, size_t pool) {
+  RCSW_FPC_NV(0, NULL != swb, pool < swb->hdr->n_pools);
+
+  return (size_t)__atomic_load_n(&swbus_shm_pools(swb)[pool].n_alloc,
+                                 __ATOMIC_RELAXED);
+} /* swbus_shm_pool_size() */
+
+status_t swbus_shm_meta_get(const struct swbus_shm* swb,
+                            struct swbus_meta* meta) {
+  RCSW_FPC_NV(ERROR, NULL != swb, NULL != meta);
+
+  const struct swbus_shm_hdr* hdr = swb->hdr;
+  meta->n_rxqs = (size_t)__atomic_load_n(&hdr->n_rxqs, __ATOMIC_RELAXED);
+  meta->n_subs = (size_t)__atomic_load_n(&hdr->n_subs, __ATOMIC_RELAXED);
+  meta->n_published = (size_t)__atomic_load_n(&hdr->n_published,
+                                              __ATOMIC_RELAXED);
+  meta->n_notify_fails = (size_t)__atomic_load_n(&hdr->n_notify_fails,
+                                                 __ATOMIC_RELAXED);
+  return OK;
+} /* swbus_shm_meta_get() */
+
+END_C_DECLS
@@ -22,6 +22,10 @@
 #include "rcsw/utils/time.h"
 #include "rcsw/common/alloc.h"
 
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+#include "rcsw/multithread/lockprof.h"
+#endif
+
 /*******************************************************************************
  * Macros
  ******************************************************************************/
@@ -31,6 +35,31 @@
 /*******************************************************************************
  * Private Functions
  ******************************************************************************/
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+/**
+ * \brief Report contention statistics for a single lock.
+ */
+static void grind_report_lock(const char* const name,
+                              const struct lockprof_stats* const stats,
+                              RCSW_UNUSED void* arg) {
+  DPRINTF("\nLock '%s':\n", name);
+  DPRINTF("Acquisitions       : %zu\n", stats->n_acquires);
+  DPRINTF("Contended          : %zu (%.2f%%)\n",
+          stats->n_contended,
+          stats->n_acquires > 0
+              ? 100.0 * stats->n_contended / stats->n_acquires
+              : 0.0);
+  DPRINTF("Wait total         : %zu ns\n", (size_t)stats->wait_total);
+  DPRINTF("Wait max           : %zu ns\n", (size_t)stats->wait_max);
+  DPRINTF("Wait mean          : %.8e ns\n",
+          stats->n_contended > 0
+              ? (double)stats->wait_total / stats->n_contended
+              : 0.0);
+  DPRINTF("Hold total         : %zu ns\n", (size_t)stats->hold_total);
+  DPRINTF("Hold max           : %zu ns\n", (size_t)stats->hold_max);
+} /* grind_report_lock() */
+#endif
+
 /**
  * \brief Report basic statistics for a \ref grindee.
  */
@@ -76,6 +105,17 @@ static void grind_report_stats(const struct grinder* the_grinder,
   DPRINTF("\n\n");
 } /* grind_report_stats() */
 
+/**
+ * \brief Get the \ref grind_hist bin for a value: 1 + floor(log2(val)).
+ */
+static size_t grind_hist_bin(uint64_t val) {
+  if (0 == val) {
+    return 0;
+  }
+  size_t bin = 64 - (size_t)__builtin_clzll(val);
+  return RCSW_MIN(bin, (size_t)RCSW_GRIND_HIST_BINS - 1);
+} /* grind_hist_bin() */
+
 /**
  *  \brief Create and print a histogram for a grindee
  */
@@ -659,8 +699,120 @@ void grind_report_all(const struct grinder* const the_grinder) {
   for (size_t i = 0; i < the_grinder->n_inst; ++i) {
     grind_report(the_grinder, &the_grinder->grindees[i]);
   }
+  if (the_grinder->flags & RCSW_GRIND_REPORT_LOCKS) {
+    grind_report_locks();
+  }
 } /* grind_report_all() */
 
+void grind_hist_record(struct grind_hist* const hist, uint64_t val) {
+  RCSW_FPC_V(NULL != hist);
+
+  __atomic_fetch_add(&hist->bins[grind_hist_bin(val)], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&hist->sum, val, __ATOMIC_RELAXED);
+
+  uint64_t cur = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+  while (val > cur &&
+         !__atomic_compare_exchange_n(&hist->max,
+                                      &cur,
+                                      val,
+                                      true,
+                                      __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+  } /* while() */
+} /* grind_hist_record() */
+
+void grind_hist_snapshot(const struct grind_hist* const hist,
+                         struct grind_hist* const out) {
+  RCSW_FPC_V(NULL != hist, NULL != out);
+
+  for (size_t i = 0; i < RCSW_GRIND_HIST_BINS; ++i) {
+    out->bins[i] = __atomic_load_n(&hist->bins[i], __ATOMIC_RELAXED);
+  } /* for(i..) */
+  out->count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+  out->sum = __atomic_load_n(&hist->sum, __ATOMIC_RELAXED);
+  out->max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+} /* grind_hist_snapshot() */
+
+void grind_hist_reset(struct grind_hist* const hist) {
+  RCSW_FPC_V(NULL != hist);
+
+  for (size_t i = 0; i < RCSW_GRIND_HIST_BINS; ++i) {
+    __atomic_store_n(&hist->bins[i], 0, __ATOMIC_RELAXED);
+  } /* for(i..) */
+  __atomic_store_n(&hist->count, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&hist->sum, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&hist->max, 0, __ATOMIC_RELAXED);
+} /* grind_hist_reset() */
+
+uint64_t grind_hist_percentile(const struct grind_hist* const hist,
+                               double pct) {
+  RCSW_FPC_NV(0, NULL != hist, pct >= 0.0, pct <= 100.0);
+
+  if (0 == hist->count) {
+    return 0;
+  }
+  size_t target = (size_t)ceil(pct / 100.0 * (double)hist->count);
+  size_t seen = 0;
+  for (size_t i = 0; i < RCSW_GRIND_HIST_BINS; ++i) {
+    seen += hist->bins[i];
+    if (seen >= target && seen > 0) {
+      uint64_t upper = (0 == i) ? 0 : ((uint64_t)1 << i) - 1;
+      return RCSW_MIN(upper, hist->max);
+    }
+  } /* for(i..) */
+  return hist->max;
+} /* grind_hist_percentile() */
+
+void grind_hist_report(const char* const name,
+                       const struct grind_hist* const hist) {
+  RCSW_FPC_V(NULL != name, NULL != hist);
+
+  struct grind_hist snap;
+  grind_hist_snapshot(hist, &snap);
+
+  DPRINTF("\nHistogram '%s':\n", name);
+  DPRINTF("Count              : %zu\n", snap.count);
+  DPRINTF("Max                : %zu ns\n", (size_t)snap.max);
+  DPRINTF("Mean               : %.8e ns\n",
+          snap.count > 0 ? (double)snap.sum / (double)snap.count : 0.0);
+  DPRINTF("p50/p99            : %zu/%zu ns\n",
+          (size_t)grind_hist_percentile(&snap, 50.0),
+          (size_t)grind_hist_percentile(&snap, 99.0));
+
+  size_t bin_count_max = 0;
+  for (size_t i = 0; i < RCSW_GRIND_HIST_BINS; ++i) {
+    bin_count_max = RCSW_MAX(bin_count_max, snap.bins[i]);
+  } /* for(i..) */
+
+  for (size_t i = 0; i < RCSW_GRIND_HIST_BINS; ++i) {
+    if (0 == snap.bins[i]) {
+      continue;
+    }
+    /* the last bin is open ended */
+    DPRINTF("%s %12zu ns | %10zu | ",
+            (RCSW_GRIND_HIST_BINS - 1 == i) ? ">=" : "< ",
+            (size_t)((uint64_t)1 << ((RCSW_GRIND_HIST_BINS - 1 == i) ? i - 1
+                                                                       : i)),
+            snap.bins[i]);
+    size_t fill = (size_t)((double)snap.bins[i] / (double)bin_count_max * 40);
+    for (size_t j = 0; j < fill; ++j) {
+      DPRINTF("*");
+    } /* for(j..) */
+    DPRINTF("\n");
+  } /* for(i..) */
+} /* grind_hist_report() */
+
+void grind_report_locks(void) {
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  DPRINTF("----------------------------------------\n");
+  DPRINTF("            LOCK CONTENTION             \n");
+  DPRINTF("----------------------------------------\n");
+  size_t n_locks = lockprof_foreach(grind_report_lock, NULL);
+  DPRINTF("\n%zu lock(s) registered\n\n", n_locks);
+#endif
+} /* grind_report_locks() */
+
 status_t grind_report(const struct grinder* const the_grinder,
                       struct grindee* const grindee) {
   RCSW_FPC_NV(ERROR, NULL != the_grinder, NULL != grindee);
@@ -43,7 +43,8 @@ static void run_test(hashmap_test_t test) {
     RCSW_NOALLOC_DATA,
     RCSW_NOALLOC_META,
     RCSW_DS_SORTED,
-    RCSW_DS_HASHMAP_LINPROB
+    RCSW_DS_HASHMAP_LINPROB,
+    RCSW_DS_HASHMAP_SEQSTATS
   };
 
   uint32_t applied = 0;
@@ -136,7 +137,7 @@ template<typename T>
 static void stats_test(struct hashmap_params *  params) {
   struct hashmap *map;
   struct hashmap mymap;
-  size_t i, j;
+  size_t i, j = 0;
   int failed_count = 0;
 
   params->bsize = TH_NUM_ITEMS * TH_NUM_ITEMS;
@@ -154,9 +155,19 @@ static void stats_test(struct hashmap_params *  params) {
     memcpy(n.key, rand_key, RCSW_HASHMAP_KEYSIZE);
 
     /* we don't care how many things are in the hashmap */
-    hashmap_add(map, n.key, &e);
+    if (OK == hashmap_add(map, n.key, &e)) {
+      ++j;
+    } else {
+      ++failed_count;
+    }
   }
 
+  struct hashmap_stats stats;
+  CATCH_REQUIRE(OK == hashmap_stats_snapshot(map, &stats));
+  CATCH_REQUIRE(stats.n_adds == j);
+  CATCH_REQUIRE(stats.n_nodes == j);
+  CATCH_REQUIRE(stats.n_addfails == (size_t)failed_count);
+
   hashmap_destroy(map);
 } /* stats_test() */
 
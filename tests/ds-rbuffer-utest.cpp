@@ -9,6 +9,10 @@
 /*******************************************************************************
  * Includes
  ******************************************************************************/
+#include <chrono>
+#include <iostream>
+#include <vector>
+
 #define CATCH_CONFIG_MAIN
 #define CATCH_CONFIG_PREFIX_ALL
 #include <catch/catch.hpp>
@@ -317,6 +321,175 @@ static void iter_test(int len, struct rbuffer_params * params) {
   rbuffer_destroy(rb);
 } /* iter_test() */
 
+template<typename T>
+static void region_test(int len, struct rbuffer_params* params) {
+  struct rbuffer *rb;
+  struct rbuffer myrb;
+  size_t n_elts;
+
+  params->flags |= RCSW_DS_RBUFFER_AS_FIFO;
+  rb = rbuffer_init(&myrb, params);
+  CATCH_REQUIRE(rb != nullptr);
+
+  th::element_generator<T> g(gen_elt_type::ekINC_VALS, params->max_elts);
+
+  /* move start into the middle of the array so the valid data wraps */
+  for (int i = 0; i < len / 2 + 1; ++i) {
+    T e = g.next();
+    CATCH_REQUIRE(rbuffer_add(rb, &e) == OK);
+  } /* for(i..) */
+  CATCH_REQUIRE(rbuffer_rd_commit(rb, len / 2 + 1) == OK);
+  CATCH_REQUIRE(rbuffer_isempty(rb));
+  CATCH_REQUIRE(rbuffer_rd_region(rb, &n_elts) == nullptr);
+  CATCH_REQUIRE(n_elts == 0);
+
+  /* fill via write regions--should need two */
+  g.reset();
+  size_t total = 0;
+  for (int pass = 0; pass < 2; ++pass) {
+    T* w = reinterpret_cast<T*>(rbuffer_wr_region(rb, &n_elts));
+    CATCH_REQUIRE(w != nullptr);
+    for (size_t i = 0; i < n_elts; ++i) {
+      w[i] = g.next();
+    } /* for(i..) */
+    CATCH_REQUIRE(rbuffer_wr_commit(rb, n_elts) == OK);
+    total += n_elts;
+  } /* for(pass..) */
+  CATCH_REQUIRE(total == (size_t)len);
+  CATCH_REQUIRE(rbuffer_isfull(rb));
+  CATCH_REQUIRE(rbuffer_wr_region(rb, &n_elts) == nullptr);
+  CATCH_REQUIRE(rbuffer_wr_commit(rb, 1) == ERROR);
+
+  /* read back in order via read regions */
+  size_t count = 0;
+  const T* r = nullptr;
+  while (nullptr != (r = reinterpret_cast<T*>(rbuffer_rd_region(rb,
+                                                                &n_elts)))) {
+    for (size_t i = 0; i < n_elts; ++i) {
+      CATCH_REQUIRE((size_t)r[i].value1 == count + i);
+    } /* for(i..) */
+    count += n_elts;
+    CATCH_REQUIRE(rbuffer_rd_commit(rb, n_elts) == OK);
+  } /* while() */
+  CATCH_REQUIRE(count == (size_t)len);
+  CATCH_REQUIRE(rbuffer_rd_commit(rb, 1) == ERROR);
+
+  rbuffer_destroy(rb);
+} /* region_test() */
+
+template<typename T>
+static void mirrored_test(int len, struct rbuffer_params* params) {
+  struct rbuffer *rb;
+  struct rbuffer myrb;
+  size_t n_elts;
+
+  /* can't mirror memory we don't own */
+  params->flags |= RCSW_DS_RBUFFER_MIRRORED | RCSW_NOALLOC_DATA;
+  CATCH_REQUIRE(rbuffer_init(&myrb, params) == nullptr);
+
+  params->flags &= ~RCSW_NOALLOC_DATA;
+  params->flags |= RCSW_DS_RBUFFER_AS_FIFO;
+  rb = rbuffer_init(&myrb, params);
+  CATCH_REQUIRE(rb != nullptr);
+  CATCH_REQUIRE(rbuffer_capacity(rb) >= (size_t)len);
+
+  size_t cap = rbuffer_capacity(rb);
+  th::element_generator<T> g(gen_elt_type::ekINC_VALS, cap);
+
+  /* move start to the end of the array so the valid data wraps */
+  for (size_t i = 0; i < cap - 1; ++i) {
+    T e = g.next();
+    CATCH_REQUIRE(rbuffer_add(rb, &e) == OK);
+  } /* for(i..) */
+  CATCH_REQUIRE(rbuffer_rd_commit(rb, cap - 1) == OK);
+
+  /* one write region covers all free space */
+  g.reset();
+  T* w = reinterpret_cast<T*>(rbuffer_wr_region(rb, &n_elts));
+  CATCH_REQUIRE(w != nullptr);
+  CATCH_REQUIRE(n_elts == cap);
+  for (size_t i = 0; i < n_elts; ++i) {
+    w[i] = g.next();
+  } /* for(i..) */
+  CATCH_REQUIRE(rbuffer_wr_commit(rb, n_elts) == OK);
+  CATCH_REQUIRE(rbuffer_isfull(rb));
+
+  /* both mappings refer to the same memory */
+  for (size_t i = 0; i < cap; ++i) {
+    auto* base = reinterpret_cast<uint8_t*>(rb->elements);
+    CATCH_REQUIRE(memcmp(base + i * sizeof(T),
+                         base + (i + cap) * sizeof(T),
+                         sizeof(T)) == 0);
+  } /* for(i..) */
+
+  /* one read region covers all valid data */
+  const T* r = reinterpret_cast<T*>(rbuffer_rd_region(rb, &n_elts));
+  CATCH_REQUIRE(r != nullptr);
+  CATCH_REQUIRE(n_elts == cap);
+  for (size_t i = 0; i < n_elts; ++i) {
+    CATCH_REQUIRE(r[i].value1 == (decltype(T::value1))i);
+    CATCH_REQUIRE(memcmp(&r[i],
+                         rbuffer_data_get(rb, rb->start + i),
+                         sizeof(T)) == 0);
+  } /* for(i..) */
+  CATCH_REQUIRE(rbuffer_rd_commit(rb, n_elts) == OK);
+  CATCH_REQUIRE(rbuffer_isempty(rb));
+
+  rbuffer_destroy(rb);
+  params->flags &= ~RCSW_DS_RBUFFER_MIRRORED;
+} /* mirrored_test() */
+
+/**
+ * \brief Push a stream of variable-length records (1 byte length + payload)
+ * through a byte rbuffer in fixed-size chunks, parsing them on the consumer
+ * side. Records which straddle the wraparound point must be copied out unless
+ * the rbuffer is mirrored.
+ *
+ * \return The # of records parsed.
+ */
+static size_t stream_parse(struct rbuffer* rb,
+                           const std::vector<uint8_t>& stream,
+                           size_t chunk,
+                           uint64_t* checksum) {
+  size_t in = 0;
+  size_t n_records = 0;
+  uint8_t scratch[UINT8_MAX + 1];
+
+  while (in < stream.size() || !rbuffer_isempty(rb)) {
+    size_t n_elts;
+    uint8_t* w = reinterpret_cast<uint8_t*>(rbuffer_wr_region(rb, &n_elts));
+    if (nullptr != w && in < stream.size()) {
+      n_elts = std::min({n_elts, chunk, stream.size() - in});
+      memcpy(w, stream.data() + in, n_elts);
+      rbuffer_wr_commit(rb, n_elts);
+      in += n_elts;
+    }
+
+    while (!rbuffer_isempty(rb)) {
+      auto* r = reinterpret_cast<const uint8_t*>(rbuffer_rd_region(rb,
+                                                                   &n_elts));
+      size_t rec_len = 1 + r[0];
+      if (rbuffer_size(rb) < rec_len) {
+        break;
+      }
+      if (n_elts < rec_len) {
+        /* record wraps--copy it out */
+        for (size_t i = 0; i < rec_len; ++i) {
+          void* b = rbuffer_data_get(rb, rb->start + i);
+          scratch[i] = *reinterpret_cast<uint8_t*>(b);
+        } /* for(i..) */
+        r = scratch;
+      }
+      for (size_t i = 1; i < rec_len; ++i) {
+        *checksum += r[i];
+      } /* for(i..) */
+      rbuffer_rd_commit(rb, rec_len);
+      ++n_records;
+    } /* while() */
+  } /* while() */
+  return n_records;
+} /* stream_parse() */
+
 /*******************************************************************************
  * Test Cases
  ******************************************************************************/
@@ -355,3 +528,54 @@ CATCH_TEST_CASE("Iterator Test", "[ds][rbuffer]") {
   run_test<element4>(iter_test<element4>);
   run_test<element8>(iter_test<element8>);
 }
+CATCH_TEST_CASE("Region Test", "[ds][rbuffer]") {
+  run_test<element4>(region_test<element4>);
+  run_test<element8>(region_test<element8>);
+}
+CATCH_TEST_CASE("Mirrored Test", "[ds][rbuffer]") {
+  run_test<element1>(mirrored_test<element1>);
+  run_test<element2>(mirrored_test<element2>);
+  run_test<element4>(mirrored_test<element4>);
+  run_test<element8>(mirrored_test<element8>);
+}
+CATCH_TEST_CASE("Streaming Parse Benchmark", "[.][bench][ds][rbuffer]") {
+  std::vector<uint8_t> stream;
+  size_t n_records = 0;
+  uint64_t expected = 0;
+  while (stream.size() < (64 << 20)) {
+    uint8_t len = static_cast<uint8_t>(1 + rand() % UINT8_MAX);
+    stream.push_back(len);
+    for (size_t i = 0; i < len; ++i) {
+      uint8_t b = static_cast<uint8_t>(rand());
+      stream.push_back(b);
+      expected += b;
+    } /* for(i..) */
+    ++n_records;
+  } /* while() */
+
+  uint32_t flags[] = { RCSW_DS_RBUFFER_AS_FIFO,
+                       RCSW_DS_RBUFFER_AS_FIFO | RCSW_DS_RBUFFER_MIRRORED };
+  for (auto f : flags) {
+    for (size_t chunk : {64, 512, 4096}) {
+      struct rbuffer_params params;
+      memset(&params, 0, sizeof(params));
+      params.elt_size = 1;
+      params.max_elts = 4096;
+      params.flags = f;
+      struct rbuffer* rb = rbuffer_init(nullptr, &params);
+      CATCH_REQUIRE(rb != nullptr);
+
+      uint64_t checksum = 0;
+      auto start = std::chrono::steady_clock::now();
+      CATCH_REQUIRE(stream_parse(rb, stream, chunk, &checksum) == n_records);
+      auto end = std::chrono::steady_clock::now();
+      CATCH_REQUIRE(checksum == expected);
+
+      double secs = std::chrono::duration<double>(end - start).count();
+      std::cout << ((f & RCSW_DS_RBUFFER_MIRRORED) ? "mirrored" : "plain   ")
+                << " chunk=" << chunk
+                << ": " << stream.size() / secs / (1 << 20) << " MiB/s\n";
+      rbuffer_destroy(rb);
+    } /* for(chunk..) */
+  } /* for(f..) */
+}
@@ -0,0 +1,240 @@
+/**
+ * \file mp-procm-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multiprocess/procm.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_N_JOBS 64
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+/*
+ * A shell command to run as a job, and space for its argv and output.
+ */
+struct sh_job {
+  explicit sh_job(const std::string& script)
+      : script(script), argv{(char*)"/bin/sh", (char*)"-c", nullptr, nullptr} {
+    argv[2] = (char*)this->script.c_str();
+  }
+  std::string script;
+  char* argv[4];
+  char output[64]{};
+  struct procm_job job{};
+};
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+/*
+ * Read everything from a pipe until EOF.
+ */
+static std::string read_all(int fd) {
+  std::string out;
+  char buf[256];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    out.append(buf, (size_t)n);
+  } /* while() */
+  return out;
+} /* read_all() */
+
+static void count_done(struct procm_job*, void* arg) {
+  ++*(size_t*)arg;
+} /* count_done() */
+
+/*
+ * Run /bin/true \p n times one after the other with \p launch, and return the #
+ * of launches/sec.
+ */
+template <typename T>
+static double launch_rate(size_t n, const T& launch) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    pid_t pid = launch();
+    CATCH_REQUIRE(pid > 0);
+    CATCH_REQUIRE(pid == waitpid(pid, nullptr, 0));
+  } /* for(i..) */
+  auto end = std::chrono::steady_clock::now();
+  return n / std::chrono::duration<double>(end - start).count();
+} /* launch_rate() */
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void spawn_test(const char* new_wd) {
+  int fds[2];
+  CATCH_REQUIRE(0 == pipe(fds));
+  char* cmd[] = {(char*)"/bin/sh", (char*)"-c", (char*)"pwd; exit 3", nullptr};
+  struct procm_spawn_params params = {cmd, nullptr, new_wd, -1, fds[1], -1};
+
+  pid_t pid = procm_spawn(&params);
+  CATCH_REQUIRE(pid > 0);
+  close(fds[1]);
+  std::string out = read_all(fds[0]);
+  close(fds[0]);
+
+  int status;
+  CATCH_REQUIRE(pid == waitpid(pid, &status, 0));
+  CATCH_REQUIRE(WIFEXITED(status));
+  CATCH_REQUIRE(3 == WEXITSTATUS(status));
+  if (nullptr != new_wd) {
+    CATCH_REQUIRE(std::string(new_wd) + "\n" == out);
+  } else {
+    CATCH_REQUIRE(!out.empty());
+  }
+
+  /* exec() failures are reported to the caller */
+  char* bad[] = {(char*)"/nonexistent/cmd", nullptr};
+  params.cmd = bad;
+  CATCH_REQUIRE(-1 == procm_spawn(&params));
+} /* spawn_test() */
+
+static void pool_test(size_t max_procs, size_t max_jobs) {
+  size_t n_done = 0;
+  struct procm_pool_params params;
+  params.max_procs = max_procs;
+  params.max_jobs = max_jobs;
+  params.done = count_done;
+  params.done_arg = &n_done;
+  params.flags = RCSW_NOALLOC_HANDLE;
+
+  struct procm_pool pool_in;
+  struct procm_pool* pool = procm_pool_init(&pool_in, &params);
+  CATCH_REQUIRE(nullptr != pool);
+
+  std::vector<std::unique_ptr<sh_job>> jobs;
+  for (size_t i = 0; i < TH_N_JOBS; ++i) {
+    auto script = "echo " + std::to_string(i) + "; exit " +
+                  std::to_string(i % 3);
+    jobs.push_back(std::make_unique<sh_job>(script));
+    auto& j = *jobs.back();
+    j.job.cmd = j.argv;
+    j.job.output = j.output;
+    j.job.output_size = sizeof(j.output);
+    CATCH_REQUIRE(OK == procm_pool_submit(pool, &j.job));
+    CATCH_REQUIRE(pool->n_running <= pool->max_procs);
+  } /* for(i..) */
+
+  /* output past the end of the buffer is dropped */
+  sh_job small("echo hello");
+  small.job.cmd = small.argv;
+  small.job.output = small.output;
+  small.job.output_size = 2;
+  CATCH_REQUIRE(OK == procm_pool_submit(pool, &small.job));
+
+  /* a job which can't be started still finishes */
+  char* bad[] = {(char*)"/nonexistent/cmd", nullptr};
+  struct procm_job bad_job = {};
+  bad_job.cmd = bad;
+  CATCH_REQUIRE(OK == procm_pool_submit(pool, &bad_job));
+
+  CATCH_REQUIRE(OK == procm_pool_wait(pool));
+  CATCH_REQUIRE(0 == procm_pool_pending(pool));
+  CATCH_REQUIRE(TH_N_JOBS + 2 == n_done);
+
+  for (size_t i = 0; i < TH_N_JOBS; ++i) {
+    auto& j = *jobs[i];
+    CATCH_REQUIRE(WIFEXITED(j.job.status));
+    CATCH_REQUIRE((int)(i % 3) == WEXITSTATUS(j.job.status));
+    CATCH_REQUIRE(std::to_string(i) + "\n" ==
+                  std::string(j.output, j.job.output_len));
+  } /* for(i..) */
+  CATCH_REQUIRE(2 == small.job.output_len);
+  CATCH_REQUIRE(0 == std::memcmp("he", small.output, 2));
+  CATCH_REQUIRE(-1 == bad_job.status);
+
+  /* the pool can be reused, and nothing to do returns right away */
+  CATCH_REQUIRE(0 == procm_pool_poll(pool, -1));
+  jobs[0]->job.new_wd = "/";
+  jobs[0]->script = "pwd";
+  jobs[0]->argv[2] = (char*)jobs[0]->script.c_str();
+  CATCH_REQUIRE(OK == procm_pool_submit(pool, &jobs[0]->job));
+  CATCH_REQUIRE(OK == procm_pool_wait(pool));
+  CATCH_REQUIRE("/\n" == std::string(jobs[0]->output,
+                                     jobs[0]->job.output_len));
+  procm_pool_destroy(pool);
+} /* pool_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Spawn Test", "[mp][procm]") {
+  spawn_test(nullptr);
+  spawn_test("/");
+  spawn_test("/tmp");
+
+  char* cmd[] = {(char*)"/bin/true", nullptr};
+  struct procm_spawn_params params = {cmd, nullptr, "/nonexistent", -1, -1, -1};
+  CATCH_REQUIRE(-1 == procm_spawn(&params));
+}
+
+CATCH_TEST_CASE("Pool Test", "[mp][procm]") {
+  pool_test(1, 1);
+  pool_test(4, 2);
+  pool_test(16, TH_N_JOBS);
+  pool_test(0, 8);
+}
+
+CATCH_TEST_CASE("Spawn Benchmark", "[.][bench][mp][procm]") {
+  const size_t kN = 500;
+  char* cmd[] = {(char*)"/bin/true", nullptr};
+  struct procm_spawn_params params = {cmd, nullptr, nullptr, -1, -1, -1};
+
+  /* fork() has to copy the page tables for all of this */
+  for (size_t mb : {0, 256, 1024}) {
+    std::vector<char> ballast(mb << 20, 1);
+
+    double fork_rate = launch_rate(kN, [&]() {
+        return procm_fork_exec(cmd, nullptr, false, nullptr);
+      });
+    double spawn_rate = launch_rate(kN, [&]() {
+        return procm_spawn(&params);
+      });
+
+    size_t n_done = 0;
+    struct procm_pool_params pool_params = {0, kN, count_done, &n_done, 0};
+    struct procm_pool* pool = procm_pool_init(nullptr, &pool_params);
+    CATCH_REQUIRE(nullptr != pool);
+    std::vector<struct procm_job> jobs(kN);
+    auto start = std::chrono::steady_clock::now();
+    for (auto& job : jobs) {
+      job.cmd = cmd;
+      CATCH_REQUIRE(OK == procm_pool_submit(pool, &job));
+    } /* for(job..) */
+    CATCH_REQUIRE(OK == procm_pool_wait(pool));
+    auto end = std::chrono::steady_clock::now();
+    double pool_rate = kN / std::chrono::duration<double>(end - start).count();
+    CATCH_REQUIRE(kN == n_done);
+
+    std::cout << mb << " MB parent: fork+exec " << (size_t)fork_rate
+              << "/s, spawn " << (size_t)spawn_rate << "/s, pool ("
+              << pool->max_procs << " procs) " << (size_t)pool_rate << "/s"
+              << std::endl;
+    procm_pool_destroy(pool);
+  } /* for(mb..) */
+}
@@ -0,0 +1,239 @@
+/**
+ * \file mt-bcring-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/bcring.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_ELT_SIZE 16
+#define TH_NUM_CONSUMERS 12
+#define TH_NUM_MT_ITEMS 20000
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using bcring_test = void(*)(const struct bcring_params* const params);
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+/**
+ * \brief The value of byte \p j of the \p i-th element added to the ring.
+ */
+static uint8_t byte_value(size_t i, size_t j) {
+  return (uint8_t)(i * TH_ELT_SIZE + j);
+}
+
+static void elt_fill(uint8_t* elt, size_t i) {
+  for (size_t j = 0; j < TH_ELT_SIZE; ++j) {
+    elt[j] = byte_value(i, j);
+  } /* for(j..) */
+}
+
+/**
+ * \brief Check that the \p k-th chunk of size \p chunk_size read by a consumer
+ * is what was put in.
+ */
+static bool chunk_check(const uint8_t* chunk, size_t chunk_size, size_t k) {
+  size_t n_chunks = TH_ELT_SIZE / chunk_size;
+  size_t i = k / n_chunks;
+  size_t offset = (k % n_chunks) * chunk_size;
+  for (size_t j = 0; j < chunk_size; ++j) {
+    if (chunk[j] != byte_value(i, offset + j)) {
+      return false;
+    }
+  } /* for(j..) */
+  return true;
+}
+
+static void run_test(bcring_test test) {
+  struct bcring_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = TH_ELT_SIZE;
+
+  /* more than 8 consumers, all reading different chunk sizes */
+  size_t chunks[TH_NUM_CONSUMERS];
+  for (size_t i = 0; i < TH_NUM_CONSUMERS; ++i) {
+    chunks[i] = 1 << (i % 5);
+  } /* for(i..) */
+  params.chunks = chunks;
+  params.n_consumers = TH_NUM_CONSUMERS;
+
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_ZALLOC,
+    RCSW_NOALLOC_HANDLE,
+    RCSW_NOALLOC_HANDLE | RCSW_NOALLOC_DATA | RCSW_NOALLOC_META,
+  };
+  std::vector<uint8_t> meta(bcring_meta_space(TH_NUM_CONSUMERS));
+  params.meta = reinterpret_cast<dptr_t*>(meta.data());
+
+  for (size_t max_elts : {1, 7, 64}) {
+    params.max_elts = max_elts;
+    std::vector<uint8_t> elements(bcring_element_space(max_elts,
+                                                       TH_ELT_SIZE));
+    params.elements = reinterpret_cast<dptr_t*>(elements.data());
+    for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+      params.flags = flags[i];
+      test(&params);
+    } /* for(i..) */
+  } /* for(max_elts..) */
+} /* run_test() */
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void serial_test(const struct bcring_params* const params) {
+  struct bcring ring_in;
+  struct bcring* ring = bcring_init(&ring_in, params);
+  CATCH_REQUIRE(nullptr != ring);
+  CATCH_REQUIRE(bcring_capacity(ring) == params->max_elts);
+  CATCH_REQUIRE(0 == bcring_size(ring));
+
+  uint8_t chunk[TH_ELT_SIZE];
+  for (size_t c = 0; c < params->n_consumers; ++c) {
+    CATCH_REQUIRE(nullptr == bcring_front(ring, c));
+    CATCH_REQUIRE(ERROR == bcring_remove(ring, c, chunk));
+    CATCH_REQUIRE(EAGAIN == errno);
+  } /* for(c..) */
+
+  std::vector<size_t> n_read(params->n_consumers, 0);
+  size_t n_added = 0;
+  uint8_t elt[TH_ELT_SIZE];
+
+  for (size_t round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < params->max_elts; ++i) {
+      elt_fill(elt, n_added++);
+      CATCH_REQUIRE(OK == bcring_add(ring, elt));
+    } /* for(i..) */
+    CATCH_REQUIRE(bcring_size(ring) == params->max_elts);
+    CATCH_REQUIRE(ERROR == bcring_add(ring, elt));
+    CATCH_REQUIRE(EAGAIN == errno);
+
+    /* all but the last consumer read everything; ring is still full */
+    for (size_t c = 0; c < params->n_consumers - 1; ++c) {
+      size_t chunk_size = params->chunks[c];
+      size_t avail = bcring_consumer_size(ring, c);
+      CATCH_REQUIRE(avail == params->max_elts * TH_ELT_SIZE / chunk_size);
+      for (size_t k = 0; k < avail; ++k) {
+        CATCH_REQUIRE(OK == bcring_remove(ring, c, chunk));
+        CATCH_REQUIRE(chunk_check(chunk, chunk_size, n_read[c]++));
+      } /* for(k..) */
+      CATCH_REQUIRE(nullptr == bcring_front(ring, c));
+    } /* for(c..) */
+    CATCH_REQUIRE(ERROR == bcring_add(ring, elt));
+
+    /* last consumer reads in place, and frees up slots as it goes */
+    size_t last = params->n_consumers - 1;
+    size_t chunk_size = params->chunks[last];
+    size_t avail = bcring_consumer_size(ring, last);
+    for (size_t k = 0; k < avail; ++k) {
+      auto* front = static_cast<uint8_t*>(bcring_front(ring, last));
+      CATCH_REQUIRE(nullptr != front);
+      CATCH_REQUIRE(chunk_check(front, chunk_size, n_read[last]++));
+      CATCH_REQUIRE(OK == bcring_remove(ring, last, nullptr));
+    } /* for(k..) */
+    CATCH_REQUIRE(0 == bcring_size(ring));
+  } /* for(round..) */
+
+  bcring_destroy(ring);
+} /* serial_test() */
+
+static void concurrent_test(const struct bcring_params* const params) {
+  struct bcring ring_in;
+  struct bcring* ring = bcring_init(&ring_in, params);
+  CATCH_REQUIRE(nullptr != ring);
+
+  std::vector<size_t> n_bad(params->n_consumers, 0);
+  std::vector<std::thread> consumers;
+
+  for (size_t c = 0; c < params->n_consumers; ++c) {
+    consumers.emplace_back([&, c]() {
+                             size_t chunk_size = params->chunks[c];
+                             size_t total = TH_NUM_MT_ITEMS * TH_ELT_SIZE /
+                                            chunk_size;
+                             uint8_t chunk[TH_ELT_SIZE];
+                             for (size_t k = 0; k < total;) {
+                               if (OK != bcring_remove(ring, c, chunk)) {
+                                 std::this_thread::yield();
+                                 continue;
+                               }
+                               n_bad[c] += !chunk_check(chunk, chunk_size, k);
+                               ++k;
+                             } /* for(k..) */
+                           });
+  } /* for(c..) */
+
+  uint8_t elt[TH_ELT_SIZE];
+  for (size_t i = 0; i < TH_NUM_MT_ITEMS;) {
+    elt_fill(elt, i);
+    if (OK != bcring_add(ring, elt)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ++i;
+  } /* for(i..) */
+
+  for (auto& t : consumers) {
+    t.join();
+  } /* for(&t..) */
+
+  for (size_t c = 0; c < params->n_consumers; ++c) {
+    CATCH_REQUIRE(0 == n_bad[c]);
+    CATCH_REQUIRE(0 == bcring_consumer_size(ring, c));
+  } /* for(c..) */
+  CATCH_REQUIRE(0 == bcring_size(ring));
+
+  bcring_destroy(ring);
+} /* concurrent_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Serial Test", "[mt][bcring]") {
+  run_test(serial_test);
+}
+
+CATCH_TEST_CASE("Concurrency Test", "[mt][bcring]") {
+  run_test(concurrent_test);
+}
+
+CATCH_TEST_CASE("No Consumers Test", "[mt][bcring]") {
+  struct bcring_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = TH_ELT_SIZE;
+  params.max_elts = 4;
+
+  struct bcring* ring = bcring_init(nullptr, &params);
+  CATCH_REQUIRE(nullptr != ring);
+
+  /* nobody is reading, so the ring never fills up */
+  uint8_t elt[TH_ELT_SIZE] = {0};
+  for (size_t i = 0; i < 100; ++i) {
+    CATCH_REQUIRE(OK == bcring_add(ring, elt));
+  } /* for(i..) */
+  CATCH_REQUIRE(0 == bcring_size(ring));
+  bcring_destroy(ring);
+
+  /* chunk sizes which don't divide the element size are rejected */
+  size_t chunks[] = {3};
+  params.n_consumers = 1;
+  params.chunks = chunks;
+  CATCH_REQUIRE(nullptr == bcring_init(nullptr, &params));
+}
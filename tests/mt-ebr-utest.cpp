@@ -0,0 +1,315 @@
+/**
+ * \file mt-ebr-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/ebr.h"
+#include "rcsw/common/alloc.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_MAX_THREADS 8
+#define TH_RETIRE_MAX 16
+#define TH_POOL_SIZE 128
+#define TH_MAGIC_LIVE 0x11FE11FEU
+#define TH_MAGIC_DEAD 0xDEADDEADU
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using ebr_test = void(*)(struct ebr_params* params);
+
+struct node {
+  uint32_t magic;
+  size_t val;
+};
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+static void run_test(ebr_test test) {
+  struct ebr_params params = {};
+  params.max_threads = TH_MAX_THREADS;
+  params.retire_max = TH_RETIRE_MAX;
+  params.period = {.tv_sec = 0, .tv_nsec = 1000000};
+  params.meta = (dptr_t*)malloc(ebr_meta_space(TH_MAX_THREADS));
+  params.elements = (dptr_t*)malloc(ebr_element_space(TH_MAX_THREADS,
+                                                      TH_RETIRE_MAX));
+
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE,
+    RCSW_NOALLOC_DATA | RCSW_NOALLOC_META,
+    RCSW_EBR_RECLAIMER,
+  };
+
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+    params.flags = flags[i];
+    test(&params);
+  } /* for(i..) */
+
+  free(params.meta);
+  free(params.elements);
+} /* run_test() */
+
+static struct ebr* th_ebr_init(struct ebr* ebr_in,
+                               const struct ebr_params* params) {
+  if (params->flags & RCSW_NOALLOC_HANDLE) {
+    return ebr_init(ebr_in, params);
+  }
+  return ebr_init(nullptr, params);
+}
+
+static struct mpool* th_pool_init(struct mpool* pool_in) {
+  struct mpool_params params = {};
+  params.elt_size = sizeof(struct node);
+  params.max_elts = TH_POOL_SIZE;
+  params.flags = RCSW_NOALLOC_HANDLE;
+  return mpool_init(pool_in, &params);
+}
+
+/* Poison nodes on reclaim, so that readers can detect premature reclaims */
+static void th_node_reclaim(void* ctx, void* ptr) {
+  ((struct node*)ptr)->magic = TH_MAGIC_DEAD;
+  mpool_release((struct mpool*)ctx, ptr);
+}
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void simple_test(struct ebr_params* params) {
+  struct ebr ebr_in;
+  struct ebr* ebr = th_ebr_init(&ebr_in, params);
+  CATCH_REQUIRE(nullptr != ebr);
+  struct mpool pool_in;
+  struct mpool* pool = th_pool_init(&pool_in);
+  CATCH_REQUIRE(nullptr != pool);
+
+  /* registration */
+  std::vector<struct ebr_rec*> recs;
+  for (size_t i = 0; i < TH_MAX_THREADS; ++i) {
+    recs.push_back(ebr_register(ebr));
+    CATCH_REQUIRE(nullptr != recs.back());
+  } /* for(i..) */
+  CATCH_REQUIRE(nullptr == ebr_register(ebr));
+  for (size_t i = 1; i < TH_MAX_THREADS; ++i) {
+    ebr_unregister(recs[i]);
+  } /* for(i..) */
+  struct ebr_rec* rec = recs[0];
+  struct ebr_rec* reader = ebr_register(ebr);
+  CATCH_REQUIRE(nullptr != reader);
+
+  /* a reader in a critical section holds off reclamation */
+  ebr_enter(reader);
+  ebr_enter(reader);
+  ebr_exit(reader);
+  void* chunk = mpool_req(pool);
+  CATCH_REQUIRE(nullptr != chunk);
+  CATCH_REQUIRE(OK == ebr_retire_mpool(rec, pool, chunk));
+  void* mem = rcsw_alloc(nullptr, 32, RCSW_NONE);
+  CATCH_REQUIRE(OK == ebr_retire_free(rec, mem));
+  if (!(params->flags & RCSW_EBR_RECLAIMER)) {
+    for (size_t i = 0; i < 4; ++i) {
+      CATCH_REQUIRE(0 == ebr_reclaim(ebr));
+    } /* for(i..) */
+  }
+  CATCH_REQUIRE(1 == mpool_size(pool));
+
+  /* after it leaves, two epoch advances reclaim everything */
+  ebr_exit(reader);
+  if (params->flags & RCSW_EBR_RECLAIMER) {
+    while (!mpool_isempty(pool)) {
+      std::this_thread::yield();
+    } /* while() */
+  } else {
+    CATCH_REQUIRE(2 == ebr_reclaim(ebr) + ebr_reclaim(ebr));
+  }
+  CATCH_REQUIRE(mpool_isempty(pool));
+
+  /* a full retire list reclaims on its own, if it can */
+  for (size_t i = 0; i < TH_RETIRE_MAX * 4; ++i) {
+    chunk = mpool_req(pool);
+    CATCH_REQUIRE(nullptr != chunk);
+    CATCH_REQUIRE(OK == ebr_retire_mpool(rec, pool, chunk));
+  } /* for(i..) */
+
+  /* ...but not if a reader is stuck */
+  ebr_enter(reader);
+  while (OK == ebr_retire_mpool(rec, pool, mpool_req(pool))) {
+  } /* while() */
+  CATCH_REQUIRE(ENOMEM == errno);
+  CATCH_REQUIRE(ERROR == ebr_retire_reserve(rec));
+  ebr_exit(reader);
+  CATCH_REQUIRE(OK == ebr_retire_reserve(rec));
+
+  /* QSBR style */
+  ebr_enter(reader);
+  uint64_t epoch = reader->epoch;
+  ebr_reclaim(ebr);
+  ebr_quiescent(reader);
+  CATCH_REQUIRE(reader->epoch > epoch);
+  ebr_exit(reader);
+
+  ebr_unregister(rec);
+  ebr_unregister(reader);
+
+  /* everything left is reclaimed on destroy */
+  ebr_destroy(ebr);
+  CATCH_REQUIRE(mpool_size(pool) <= 1);
+  mpool_destroy(pool);
+} /* simple_test() */
+
+/* Two writers each replace and retire a shared node kIters times */
+template<size_t kIters>
+static void stress_test(struct ebr_params* params) {
+  struct ebr ebr_in;
+  struct ebr* ebr = th_ebr_init(&ebr_in, params);
+  CATCH_REQUIRE(nullptr != ebr);
+  struct mpool pool_in;
+  struct mpool* pool = th_pool_init(&pool_in);
+  CATCH_REQUIRE(nullptr != pool);
+
+  struct node* first = (struct node*)mpool_req(pool);
+  first->magic = TH_MAGIC_LIVE;
+  first->val = 0;
+  struct node* shared = first;
+
+  std::atomic_bool done(false);
+  std::atomic_size_t n_bad(0);
+
+  auto reader = [&]() {
+    struct ebr_rec* rec = ebr_register(ebr);
+    CATCH_REQUIRE(nullptr != rec);
+    while (!done) {
+      ebr_enter(rec);
+      struct node* n = __atomic_load_n(&shared, __ATOMIC_ACQUIRE);
+      size_t val = n->val;
+      /* give writers a chance to retire it out from under us */
+      for (size_t i = 0; i < 100; ++i) {
+        asm volatile("" ::: "memory");
+      } /* for(i..) */
+      if (TH_MAGIC_LIVE != __atomic_load_n(&n->magic, __ATOMIC_RELAXED) ||
+          val != n->val) {
+        ++n_bad;
+      }
+      ebr_exit(rec);
+    } /* while() */
+    ebr_unregister(rec);
+  };
+  auto writer = [&](size_t id) {
+    struct ebr_rec* rec = ebr_register(ebr);
+    CATCH_REQUIRE(nullptr != rec);
+    for (size_t i = 0; i < kIters; ++i) {
+      struct node* next;
+      struct timespec to = {.tv_sec = 0, .tv_nsec = 100000};
+      while (OK != mpool_timedreq(pool, &to, (void**)&next)) {
+        ebr_reclaim(ebr);
+      } /* while() */
+      next->magic = TH_MAGIC_LIVE;
+      next->val = id * 1000000 + i;
+
+      struct node* old = __atomic_exchange_n(&shared, next, __ATOMIC_ACQ_REL);
+      while (OK != ebr_retire(rec, old, th_node_reclaim, pool)) {
+        std::this_thread::yield();
+      } /* while() */
+    } /* for(i..) */
+    ebr_unregister(rec);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 3; ++i) {
+    threads.emplace_back(reader);
+  } /* for(i..) */
+  std::thread w1(writer, 1);
+  std::thread w2(writer, 2);
+  w1.join();
+  w2.join();
+  done = true;
+  for (auto& t : threads) {
+    t.join();
+  } /* for(t..) */
+
+  CATCH_REQUIRE(0 == n_bad);
+  ebr_destroy(ebr);
+
+  /* only the current node is still allocated */
+  CATCH_REQUIRE(1 == mpool_size(pool));
+  mpool_destroy(pool);
+} /* stress_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Simple Test", "[mt][ebr]") {
+  run_test(simple_test);
+}
+
+CATCH_TEST_CASE("Stress Test", "[mt][ebr]") {
+  run_test(stress_test<500>);
+}
+
+CATCH_TEST_CASE("Long Stress Test", "[.][mt][ebr]") {
+  run_test(stress_test<5000>);
+}
+
+CATCH_TEST_CASE("Read Overhead Benchmark", "[.][bench][mt][ebr]") {
+  const size_t kOps = 50000000;
+  struct ebr_params params = {};
+  params.max_threads = 1;
+  params.retire_max = 1;
+  params.flags = RCSW_NONE;
+  struct ebr* ebr = ebr_init(nullptr, &params);
+  CATCH_REQUIRE(nullptr != ebr);
+  struct ebr_rec* rec = ebr_register(ebr);
+
+  size_t val = 17;
+  size_t* shared = &val;
+  size_t sum = 0;
+
+  for (int mode = 0; mode < 3; ++mode) {
+    auto start = std::chrono::steady_clock::now();
+    if (1 == mode) {
+      ebr_enter(rec);
+    }
+    for (size_t i = 0; i < kOps; ++i) {
+      if (0 == mode) {
+        ebr_enter(rec);
+      }
+      sum += *__atomic_load_n(&shared, __ATOMIC_ACQUIRE);
+      if (0 == mode) {
+        ebr_exit(rec);
+      } else if (1 == mode && 0 == (i & 0xFF)) {
+        ebr_quiescent(rec);
+      }
+    } /* for(i..) */
+    if (1 == mode) {
+      ebr_exit(rec);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    const char* names[] = {"ebr enter/exit", "qsbr (1/256)", "unprotected"};
+    std::cout << names[mode] << ": " << ns / kOps << " ns/read" << std::endl;
+  } /* for(mode..) */
+  CATCH_REQUIRE(sum == 3 * kOps * 17);
+
+  ebr_unregister(rec);
+  ebr_destroy(ebr);
+}
@@ -0,0 +1,323 @@
+/**
+ * \file mt-lockprof-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/lockprof.h"
+#include "rcsw/multithread/mutex.h"
+#include "rcsw/multithread/condv.h"
+#include "rcsw/multithread/csem.h"
+#include "rcsw/multithread/rdwrlock.h"
+#include "rcsw/tool/grind.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_N_THREADS 4
+#define TH_N_ITERS 10000
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using lockprof_test = void(*)(uint32_t flags);
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+static void run_test(lockprof_test test) {
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE,
+  };
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+    test(flags[i]);
+  } /* for(i..) */
+} /* run_test() */
+
+static void th_count_cb(const char* name,
+                        const struct lockprof_stats* stats,
+                        void* arg) {
+  (void)name;
+  (void)stats;
+  ++*(size_t*)arg;
+} /* th_count_cb() */
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+static void th_stats_check(const char* name,
+                           size_t n_acquires,
+                           bool exclusive) {
+  struct lockprof_stats stats;
+  CATCH_REQUIRE(OK == lockprof_lookup(name, &stats));
+  CATCH_REQUIRE(n_acquires == stats.n_acquires);
+  CATCH_REQUIRE(stats.n_contended <= stats.n_acquires);
+  CATCH_REQUIRE(stats.wait_max <= stats.wait_total);
+  if (0 == stats.n_contended) {
+    CATCH_REQUIRE(0 == stats.wait_total);
+  }
+  if (exclusive) {
+    CATCH_REQUIRE(stats.hold_total > 0);
+    CATCH_REQUIRE(stats.hold_max <= stats.hold_total);
+  } else {
+    CATCH_REQUIRE(0 == stats.hold_total);
+  }
+} /* th_stats_check() */
+#endif
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void registry_test(uint32_t flags) {
+  (void)flags;
+  struct lockprof prof1;
+  struct lockprof prof2;
+  struct lockprof_stats stats;
+  lockprof_init(&prof1);
+  lockprof_init(&prof2);
+
+  CATCH_REQUIRE(!lockprof_enabled(&prof1));
+  CATCH_REQUIRE(ERROR == lockprof_register(&prof1, ""));
+  CATCH_REQUIRE(OK == lockprof_register(&prof1, "prof1"));
+  CATCH_REQUIRE(lockprof_enabled(&prof1));
+  CATCH_REQUIRE(ERROR == lockprof_register(&prof1, "prof1"));
+  CATCH_REQUIRE(OK == lockprof_register(&prof2,
+                                        "a-really-long-name-which-is-truncated"));
+  CATCH_REQUIRE(RCSW_LOCKPROF_NAMELEN - 1 == strlen(prof2.name));
+
+  size_t count = 0;
+  CATCH_REQUIRE(2 == lockprof_foreach(th_count_cb, &count));
+  CATCH_REQUIRE(2 == count);
+
+  /* exclusive acquire/release, one of them contended */
+  lockprof_acquired(&prof1, false, 0, true);
+  lockprof_released(&prof1);
+  uint64_t start = lockprof_now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  lockprof_acquired(&prof1, true, start, true);
+  lockprof_released(&prof1);
+
+  CATCH_REQUIRE(OK == lockprof_lookup("prof1", &stats));
+  CATCH_REQUIRE(2 == stats.n_acquires);
+  CATCH_REQUIRE(1 == stats.n_contended);
+  CATCH_REQUIRE(stats.wait_total >= 1000000);
+  CATCH_REQUIRE(stats.wait_max == stats.wait_total);
+  CATCH_REQUIRE(stats.hold_max <= stats.hold_total);
+
+  lockprof_reset_all();
+  CATCH_REQUIRE(OK == lockprof_lookup("prof1", &stats));
+  CATCH_REQUIRE(0 == stats.n_acquires);
+  CATCH_REQUIRE(0 == stats.wait_total);
+
+  lockprof_unregister(&prof1);
+  CATCH_REQUIRE(!lockprof_enabled(&prof1));
+  CATCH_REQUIRE(ERROR == lockprof_lookup("prof1", &stats));
+  lockprof_unregister(&prof1);
+  lockprof_unregister(&prof2);
+  CATCH_REQUIRE(0 == lockprof_foreach(th_count_cb, &count));
+} /* registry_test() */
+
+static void mutex_test(uint32_t flags) {
+  struct mutex mtx_in;
+  struct mutex* mtx = mutex_init(&mtx_in, flags);
+  CATCH_REQUIRE(nullptr != mtx);
+  RCSW_LOCKPROF_REGISTER(mtx, "mutex");
+
+  size_t count = 0;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < TH_N_THREADS; ++i) {
+    threads.emplace_back([&]() {
+        for (size_t j = 0; j < TH_N_ITERS; ++j) {
+          mutex_lock(mtx);
+          ++count;
+          mutex_unlock(mtx);
+        } /* for(j..) */
+      });
+  } /* for(i..) */
+  for (auto& t : threads) {
+    t.join();
+  } /* for(t..) */
+  CATCH_REQUIRE(TH_N_THREADS * TH_N_ITERS == count);
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  th_stats_check("mutex", TH_N_THREADS * TH_N_ITERS, true);
+  grind_report_locks();
+#endif
+
+  /* destroying a lock removes it from the registry */
+  mutex_destroy(mtx);
+  struct lockprof_stats stats;
+  CATCH_REQUIRE(ERROR == lockprof_lookup("mutex", &stats));
+} /* mutex_test() */
+
+static void held_test(uint32_t flags) {
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  struct mutex mtx_in;
+  struct mutex* mtx = mutex_init(&mtx_in, flags);
+  struct condv cv_in;
+  struct condv* cv = condv_init(&cv_in, flags);
+  CATCH_REQUIRE(nullptr != mtx);
+  CATCH_REQUIRE(nullptr != cv);
+  struct lockprof_stats stats;
+
+  /* registered while held: no idea how long it was held */
+  mutex_lock(mtx);
+  RCSW_LOCKPROF_REGISTER(mtx, "held");
+  mutex_unlock(mtx);
+  CATCH_REQUIRE(OK == lockprof_lookup("held", &stats));
+  CATCH_REQUIRE(0 == stats.hold_total);
+
+  /* waiting on a condition variable doesn't count as holding the mutex */
+  const long kWaitNs = 20000000;
+  struct timespec to = {.tv_sec = 0, .tv_nsec = kWaitNs};
+  mutex_lock(mtx);
+  CATCH_REQUIRE(ERROR == condv_timedwait(cv, mtx, &to));
+  mutex_unlock(mtx);
+  CATCH_REQUIRE(OK == lockprof_lookup("held", &stats));
+  CATCH_REQUIRE(stats.hold_total > 0);
+  CATCH_REQUIRE(stats.hold_max < (uint64_t)kWaitNs);
+
+  condv_destroy(cv);
+  mutex_destroy(mtx);
+#else
+  (void)flags;
+#endif
+} /* held_test() */
+
+static void csem_test(uint32_t flags) {
+  struct csem sem_in;
+  struct csem* sem = csem_init(&sem_in, 0, flags);
+  CATCH_REQUIRE(nullptr != sem);
+  RCSW_LOCKPROF_REGISTER(sem, "csem");
+
+  std::thread consumer([&]() {
+      struct timespec to = {.tv_sec = 5, .tv_nsec = 0};
+      for (size_t i = 0; i < TH_N_ITERS; ++i) {
+        if (0 == (i & 1)) {
+          csem_wait(sem);
+        } else {
+          csem_timedwait(sem, &to);
+        }
+      } /* for(i..) */
+    });
+  for (size_t i = 0; i < TH_N_ITERS; ++i) {
+    csem_post(sem);
+  } /* for(i..) */
+  consumer.join();
+
+  /* a failed trywait is not an acquisition */
+  CATCH_REQUIRE(ERROR == csem_trywait(sem));
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+  th_stats_check("csem", TH_N_ITERS, false);
+#endif
+  csem_destroy(sem);
+} /* csem_test() */
+
+static void rdwrl_test(uint32_t flags) {
+  uint32_t lflags[] = {RCSW_NONE, RCSW_RDWRLOCK_RDBIAS};
+
+  for (size_t k = 0; k < RCSW_ARRAY_ELTS(lflags); ++k) {
+    struct rdwrlock rdwr_in;
+    struct rdwrlock* rdwr = rdwrl_init(&rdwr_in, flags | lflags[k]);
+    CATCH_REQUIRE(nullptr != rdwr);
+    RCSW_LOCKPROF_REGISTER(rdwr, "rdwrl");
+
+    size_t count = 0;
+    std::atomic_size_t n_errs(0);
+    std::vector<std::thread> threads;
+    threads.emplace_back([&]() {
+        struct timespec to = {.tv_sec = 5, .tv_nsec = 0};
+        for (size_t j = 0; j < TH_N_ITERS; ++j) {
+          if (OK != rdwrl_timedreq(rdwr, ekSCOPE_WR, &to)) {
+            ++n_errs;
+            continue;
+          }
+          ++count;
+          rdwrl_exit(rdwr, ekSCOPE_WR);
+        } /* for(j..) */
+      });
+    for (size_t i = 1; i < TH_N_THREADS; ++i) {
+      threads.emplace_back([&]() {
+          for (size_t j = 0; j < TH_N_ITERS; ++j) {
+            rdwrl_req(rdwr, ekSCOPE_RD);
+            rdwrl_exit(rdwr, ekSCOPE_RD);
+          } /* for(j..) */
+        });
+    } /* for(i..) */
+    for (auto& t : threads) {
+      t.join();
+    } /* for(t..) */
+    CATCH_REQUIRE(0 == n_errs);
+    CATCH_REQUIRE(TH_N_ITERS == count);
+
+#if defined(RCSW_CONFIG_MT_LOCKPROF)
+    /* writers are exclusive, so there is hold time */
+    th_stats_check("rdwrl", TH_N_THREADS * TH_N_ITERS, true);
+#endif
+    rdwrl_destroy(rdwr);
+  } /* for(k..) */
+} /* rdwrl_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Registry Test", "[mt][lockprof]") {
+  run_test(registry_test);
+}
+
+CATCH_TEST_CASE("Mutex Test", "[mt][lockprof]") {
+  run_test(mutex_test);
+}
+
+CATCH_TEST_CASE("Held Test", "[mt][lockprof]") {
+  run_test(held_test);
+}
+
+CATCH_TEST_CASE("CSEM Test", "[mt][lockprof]") {
+  run_test(csem_test);
+}
+
+CATCH_TEST_CASE("RDWRL Test", "[mt][lockprof]") {
+  run_test(rdwrl_test);
+}
+
+CATCH_TEST_CASE("Overhead Benchmark", "[.][bench][mt][lockprof]") {
+  const size_t kOps = 10000000;
+  struct mutex mtx_in;
+  struct mutex* mtx = mutex_init(&mtx_in, RCSW_NOALLOC_HANDLE);
+  CATCH_REQUIRE(nullptr != mtx);
+
+  for (int mode = 0; mode < 2; ++mode) {
+    if (1 == mode) {
+      RCSW_LOCKPROF_REGISTER(mtx, "bench");
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kOps; ++i) {
+      mutex_lock(mtx);
+      mutex_unlock(mtx);
+    } /* for(i..) */
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    const char* names[] = {"unregistered", "registered"};
+    std::cout << names[mode] << ": " << ns / kOps << " ns/lock+unlock"
+              << std::endl;
+  } /* for(mode..) */
+  mutex_destroy(mtx);
+}
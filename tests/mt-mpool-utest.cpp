@@ -11,6 +11,8 @@
  ******************************************************************************/
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <iostream>
 
 #define CATCH_CONFIG_MAIN
 #define CATCH_CONFIG_PREFIX_ALL
@@ -42,6 +44,7 @@ static void run_test(mpool_test test, size_t n_threads = 1) {
   params.flags = 0;
   params.elt_size = sizeof(T);
   params.max_elts = TH_NUM_MT_ITEMS;
+  params.numa_node = -1;
   params.meta = (dptr_t*)malloc(mpool_meta_space(params.max_elts));
   params.elements = (dptr_t*)malloc(mpool_element_space(params.max_elts,
                                                          params.elt_size));
@@ -51,6 +54,10 @@ static void run_test(mpool_test test, size_t n_threads = 1) {
     RCSW_NOALLOC_HANDLE,
     RCSW_NOALLOC_DATA,
     RCSW_NOALLOC_META,
+    RCSW_MPOOL_LOCKFREE,
+    RCSW_MPOOL_LOCKFREE | RCSW_NOALLOC_HANDLE | RCSW_NOALLOC_DATA,
+    RCSW_MPOOL_NUMA,
+    RCSW_MPOOL_NUMA | RCSW_NOALLOC_DATA,
   };
 
   for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
@@ -95,6 +102,25 @@ static void simple_test(const struct mpool_params* const params,
     CATCH_REQUIRE(OK == mpool_release(pool, (uint8_t*)vals[i]));
     CATCH_REQUIRE(mpool_ref_count(pool, (uint8_t*)vals[i]) == 0);
   } /* for(i..) */
+  CATCH_REQUIRE(mpool_isempty(pool));
+
+  /* freed chunks can't be released or referenced again */
+  CATCH_REQUIRE(ERROR == mpool_release(pool, (uint8_t*)vals[0]));
+  CATCH_REQUIRE(ERROR == mpool_ref_add(pool, (uint8_t*)vals[0]));
+  CATCH_REQUIRE(mpool_isempty(pool));
+
+  /* neither can pointers into the middle of a chunk */
+  T* e = (T*)mpool_req(pool);
+  CATCH_REQUIRE(nullptr != e);
+  if (sizeof(T) > 1) {
+    CATCH_REQUIRE(-1 == mpool_ref_query(pool, (uint8_t*)e + 1));
+  }
+  CATCH_REQUIRE(OK == mpool_ref_add(pool, (uint8_t*)e));
+  CATCH_REQUIRE(mpool_ref_count(pool, (uint8_t*)e) == 2);
+  CATCH_REQUIRE(OK == mpool_release(pool, (uint8_t*)e));
+  CATCH_REQUIRE(mpool_ref_count(pool, (uint8_t*)e) == 1);
+  CATCH_REQUIRE(OK == mpool_release(pool, (uint8_t*)e));
+  CATCH_REQUIRE(mpool_isempty(pool));
 
   mpool_destroy(pool);
 }
@@ -199,6 +225,110 @@ static void concurrency_test(const struct mpool_params* const params,
 }
 
 
+/**
+ * \brief Check that threads with empty magazines can get chunks cached in
+ * other threads' magazines, and wake up when a chunk is freed.
+ */
+static void magazine_test(void) {
+  struct mpool_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = sizeof(element8);
+  params.max_elts = 4;
+  params.flags = RCSW_MPOOL_LOCKFREE;
+
+  struct mpool* pool = mpool_init(nullptr, &params);
+  CATCH_REQUIRE(nullptr != pool);
+
+  /* this thread ends up with all the chunks cached */
+  std::vector<void*> chunks;
+  for (size_t i = 0; i < params.max_elts; ++i) {
+    chunks.push_back(mpool_req(pool));
+    CATCH_REQUIRE(nullptr != chunks.back());
+  } /* for(i..) */
+  CATCH_REQUIRE(mpool_isfull(pool));
+  for (auto* c : chunks) {
+    CATCH_REQUIRE(OK == mpool_release(pool, c));
+  } /* for(*c..) */
+  CATCH_REQUIRE(mpool_isempty(pool));
+
+  /* ...but another thread can still get all of them */
+  std::vector<void*> stolen;
+  std::thread thief([&]() {
+                      for (size_t i = 0; i < params.max_elts; ++i) {
+                        stolen.push_back(mpool_req(pool));
+                      } /* for(i..) */
+                    });
+  thief.join();
+  CATCH_REQUIRE(stolen.size() == params.max_elts);
+  CATCH_REQUIRE(std::all_of(stolen.begin(),
+                            stolen.end(),
+                            [](void* c) { return nullptr != c; }));
+  CATCH_REQUIRE(mpool_isfull(pool));
+
+  /* pool is truly empty: wait, and get woken up by a release */
+  struct timespec to = {.tv_sec = 0, .tv_nsec = 1000000};
+  void* chunk = nullptr;
+  CATCH_REQUIRE(ERROR == mpool_timedreq(pool, &to, &chunk));
+  CATCH_REQUIRE(ETIMEDOUT == errno);
+
+  std::thread waiter([&]() { chunk = mpool_req(pool); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  CATCH_REQUIRE(OK == mpool_release(pool, stolen.back()));
+  waiter.join();
+  CATCH_REQUIRE(stolen.back() == chunk);
+  CATCH_REQUIRE(OK == mpool_release(pool, chunk));
+
+  /* chunks cached by exited threads are returned to the pool */
+  std::thread releaser([&]() {
+                         for (size_t i = 0; i < stolen.size() - 1; ++i) {
+                           mpool_release(pool, stolen[i]);
+                         } /* for(i..) */
+                       });
+  releaser.join();
+  CATCH_REQUIRE(mpool_isempty(pool));
+  CATCH_REQUIRE(0 == pool->lf.waiters);
+  CATCH_REQUIRE(0 != (uint32_t)pool->free_top);
+
+  mpool_destroy(pool);
+}
+
+/**
+ * \brief Time \p n_threads threads each doing \p n_items request/release pairs
+ * on a pool, holding a few chunks at a time.
+ *
+ * \return Total throughput in request/release pairs per second.
+ */
+static double scaling_measure(const struct mpool_params* const params,
+                              size_t n_threads,
+                              size_t n_items) {
+  struct mpool* pool = mpool_init(nullptr, params);
+  CATCH_REQUIRE(nullptr != pool);
+
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n_threads; ++i) {
+    threads.emplace_back([&]() {
+                           void* held[4];
+                           for (size_t j = 0; j < n_items; j += 4) {
+                             for (auto& h : held) {
+                               h = mpool_req(pool);
+                             } /* for(&h..) */
+                             for (auto* h : held) {
+                               mpool_release(pool, h);
+                             } /* for(*h..) */
+                           } /* for(j..) */
+                         });
+  } /* for(i..) */
+  for (auto& t : threads) {
+    t.join();
+  } /* for(&t..) */
+  auto end = std::chrono::steady_clock::now();
+
+  mpool_destroy(pool);
+  return n_threads * n_items /
+      std::chrono::duration<double>(end - start).count();
+} /* scaling_measure() */
+
 /*******************************************************************************
  * Test Cases
  ******************************************************************************/
@@ -211,13 +341,44 @@ CATCH_TEST_CASE("Simple Test", "[mt][mpool]") {
    */
 }
 CATCH_TEST_CASE("Concurrency Test", "[mt][mpool]") {
-  for (size_t i = 1; i <= 10; ++i) {
-    run_test<element8>(concurrency_test<element8>, i);
-    run_test<element4>(concurrency_test<element4>, i);  
-  } /* for(i..) */
+  run_test<element8>(concurrency_test<element8>, 4);
+  run_test<element4>(concurrency_test<element4>, 4);
 
   /*
    * Don't test with element2 or element1 because the integers used are not
    * large enough to hold the full range of values put into the pool.
    */
 }
+
+/*
+ * Same as above, for every thread count up to 10. Takes ~30s, so not run by
+ * default.
+ */
+CATCH_TEST_CASE("Concurrency Stress Test", "[.][mt][mpool]") {
+  for (size_t i = 1; i <= 10; ++i) {
+    run_test<element8>(concurrency_test<element8>, i);
+    run_test<element4>(concurrency_test<element4>, i);
+  } /* for(i..) */
+}
+
+CATCH_TEST_CASE("Magazine Test", "[mt][mpool]") {
+  magazine_test();
+}
+
+CATCH_TEST_CASE("Scaling Benchmark", "[.][bench][mt][mpool]") {
+  struct mpool_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = 64;
+  params.max_elts = 1024;
+
+  size_t max_threads = std::max(2U, std::thread::hardware_concurrency());
+  for (size_t n = 1; n <= max_threads; n *= 2) {
+    for (uint32_t flags : {RCSW_NONE, RCSW_MPOOL_LOCKFREE}) {
+      params.flags = flags;
+      std::cout << ((flags & RCSW_MPOOL_LOCKFREE) ? "lockfree " : "mutex    ")
+                << n << " threads: "
+                << scaling_measure(&params, n, 400000)
+                << " req+release/s\n";
+    } /* for(flags..) */
+  } /* for(n..) */
+}
@@ -10,8 +10,11 @@
  * Includes
  ******************************************************************************/
 #include <thread>
+#include <atomic>
 #include <mutex>
 #include <numeric>
+#include <chrono>
+#include <iostream>
 
 #define CATCH_CONFIG_MAIN
 #define CATCH_CONFIG_PREFIX_ALL
@@ -42,6 +45,8 @@ static void run_test(pcqueue_test test, size_t n_prod = 1, size_t n_cons = 1) {
   uint32_t flags[] = {
     RCSW_NONE,
     RCSW_NOALLOC_HANDLE,
+    RCSW_PCQUEUE_MPMC,
+    RCSW_PCQUEUE_MPMC | RCSW_NOALLOC_HANDLE,
   };
 
   for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
@@ -50,6 +55,11 @@ static void run_test(pcqueue_test test, size_t n_prod = 1, size_t n_cons = 1) {
   }
 } /* test_runner() */
 
+template<typename T>
+static bool_t th_value1_match(const void* elt, const void* e) {
+  return static_cast<const T*>(elt)->value1 == static_cast<const T*>(e)->value1;
+} /* th_value1_match() */
+
 /*******************************************************************************
  * Test Functions
  ******************************************************************************/
@@ -147,20 +157,29 @@ static void concurrent_test(const struct pcqueue_params* const params,
   /* mutex can't be thread-local */
   std::mutex mtx;
 
+  /*
+   * Consumers stop as soon as everything has been popped, rather than sleeping
+   * out a fixed # of timeouts. Give up after ~1s with no progress, so a lost
+   * element fails the test instead of hanging it.
+   */
+  const size_t total = n_prod * TH_NUM_MT_ITEMS;
+  std::atomic_size_t n_popped(0);
   auto cons_cb = [&](auto* const q) {
                    T e;
-                   size_t count = 0;
-                   while (count < 10) {
-                     struct timespec to = {.tv_sec = 0, .tv_nsec = 100000000};
+                   size_t n_timeouts = 0;
+                   while (n_popped < total && n_timeouts < 100) {
+                     struct timespec to = {.tv_sec = 0, .tv_nsec = 10000000};
                      status_t rval = pcqueue_timedpop(q, &to, &e);
                      if (OK == rval) {
                        std::scoped_lock lock(mtx);
                        pops.push_back(e);
                        cons_res.push_back(rval);
+                       ++n_popped;
+                       n_timeouts = 0;
                      } else {
-                       ++count;
+                       ++n_timeouts;
                      }
-                   } /* for(i..) */
+                   } /* while() */
                  };
 
   std::vector<std::thread> producers;
@@ -283,6 +302,224 @@ void timeout_test(const struct pcqueue_params* const params,
   pcqueue_destroy(queue);
 }
 
+template <typename T>
+static void batch_test(const struct pcqueue_params* const params_in,
+                       size_t n_prod,
+                       size_t n_cons) {
+  /* small queue so that batches have to be split up */
+  struct pcqueue_params params = *params_in;
+  params.max_elts = 16;
+
+  struct pcqueue queue_in;
+  struct pcqueue* queue = pcqueue_init(&queue_in, &params);
+  CATCH_REQUIRE(nullptr != queue);
+
+  /* nothing to drain */
+  size_t got = 1;
+  T e[32];
+  CATCH_REQUIRE(OK == pcqueue_drain(queue, e, RCSW_ARRAY_ELTS(e), &got));
+  CATCH_REQUIRE(0 == got);
+
+  auto prod_cb = [&](auto* const q) {
+                   th::element_generator<T> g(gen_elt_type::ekINC_VALS,
+                                              TH_NUM_MT_ITEMS + 1);
+                   g.next();
+                   std::vector<T> batch;
+                   size_t count = 0;
+                   while (count < TH_NUM_MT_ITEMS) {
+                     /* batch sizes smaller/larger than the queue */
+                     size_t n = std::min(count % 29 + 1,
+                                         TH_NUM_MT_ITEMS - count);
+                     batch.clear();
+                     for (size_t i = 0; i < n; ++i) {
+                       batch.push_back(g.next());
+                     } /* for(i..) */
+                     CATCH_REQUIRE(OK == pcqueue_push_n(q, batch.data(), n));
+                     count += n;
+                   } /* while() */
+                 };
+
+  std::vector<T> pops;
+  std::mutex mtx;
+  size_t total = n_prod * TH_NUM_MT_ITEMS;
+  auto cons_cb = [&](auto* const q) {
+                   T out[13];
+                   while (true) {
+                     {
+                       std::scoped_lock lock(mtx);
+                       if (pops.size() == total) {
+                         break;
+                       }
+                     }
+                     size_t n = 0;
+                     CATCH_REQUIRE(OK == pcqueue_drain(q,
+                                                       out,
+                                                       RCSW_ARRAY_ELTS(out),
+                                                       &n));
+                     if (0 == n) {
+                       std::this_thread::yield();
+                       continue;
+                     }
+                     std::scoped_lock lock(mtx);
+                     pops.insert(pops.end(), out, out + n);
+                   } /* while() */
+                 };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < n_prod; ++i) {
+    threads.push_back(std::thread(prod_cb, queue));
+  } /* for(i..) */
+  for (size_t i = 0; i < n_cons; ++i) {
+    threads.push_back(std::thread(cons_cb, queue));
+  } /* for(i..) */
+  for (auto& t : threads) {
+    t.join();
+  } /* for(&t..) */
+
+  CATCH_REQUIRE(pcqueue_isempty(queue));
+  auto sum = std::accumulate(std::begin(pops),
+                             std::end(pops),
+                             0U,
+                             [](auto& accum, const auto& val){
+                               accum += val.value1;
+                               return accum;
+                             });
+  CATCH_REQUIRE(sum == n_prod * (TH_NUM_MT_ITEMS * (TH_NUM_MT_ITEMS + 1))/ 2);
+
+  /* blocking batch pop returns whatever is there, in order */
+  T in[5];
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(in); ++i) {
+    in[i].value1 = i;
+  } /* for(i..) */
+  CATCH_REQUIRE(OK == pcqueue_push_n(queue, in, RCSW_ARRAY_ELTS(in)));
+  CATCH_REQUIRE(OK == pcqueue_pop_n(queue, e, 2, &got));
+  CATCH_REQUIRE(2 == got);
+  CATCH_REQUIRE(OK == pcqueue_pop_n(queue,
+                                    e + 2,
+                                    RCSW_ARRAY_ELTS(e) - 2,
+                                    &got));
+  CATCH_REQUIRE(3 == got);
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(in); ++i) {
+    CATCH_REQUIRE(e[i].value1 == (decltype(T::value1))i);
+  } /* for(i..) */
+  CATCH_REQUIRE(pcqueue_isempty(queue));
+
+  pcqueue_destroy(queue);
+}
+
+template <typename T>
+static void try_test(const struct pcqueue_params* const params_in,
+                     size_t,
+                     size_t) {
+  struct pcqueue_params params = *params_in;
+  params.max_elts = 8;
+
+  struct pcqueue queue_in;
+  struct pcqueue* queue = pcqueue_init(&queue_in, &params);
+  CATCH_REQUIRE(nullptr != queue);
+
+  T e;
+  void* front = &e;
+  CATCH_REQUIRE(ERROR == pcqueue_trypop(queue, &e));
+  CATCH_REQUIRE(EAGAIN == errno);
+  CATCH_REQUIRE(ERROR == pcqueue_trypeek(queue, &front));
+  CATCH_REQUIRE(EAGAIN == errno);
+  CATCH_REQUIRE(nullptr == front);
+
+  th::element_generator<T> g(gen_elt_type::ekINC_VALS, params.max_elts + 1);
+  for (size_t round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < params.max_elts; ++i) {
+      T val = g.next();
+      CATCH_REQUIRE(OK == pcqueue_trypush(queue, &val));
+    } /* for(i..) */
+    CATCH_REQUIRE(pcqueue_isfull(queue));
+    T val = g.next();
+    CATCH_REQUIRE(ERROR == pcqueue_trypush(queue, &val));
+    CATCH_REQUIRE(EAGAIN == errno);
+
+    /* replacing works even though the queue is full */
+    bool replaceable = !(params.flags & RCSW_PCQUEUE_MPMC);
+    T repl = val;
+    repl.value1 = 3;
+    repl.value2 = 42;
+    CATCH_REQUIRE(replaceable == (OK == pcqueue_tryreplace(queue,
+                                                           &repl,
+                                                           th_value1_match<T>,
+                                                           &e)));
+    if (replaceable) {
+      CATCH_REQUIRE(3 == e.value1);
+      repl.value1 = -1;
+      CATCH_REQUIRE(ERROR == pcqueue_tryreplace(queue,
+                                                &repl,
+                                                th_value1_match<T>,
+                                                nullptr));
+      CATCH_REQUIRE(ENOENT == errno);
+    }
+    CATCH_REQUIRE(pcqueue_isfull(queue));
+
+    for (size_t i = 0; i < params.max_elts; ++i) {
+      CATCH_REQUIRE(OK == pcqueue_trypeek(queue, &front));
+      CATCH_REQUIRE(nullptr != front);
+      CATCH_REQUIRE(OK == pcqueue_peek(queue, &front));
+      CATCH_REQUIRE(static_cast<T*>(front)->value1 == (decltype(T::value1))i);
+      CATCH_REQUIRE(OK == pcqueue_trypop(queue, &e));
+      CATCH_REQUIRE(e.value1 == (decltype(T::value1))i);
+      if (replaceable && 3 == i) {
+        CATCH_REQUIRE(42 == e.value2);
+      }
+    } /* for(i..) */
+    CATCH_REQUIRE(pcqueue_isempty(queue));
+    CATCH_REQUIRE(ERROR == pcqueue_trypop(queue, &e));
+    g.reset();
+  } /* for(round..) */
+
+  pcqueue_destroy(queue);
+}
+
+/**
+ * \brief Move \p n_items from each of \p n_prod producers through a queue to \p
+ * n_cons consumers.
+ *
+ * \return Total throughput in items/sec.
+ */
+static double throughput_measure(const struct pcqueue_params* const params,
+                                 size_t n_prod,
+                                 size_t n_cons,
+                                 size_t n_items) {
+  struct pcqueue* queue = pcqueue_init(nullptr, params);
+  CATCH_REQUIRE(nullptr != queue);
+
+  std::vector<std::thread> threads;
+  size_t total = n_prod * n_items;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n_prod; ++i) {
+    threads.emplace_back([&]() {
+                           element8 e{};
+                           for (size_t j = 0; j < n_items; ++j) {
+                             pcqueue_push(queue, &e);
+                           } /* for(j..) */
+                         });
+  } /* for(i..) */
+  for (size_t i = 0; i < n_cons; ++i) {
+    /* spread any remainder across the first few consumers */
+    size_t n = total / n_cons + (i < total % n_cons);
+    threads.emplace_back([=]() {
+                           element8 e{};
+                           for (size_t j = 0; j < n; ++j) {
+                             pcqueue_pop(queue, &e);
+                           } /* for(j..) */
+                         });
+  } /* for(i..) */
+  for (auto& t : threads) {
+    t.join();
+  } /* for(&t..) */
+  auto end = std::chrono::steady_clock::now();
+
+  pcqueue_destroy(queue);
+  return total / std::chrono::duration<double>(end - start).count();
+} /* throughput_measure() */
+
 /*******************************************************************************
  * Test Cases
  ******************************************************************************/
@@ -333,3 +570,92 @@ CATCH_TEST_CASE("Timeout Test", "[mt][pcqueue]") {
    * large enough to hold the full range of values put into the queue.
    */
 }
+
+CATCH_TEST_CASE("Batch Test", "[mt][pcqueue]") {
+  for (size_t i = 1; i <= 3; ++i) {
+    for (size_t j = 1; j <= 3; ++j) {
+      run_test<element8>(batch_test<element8>, i, j);
+      run_test<element4>(batch_test<element4>, i, j);
+    } /* for(j..) */
+  } /* for(i..) */
+}
+
+CATCH_TEST_CASE("Try Test", "[mt][pcqueue]") {
+  run_test<element8>(try_test<element8>);
+  run_test<element4>(try_test<element4>);
+}
+
+CATCH_TEST_CASE("Scaling Benchmark", "[.][bench][mt][pcqueue]") {
+  struct pcqueue_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = sizeof(element8);
+  params.max_elts = 1024;
+
+  size_t max_threads = std::max(2U, std::thread::hardware_concurrency());
+  for (size_t n = 1; n <= max_threads / 2; n *= 2) {
+    for (uint32_t flags : {RCSW_NONE, RCSW_PCQUEUE_MPMC}) {
+      params.flags = flags;
+      std::cout << ((flags & RCSW_PCQUEUE_MPMC) ? "mpmc  " : "mutex ")
+                << n << "P/" << n << "C: "
+                << throughput_measure(&params, n, n, 200000)
+                << " items/s\n";
+    } /* for(flags..) */
+  } /* for(n..) */
+}
+
+CATCH_TEST_CASE("Polling Benchmark", "[.][bench][mt][pcqueue]") {
+  const size_t n_items = 200000;
+  struct pcqueue_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = sizeof(element8);
+  params.max_elts = 1024;
+
+  /* consumer polls; producer blocks */
+  auto measure = [&](auto poll) {
+                   struct pcqueue* queue = pcqueue_init(nullptr, &params);
+                   auto start = std::chrono::steady_clock::now();
+                   std::thread prod([&]() {
+                                      element8 e{};
+                                      for (size_t i = 0; i < n_items; ++i) {
+                                        pcqueue_push(queue, &e);
+                                      } /* for(i..) */
+                                    });
+                   size_t n_polls = 0;
+                   for (size_t i = 0; i < n_items; ++n_polls) {
+                     i += (OK == poll(queue));
+                   } /* for(i..) */
+                   prod.join();
+                   auto end = std::chrono::steady_clock::now();
+                   pcqueue_destroy(queue);
+                   auto ns = std::chrono::duration<double, std::nano>(
+                       end - start).count();
+                   return std::make_pair(n_items / (ns / 1e9), ns / n_polls);
+                 };
+
+  for (uint32_t flags : {RCSW_NONE, RCSW_PCQUEUE_MPMC}) {
+    params.flags = flags;
+    const char* name = (flags & RCSW_PCQUEUE_MPMC) ? "mpmc " : "mutex";
+    auto timed = measure([](struct pcqueue* q) {
+                           element8 e;
+                           struct timespec to = {.tv_sec = 0, .tv_nsec = 1};
+                           return pcqueue_timedpop(q, &to, &e);
+                         });
+    auto tried = measure([](struct pcqueue* q) {
+                           element8 e;
+                           return pcqueue_trypop(q, &e);
+                         });
+    auto peeked = measure([](struct pcqueue* q) {
+                            void* front = nullptr;
+                            if (OK != pcqueue_trypeek(q, &front)) {
+                              return ERROR;
+                            }
+                            return pcqueue_trypop(q, nullptr);
+                          });
+    std::cout << name << " timedpop : " << timed.first << " items/s, "
+              << timed.second << " ns/poll\n"
+              << name << " trypop   : " << tried.first << " items/s, "
+              << tried.second << " ns/poll\n"
+              << name << " trypeek  : " << peeked.first << " items/s, "
+              << peeked.second << " ns/poll\n";
+  } /* for(flags..) */
+}
@@ -12,6 +12,8 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <iostream>
 
 #define CATCH_CONFIG_MAIN
 #define CATCH_CONFIG_PREFIX_ALL
@@ -34,6 +36,8 @@ static void run_test(rdwrl_test test, size_t n_threads = 1) {
   uint32_t flags[] = {
     RCSW_NONE,
     RCSW_NOALLOC_HANDLE,
+    RCSW_RDWRLOCK_RDBIAS,
+    RCSW_RDWRLOCK_RDBIAS | RCSW_NOALLOC_HANDLE,
   };
 
   for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
@@ -58,7 +62,7 @@ static void simple_test(uint32_t flags, size_t) {
   CATCH_REQUIRE(nullptr != lock);
 
   rdwrl_req(lock, ekSCOPE_RD);
-  CATCH_REQUIRE(lock->n_readers == 1);
+  CATCH_REQUIRE(rdwrl_n_readers(lock) == 1);
   rdwrl_exit(lock, ekSCOPE_RD);
 
   rdwrl_req(lock, ekSCOPE_WR);
@@ -67,11 +71,11 @@ static void simple_test(uint32_t flags, size_t) {
   rdwrl_req(lock, ekSCOPE_RD);
   rdwrl_req(lock, ekSCOPE_RD);
   rdwrl_req(lock, ekSCOPE_RD);
-  CATCH_REQUIRE(lock->n_readers == 3);
+  CATCH_REQUIRE(rdwrl_n_readers(lock) == 3);
 
   rdwrl_exit(lock, ekSCOPE_RD);
   rdwrl_exit(lock, ekSCOPE_RD);
-  CATCH_REQUIRE(lock->n_readers == 1);
+  CATCH_REQUIRE(rdwrl_n_readers(lock) == 1);
   rdwrl_exit(lock, ekSCOPE_RD);
 
   rdwrl_req(lock, ekSCOPE_WR);
@@ -183,3 +187,41 @@ CATCH_TEST_CASE("Concurrency Test", "[mt][rdwrlock]") {
     run_test(concurrency_test, i);
   } /* for(i..) */
 }
+
+CATCH_TEST_CASE("Reader Scaling Benchmark", "[.][bench][mt][rdwrlock]") {
+  const size_t kOpsPerThread = 1000000;
+  size_t max_threads = std::max(1U, std::thread::hardware_concurrency());
+
+  for (uint32_t flags : {(uint32_t)RCSW_NONE, (uint32_t)RCSW_RDWRLOCK_RDBIAS}) {
+    for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+      struct rdwrlock lock_in;
+      struct rdwrlock* lock = rdwrl_init(&lock_in, flags);
+      CATCH_REQUIRE(nullptr != lock);
+
+      std::vector<std::thread> threads;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < n_threads; ++i) {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < kOpsPerThread; ++j) {
+              rdwrl_req(lock, ekSCOPE_RD);
+              rdwrl_exit(lock, ekSCOPE_RD);
+            } /* for(j..) */
+          });
+      } /* for(i..) */
+      for (auto& t : threads) {
+        t.join();
+      } /* for(t..) */
+      auto end = std::chrono::steady_clock::now();
+      double secs = std::chrono::duration<double>(end - start).count();
+
+      std::cout << ((flags & RCSW_RDWRLOCK_RDBIAS) ? "biased" : "fair")
+                << " readers=" << n_threads << ": "
+                << (n_threads * kOpsPerThread) / secs / 1e6
+                << " Mops/s" << std::endl;
+      rdwrl_destroy(lock);
+      if (n_threads < max_threads && n_threads * 2 > max_threads) {
+        n_threads = max_threads / 2;
+      }
+    } /* for(n_threads..) */
+  } /* for(flags..) */
+}
@@ -0,0 +1,210 @@
+/**
+ * \file mt-seqlock-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/seqlock.h"
+#include "rcsw/multithread/rdwrlock.h"
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using seqlock_test = void(*)(uint32_t flags);
+
+/*
+ * State which is only consistent if all fields are equal, so torn reads are
+ * easy to detect.
+ */
+struct snapshot {
+  size_t vals[8];
+};
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+static void run_test(seqlock_test test) {
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE,
+  };
+
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+    test(flags[i]);
+  }
+} /* run_test() */
+
+static bool snapshot_consistent(const struct snapshot& s) {
+  for (size_t i = 1; i < RCSW_ARRAY_ELTS(s.vals); ++i) {
+    if (s.vals[i] != s.vals[0]) {
+      return false;
+    }
+  } /* for(i..) */
+  return true;
+}
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void simple_test(uint32_t flags) {
+  struct seqlock sl_in;
+  struct seqlock* sl;
+
+  if (flags & RCSW_NOALLOC_HANDLE) {
+    sl = seqlock_init(NULL, flags);
+    CATCH_REQUIRE(nullptr == sl);
+  }
+  sl = seqlock_init(&sl_in, flags);
+  CATCH_REQUIRE(nullptr != sl);
+
+  struct snapshot shared = {};
+  struct snapshot local = {};
+  struct snapshot update;
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(update.vals); ++i) {
+    update.vals[i] = 17;
+  } /* for(i..) */
+
+  /* each write bumps the sequence # by 2 */
+  uint32_t seq = seqlock_rd_begin(sl);
+  CATCH_REQUIRE(OK == seqlock_write(sl, &shared, &update, sizeof(shared)));
+  CATCH_REQUIRE(seqlock_rd_retry(sl, seq));
+  CATCH_REQUIRE(seqlock_rd_begin(sl) == seq + 2);
+
+  CATCH_REQUIRE(OK == seqlock_read(sl, &local, &shared, sizeof(local)));
+  CATCH_REQUIRE(local.vals[7] == 17);
+
+  update.vals[3] = 4;
+  RCSW_SEQLOCK_WRITE(sl, shared, update);
+  RCSW_SEQLOCK_READ(sl, local, shared);
+  CATCH_REQUIRE(local.vals[3] == 4);
+  CATCH_REQUIRE(!seqlock_rd_retry(sl, seqlock_rd_begin(sl)));
+
+  seqlock_destroy(sl);
+} /* simple_test() */
+
+static void concurrency_test(uint32_t flags) {
+  struct seqlock sl_in;
+  struct seqlock* sl = seqlock_init(&sl_in, flags);
+  CATCH_REQUIRE(nullptr != sl);
+
+  struct snapshot shared = {};
+  std::atomic_bool done(false);
+  std::atomic_size_t n_torn(0);
+  std::atomic_size_t n_reads(0);
+
+  auto reader = [&]() {
+    size_t last = 0;
+    while (!done) {
+      struct snapshot local;
+      RCSW_SEQLOCK_READ(sl, local, shared);
+      if (!snapshot_consistent(local) || local.vals[0] < last) {
+        ++n_torn;
+      }
+      last = local.vals[0];
+      ++n_reads;
+    } /* while() */
+  };
+  auto writer = [&]() {
+    for (size_t i = 1; i <= 100000; ++i) {
+      seqlock_wr_enter(sl);
+      /* writers are serialized, so this is always increasing */
+      size_t next = shared.vals[0] + 1;
+      for (size_t j = 0; j < RCSW_ARRAY_ELTS(shared.vals); ++j) {
+        shared.vals[j] = next;
+      } /* for(j..) */
+      seqlock_wr_exit(sl);
+    } /* for(i..) */
+  };
+
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < 4; ++i) {
+    readers.emplace_back(reader);
+  } /* for(i..) */
+  std::thread w1(writer);
+  std::thread w2(writer);
+  w1.join();
+  w2.join();
+  done = true;
+  for (auto& t : readers) {
+    t.join();
+  } /* for(t..) */
+
+  CATCH_REQUIRE(0 == n_torn);
+  CATCH_REQUIRE(snapshot_consistent(shared));
+  CATCH_REQUIRE(shared.vals[0] == 200000);
+  seqlock_destroy(sl);
+} /* concurrency_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Simple Test", "[mt][seqlock]") {
+  run_test(simple_test);
+}
+
+CATCH_TEST_CASE("Concurrency Test", "[mt][seqlock]") {
+  run_test(concurrency_test);
+}
+
+CATCH_TEST_CASE("Reader Scaling Benchmark", "[.][bench][mt][seqlock]") {
+  const size_t kOpsPerThread = 1000000;
+  size_t max_threads = std::max(1U, std::thread::hardware_concurrency());
+
+  struct seqlock sl_in;
+  struct seqlock* sl = seqlock_init(&sl_in, RCSW_NONE);
+  struct rdwrlock rdwr_in;
+  struct rdwrlock* rdwr = rdwrl_init(&rdwr_in, RCSW_RDWRLOCK_RDBIAS);
+  CATCH_REQUIRE(nullptr != sl);
+  CATCH_REQUIRE(nullptr != rdwr);
+  struct snapshot shared = {};
+
+  for (bool use_seqlock : {false, true}) {
+    for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+      std::vector<std::thread> threads;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < n_threads; ++i) {
+        threads.emplace_back([&]() {
+            struct snapshot local;
+            for (size_t j = 0; j < kOpsPerThread; ++j) {
+              if (use_seqlock) {
+                RCSW_SEQLOCK_READ(sl, local, shared);
+              } else {
+                rdwrl_req(rdwr, ekSCOPE_RD);
+                local = shared;
+                rdwrl_exit(rdwr, ekSCOPE_RD);
+              }
+              asm volatile("" : : "r"(&local) : "memory");
+            } /* for(j..) */
+          });
+      } /* for(i..) */
+      for (auto& t : threads) {
+        t.join();
+      } /* for(t..) */
+      auto end = std::chrono::steady_clock::now();
+      double secs = std::chrono::duration<double>(end - start).count();
+
+      std::cout << (use_seqlock ? "seqlock" : "rdwrlock(biased)")
+                << " readers=" << n_threads << ": "
+                << (n_threads * kOpsPerThread) / secs / 1e6
+                << " Mops/s" << std::endl;
+    } /* for(n_threads..) */
+  } /* for(use_seqlock..) */
+
+  rdwrl_destroy(rdwr);
+  seqlock_destroy(sl);
+}
@@ -0,0 +1,341 @@
+/**
+ * \file mt-slab-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/slab.h"
+#include "rcsw/ds/darray.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_PAGE_SIZE 4096
+#define TH_MAX_PAGES 64
+#define TH_MIN_SIZE 16
+#define TH_MAX_SIZE 1024
+#define TH_NUM_THREADS 4
+#define TH_NUM_MT_ITEMS 20000
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using slab_test = void(*)(const struct slab_params* const params);
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+static void run_test(slab_test test) {
+  struct slab_params params;
+  memset(&params, 0, sizeof(params));
+  params.page_size = TH_PAGE_SIZE;
+  params.max_pages = TH_MAX_PAGES;
+  params.min_size = TH_MIN_SIZE;
+  params.max_size = TH_MAX_SIZE;
+  params.arena = (dptr_t*)malloc(slab_arena_space(TH_MAX_PAGES, TH_PAGE_SIZE));
+  params.meta = (dptr_t*)malloc(slab_meta_space(TH_MAX_PAGES));
+
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE | RCSW_NOALLOC_DATA | RCSW_NOALLOC_META,
+    RCSW_SLAB_CACHE,
+    RCSW_SLAB_CACHE | RCSW_NOALLOC_DATA,
+  };
+
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+    params.flags = flags[i];
+    test(&params);
+  } /* for(i..) */
+
+  free(params.arena);
+  free(params.meta);
+} /* run_test() */
+
+static struct slab* slab_create(struct slab* slab_in,
+                                const struct slab_params* const params) {
+  struct slab* slab = slab_init(slab_in, params);
+  CATCH_REQUIRE(nullptr != slab);
+  return slab;
+}
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void class_test(const struct slab_params* const params) {
+  struct slab slab_in;
+  struct slab* slab = slab_create(&slab_in, params);
+
+  CATCH_REQUIRE(7 == slab->n_classes);
+  CATCH_REQUIRE(0 == slab_class_idx(slab, 1));
+  CATCH_REQUIRE(0 == slab_class_idx(slab, 16));
+  CATCH_REQUIRE(1 == slab_class_idx(slab, 17));
+  CATCH_REQUIRE(1 == slab_class_idx(slab, 32));
+  CATCH_REQUIRE(6 == slab_class_idx(slab, 1000));
+  CATCH_REQUIRE(6 == slab_class_idx(slab, 1024));
+  CATCH_REQUIRE(slab->n_classes == slab_class_idx(slab, 1025));
+
+  for (size_t i = 0; i < slab->n_classes; ++i) {
+    CATCH_REQUIRE(slab->classes[i].size == ((size_t)TH_MIN_SIZE << i));
+  } /* for(i..) */
+
+  /* too big */
+  CATCH_REQUIRE(nullptr == slab_alloc(slab, TH_MAX_SIZE + 1));
+  CATCH_REQUIRE(EINVAL == errno);
+
+  /* not from the slab */
+  int x;
+  CATCH_REQUIRE(ERROR == slab_free(slab, &x));
+  CATCH_REQUIRE(!slab_owns(slab, &x));
+
+  slab_destroy(slab);
+
+  /* page too small for the largest class */
+  struct slab_params bad = *params;
+  bad.page_size = TH_MAX_SIZE;
+  CATCH_REQUIRE(nullptr == slab_init(&slab_in, &bad));
+
+  /* not a power of 2 */
+  bad = *params;
+  bad.min_size = 24;
+  CATCH_REQUIRE(nullptr == slab_init(&slab_in, &bad));
+} /* class_test() */
+
+static void alloc_test(const struct slab_params* const params) {
+  struct slab slab_in;
+  struct slab* slab = slab_create(&slab_in, params);
+
+  /* every size gets a chunk big enough, in the right class */
+  std::vector<std::pair<uint8_t*, size_t>> chunks;
+  for (size_t size = 1; size <= TH_MAX_SIZE; size += 37) {
+    auto* chunk = (uint8_t*)slab_alloc(slab, size);
+    CATCH_REQUIRE(nullptr != chunk);
+    CATCH_REQUIRE(slab_owns(slab, chunk));
+    memset(chunk, (int)size, size);
+    chunks.emplace_back(chunk, size);
+  } /* for(size..) */
+
+  /* nothing overlapped */
+  for (auto& [chunk, size] : chunks) {
+    for (size_t i = 0; i < size; ++i) {
+      CATCH_REQUIRE(chunk[i] == (uint8_t)size);
+    } /* for(i..) */
+    CATCH_REQUIRE(OK == slab_free(slab, chunk));
+  } /* for(&[chunk..) */
+
+  /* pointers into the middle of chunks are rejected */
+  auto* chunk = (uint8_t*)slab_alloc(slab, 64);
+  CATCH_REQUIRE(ERROR == slab_free(slab, chunk + 1));
+  CATCH_REQUIRE(OK == slab_free(slab, chunk));
+
+  slab_destroy(slab);
+} /* alloc_test() */
+
+static void grow_test(const struct slab_params* const params) {
+  struct slab slab_in;
+  struct slab* slab = slab_create(&slab_in, params);
+
+  /* grows one page at a time, until it can't */
+  std::vector<void*> chunks;
+  while (true) {
+    void* chunk = slab_alloc(slab, 256);
+    if (nullptr == chunk) {
+      break;
+    }
+    chunks.push_back(chunk);
+    CATCH_REQUIRE(slab->n_pages <= TH_MAX_PAGES);
+  } /* while() */
+  CATCH_REQUIRE(ENOMEM == errno);
+  CATCH_REQUIRE(TH_MAX_PAGES == slab->n_pages);
+
+  /* other classes can't get pages any more */
+  CATCH_REQUIRE(nullptr == slab_alloc(slab, 16));
+
+  /* anything freed can be reused */
+  for (auto* c : chunks) {
+    CATCH_REQUIRE(OK == slab_free(slab, c));
+  } /* for(*c..) */
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    CATCH_REQUIRE(nullptr != slab_alloc(slab, 200));
+  } /* for(i..) */
+  CATCH_REQUIRE(TH_MAX_PAGES == slab->n_pages);
+
+  slab_destroy(slab);
+} /* grow_test() */
+
+static void concurrent_test(const struct slab_params* const params) {
+  struct slab slab_in;
+  struct slab* slab = slab_create(&slab_in, params);
+
+  std::vector<size_t> n_bad(TH_NUM_THREADS, 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < TH_NUM_THREADS; ++t) {
+    threads.emplace_back([&, t]() {
+                           std::vector<std::pair<uint8_t*, size_t>> live;
+                           unsigned seed = (unsigned)t;
+                           for (size_t i = 0; i < TH_NUM_MT_ITEMS; ++i) {
+                             if (live.size() < 32 && rand_r(&seed) % 2) {
+                               size_t size = 1 + rand_r(&seed) % TH_MAX_SIZE;
+                               auto* c = (uint8_t*)slab_alloc(slab, size);
+                               if (nullptr == c) {
+                                 continue;
+                               }
+                               memset(c, (int)t, size);
+                               live.emplace_back(c, size);
+                             } else if (!live.empty()) {
+                               auto [c, size] = live.back();
+                               live.pop_back();
+                               for (size_t j = 0; j < size; ++j) {
+                                 n_bad[t] += (c[j] != (uint8_t)t);
+                               } /* for(j..) */
+                               n_bad[t] += (OK != slab_free(slab, c));
+                             }
+                           } /* for(i..) */
+                           for (auto& [c, size] : live) {
+                             n_bad[t] += (OK != slab_free(slab, c));
+                           } /* for(&[c..) */
+                         });
+  } /* for(t..) */
+  for (auto& t : threads) {
+    t.join();
+  } /* for(&t..) */
+
+  for (size_t t = 0; t < TH_NUM_THREADS; ++t) {
+    CATCH_REQUIRE(0 == n_bad[t]);
+  } /* for(t..) */
+
+  /* everything went back to the pages when the threads exited */
+  for (size_t i = 0; i < slab->n_pages; ++i) {
+    CATCH_REQUIRE(mpool_isempty(&slab->pages[i].pool));
+  } /* for(i..) */
+
+  slab_destroy(slab);
+} /* concurrent_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Class Test", "[mt][slab]") {
+  run_test(class_test);
+}
+
+CATCH_TEST_CASE("Alloc Test", "[mt][slab]") {
+  run_test(alloc_test);
+}
+
+CATCH_TEST_CASE("Grow Test", "[mt][slab]") {
+  run_test(grow_test);
+}
+
+CATCH_TEST_CASE("Concurrency Test", "[mt][slab]") {
+  run_test(concurrent_test);
+}
+
+CATCH_TEST_CASE("Backend Test", "[mt][slab]") {
+  struct slab_params params;
+  memset(&params, 0, sizeof(params));
+  params.page_size = TH_PAGE_SIZE;
+  params.max_pages = TH_MAX_PAGES;
+  params.min_size = TH_MIN_SIZE;
+  params.max_size = TH_MAX_SIZE;
+  params.flags = RCSW_SLAB_CACHE;
+
+  struct slab* slab = slab_create(nullptr, &params);
+  struct rcsw_alloc_backend backend;
+  slab_backend_init(slab, &backend);
+  rcsw_alloc_backend_set(&backend);
+
+  /* small allocations come from the slab, big ones from malloc() */
+  void* small = rcsw_alloc(nullptr, 100, RCSW_ZALLOC);
+  void* big = rcsw_alloc(nullptr, TH_MAX_SIZE * 4, RCSW_NONE);
+  CATCH_REQUIRE(slab_owns(slab, small));
+  CATCH_REQUIRE(!slab_owns(slab, big));
+  CATCH_REQUIRE(0 == ((uint8_t*)small)[99]);
+  rcsw_free(small, RCSW_NONE);
+  rcsw_free(big, RCSW_NONE);
+
+  /* data structures use it without knowing */
+  struct darray_params dparams;
+  memset(&dparams, 0, sizeof(dparams));
+  dparams.elt_size = sizeof(int);
+  dparams.max_elts = -1;
+  dparams.init_size = 4;
+  struct darray* arr = darray_init(nullptr, &dparams);
+  CATCH_REQUIRE(nullptr != arr);
+  CATCH_REQUIRE(slab_owns(slab, arr));
+  for (int i = 0; i < 100; ++i) {
+    CATCH_REQUIRE(OK == darray_insert(arr, &i, (size_t)i));
+  } /* for(i..) */
+  for (int i = 0; i < 100; ++i) {
+    CATCH_REQUIRE(i == *(int*)darray_data_get(arr, (size_t)i));
+  } /* for(i..) */
+  darray_destroy(arr);
+
+  rcsw_alloc_backend_set(nullptr);
+  slab_destroy(slab);
+}
+
+CATCH_TEST_CASE("Scaling Benchmark", "[.][bench][mt][slab]") {
+  struct slab_params params;
+  memset(&params, 0, sizeof(params));
+  params.page_size = 64 * 1024;
+  params.max_pages = 256;
+  params.min_size = TH_MIN_SIZE;
+  params.max_size = TH_MAX_SIZE;
+
+  size_t n_threads = std::max(2U, std::thread::hardware_concurrency());
+  size_t n_ops = 1000000;
+
+  auto bench = [&](const char* name, auto alloc, auto release) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < n_threads; ++t) {
+      threads.emplace_back([&, t]() {
+                             void* live[16];
+                             for (size_t i = 0; i < n_ops / 16; ++i) {
+                               for (size_t j = 0; j < 16; ++j) {
+                                 live[j] = alloc(16 << ((i + j + t) % 6));
+                               } /* for(j..) */
+                               for (size_t j = 0; j < 16; ++j) {
+                                 release(live[j]);
+                               } /* for(j..) */
+                             } /* for(i..) */
+                           });
+    } /* for(t..) */
+    for (auto& t : threads) {
+      t.join();
+    } /* for(&t..) */
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() -
+                                         start;
+    std::cout << name << ": " << n_threads << " threads, "
+              << (2.0 * n_ops * n_threads) / secs.count() / 1e6
+              << " Mops/s" << std::endl;
+  };
+
+  bench("malloc",
+        [](size_t n) { return malloc(n); },
+        [](void* p) { free(p); });
+
+  for (uint32_t flags : {(uint32_t)RCSW_NONE, (uint32_t)RCSW_SLAB_CACHE}) {
+    params.flags = flags;
+    struct slab* slab = slab_create(nullptr, &params);
+    bench((flags & RCSW_SLAB_CACHE) ? "slab(cache)" : "slab",
+          [&](size_t n) { return slab_alloc(slab, n); },
+          [&](void* p) { slab_free(slab, p); });
+    slab_destroy(slab);
+  } /* for(flags..) */
+}
@@ -0,0 +1,243 @@
+/**
+ * \file mt-spscqueue-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/spscqueue.h"
+#include "rcsw/multithread/pcqueue.h"
+
+#include "tests/ds_test.hpp"
+
+#define TH_NUM_MT_ITEMS 20000
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using spscqueue_test = void(*)(const struct spscqueue_params* const params);
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+template<typename T>
+static void run_test(spscqueue_test test) {
+  struct spscqueue_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = sizeof(T);
+
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE,
+    RCSW_NOALLOC_DATA,
+    RCSW_SPSCQUEUE_FUTEX,
+    RCSW_SPSCQUEUE_FUTEX | RCSW_NOALLOC_HANDLE | RCSW_NOALLOC_DATA,
+  };
+
+  for (size_t max_elts : {1, 7, 64, 1000}) {
+    params.max_elts = max_elts;
+    std::vector<uint8_t> elements(spscqueue_element_space(max_elts,
+                                                          sizeof(T)));
+    params.elements = reinterpret_cast<dptr_t*>(elements.data());
+    for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+      params.flags = flags[i];
+      test(&params);
+    } /* for(i..) */
+  } /* for(max_elts..) */
+} /* run_test() */
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+template <typename T>
+static void serial_test(const struct spscqueue_params* const params) {
+  struct spscqueue queue_in;
+  struct spscqueue* queue = spscqueue_init(&queue_in, params);
+  CATCH_REQUIRE(nullptr != queue);
+  CATCH_REQUIRE(spscqueue_isempty(queue));
+  CATCH_REQUIRE(spscqueue_capacity(queue) == params->max_elts);
+  CATCH_REQUIRE(nullptr == spscqueue_front(queue));
+
+  T e;
+  CATCH_REQUIRE(ERROR == spscqueue_trypop(queue, &e));
+  CATCH_REQUIRE(EAGAIN == errno);
+
+  struct timespec to = {.tv_sec = 0, .tv_nsec = 1000000};
+  CATCH_REQUIRE(ERROR == spscqueue_timedpop(queue, &to, &e));
+  CATCH_REQUIRE(ETIMEDOUT == errno);
+
+  /* wrap around a few times */
+  th::element_generator<T> g(gen_elt_type::ekINC_VALS, params->max_elts);
+  for (size_t round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < params->max_elts; ++i) {
+      T val = g.next();
+      CATCH_REQUIRE(OK == spscqueue_trypush(queue, &val));
+      CATCH_REQUIRE(spscqueue_size(queue) == i + 1);
+    } /* for(i..) */
+    CATCH_REQUIRE(spscqueue_isfull(queue));
+    T val = g.next();
+    CATCH_REQUIRE(ERROR == spscqueue_trypush(queue, &val));
+    CATCH_REQUIRE(EAGAIN == errno);
+
+    for (size_t i = 0; i < params->max_elts; ++i) {
+      T* front = reinterpret_cast<T*>(spscqueue_front(queue));
+      CATCH_REQUIRE(nullptr != front);
+      CATCH_REQUIRE(OK == spscqueue_pop(queue, &e));
+      CATCH_REQUIRE(front->value1 == e.value1);
+      size_t expected = round * (params->max_elts + 1) + i;
+      CATCH_REQUIRE(e.value1 == (decltype(T::value1))expected);
+    } /* for(i..) */
+    CATCH_REQUIRE(spscqueue_isempty(queue));
+  } /* for(round..) */
+
+  spscqueue_destroy(queue);
+} /* serial_test() */
+
+template <typename T>
+static void concurrent_test(const struct spscqueue_params* const params) {
+  struct spscqueue queue_in;
+  struct spscqueue* queue = spscqueue_init(&queue_in, params);
+  CATCH_REQUIRE(nullptr != queue);
+
+  auto prod_cb = [&]() {
+                   th::element_generator<T> g(gen_elt_type::ekINC_VALS,
+                                              TH_NUM_MT_ITEMS);
+                   for (size_t i = 0; i < TH_NUM_MT_ITEMS; ++i) {
+                     T e = g.next();
+                     CATCH_REQUIRE(OK == spscqueue_push(queue, &e));
+                   } /* for(i..) */
+                 };
+  size_t n_bad = 0;
+  auto cons_cb = [&]() {
+                   T e;
+                   for (size_t i = 0; i < TH_NUM_MT_ITEMS; ++i) {
+                     if (i % 2) {
+                       CATCH_REQUIRE(OK == spscqueue_pop(queue, &e));
+                     } else {
+                       struct timespec to = {.tv_sec = 1, .tv_nsec = 0};
+                       CATCH_REQUIRE(OK == spscqueue_timedpop(queue, &to, &e));
+                     }
+                     n_bad += (e.value1 != (decltype(T::value1))i);
+                   } /* for(i..) */
+                 };
+
+  std::thread cons(cons_cb);
+  std::thread prod(prod_cb);
+  prod.join();
+  cons.join();
+
+  CATCH_REQUIRE(0 == n_bad);
+  CATCH_REQUIRE(spscqueue_isempty(queue));
+  spscqueue_destroy(queue);
+} /* concurrent_test() */
+
+/**
+ * \brief Time moving \p n_items through a queue from one thread to another.
+ *
+ * \return Throughput in items/sec.
+ */
+template <typename Q, typename Push, typename Pop>
+static double throughput_measure(Q* queue, size_t n_items, Push push, Pop pop) {
+  auto start = std::chrono::steady_clock::now();
+  std::thread prod([&]() {
+                     element8 e{};
+                     for (size_t i = 0; i < n_items; ++i) {
+                       e.value1 = i;
+                       push(queue, &e);
+                     } /* for(i..) */
+                   });
+  element8 e{};
+  for (size_t i = 0; i < n_items; ++i) {
+    pop(queue, &e);
+  } /* for(i..) */
+  prod.join();
+  auto end = std::chrono::steady_clock::now();
+  return n_items / std::chrono::duration<double>(end - start).count();
+} /* throughput_measure() */
+
+/**
+ * \brief Time round trips of a single item between two threads through a pair
+ * of queues.
+ *
+ * \return Mean one-way latency in nanoseconds.
+ */
+template <typename Q, typename Push, typename Pop>
+static double latency_measure(Q* ping, Q* pong, size_t n_items,
+                              Push push, Pop pop) {
+  std::thread echo([&]() {
+                     element8 e{};
+                     for (size_t i = 0; i < n_items; ++i) {
+                       pop(ping, &e);
+                       push(pong, &e);
+                     } /* for(i..) */
+                   });
+  auto start = std::chrono::steady_clock::now();
+  element8 e{};
+  for (size_t i = 0; i < n_items; ++i) {
+    push(ping, &e);
+    pop(pong, &e);
+  } /* for(i..) */
+  auto end = std::chrono::steady_clock::now();
+  echo.join();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+      (2 * n_items);
+} /* latency_measure() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Serial Test", "[mt][spscqueue]") {
+  run_test<element8>(serial_test<element8>);
+  run_test<element4>(serial_test<element4>);
+}
+
+CATCH_TEST_CASE("Concurrency Test", "[mt][spscqueue]") {
+  run_test<element8>(concurrent_test<element8>);
+  run_test<element4>(concurrent_test<element4>);
+}
+
+CATCH_TEST_CASE("Benchmark", "[.][bench][mt][spscqueue]") {
+  const size_t n_items = 2000000;
+  struct fifo_params params;
+  memset(&params, 0, sizeof(params));
+  params.elt_size = sizeof(element8);
+  params.max_elts = 1024;
+
+  struct pcqueue* pcq = pcqueue_init(nullptr, &params);
+  struct pcqueue* pcq2 = pcqueue_init(nullptr, &params);
+  std::cout << "pcqueue           : "
+            << throughput_measure(pcq, n_items, pcqueue_push, pcqueue_pop)
+            << " items/s, "
+            << latency_measure(pcq, pcq2, n_items / 10, pcqueue_push,
+                               pcqueue_pop)
+            << " ns one-way\n";
+  pcqueue_destroy(pcq);
+  pcqueue_destroy(pcq2);
+
+  for (uint32_t flags : {RCSW_NONE, RCSW_SPSCQUEUE_FUTEX}) {
+    params.flags = flags;
+    struct spscqueue* q = spscqueue_init(nullptr, &params);
+    struct spscqueue* q2 = spscqueue_init(nullptr, &params);
+    std::cout << ((flags & RCSW_SPSCQUEUE_FUTEX) ? "spscqueue (futex) : " :
+                  "spscqueue (spin)  : ")
+              << throughput_measure(q, n_items, spscqueue_push, spscqueue_pop)
+              << " items/s, "
+              << latency_measure(q, q2, n_items / 10, spscqueue_push,
+                                 spscqueue_pop)
+              << " ns one-way\n";
+    spscqueue_destroy(q);
+    spscqueue_destroy(q2);
+  } /* for(flags..) */
+}
@@ -0,0 +1,370 @@
+/**
+ * \file mt-sync-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/mutex.h"
+#include "rcsw/multithread/csem.h"
+#include "rcsw/multithread/bsem.h"
+#include "rcsw/multithread/condv.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_N_THREADS 4
+#define TH_N_ITERS 20000
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using sync_test = void(*)(uint32_t flags);
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+static void run_test(sync_test test) {
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE,
+  };
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+    test(flags[i]);
+  } /* for(i..) */
+} /* run_test() */
+
+/* The counters only exist with the futex-based implementations */
+static void th_stats_check(status_t rstat, const struct futex_stats* stats) {
+#if defined(RCSW_CONFIG_AL_FUTEX_SYNC)
+  CATCH_REQUIRE(OK == rstat);
+  (void)stats;
+#else
+  CATCH_REQUIRE(ERROR == rstat);
+  CATCH_REQUIRE(0 == stats->n_spins);
+  CATCH_REQUIRE(0 == stats->n_sleeps);
+  CATCH_REQUIRE(0 == stats->n_wakeups);
+#endif
+} /* th_stats_check() */
+
+static double th_elapsed_ms(std::chrono::steady_clock::time_point start) {
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+} /* th_elapsed_ms() */
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void mutex_test(uint32_t flags) {
+  struct mutex mtx_in;
+  struct mutex* mtx = mutex_init(&mtx_in, flags);
+  CATCH_REQUIRE(nullptr != mtx);
+
+  /* non-atomic increments, so lost updates show up if exclusion is broken */
+  size_t count = 0;
+  std::atomic_size_t n_errs(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < TH_N_THREADS; ++i) {
+    threads.emplace_back([&]() {
+        for (size_t j = 0; j < TH_N_ITERS; ++j) {
+          n_errs += (OK != mutex_lock(mtx));
+          ++count;
+          n_errs += (OK != mutex_unlock(mtx));
+        } /* for(j..) */
+      });
+  } /* for(i..) */
+  for (auto& t : threads) {
+    t.join();
+  } /* for(t..) */
+  CATCH_REQUIRE(0 == n_errs);
+  CATCH_REQUIRE(TH_N_THREADS * TH_N_ITERS == count);
+
+  struct futex_stats stats;
+  th_stats_check(mutex_stats_get(mtx, &stats), &stats);
+  mutex_destroy(mtx);
+} /* mutex_test() */
+
+static void csem_test(uint32_t flags) {
+  struct csem sem_in;
+  struct csem* sem = csem_init(&sem_in, 2, flags);
+  CATCH_REQUIRE(nullptr != sem);
+
+  /* initial value */
+  CATCH_REQUIRE(OK == csem_trywait(sem));
+  CATCH_REQUIRE(OK == csem_wait(sem));
+  CATCH_REQUIRE(ERROR == csem_trywait(sem));
+
+  /* batches */
+  CATCH_REQUIRE(0 == csem_trywait_n(sem, 4));
+  CATCH_REQUIRE(OK == csem_post_n(sem, 5));
+  CATCH_REQUIRE(0 == csem_trywait_n(sem, 0));
+  CATCH_REQUIRE(3 == csem_trywait_n(sem, 3));
+  CATCH_REQUIRE(2 == csem_trywait_n(sem, 3));
+  CATCH_REQUIRE(ERROR == csem_trywait(sem));
+
+  /* timeouts */
+  struct timespec to = {.tv_sec = 0, .tv_nsec = 10000000};
+  auto start = std::chrono::steady_clock::now();
+  CATCH_REQUIRE(ERROR == csem_timedwait(sem, &to));
+  CATCH_REQUIRE(th_elapsed_ms(start) >= 9.0);
+
+  /* producer/consumer: every post is consumed exactly once */
+  std::atomic_size_t n_consumed(0);
+  std::atomic_size_t n_errs(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < TH_N_THREADS; ++i) {
+    threads.emplace_back([&]() {
+        for (size_t j = 0; j < TH_N_ITERS / TH_N_THREADS; ++j) {
+          n_errs += (OK != csem_wait(sem));
+          ++n_consumed;
+        } /* for(j..) */
+      });
+  } /* for(i..) */
+  /* half posted one at a time, half in batches that wake several waiters */
+  for (size_t i = 0; i < TH_N_ITERS / 2; ++i) {
+    CATCH_REQUIRE(OK == csem_post(sem));
+  } /* for(i..) */
+  for (size_t i = TH_N_ITERS / 2; i < TH_N_ITERS; i += TH_N_THREADS) {
+    CATCH_REQUIRE(OK == csem_post_n(sem, std::min<size_t>(TH_N_THREADS,
+                                                          TH_N_ITERS - i)));
+  } /* for(i..) */
+  for (auto& t : threads) {
+    t.join();
+  } /* for(t..) */
+  CATCH_REQUIRE(0 == n_errs);
+  CATCH_REQUIRE(TH_N_ITERS == n_consumed);
+  CATCH_REQUIRE(ERROR == csem_trywait(sem));
+
+  struct futex_stats stats;
+  th_stats_check(csem_stats_get(sem, &stats), &stats);
+  csem_destroy(sem);
+} /* csem_test() */
+
+static void bsem_test(uint32_t flags) {
+  struct bsem ping_in;
+  struct bsem pong_in;
+  struct bsem* ping = bsem_init(&ping_in, flags);
+  struct bsem* pong = bsem_init(&pong_in, flags);
+  CATCH_REQUIRE(nullptr != ping);
+  CATCH_REQUIRE(nullptr != pong);
+
+  /* starts available, and can't be posted twice */
+  CATCH_REQUIRE(ERROR == bsem_post(ping));
+  CATCH_REQUIRE(OK == bsem_wait(ping));
+  CATCH_REQUIRE(OK == bsem_wait(pong));
+
+  struct timespec to = {.tv_sec = 0, .tv_nsec = 10000000};
+  auto start = std::chrono::steady_clock::now();
+  CATCH_REQUIRE(ERROR == bsem_timedwait(ping, &to));
+  CATCH_REQUIRE(th_elapsed_ms(start) >= 9.0);
+
+  /* ping-pong: strictly alternating */
+  size_t turns = 0;
+  std::atomic_size_t n_errs(0);
+  std::thread t([&]() {
+      for (size_t i = 0; i < TH_N_ITERS; ++i) {
+        n_errs += (OK != bsem_wait(ping));
+        n_errs += (1 != turns % 2);
+        ++turns;
+        n_errs += (OK != bsem_post(pong));
+      } /* for(i..) */
+    });
+  for (size_t i = 0; i < TH_N_ITERS; ++i) {
+    n_errs += (0 != turns % 2);
+    ++turns;
+    n_errs += (OK != bsem_post(ping));
+    n_errs += (OK != bsem_wait(pong));
+  } /* for(i..) */
+  t.join();
+  CATCH_REQUIRE(0 == n_errs);
+  CATCH_REQUIRE(2 * TH_N_ITERS == turns);
+
+  /* flush releases a waiter, which passes it on to the next */
+  std::atomic_size_t n_woken(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < TH_N_THREADS; ++i) {
+    threads.emplace_back([&]() {
+        n_errs += (OK != bsem_wait(ping));
+        ++n_woken;
+        bsem_post(ping);
+      });
+  } /* for(i..) */
+  CATCH_REQUIRE(OK == bsem_flush(ping));
+  for (auto& th : threads) {
+    th.join();
+  } /* for(th..) */
+  CATCH_REQUIRE(0 == n_errs);
+  CATCH_REQUIRE(TH_N_THREADS == n_woken);
+
+  struct futex_stats stats;
+  th_stats_check(bsem_stats_get(ping, &stats), &stats);
+  bsem_destroy(ping);
+  bsem_destroy(pong);
+} /* bsem_test() */
+
+static void condv_test(uint32_t flags) {
+  struct condv cv_in;
+  struct mutex mtx_in;
+  struct condv* cv = condv_init(&cv_in, flags);
+  struct mutex* mtx = mutex_init(&mtx_in, flags);
+  CATCH_REQUIRE(nullptr != cv);
+  CATCH_REQUIRE(nullptr != mtx);
+
+  /* nobody signals, so we time out--with the mutex held again */
+  struct timespec to = {.tv_sec = 0, .tv_nsec = 10000000};
+  auto start = std::chrono::steady_clock::now();
+  mutex_lock(mtx);
+  CATCH_REQUIRE(ERROR == condv_timedwait(cv, mtx, &to));
+  mutex_unlock(mtx);
+  CATCH_REQUIRE(th_elapsed_ms(start) >= 9.0);
+
+  /* broadcast wakes everyone */
+  bool_t go = false;
+  size_t n_woken = 0;
+  std::atomic_size_t n_errs(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < TH_N_THREADS; ++i) {
+    threads.emplace_back([&]() {
+        mutex_lock(mtx);
+        while (!go) {
+          n_errs += (OK != condv_wait(cv, mtx));
+        } /* while() */
+        ++n_woken;
+        mutex_unlock(mtx);
+      });
+  } /* for(i..) */
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  mutex_lock(mtx);
+  go = true;
+  mutex_unlock(mtx);
+  CATCH_REQUIRE(OK == condv_broadcast(cv));
+  for (auto& t : threads) {
+    t.join();
+  } /* for(t..) */
+  CATCH_REQUIRE(TH_N_THREADS == n_woken);
+
+  /* signal hands off items one at a time */
+  size_t avail = 0;
+  size_t n_taken = 0;
+  std::thread consumer([&]() {
+      mutex_lock(mtx);
+      while (n_taken < TH_N_ITERS) {
+        while (0 == avail) {
+          n_errs += (OK != condv_wait(cv, mtx));
+        } /* while() */
+        --avail;
+        ++n_taken;
+      } /* while() */
+      mutex_unlock(mtx);
+    });
+  for (size_t i = 0; i < TH_N_ITERS; ++i) {
+    mutex_lock(mtx);
+    ++avail;
+    mutex_unlock(mtx);
+    n_errs += (OK != condv_signal(cv));
+  } /* for(i..) */
+  consumer.join();
+  CATCH_REQUIRE(0 == n_errs);
+  CATCH_REQUIRE(TH_N_ITERS == n_taken);
+
+  struct futex_stats stats;
+  th_stats_check(condv_stats_get(cv, &stats), &stats);
+  condv_destroy(cv);
+  mutex_destroy(mtx);
+} /* condv_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Mutex Test", "[mt][sync]") {
+  run_test(mutex_test);
+}
+
+CATCH_TEST_CASE("Counting Semaphore Test", "[mt][sync]") {
+  run_test(csem_test);
+}
+
+CATCH_TEST_CASE("Binary Semaphore Test", "[mt][sync]") {
+  run_test(bsem_test);
+}
+
+CATCH_TEST_CASE("Condition Variable Test", "[mt][sync]") {
+  run_test(condv_test);
+}
+
+CATCH_TEST_CASE("Contention Benchmark", "[.][bench][mt][sync]") {
+  const size_t kOps = 1000000;
+  struct mutex* mtx = mutex_init(nullptr, RCSW_NONE);
+  struct bsem* ping = bsem_init(nullptr, RCSW_NONE);
+  struct bsem* pong = bsem_init(nullptr, RCSW_NONE);
+  CATCH_REQUIRE(nullptr != mtx);
+  CATCH_REQUIRE(nullptr != ping);
+  CATCH_REQUIRE(nullptr != pong);
+  struct futex_stats stats;
+
+  for (size_t n_threads = 1; n_threads <= 8; n_threads *= 2) {
+    size_t count = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n_threads; ++i) {
+      threads.emplace_back([&]() {
+          for (size_t j = 0; j < kOps / n_threads; ++j) {
+            mutex_lock(mtx);
+            ++count;
+            mutex_unlock(mtx);
+          } /* for(j..) */
+        });
+    } /* for(i..) */
+    for (auto& t : threads) {
+      t.join();
+    } /* for(t..) */
+    double ms = th_elapsed_ms(start);
+    mutex_stats_get(mtx, &stats);
+    std::cout << "mutex " << n_threads << " threads: "
+              << ms * 1e6 / kOps << " ns/op"
+              << " spins=" << stats.n_spins
+              << " sleeps=" << stats.n_sleeps
+              << " wakeups=" << stats.n_wakeups << std::endl;
+  } /* for(n_threads..) */
+
+  bsem_wait(ping);
+  bsem_wait(pong);
+  const size_t kRounds = kOps / 10;
+  auto start = std::chrono::steady_clock::now();
+  std::thread t([&]() {
+      for (size_t i = 0; i < kRounds; ++i) {
+        bsem_wait(ping);
+        bsem_post(pong);
+      } /* for(i..) */
+    });
+  for (size_t i = 0; i < kRounds; ++i) {
+    bsem_post(ping);
+    bsem_wait(pong);
+  } /* for(i..) */
+  t.join();
+  double ms = th_elapsed_ms(start);
+  bsem_stats_get(ping, &stats);
+  std::cout << "bsem ping-pong: " << ms * 1e6 / kRounds << " ns/round"
+            << " spins=" << stats.n_spins
+            << " sleeps=" << stats.n_sleeps
+            << " wakeups=" << stats.n_wakeups << std::endl;
+
+  mutex_destroy(mtx);
+  bsem_destroy(ping);
+  bsem_destroy(pong);
+}
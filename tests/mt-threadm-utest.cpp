@@ -0,0 +1,323 @@
+/**
+ * \file mt-threadm-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/multithread/threadm.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_N_THREADS 4
+#define TH_N_TASKS 10000
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using threadm_test = void(*)(struct threadm_pool_params* params);
+
+struct tree_node {
+  struct threadm_pool* pool;
+  std::atomic_size_t* count;
+  size_t depth;
+};
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+static void run_test(threadm_test test) {
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE,
+    RCSW_THREADM_POOL_PIN,
+  };
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+    struct threadm_pool_params params;
+    params.n_threads = TH_N_THREADS;
+    params.deque_size = 1024;
+    params.queue_size = 1024;
+    params.core_offset = 0;
+    params.flags = flags[i];
+    test(&params);
+  } /* for(i..) */
+} /* run_test() */
+
+static void th_count(void* arg) {
+  ++*(std::atomic_size_t*)arg;
+} /* th_count() */
+
+/*
+ * Count the nodes in a binary tree of tasks, each of which submits its
+ * children and waits for them.
+ */
+static void th_tree(void* arg) {
+  auto* node = (struct tree_node*)arg;
+  ++*node->count;
+  if (0 == node->depth) {
+    return;
+  }
+  struct tree_node children[2];
+  struct threadm_task tasks[2];
+  struct threadm_group group = {0};
+  for (size_t i = 0; i < 2; ++i) {
+    children[i] = {node->pool, node->count, node->depth - 1};
+    tasks[i].fn = th_tree;
+    tasks[i].arg = &children[i];
+    threadm_pool_submit(node->pool, &group, &tasks[i]);
+  } /* for(i..) */
+  threadm_pool_wait(node->pool, &group);
+} /* th_tree() */
+
+static void th_visit(size_t lo, size_t hi, void* arg) {
+  auto* visits = (std::vector<std::atomic_uint>*)arg;
+  for (size_t i = lo; i < hi; ++i) {
+    ++(*visits)[i];
+  } /* for(i..) */
+} /* th_visit() */
+
+static void th_sum(size_t lo, size_t hi, void* arg) {
+  size_t sum = 0;
+  for (size_t i = lo; i < hi; ++i) {
+    sum += i;
+  } /* for(i..) */
+  *(std::atomic_size_t*)arg += sum;
+} /* th_sum() */
+
+static void th_hash(size_t lo, size_t hi, void* arg) {
+  size_t sum = 0;
+  for (size_t i = lo; i < hi; ++i) {
+    sum += (i * 2654435761UL) >> 7;
+  } /* for(i..) */
+  *(std::atomic_size_t*)arg += sum;
+} /* th_hash() */
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void submit_test(struct threadm_pool_params* params) {
+  struct threadm_pool pool_in;
+  struct threadm_pool* pool = threadm_pool_init(&pool_in, params);
+  CATCH_REQUIRE(nullptr != pool);
+  CATCH_REQUIRE(TH_N_THREADS == pool->n_workers);
+
+  std::atomic_size_t count(0);
+  std::vector<struct threadm_task> tasks(TH_N_TASKS);
+  struct threadm_group group = {0};
+  for (auto& task : tasks) {
+    task.fn = th_count;
+    task.arg = &count;
+    CATCH_REQUIRE(OK == threadm_pool_submit(pool, &group, &task));
+  } /* for(task..) */
+  CATCH_REQUIRE(OK == threadm_pool_wait(pool, &group));
+  CATCH_REQUIRE(TH_N_TASKS == count);
+  CATCH_REQUIRE(0 == group.n_pending);
+
+  /* waiting on an empty group returns immediately */
+  CATCH_REQUIRE(OK == threadm_pool_wait(pool, &group));
+  threadm_pool_destroy(pool);
+} /* submit_test() */
+
+static void nested_test(struct threadm_pool_params* params) {
+  /* small queues, so some tasks are run inline by the submitter */
+  params->deque_size = 4;
+  params->queue_size = 2;
+  struct threadm_pool pool_in;
+  struct threadm_pool* pool = threadm_pool_init(&pool_in, params);
+  CATCH_REQUIRE(nullptr != pool);
+
+  const size_t kDepth = 12;
+  std::atomic_size_t count(0);
+  struct tree_node root = {pool, &count, kDepth};
+  struct threadm_task task = {th_tree, &root, nullptr};
+  struct threadm_group group = {0};
+  CATCH_REQUIRE(OK == threadm_pool_submit(pool, &group, &task));
+  CATCH_REQUIRE(OK == threadm_pool_wait(pool, &group));
+  CATCH_REQUIRE((1UL << (kDepth + 1)) - 1 == count);
+
+  size_t n_executed = 0;
+  for (size_t i = 0; i < pool->n_workers; ++i) {
+    n_executed += pool->workers[i].n_executed;
+  } /* for(i..) */
+  CATCH_REQUIRE(n_executed <= count);
+  threadm_pool_destroy(pool);
+} /* nested_test() */
+
+static void parallel_for_test(struct threadm_pool_params* params) {
+  struct threadm_pool pool_in;
+  struct threadm_pool* pool = threadm_pool_init(&pool_in, params);
+  CATCH_REQUIRE(nullptr != pool);
+
+  const size_t kN = 100000;
+  size_t grains[] = {0, 1, 7, 1000, kN, 2 * kN};
+  for (size_t grain : grains) {
+    std::vector<std::atomic_uint> visits(kN);
+    CATCH_REQUIRE(OK == threadm_pool_parallel_for(pool,
+                                                  0,
+                                                  kN,
+                                                  grain,
+                                                  th_visit,
+                                                  &visits));
+    for (size_t i = 0; i < kN; ++i) {
+      CATCH_REQUIRE(1 == visits[i]);
+    } /* for(i..) */
+
+    std::atomic_size_t sum(0);
+    CATCH_REQUIRE(OK == threadm_pool_parallel_for(pool,
+                                                  10,
+                                                  kN,
+                                                  grain,
+                                                  th_sum,
+                                                  &sum));
+    CATCH_REQUIRE((kN - 1) * kN / 2 - 45 == sum);
+  } /* for(grain..) */
+
+  /* empty range */
+  std::atomic_size_t sum(0);
+  CATCH_REQUIRE(OK == threadm_pool_parallel_for(pool, 5, 5, 0, th_sum, &sum));
+  CATCH_REQUIRE(0 == sum);
+  CATCH_REQUIRE(ERROR == threadm_pool_parallel_for(pool,
+                                                   5,
+                                                   4,
+                                                   0,
+                                                   th_sum,
+                                                   &sum));
+  threadm_pool_destroy(pool);
+} /* parallel_for_test() */
+
+static void topology_test(void) {
+  struct threadm_topology topo;
+  CATCH_REQUIRE(OK == threadm_topology_discover(&topo));
+  CATCH_REQUIRE(topo.n_nodes >= 1);
+  CATCH_REQUIRE(topo.n_cpus >= 1);
+
+  /* every CPU is on exactly one node */
+  size_t n_cpus = 0;
+  for (size_t i = 0; i < topo.n_nodes; ++i) {
+    CATCH_REQUIRE(topo.nodes[i].n_cpus > 0);
+    n_cpus += topo.nodes[i].n_cpus;
+  } /* for(i..) */
+  CATCH_REQUIRE(topo.n_cpus == n_cpus);
+  CATCH_REQUIRE(topo.n_nodes > threadm_node_current(&topo));
+  CATCH_REQUIRE(-1 == threadm_cpu_node(&topo, RCSW_THREADM_MAX_CPUS));
+
+  /* spreading visits every CPU once, then wraps */
+  std::vector<size_t> cpus(2 * topo.n_cpus + 1);
+  CATCH_REQUIRE(cpus.size() == threadm_cpus_spread(&topo,
+                                                   cpus.data(),
+                                                   cpus.size()));
+  std::vector<size_t> seen(RCSW_THREADM_MAX_CPUS);
+  for (size_t i = 0; i < topo.n_cpus; ++i) {
+    CATCH_REQUIRE(-1 != threadm_cpu_node(&topo, cpus[i]));
+    CATCH_REQUIRE(0 == seen[cpus[i]]++);
+    CATCH_REQUIRE(cpus[i] == cpus[i + topo.n_cpus]);
+  } /* for(i..) */
+
+  /* the first CPUs picked are on different nodes */
+  for (size_t i = 1; i < topo.n_nodes; ++i) {
+    CATCH_REQUIRE(threadm_cpu_node(&topo, cpus[i - 1]) !=
+                  threadm_cpu_node(&topo, cpus[i]));
+  } /* for(i..) */
+} /* topology_test() */
+
+static void numa_test(void) {
+  struct threadm_topology topo;
+  CATCH_REQUIRE(OK == threadm_topology_discover(&topo));
+
+  for (size_t i = 0; i < topo.n_nodes; ++i) {
+    CATCH_REQUIRE(OK == threadm_node_lock(pthread_self(), &topo, i));
+    CATCH_REQUIRE(i == threadm_node_current(&topo));
+
+    const size_t kSize = 1 << 20;
+    auto* mem = (uint8_t*)threadm_numa_alloc(&topo, i, kSize);
+    CATCH_REQUIRE(nullptr != mem);
+    CATCH_REQUIRE(OK == threadm_numa_bind(&topo,
+                                          0,
+                                          mem + kSize / 2,
+                                          kSize / 2));
+    for (size_t j = 0; j < kSize; ++j) {
+      mem[j] = (uint8_t)j;
+    } /* for(j..) */
+    for (size_t j = 0; j < kSize; ++j) {
+      CATCH_REQUIRE((uint8_t)j == mem[j]);
+    } /* for(j..) */
+    threadm_numa_free(mem, kSize);
+  } /* for(i..) */
+  CATCH_REQUIRE(ERROR == threadm_node_lock(pthread_self(),
+                                           &topo,
+                                           topo.n_nodes));
+  CATCH_REQUIRE(nullptr == threadm_numa_alloc(&topo, topo.n_nodes, 4096));
+} /* numa_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Submit Test", "[mt][threadm]") {
+  run_test(submit_test);
+}
+
+CATCH_TEST_CASE("Nested Test", "[mt][threadm]") {
+  run_test(nested_test);
+}
+
+CATCH_TEST_CASE("Parallel For Test", "[mt][threadm]") {
+  run_test(parallel_for_test);
+}
+
+CATCH_TEST_CASE("Topology Test", "[mt][threadm]") {
+  topology_test();
+}
+
+CATCH_TEST_CASE("NUMA Test", "[mt][threadm]") {
+  numa_test();
+}
+
+CATCH_TEST_CASE("Parallel For Benchmark", "[.][bench][mt][threadm]") {
+  const size_t kN = 1 << 26;
+  struct threadm_pool_params params;
+  params.n_threads = 0;
+  params.deque_size = 1024;
+  params.queue_size = 1024;
+  params.core_offset = 0;
+  params.flags = RCSW_THREADM_POOL_PIN;
+  struct threadm_pool* pool = threadm_pool_init(nullptr, &params);
+  CATCH_REQUIRE(nullptr != pool);
+
+  std::atomic_size_t sum(0);
+  auto start = std::chrono::steady_clock::now();
+  th_hash(0, kN, &sum);
+  auto end = std::chrono::steady_clock::now();
+  double serial = std::chrono::duration<double,
+                                        std::milli>(end - start).count();
+
+  std::atomic_size_t psum(0);
+  start = std::chrono::steady_clock::now();
+  CATCH_REQUIRE(OK == threadm_pool_parallel_for(pool,
+                                                0,
+                                                kN,
+                                                0,
+                                                th_hash,
+                                                &psum));
+  end = std::chrono::steady_clock::now();
+  double parallel = std::chrono::duration<double,
+                                          std::milli>(end - start).count();
+  CATCH_REQUIRE(sum == psum);
+
+  std::cout << "serial: " << serial << " ms, parallel (" << pool->n_workers
+            << " workers): " << parallel << " ms" << std::endl;
+  threadm_pool_destroy(pool);
+}
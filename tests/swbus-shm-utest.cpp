@@ -0,0 +1,503 @@
+/**
+ * \file swbus-shm-utest.cpp
+ *
+ * \copyright 2024 John Harwell, All rights reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_PREFIX_ALL
+#include <catch/catch.hpp>
+
+#include "rcsw/swbus/swbus_shm.h"
+
+/*******************************************************************************
+ * Constant Definitions
+ ******************************************************************************/
+#define TH_MAX_RXQS 4
+#define TH_MAX_SUBS 16
+#define TH_RXQ_SIZE 16
+#define TH_SMALL_ELTS 16
+#define TH_BIG_ELTS 8
+#define TH_N_PKTS 5000
+
+/* Size of ping packets in the multiprocess test: smaller than a th_pkt */
+#define TH_PING_SIZE sizeof(uint32_t)
+
+/* PIDs for the multiprocess tests */
+#define TH_PID_DATA 0
+#define TH_PID_READY 1
+#define TH_PID_PING 2
+#define TH_PID_PONG 3
+
+/*******************************************************************************
+ * Namespaces/Decls
+ ******************************************************************************/
+using shm_test = void(*)(uint32_t flags);
+
+struct th_pkt {
+  uint32_t src;
+  uint32_t seq;
+};
+
+/*
+ * Kills and reaps any forked children which haven't been waited for on scope
+ * exit, so a failed CATCH_REQUIRE() in the parent doesn't leave them running
+ * (and holding the test runner's stdout open).
+ */
+struct th_children {
+  th_children() = default;
+  th_children(const th_children&) = delete;
+  th_children& operator=(const th_children&) = delete;
+  ~th_children() {
+    for (pid_t child : pids) {
+      kill(child, SIGKILL);
+      waitpid(child, nullptr, 0);
+    } /* for(child..) */
+  }
+  std::vector<pid_t> pids;
+};
+
+/*******************************************************************************
+ * Test Helper Functions
+ ******************************************************************************/
+/* computed once, so forked children get the same name as their parent */
+static const std::string& th_shm_name(void) {
+  static const std::string name = "/rcsw-swbus-utest-" +
+                                  std::to_string(getpid());
+  return name;
+}
+
+static void run_test(shm_test test) {
+  uint32_t flags[] = {
+    RCSW_NONE,
+    RCSW_NOALLOC_HANDLE,
+  };
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
+    swbus_shm_unlink(th_shm_name().c_str());
+    test(flags[i]);
+    swbus_shm_unlink(th_shm_name().c_str());
+  } /* for(i..) */
+}
+
+/*
+ * \param ping_pool If true, pool 0 holds only \ref TH_PING_SIZE packets, which
+ * \ref th_pkt packets can't spill into, so the small and big pools are 1 and
+ * 2.
+ */
+static struct swbus_shm* th_bus_create(struct swbus_shm* swb_in,
+                                       uint32_t flags,
+                                       size_t rxq_size,
+                                       bool ping_pool = false) {
+  struct mpool_params pools[3] = {};
+  size_t n_pools = 0;
+  if (ping_pool) {
+    pools[n_pools].elt_size = TH_PING_SIZE;
+    pools[n_pools++].max_elts = 2;
+  }
+  pools[n_pools].elt_size = sizeof(struct th_pkt);
+  pools[n_pools++].max_elts = TH_SMALL_ELTS;
+  pools[n_pools].elt_size = 512;
+  pools[n_pools++].max_elts = TH_BIG_ELTS;
+
+  struct swbus_shm_params params = {};
+  params.pools = pools;
+  params.max_pools = n_pools;
+  params.max_rxqs = TH_MAX_RXQS;
+  params.max_subs = TH_MAX_SUBS;
+  params.rxq_size = rxq_size;
+  params.flags = flags;
+  strncpy(params.name, "shm-utest", RCSW_SWBUS_MAX_NAMELEN);
+  return swbus_shm_create(swb_in, th_shm_name().c_str(), &params);
+}
+
+/*
+ * Publish a packet from a child process, retrying while the subscriber is
+ * behind. Children can't use CATCH_REQUIRE().
+ */
+static bool th_child_publish(struct swbus_shm* swb,
+                             uint32_t pid,
+                             const struct th_pkt* pkt) {
+  struct swbus_shm_rsrvn res;
+  while (OK != swbus_shm_publish_reserve(swb, &res, sizeof(*pkt))) {
+    if (ENOMEM != errno) {
+      return false;
+    }
+    usleep(10);
+  } /* while() */
+  memcpy(res.data, pkt, sizeof(*pkt));
+  return OK == swbus_shm_publish_release(swb, pid, &res, sizeof(*pkt));
+}
+
+/*
+ * Fork a child which is killed if the parent dies, and track it in \p
+ * children.
+ */
+static pid_t th_fork(struct th_children* children) {
+  pid_t parent = getpid();
+  pid_t child = fork();
+  CATCH_REQUIRE(-1 != child);
+  if (0 == child) {
+    /* the parent might have died before prctl() */
+    if (0 != prctl(PR_SET_PDEATHSIG, SIGKILL) || getppid() != parent) {
+      _exit(1);
+    }
+  } else {
+    children->pids.push_back(child);
+  }
+  return child;
+}
+
+/*
+ * Wait for all children to exit successfully.
+ */
+static void th_children_wait(struct th_children* children) {
+  while (!children->pids.empty()) {
+    pid_t child = children->pids.back();
+    children->pids.pop_back();
+    int status = 0;
+    CATCH_REQUIRE(child == waitpid(child, &status, 0));
+    CATCH_REQUIRE(WIFEXITED(status));
+    CATCH_REQUIRE(0 == WEXITSTATUS(status));
+  } /* while() */
+}
+
+/*******************************************************************************
+ * Test Functions
+ ******************************************************************************/
+static void simple_test(uint32_t flags) {
+  struct swbus_shm swb_in;
+  struct swbus_shm* swb = th_bus_create(&swb_in, flags, TH_RXQ_SIZE);
+  CATCH_REQUIRE(nullptr != swb);
+
+  /* the segment already exists */
+  struct swbus_shm dup_in;
+  CATCH_REQUIRE(nullptr == th_bus_create(&dup_in, flags, TH_RXQ_SIZE));
+
+  /* A second mapping of the same segment, as another process would have */
+  struct swbus_shm peer_in;
+  struct swbus_shm* peer = swbus_shm_open(&peer_in,
+                                          th_shm_name().c_str(),
+                                          flags);
+  CATCH_REQUIRE(nullptr != peer);
+  CATCH_REQUIRE(peer->hdr != swb->hdr);
+  CATCH_REQUIRE(nullptr == swbus_shm_open(nullptr,
+                                          "/rcsw-no-such-bus",
+                                          flags));
+
+  struct swbus_shm_rxq* rxq = swbus_shm_rxq_init(swb);
+  CATCH_REQUIRE(nullptr != rxq);
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(swb, rxq, 17));
+  CATCH_REQUIRE(ERROR == swbus_shm_subscribe(swb, rxq, 17));
+
+  /* zero-copy publish from the peer mapping */
+  struct swbus_shm_rsrvn res;
+  CATCH_REQUIRE(OK == swbus_shm_publish_reserve(peer, &res, 100));
+  CATCH_REQUIRE(1 == res.pool);
+  for (size_t i = 0; i < 100; ++i) {
+    res.data[i] = (dptr_t)i;
+  } /* for(i..) */
+  swbus_shm_off_t off = res.off;
+  CATCH_REQUIRE(OK == swbus_shm_publish_release(peer, 17, &res, 100));
+
+  struct swbus_shm_rxq_ent ent;
+  CATCH_REQUIRE(OK == swbus_shm_rxq_wait(swb, rxq, &ent));
+  CATCH_REQUIRE(17 == ent.pid);
+  CATCH_REQUIRE(100 == ent.pkt_size);
+  CATCH_REQUIRE(off == ent.off);
+  CATCH_REQUIRE(swbus_shm_ptr(swb, off) == ent.data);
+  for (size_t i = 0; i < 100; ++i) {
+    CATCH_REQUIRE((dptr_t)i == ent.data[i]);
+  } /* for(i..) */
+  CATCH_REQUIRE(1 == swbus_shm_pool_size(swb, 1));
+  CATCH_REQUIRE(OK == swbus_shm_rxq_release(swb, &ent));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 1));
+
+  /* nobody subscribed: the buffer is freed immediately */
+  struct th_pkt pkt = { 1, 2 };
+  CATCH_REQUIRE(OK == swbus_shm_publish(peer, 18, sizeof(pkt), &pkt));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 0));
+  CATCH_REQUIRE(0 == swbus_shm_rxq_size(rxq));
+
+  /* nothing to receive */
+  struct timespec to = { .tv_sec = 0, .tv_nsec = 1000000 };
+  CATCH_REQUIRE(ERROR == swbus_shm_rxq_timedwait(swb, rxq, &ent, &to));
+  CATCH_REQUIRE(ETIMEDOUT == errno);
+  CATCH_REQUIRE(ERROR == swbus_shm_rxq_trypop(swb, rxq, &ent));
+
+  /* small packets spill over into the big pool, until both run out */
+  std::vector<struct swbus_shm_rsrvn> rsrvns(TH_SMALL_ELTS + TH_BIG_ELTS);
+  for (auto& r : rsrvns) {
+    CATCH_REQUIRE(OK == swbus_shm_publish_reserve(peer, &r, sizeof(pkt)));
+    /* chunks don't share cache lines, even though they are only 8 bytes */
+    CATCH_REQUIRE(0 == r.off % RCSW_CACHELINE_SIZE);
+  } /* for(r..) */
+  CATCH_REQUIRE(TH_SMALL_ELTS == swbus_shm_pool_size(swb, 0));
+  CATCH_REQUIRE(TH_BIG_ELTS == swbus_shm_pool_size(swb, 1));
+  CATCH_REQUIRE(ERROR == swbus_shm_publish_reserve(peer, &res, sizeof(pkt)));
+  CATCH_REQUIRE(ENOMEM == errno);
+  for (auto& r : rsrvns) {
+    CATCH_REQUIRE(OK == swbus_shm_publish_release(peer, 18, &r, sizeof(pkt)));
+  } /* for(r..) */
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 0));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 1));
+
+  /* a full RXQ fails the publish, but not for other subscribers */
+  struct swbus_shm_rxq* rxq2 = swbus_shm_rxq_init(peer);
+  CATCH_REQUIRE(nullptr != rxq2);
+  CATCH_REQUIRE(rxq2->id != rxq->id);
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(peer, rxq2, 17));
+  for (size_t i = 0; i < TH_RXQ_SIZE; ++i) {
+    CATCH_REQUIRE(OK == swbus_shm_publish(peer, 17, sizeof(pkt), &pkt));
+    CATCH_REQUIRE(OK == swbus_shm_rxq_trypop(peer, rxq2, &ent));
+    CATCH_REQUIRE(OK == swbus_shm_rxq_release(peer, &ent));
+  } /* for(i..) */
+  CATCH_REQUIRE(TH_RXQ_SIZE == swbus_shm_rxq_size(rxq));
+  CATCH_REQUIRE(ERROR == swbus_shm_publish(peer, 17, sizeof(pkt), &pkt));
+  CATCH_REQUIRE(1 == swbus_shm_rxq_size(rxq2));
+
+  struct swbus_meta meta;
+  CATCH_REQUIRE(OK == swbus_shm_meta_get(peer, &meta));
+  CATCH_REQUIRE(2 == meta.n_rxqs);
+  CATCH_REQUIRE(2 == meta.n_subs);
+  CATCH_REQUIRE(1 == meta.n_notify_fails);
+  CATCH_REQUIRE(2 + TH_SMALL_ELTS + TH_BIG_ELTS + TH_RXQ_SIZE + 1 ==
+                meta.n_published);
+
+  /* destroying the RXQs releases everything still in them */
+  CATCH_REQUIRE(OK == swbus_shm_unsubscribe(peer, rxq2, 17));
+  CATCH_REQUIRE(ERROR == swbus_shm_unsubscribe(peer, rxq2, 17));
+  CATCH_REQUIRE(OK == swbus_shm_rxq_destroy(peer, rxq2));
+  CATCH_REQUIRE(OK == swbus_shm_rxq_destroy(swb, rxq));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 0));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 1));
+  CATCH_REQUIRE(OK == swbus_shm_meta_get(swb, &meta));
+  CATCH_REQUIRE(0 == meta.n_rxqs);
+  CATCH_REQUIRE(0 == meta.n_subs);
+
+  /* RXQs can be reused */
+  for (size_t i = 0; i < TH_MAX_RXQS; ++i) {
+    CATCH_REQUIRE(nullptr != swbus_shm_rxq_init(swb));
+  } /* for(i..) */
+  CATCH_REQUIRE(nullptr == swbus_shm_rxq_init(swb));
+
+  swbus_shm_close(peer);
+  swbus_shm_close(swb);
+} /* simple_test() */
+
+static void multiprocess_test(uint32_t flags) {
+  /* big enough that no RXQ can fill up before the pools run out */
+  const size_t kRxqSize = 4 * (TH_SMALL_ELTS + TH_BIG_ELTS);
+  struct swbus_shm swb_in;
+  struct swbus_shm* swb = th_bus_create(&swb_in, flags, kRxqSize, true);
+  CATCH_REQUIRE(nullptr != swb);
+  struct swbus_shm_rxq* rxq = swbus_shm_rxq_init(swb);
+  CATCH_REQUIRE(nullptr != rxq);
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(swb, rxq, TH_PID_DATA));
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(swb, rxq, TH_PID_READY));
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(swb, rxq, TH_PID_PONG));
+
+  /*
+   * Two producer processes stream packets to us, while a third plays
+   * ping-pong, so that both sides sleep on futexes in the segment. The
+   * producers can use up every chunk of the data pools, so pings have their
+   * own pool: the parent can't wait for chunks, since it is also the one
+   * freeing them.
+   */
+  const uint32_t kProducers = 2;
+  struct th_children children;
+  for (uint32_t c = 0; c < kProducers; ++c) {
+    if (0 == th_fork(&children)) {
+      struct swbus_shm* peer = swbus_shm_open(nullptr,
+                                              th_shm_name().c_str(),
+                                              RCSW_NONE);
+      bool ok = nullptr != peer;
+      for (uint32_t i = 0; ok && i < TH_N_PKTS; ++i) {
+        struct th_pkt pkt = { c, i };
+        ok = th_child_publish(peer, TH_PID_DATA, &pkt);
+      } /* for(i..) */
+      _exit(ok ? 0 : 1);
+    }
+  } /* for(c..) */
+
+  if (0 == th_fork(&children)) {
+    struct swbus_shm* peer = swbus_shm_open(nullptr,
+                                            th_shm_name().c_str(),
+                                            RCSW_NONE);
+    bool ok = nullptr != peer;
+    struct swbus_shm_rxq* prxq = ok ? swbus_shm_rxq_init(peer) : nullptr;
+    ok = ok && nullptr != prxq &&
+         OK == swbus_shm_subscribe(peer, prxq, TH_PID_PING);
+    struct th_pkt pkt = { kProducers, 0 };
+    ok = ok && th_child_publish(peer, TH_PID_READY, &pkt);
+    for (uint32_t i = 0; ok && i < TH_N_PKTS; ++i) {
+      struct swbus_shm_rxq_ent ent;
+      ok = OK == swbus_shm_rxq_wait(peer, prxq, &ent) &&
+           i == *(const uint32_t*)ent.data &&
+           OK == swbus_shm_rxq_release(peer, &ent);
+      pkt.seq = i;
+      ok = ok && th_child_publish(peer, TH_PID_PONG, &pkt);
+    } /* for(i..) */
+    ok = ok && OK == swbus_shm_rxq_destroy(peer, prxq);
+    _exit(ok ? 0 : 1);
+  }
+
+  uint32_t next_seq[kProducers] = {};
+  uint32_t n_pings = 0;
+  uint32_t n_pongs = 0;
+  bool ready = false;
+  while (next_seq[0] < TH_N_PKTS || next_seq[1] < TH_N_PKTS ||
+         n_pongs < TH_N_PKTS) {
+    struct swbus_shm_rxq_ent ent;
+    CATCH_REQUIRE(OK == swbus_shm_rxq_wait(swb, rxq, &ent));
+    const struct th_pkt* pkt = (const struct th_pkt*)ent.data;
+    if (TH_PID_READY == ent.pid) {
+      ready = true;
+    } else if (TH_PID_PONG == ent.pid) {
+      CATCH_REQUIRE(n_pongs++ == pkt->seq);
+    } else {
+      CATCH_REQUIRE(TH_PID_DATA == ent.pid);
+      CATCH_REQUIRE(pkt->src < kProducers);
+      /* each producer's packets arrive in order */
+      CATCH_REQUIRE(next_seq[pkt->src]++ == pkt->seq);
+    }
+    CATCH_REQUIRE(OK == swbus_shm_rxq_release(swb, &ent));
+
+    if (ready && n_pings == n_pongs && n_pings < TH_N_PKTS) {
+      uint32_t ping = n_pings++;
+      CATCH_REQUIRE(OK == swbus_shm_publish(swb,
+                                            TH_PID_PING,
+                                            TH_PING_SIZE,
+                                            &ping));
+    }
+  } /* while() */
+
+  th_children_wait(&children);
+
+  struct swbus_meta meta;
+  CATCH_REQUIRE(OK == swbus_shm_meta_get(swb, &meta));
+  CATCH_REQUIRE(0 == meta.n_notify_fails);
+  CATCH_REQUIRE((kProducers + 2) * TH_N_PKTS + 1 == meta.n_published);
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 0));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 1));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 2));
+  swbus_shm_close(swb);
+} /* multiprocess_test() */
+
+static void owner_death_test(uint32_t flags) {
+  struct swbus_shm swb_in;
+  struct swbus_shm* swb = th_bus_create(&swb_in, flags, TH_RXQ_SIZE);
+  CATCH_REQUIRE(nullptr != swb);
+  struct swbus_shm_rxq* rxq = swbus_shm_rxq_init(swb);
+  CATCH_REQUIRE(nullptr != rxq);
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(swb, rxq, 17));
+
+  /*
+   * A child dies holding the lock, halfway through shifting the subscription
+   * table, which leaves a duplicate entry.
+   */
+  struct th_children children;
+  if (0 == th_fork(&children)) {
+    struct swbus_shm_sub* subs = (struct swbus_shm_sub*)swbus_shm_ptr(
+        swb, swb->hdr->subs_off);
+    pthread_mutex_lock(&swb->hdr->lock);
+    subs[1] = subs[0];
+    swb->hdr->n_subs = 2;
+    _exit(0);
+  }
+  th_children_wait(&children);
+
+  /* the next lock holder repairs the table instead of waiting forever */
+  struct th_pkt pkt = { 1, 2 };
+  CATCH_REQUIRE(OK == swbus_shm_publish(swb, 17, sizeof(pkt), &pkt));
+  CATCH_REQUIRE(1 == swbus_shm_rxq_size(rxq));
+
+  struct swbus_meta meta;
+  CATCH_REQUIRE(OK == swbus_shm_meta_get(swb, &meta));
+  CATCH_REQUIRE(1 == meta.n_subs);
+  CATCH_REQUIRE(1 == meta.n_rxqs);
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(swb, rxq, 18));
+  CATCH_REQUIRE(OK == swbus_shm_unsubscribe(swb, rxq, 17));
+  CATCH_REQUIRE(OK == swbus_shm_rxq_destroy(swb, rxq));
+  CATCH_REQUIRE(0 == swbus_shm_pool_size(swb, 0));
+  swbus_shm_close(swb);
+} /* owner_death_test() */
+
+/*******************************************************************************
+ * Test Cases
+ ******************************************************************************/
+CATCH_TEST_CASE("Simple Test", "[swbus][shm]") {
+  run_test(simple_test);
+}
+
+CATCH_TEST_CASE("Multiprocess Test", "[swbus][shm]") {
+  run_test(multiprocess_test);
+}
+
+CATCH_TEST_CASE("Owner Death Test", "[swbus][shm]") {
+  run_test(owner_death_test);
+}
+
+CATCH_TEST_CASE("Round Trip Benchmark", "[.][bench][swbus][shm]") {
+  const uint32_t kTrips = 100000;
+  swbus_shm_unlink(th_shm_name().c_str());
+  struct swbus_shm* swb = th_bus_create(nullptr, RCSW_NONE, TH_RXQ_SIZE);
+  CATCH_REQUIRE(nullptr != swb);
+  struct swbus_shm_rxq* pong = swbus_shm_rxq_init(swb);
+  CATCH_REQUIRE(nullptr != pong);
+  CATCH_REQUIRE(OK == swbus_shm_subscribe(swb, pong, TH_PID_PONG));
+
+  struct th_children children;
+  if (0 == th_fork(&children)) {
+    struct swbus_shm* peer = swbus_shm_open(nullptr,
+                                            th_shm_name().c_str(),
+                                            RCSW_NONE);
+    struct swbus_shm_rxq* ping = swbus_shm_rxq_init(peer);
+    bool ok = OK == swbus_shm_subscribe(peer, ping, TH_PID_PING);
+    struct th_pkt pkt = { 0, 0 };
+    ok = ok && th_child_publish(peer, TH_PID_PONG, &pkt);
+    for (uint32_t i = 0; ok && i < kTrips; ++i) {
+      struct swbus_shm_rxq_ent ent;
+      ok = OK == swbus_shm_rxq_wait(peer, ping, &ent);
+      ok = ok && OK == swbus_shm_rxq_release(peer, &ent);
+      ok = ok && th_child_publish(peer, TH_PID_PONG, &pkt);
+    } /* for(i..) */
+    _exit(ok ? 0 : 1);
+  }
+
+  /* wait for the child to subscribe */
+  struct swbus_shm_rxq_ent ent;
+  CATCH_REQUIRE(OK == swbus_shm_rxq_wait(swb, pong, &ent));
+  CATCH_REQUIRE(OK == swbus_shm_rxq_release(swb, &ent));
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kTrips; ++i) {
+    struct th_pkt pkt = { 0, i };
+    CATCH_REQUIRE(OK == swbus_shm_publish(swb, TH_PID_PING, sizeof(pkt), &pkt));
+    CATCH_REQUIRE(OK == swbus_shm_rxq_wait(swb, pong, &ent));
+    CATCH_REQUIRE(OK == swbus_shm_rxq_release(swb, &ent));
+  } /* for(i..) */
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  std::cout << "cross-process round trip: " << ns / kTrips << " ns"
+            << std::endl;
+
+  th_children_wait(&children);
+  swbus_shm_close(swb);
+  swbus_shm_unlink(th_shm_name().c_str());
+}
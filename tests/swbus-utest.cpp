@@ -15,6 +15,10 @@
 #include <catch/catch.hpp>
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <iostream>
+#include <atomic>
+#include <vector>
 
 #include "rcsw/swbus/swbus.h"
 #include "tests/swbus_test.h"
@@ -32,6 +36,7 @@ using swbus_test = void(*)(const struct swbus_params* const params,
 #define TH_RXQ_SIZE 1024
 #define TH_MAX_BUFSIZE 512
 #define TH_MAX_PID 16
+#define TH_MAX_THREADS 16
 
 /*******************************************************************************
  * Test Helper Functions
@@ -43,6 +48,7 @@ static void run_test(swbus_test test, size_t n_threads = 1) {
   bus_params.max_pools = TH_MAX_POOLS;
   bus_params.max_rxqs = TH_MAX_RXQS;
   bus_params.max_subs = TH_MAX_SUBS;
+  bus_params.max_threads = TH_MAX_THREADS;
   bus_params.pools = (struct mpool_params*)malloc(sizeof(struct mpool_params)*TH_MAX_POOLS);
   strncpy(bus_params.name, "TESTBUS", sizeof(bus_params.name));
 
@@ -60,7 +66,10 @@ static void run_test(swbus_test test, size_t n_threads = 1) {
   uint32_t flags[] = {
     RCSW_NONE,
     RCSW_NOALLOC_HANDLE,
-    RCSW_SWBUS_ASYNC
+    RCSW_SWBUS_ASYNC,
+    RCSW_SWBUS_SEQMETA,
+    RCSW_SWBUS_LOCKFREE,
+    RCSW_SWBUS_LOCKFREE | RCSW_SWBUS_ASYNC | RCSW_SWBUS_SEQMETA,
   };
 
   for (size_t i = 0; i < RCSW_ARRAY_ELTS(flags); ++i) {
@@ -108,19 +117,34 @@ static void subscribe_test(const struct swbus_params * params, size_t) {
   struct pcqueue * rxq = swbus_rxq_init(swbus, rxq_buf, RXQ_SIZE);
   CATCH_REQUIRE(nullptr != rxq);
 
+  struct swbus_meta meta;
   for (size_t i = 0; i < TH_MAX_SUBS; ++i) {
-    CATCH_REQUIRE(llist_size(swbus->subscribers) == i);
-    CATCH_REQUIRE(swbus_subscribe(swbus, rxq, i) == OK);
-    CATCH_REQUIRE(llist_size(swbus->subscribers) == i + 1);
+    CATCH_REQUIRE(swbus->subtab->n_subs == i);
+    CATCH_REQUIRE(swbus_subscribe(swbus, rxq, TH_MAX_SUBS - i - 1) == OK);
+    CATCH_REQUIRE(swbus_subscribe(swbus, rxq, TH_MAX_SUBS - i - 1) == ERROR);
+    CATCH_REQUIRE(swbus->subtab->n_subs == i + 1);
+    CATCH_REQUIRE(OK == swbus_meta_get(swbus, &meta));
+    CATCH_REQUIRE(meta.n_rxqs == 1);
+    CATCH_REQUIRE(meta.n_subs == i + 1);
+  } /* for() */
+
+  CATCH_REQUIRE(swbus_subscribe(swbus, rxq, TH_MAX_SUBS) == ERROR);
+
+  /* subscriptions are kept sorted by PID, regardless of subscription order */
+  for (size_t i = 0; i < TH_MAX_SUBS; ++i) {
+    CATCH_REQUIRE(swbus->subtab->subs[i].pid == i);
   } /* for() */
 
   for (size_t i = 0; i < TH_MAX_SUBS; ++i) {
-    CATCH_REQUIRE(llist_size(swbus->subscribers) == TH_MAX_SUBS - i);
+    CATCH_REQUIRE(swbus->subtab->n_subs == TH_MAX_SUBS - i);
     CATCH_REQUIRE(swbus_unsubscribe(swbus, rxq, i) == OK);
-    CATCH_REQUIRE(llist_size(swbus->subscribers) == TH_MAX_SUBS - i - 1);
+    CATCH_REQUIRE(swbus_unsubscribe(swbus, rxq, i) == ERROR);
+    CATCH_REQUIRE(swbus->subtab->n_subs == TH_MAX_SUBS - i - 1);
   } /* for() */
 
-  CATCH_REQUIRE(llist_isempty(swbus->subscribers));
+  CATCH_REQUIRE(0 == swbus->subtab->n_subs);
+  CATCH_REQUIRE(OK == swbus_meta_get(swbus, &meta));
+  CATCH_REQUIRE(meta.n_subs == 0);
 
   swbus_destroy(swbus);
 } /* subscribe_test() */
@@ -172,8 +196,7 @@ static void serial_stress_test(const struct swbus_params * params, size_t) {
       CATCH_REQUIRE(pcqueue_size(rxq2) == 2* j + 2);
     } /* for(j..) */
 
-    CATCH_REQUIRE(llist_isfull(&bp->alloc));
-    CATCH_REQUIRE(llist_isempty(&bp->free));
+    CATCH_REQUIRE(mpool_isfull(bp));
 
     /*
      * Dequeue packets for this buffer pool, verifying everything as we go.
@@ -192,11 +215,11 @@ static void serial_stress_test(const struct swbus_params * params, size_t) {
       CATCH_REQUIRE(pcqueue_size(rxq2) == TH_RXQ_SIZE - j);
       CATCH_REQUIRE(mpool_ref_count(bp, ptr->data) == 2);
 
-      CATCH_REQUIRE(OK == swbus_rxq_pop_front(rxq, ptr));
+      CATCH_REQUIRE(OK == swbus_rxq_pop_front(swbus, rxq, ptr));
       CATCH_REQUIRE(pcqueue_size(rxq) == TH_RXQ_SIZE - j - 1);
       CATCH_REQUIRE(mpool_ref_count(bp, ptr->data) == 1);
 
-      CATCH_REQUIRE(OK == swbus_rxq_pop_front(rxq2, ptr2));
+      CATCH_REQUIRE(OK == swbus_rxq_pop_front(swbus, rxq2, ptr2));
       CATCH_REQUIRE(pcqueue_size(rxq2) == TH_RXQ_SIZE - j - 1);
       CATCH_REQUIRE(mpool_ref_count(bp, ptr->data) == 0);
     } /* for(j..) */
@@ -205,6 +228,628 @@ static void serial_stress_test(const struct swbus_params * params, size_t) {
   swbus_destroy(swbus);
   free(buf);
 }
+/**
+ * \brief Test batch publish/receive.
+ *
+ * - Batches larger than \ref RCSW_SWBUS_BATCH_MAX, with runs of PIDs
+ * - Packets arrive in order, with the right contents
+ * - Batches which don't fit in the buffer pools
+ */
+static void batch_test(const struct swbus_params * params, size_t) {
+  struct swbus myswbus;
+  struct swbus * swbus;
+
+  swbus = swbus_init(&myswbus, params);
+  CATCH_REQUIRE(nullptr != swbus);
+  struct pcqueue * rxq = swbus_rxq_init(swbus, nullptr, TH_RXQ_SIZE);
+  struct pcqueue * rxq2 = swbus_rxq_init(swbus, nullptr, TH_RXQ_SIZE);
+  CATCH_REQUIRE(nullptr != rxq);
+  CATCH_REQUIRE(nullptr != rxq2);
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, 0));
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, 1));
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq2, 1));
+
+  /* runs of PIDs 0,1,2 of varying lengths, PID 2 has no subscribers */
+  const size_t n_pkts = RCSW_SWBUS_BATCH_MAX * 3 + 5;
+  std::vector<uint32_t> pids(n_pkts);
+  std::vector<size_t> sizes(n_pkts);
+  std::vector<std::vector<uint8_t>> data(n_pkts);
+  std::vector<const void*> pkts(n_pkts);
+  for (size_t i = 0; i < n_pkts; ++i) {
+    pids[i] = (i / 7) % 3;
+    sizes[i] = (i % 5 < 3) ? 16 : 8 + i % 64;
+    data[i].assign(sizes[i], (uint8_t)i);
+    pkts[i] = data[i].data();
+  } /* for(i..) */
+  CATCH_REQUIRE(OK == swbus_publish_batch(swbus,
+                                          pids.data(),
+                                          sizes.data(),
+                                          pkts.data(),
+                                          n_pkts));
+
+  struct swbus_rxq_ent ents[TH_RXQ_SIZE];
+  size_t got = 0;
+  for (auto q : {rxq, rxq2}) {
+    size_t n_received = 0;
+    size_t i = 0;
+    while (!pcqueue_isempty(q)) {
+      CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, q, ents, 10, &got));
+      CATCH_REQUIRE(got > 0);
+      CATCH_REQUIRE(got <= 10);
+      for (size_t j = 0; j < got; ++j) {
+        /* skip packets this RXQ is not subscribed to */
+        while (!(1 == pids[i] || (q == rxq && 0 == pids[i]))) {
+          ++i;
+        }
+        CATCH_REQUIRE(ents[j].pid == pids[i]);
+        CATCH_REQUIRE(ents[j].pkt_size == sizes[i]);
+        CATCH_REQUIRE(0 == memcmp(ents[j].data, pkts[i], sizes[i]));
+        ++i;
+      } /* for(j..) */
+      n_received += got;
+      CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+    } /* while() */
+    size_t n_expected = std::count_if(pids.begin(),
+                                      pids.end(),
+                                      [&](uint32_t pid) {
+                                        return 1 == pid ||
+                                            (q == rxq && 0 == pid);
+                                      });
+    CATCH_REQUIRE(n_expected == n_received);
+  } /* for(q..) */
+
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    CATCH_REQUIRE(mpool_isempty(&swbus->pools[i]));
+  } /* for(i..) */
+  struct swbus_meta meta;
+  CATCH_REQUIRE(OK == swbus_meta_get(swbus, &meta));
+  CATCH_REQUIRE(n_pkts == meta.n_published);
+
+  /*
+   * More packets than fit in the largest buffer pool: everything before the
+   * first packet which doesn't fit is published. The packets stay queued on
+   * an RXQ, so their buffers are not freed until it is drained.
+   */
+  size_t n_big = TH_RXQ_SIZE + 2;
+  std::vector<uint32_t> big_pids(n_big, 2);
+  std::vector<size_t> big_sizes(n_big, TH_MAX_BUFSIZE);
+  std::vector<uint8_t> big_data(TH_MAX_BUFSIZE, 0xab);
+  std::vector<const void*> big_pkts(n_big, big_data.data());
+  big_sizes[0] = 16;
+  big_pids[0] = 3;
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, 3));
+  struct pcqueue* q = swbus_rxq_init(swbus, nullptr, TH_RXQ_SIZE);
+  CATCH_REQUIRE(nullptr != q);
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, q, 2));
+  CATCH_REQUIRE(ERROR == swbus_publish_batch(swbus,
+                                             big_pids.data(),
+                                             big_sizes.data(),
+                                             big_pkts.data(),
+                                             n_big));
+  CATCH_REQUIRE(1 == pcqueue_size(rxq));
+  CATCH_REQUIRE(TH_RXQ_SIZE == pcqueue_size(q));
+  CATCH_REQUIRE(OK == swbus_meta_get(swbus, &meta));
+  CATCH_REQUIRE(n_pkts + n_big - 1 == meta.n_published);
+  for (auto rq : {rxq, q}) {
+    while (!pcqueue_isempty(rq)) {
+      CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, rq, ents, TH_RXQ_SIZE, &got));
+      CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+    } /* while() */
+  } /* for(rq..) */
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    CATCH_REQUIRE(mpool_isempty(&swbus->pools[i]));
+  } /* for(i..) */
+
+  swbus_destroy(swbus);
+} /* batch_test() */
+
+/**
+ * \brief Test the RXQ overflow policies and per-RXQ statistics.
+ */
+static void overflow_test(const struct swbus_params * params, size_t) {
+  struct swbus myswbus;
+  struct swbus * swbus;
+  struct swbus_params lparams = *params;
+  lparams.flags |= RCSW_SWBUS_LATENCY;
+
+  swbus = swbus_init(&myswbus, &lparams);
+  CATCH_REQUIRE(nullptr != swbus);
+
+  const size_t kRXQSize = 4;
+  enum swbus_rxq_policy policies[] = {
+    ekSWBUS_RXQ_BLOCK,
+    ekSWBUS_RXQ_DROP_NEWEST,
+    ekSWBUS_RXQ_DROP_OLDEST,
+    ekSWBUS_RXQ_CONFLATE,
+  };
+  struct pcqueue* rxqs[RCSW_ARRAY_ELTS(policies)];
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(policies); ++i) {
+    rxqs[i] = swbus_rxq_init(swbus,
+                             nullptr,
+                             (0 == i) ? TH_RXQ_SIZE : kRXQSize);
+    CATCH_REQUIRE(nullptr != rxqs[i]);
+    CATCH_REQUIRE(OK == swbus_rxq_policy_set(swbus, rxqs[i], policies[i]));
+    CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxqs[i], 0));
+    CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxqs[i], 1));
+  } /* for(i..) */
+  CATCH_REQUIRE(ERROR == swbus_rxq_policy_set(swbus,
+                                              swbus->rxqs + TH_MAX_RXQS,
+                                              ekSWBUS_RXQ_BLOCK));
+
+  /* alternating PIDs, so the conflating RXQ never fills */
+  const uint32_t n_pkts = 10;
+  for (uint32_t i = 0; i < n_pkts; ++i) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, i % 2, sizeof(i), &i));
+  } /* for(i..) */
+  struct swbus_meta meta;
+  CATCH_REQUIRE(OK == swbus_meta_get(swbus, &meta));
+  CATCH_REQUIRE(0 == meta.n_notify_fails);
+
+  std::vector<std::vector<uint32_t>> expected = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
+    {0, 1, 2, 3},
+    {6, 7, 8, 9},
+    {8, 9},
+  };
+  size_t n_enqueued[] = {10, 4, 10, 10};
+  struct swbus_rxq_ent ents[TH_RXQ_SIZE];
+  size_t got = 0;
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(policies); ++i) {
+    CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, rxqs[i], ents, n_pkts, &got));
+    CATCH_REQUIRE(expected[i].size() == got);
+    for (size_t j = 0; j < got; ++j) {
+      CATCH_REQUIRE(expected[i][j] == *(uint32_t*)ents[j].data);
+      CATCH_REQUIRE(expected[i][j] % 2 == ents[j].pid);
+      CATCH_REQUIRE(0 != ents[j].released_at);
+    } /* for(j..) */
+    CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+
+    struct swbus_rxq_stats stats;
+    CATCH_REQUIRE(OK == swbus_rxq_stats_get(swbus, rxqs[i], &stats));
+    CATCH_REQUIRE(n_enqueued[i] == stats.n_enqueued);
+    CATCH_REQUIRE(n_pkts - got == stats.n_drops);
+    CATCH_REQUIRE(got == stats.hwm);
+    CATCH_REQUIRE(got == stats.n_delivered);
+    CATCH_REQUIRE(stats.latency_max <= stats.latency_total);
+  } /* for(i..) */
+
+  /*
+   * Conflating RXQ with more PIDs than space: a packet with a PID not in the
+   * RXQ is dropped, one with a PID already in the RXQ still replaces it.
+   */
+  struct pcqueue* conf = rxqs[3];
+  for (uint32_t pid = 2; pid < 5; ++pid) {
+    CATCH_REQUIRE(OK == swbus_subscribe(swbus, conf, pid));
+  } /* for(pid..) */
+  uint32_t pids[] = {0, 1, 2, 3, 4, 1};
+  for (uint32_t i = 0; i < RCSW_ARRAY_ELTS(pids); ++i) {
+    uint32_t val = 100 + i;
+    CATCH_REQUIRE(OK == swbus_publish(swbus, pids[i], sizeof(val), &val));
+  } /* for(i..) */
+  CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, conf, ents, n_pkts, &got));
+  CATCH_REQUIRE(kRXQSize == got);
+  uint32_t conf_expected[] = {100, 105, 102, 103};
+  for (size_t j = 0; j < got; ++j) {
+    CATCH_REQUIRE(conf_expected[j] == *(uint32_t*)ents[j].data);
+  } /* for(j..) */
+  CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+
+  /* buffers of dropped/replaced packets were all released */
+  for (auto q : rxqs) {
+    while (!pcqueue_isempty(q)) {
+      CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, q, ents, TH_RXQ_SIZE, &got));
+      CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+    } /* while() */
+  } /* for(q..) */
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    CATCH_REQUIRE(mpool_isempty(&swbus->pools[i]));
+  } /* for(i..) */
+
+  swbus_destroy(swbus);
+} /* overflow_test() */
+
+/**
+ * \brief Test that subscribing doesn't wait on a publisher stuck on a full
+ * blocking RXQ with \ref RCSW_SWBUS_LOCKFREE, since it may be waiting on us.
+ */
+static void stuck_publisher_test(const struct swbus_params * params, size_t) {
+  /* otherwise the stuck publisher holds the bus mutex/sync lock */
+  if (!(params->flags & RCSW_SWBUS_LOCKFREE) ||
+      !(params->flags & RCSW_SWBUS_ASYNC)) {
+    return;
+  }
+  struct swbus myswbus;
+  struct swbus * swbus = swbus_init(&myswbus, params);
+  CATCH_REQUIRE(nullptr != swbus);
+
+  const size_t kRXQSize = 4;
+  struct pcqueue* rxq = swbus_rxq_init(swbus, nullptr, kRXQSize);
+  struct pcqueue* other = swbus_rxq_init(swbus, nullptr, kRXQSize);
+  CATCH_REQUIRE(nullptr != rxq);
+  CATCH_REQUIRE(nullptr != other);
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, 1));
+  for (uint32_t i = 0; i < kRXQSize; ++i) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, 1, sizeof(i), &i));
+  } /* for(i..) */
+
+  std::thread publisher([&]() {
+      uint32_t val = kRXQSize;
+      CATCH_REQUIRE(OK == swbus_publish(swbus, 1, sizeof(val), &val));
+    });
+
+  /* old tables pile up until (un)subscribing fails */
+  auto update = [&](bool sub) {
+      return sub ? swbus_subscribe(swbus, other, 2) :
+          swbus_unsubscribe(swbus, other, 2);
+    };
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  bool subscribed = false;
+  status_t rstat = OK;
+  while (OK == rstat && std::chrono::steady_clock::now() < end) {
+    rstat = update(!subscribed);
+    if (OK == rstat) {
+      subscribed = !subscribed;
+    }
+  } /* while() */
+  CATCH_REQUIRE(ERROR == rstat);
+
+  /* draining the RXQ lets the publisher finish, and then it works again */
+  struct swbus_rxq_ent ents[kRXQSize + 1];
+  size_t got = 0;
+  size_t n_received = 0;
+  while (n_received < kRXQSize + 1) {
+    CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, rxq, ents, kRXQSize, &got));
+    CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+    n_received += got;
+  } /* while() */
+  publisher.join();
+  CATCH_REQUIRE(OK == update(!subscribed));
+
+  swbus_destroy(swbus);
+} /* stuck_publisher_test() */
+
+/**
+ * \brief Test range/mask subscriptions, alone and mixed with exact ones.
+ */
+static void wildcard_test(const struct swbus_params * params, size_t) {
+  struct swbus myswbus;
+  struct swbus * swbus;
+
+  swbus = swbus_init(&myswbus, params);
+  CATCH_REQUIRE(nullptr != swbus);
+
+  struct pcqueue* rxqs[4];
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(rxqs); ++i) {
+    rxqs[i] = swbus_rxq_init(swbus, nullptr, TH_RXQ_SIZE);
+    CATCH_REQUIRE(nullptr != rxqs[i]);
+  } /* for(i..) */
+
+  /* range + overlapping exact subscription on the same RXQ */
+  CATCH_REQUIRE(OK == swbus_subscribe_range(swbus, rxqs[0], 0x1000, 0x1FFF));
+  CATCH_REQUIRE(ERROR == swbus_subscribe_range(swbus, rxqs[0], 0x1000, 0x1FFF));
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxqs[0], 0x1005));
+
+  /* all odd PIDs */
+  CATCH_REQUIRE(OK == swbus_subscribe_mask(swbus, rxqs[1], 0x1, 0x1));
+
+  /* prefix mask (i.e., a range) */
+  CATCH_REQUIRE(OK == swbus_subscribe_mask(swbus, rxqs[2], 0x2000, 0xFFFFF000));
+
+  /* overlapping non-prefix masks on the same RXQ */
+  CATCH_REQUIRE(OK == swbus_subscribe_mask(swbus, rxqs[3], 0x1, 0x1));
+  CATCH_REQUIRE(OK == swbus_subscribe_mask(swbus, rxqs[3], 0x10, 0x10));
+  CATCH_REQUIRE(ERROR == swbus_subscribe_mask(swbus, rxqs[3], 0x10, 0x10));
+
+  /* invalid requests */
+  CATCH_REQUIRE(ERROR == swbus_subscribe_range(swbus, rxqs[0], 0x10, 0x1));
+  CATCH_REQUIRE(ERROR == swbus_subscribe_range(swbus,
+                                               swbus->rxqs + TH_MAX_RXQS,
+                                               0x1,
+                                               0x10));
+  CATCH_REQUIRE(ERROR == swbus_unsubscribe_range(swbus, rxqs[1], 0x1, 0x10));
+  CATCH_REQUIRE(ERROR == swbus_unsubscribe_mask(swbus, rxqs[0], 0x1, 0x1));
+
+  struct swbus_meta meta;
+  CATCH_REQUIRE(OK == swbus_meta_get(swbus, &meta));
+  CATCH_REQUIRE(6 == meta.n_subs);
+
+  uint32_t pids[] = {
+    0x0FFF, 0x1000, 0x1005, 0x1FFF, 0x2000, 0x2FFF, 0x3000, 0x11
+  };
+  for (uint32_t i = 0; i < RCSW_ARRAY_ELTS(pids); ++i) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, pids[i], sizeof(i), &i));
+  } /* for(i..) */
+
+  /* each RXQ receives each matching packet exactly once */
+  std::vector<std::vector<uint32_t>> expected = {
+    {0x1000, 0x1005, 0x1FFF},
+    {0x0FFF, 0x1005, 0x1FFF, 0x2FFF, 0x11},
+    {0x2000, 0x2FFF},
+    {0x0FFF, 0x1005, 0x1FFF, 0x2FFF, 0x11},
+  };
+  struct swbus_rxq_ent ents[TH_RXQ_SIZE];
+  size_t got = 0;
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(rxqs); ++i) {
+    CATCH_REQUIRE(expected[i].size() == pcqueue_size(rxqs[i]));
+    CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus,
+                                         rxqs[i],
+                                         ents,
+                                         TH_RXQ_SIZE,
+                                         &got));
+    CATCH_REQUIRE(expected[i].size() == got);
+    for (size_t j = 0; j < got; ++j) {
+      CATCH_REQUIRE(expected[i][j] == ents[j].pid);
+    } /* for(j..) */
+    CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+  } /* for(i..) */
+
+  /* removing a wildcard leaves exact subscriptions in place */
+  CATCH_REQUIRE(OK == swbus_unsubscribe_range(swbus, rxqs[0], 0x1000, 0x1FFF));
+  CATCH_REQUIRE(OK == swbus_unsubscribe_mask(swbus,
+                                             rxqs[2],
+                                             0x2000,
+                                             0xFFFFF000));
+  CATCH_REQUIRE(OK == swbus_unsubscribe_mask(swbus, rxqs[3], 0x1, 0x1));
+  for (uint32_t i = 0; i < RCSW_ARRAY_ELTS(pids); ++i) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, pids[i], sizeof(i), &i));
+  } /* for(i..) */
+  CATCH_REQUIRE(1 == pcqueue_size(rxqs[0]));
+  CATCH_REQUIRE(5 == pcqueue_size(rxqs[1]));
+  CATCH_REQUIRE(0 == pcqueue_size(rxqs[2]));
+  CATCH_REQUIRE(4 == pcqueue_size(rxqs[3]));
+  CATCH_REQUIRE(OK == swbus_meta_get(swbus, &meta));
+  CATCH_REQUIRE(3 == meta.n_subs);
+
+  for (auto q : rxqs) {
+    while (!pcqueue_isempty(q)) {
+      CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, q, ents, TH_RXQ_SIZE, &got));
+      CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+    } /* while() */
+  } /* for(q..) */
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    CATCH_REQUIRE(mpool_isempty(&swbus->pools[i]));
+  } /* for(i..) */
+
+  swbus_destroy(swbus);
+} /* wildcard_test() */
+
+/**
+ * \brief Test waiting on multiple RXQs at once with an RXQ set.
+ */
+static void rxq_set_test(const struct swbus_params * params, size_t) {
+  struct swbus myswbus;
+  struct swbus * swbus;
+
+  swbus = swbus_init(&myswbus, params);
+  CATCH_REQUIRE(nullptr != swbus);
+
+  struct pcqueue* rxqs[4];
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(rxqs); ++i) {
+    rxqs[i] = swbus_rxq_init(swbus, nullptr, TH_RXQ_SIZE);
+    CATCH_REQUIRE(nullptr != rxqs[i]);
+    CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxqs[i], i));
+  } /* for(i..) */
+
+  struct swbus_rxq_set set_in;
+  struct swbus_rxq_set* set = swbus_rxq_set_init(swbus,
+                                                 &set_in,
+                                                 RCSW_NOALLOC_HANDLE);
+  CATCH_REQUIRE(nullptr != set);
+  struct swbus_rxq_set* set2 = swbus_rxq_set_init(swbus, nullptr, RCSW_NONE);
+  CATCH_REQUIRE(nullptr != set2);
+
+  /* the last RXQ is not in the set */
+  for (size_t i = 0; i < RCSW_ARRAY_ELTS(rxqs) - 1; ++i) {
+    CATCH_REQUIRE(OK == swbus_rxq_set_add(set, rxqs[i]));
+    CATCH_REQUIRE(ERROR == swbus_rxq_set_add(set, rxqs[i]));
+    CATCH_REQUIRE(ERROR == swbus_rxq_set_add(set2, rxqs[i]));
+  } /* for(i..) */
+  CATCH_REQUIRE(ERROR == swbus_rxq_set_add(set, swbus->rxqs + TH_MAX_RXQS - 1));
+  CATCH_REQUIRE(ERROR == swbus_rxq_set_remove(set, rxqs[3]));
+  CATCH_REQUIRE(3 == set->n_members);
+
+  struct pcqueue* ready[TH_MAX_RXQS];
+  size_t n_ready = 0;
+  struct timespec to = {.tv_sec = 0, .tv_nsec = 10000000};
+  CATCH_REQUIRE(ERROR == swbus_rxq_set_timedwait(set,
+                                                 ready,
+                                                 TH_MAX_RXQS,
+                                                 &n_ready,
+                                                 &to));
+  CATCH_REQUIRE(ETIMEDOUT == errno);
+  CATCH_REQUIRE(0 == n_ready);
+
+  /* packets for RXQs outside the set don't make it ready */
+  uint32_t val = 0;
+  CATCH_REQUIRE(OK == swbus_publish(swbus, 3, sizeof(val), &val));
+  CATCH_REQUIRE(ERROR == swbus_rxq_set_timedwait(set,
+                                                 ready,
+                                                 TH_MAX_RXQS,
+                                                 &n_ready,
+                                                 &to));
+
+  /* ready RXQs are reported round-robin */
+  for (uint32_t pid = 0; pid < 3; ++pid) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, pid, sizeof(val), &val));
+  } /* for(pid..) */
+  for (size_t i = 0; i < 6; ++i) {
+    CATCH_REQUIRE(OK == swbus_rxq_set_wait(set, ready, 1, &n_ready));
+    CATCH_REQUIRE(1 == n_ready);
+    CATCH_REQUIRE(rxqs[i % 3] == ready[0]);
+  } /* for(i..) */
+  CATCH_REQUIRE(OK == swbus_rxq_set_wait(set, ready, TH_MAX_RXQS, &n_ready));
+  CATCH_REQUIRE(3 == n_ready);
+
+  struct swbus_rxq_ent ents[TH_RXQ_SIZE];
+  size_t got = 0;
+  for (auto q : rxqs) {
+    CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, q, ents, TH_RXQ_SIZE, &got));
+    CATCH_REQUIRE(1 == got);
+    CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+  } /* for(q..) */
+
+  /* one thread servicing all RXQs in the set as packets arrive */
+  const uint32_t n_pkts = 1000;
+  size_t n_errs = 0;
+  std::thread consumer([&]() {
+      uint32_t n_recvd[3] = {0, 0, 0};
+      struct pcqueue* lready[TH_MAX_RXQS];
+      struct swbus_rxq_ent lents[TH_RXQ_SIZE];
+      size_t lgot = 0;
+      size_t lready_n = 0;
+      while (n_recvd[0] + n_recvd[1] + n_recvd[2] < n_pkts) {
+        if (OK != swbus_rxq_set_wait(set, lready, TH_MAX_RXQS, &lready_n)) {
+          ++n_errs;
+          return;
+        }
+        for (size_t i = 0; i < lready_n; ++i) {
+          if (OK != swbus_rxq_wait_n(swbus,
+                                     lready[i],
+                                     lents,
+                                     TH_RXQ_SIZE,
+                                     &lgot)) {
+            ++n_errs;
+            return;
+          }
+          /* in order for each PID */
+          for (size_t j = 0; j < lgot; ++j) {
+            uint32_t pid = lents[j].pid;
+            n_errs += (n_recvd[pid] * 3 + pid != *(uint32_t*)lents[j].data);
+            ++n_recvd[pid];
+          } /* for(j..) */
+          swbus_rxq_release_n(lents, lgot);
+        } /* for(i..) */
+      } /* while() */
+    });
+  for (uint32_t i = 0; i < n_pkts; ++i) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, i % 3, sizeof(i), &i));
+    if (0 == i % 100) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  } /* for(i..) */
+  consumer.join();
+  CATCH_REQUIRE(0 == n_errs);
+
+  /* removed RXQs are no longer reported */
+  CATCH_REQUIRE(OK == swbus_rxq_set_remove(set, rxqs[0]));
+  CATCH_REQUIRE(2 == set->n_members);
+  CATCH_REQUIRE(OK == swbus_publish(swbus, 0, sizeof(val), &val));
+  CATCH_REQUIRE(ERROR == swbus_rxq_set_timedwait(set,
+                                                 ready,
+                                                 TH_MAX_RXQS,
+                                                 &n_ready,
+                                                 &to));
+  CATCH_REQUIRE(OK == swbus_rxq_set_add(set2, rxqs[0]));
+  CATCH_REQUIRE(OK == swbus_rxq_set_wait(set2, ready, TH_MAX_RXQS, &n_ready));
+  CATCH_REQUIRE(1 == n_ready);
+  CATCH_REQUIRE(rxqs[0] == ready[0]);
+
+  /* destroying a set frees its RXQs to join another */
+  swbus_rxq_set_destroy(set);
+  CATCH_REQUIRE(OK == swbus_rxq_set_add(set2, rxqs[1]));
+  swbus_rxq_set_destroy(set2);
+
+  for (auto q : rxqs) {
+    while (!pcqueue_isempty(q)) {
+      CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, q, ents, TH_RXQ_SIZE, &got));
+      CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+    } /* while() */
+  } /* for(q..) */
+  for (size_t i = 0; i < params->max_pools; ++i) {
+    CATCH_REQUIRE(mpool_isempty(&swbus->pools[i]));
+  } /* for(i..) */
+
+  swbus_destroy(swbus);
+} /* rxq_set_test() */
+
+static void th_trace_count(const struct swbus_trace_stats*, void* arg) {
+  ++*(size_t*)arg;
+} /* th_trace_count() */
+
+/**
+ * \brief Test per-PID packet latency tracing (only does anything with
+ * RCSW_CONFIG_SWBUS_TRACE).
+ */
+static void trace_test(const struct swbus_params * params, size_t) {
+  struct swbus myswbus;
+  struct swbus * swbus;
+
+  /* histogram bins are powers of 2 */
+  struct grind_hist hist;
+  memset(&hist, 0, sizeof(hist));
+  CATCH_REQUIRE(0 == grind_hist_percentile(&hist, 50.0));
+  for (uint64_t val : {0, 1, 1000, 1023}) {
+    grind_hist_record(&hist, val);
+  } /* for(val..) */
+  CATCH_REQUIRE(4 == hist.count);
+  CATCH_REQUIRE(1 == hist.bins[0]);
+  CATCH_REQUIRE(1 == hist.bins[1]);
+  CATCH_REQUIRE(2 == hist.bins[10]);
+  CATCH_REQUIRE(1 == grind_hist_percentile(&hist, 50.0));
+  CATCH_REQUIRE(1023 == grind_hist_percentile(&hist, 100.0));
+
+  swbus = swbus_init(&myswbus, params);
+  CATCH_REQUIRE(nullptr != swbus);
+  struct pcqueue * rxq = swbus_rxq_init(swbus, nullptr, TH_RXQ_SIZE);
+  CATCH_REQUIRE(nullptr != rxq);
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, 0));
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, 1));
+
+  /* PID 0: published normally, PID 1: slow to fill after reserving */
+  const size_t n_pkts = 10;
+  uint32_t val = 17;
+  for (size_t i = 0; i < n_pkts; ++i) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, 0, sizeof(val), &val));
+  } /* for(i..) */
+  struct swbus_rsrvn res;
+  CATCH_REQUIRE(OK == swbus_publish_reserve(swbus, &res, sizeof(val)));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  CATCH_REQUIRE(OK == swbus_publish_release(swbus, 1, &res, sizeof(val)));
+
+  /* receiving both ways */
+  struct swbus_rxq_ent* ent = swbus_rxq_wait(swbus, rxq);
+  CATCH_REQUIRE(nullptr != ent);
+  /* waiting again without popping doesn't count the packet again */
+  CATCH_REQUIRE(ent == swbus_rxq_wait(swbus, rxq));
+  CATCH_REQUIRE(OK == swbus_rxq_pop_front(swbus, rxq, ent));
+  struct swbus_rxq_ent ents[TH_RXQ_SIZE];
+  size_t got = 0;
+  CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus, rxq, ents, TH_RXQ_SIZE, &got));
+  CATCH_REQUIRE(n_pkts == got);
+  CATCH_REQUIRE(OK == swbus_rxq_release_n(ents, got));
+
+  struct swbus_trace_stats stats;
+  size_t count = 0;
+#if defined(RCSW_CONFIG_SWBUS_TRACE)
+  CATCH_REQUIRE(OK == swbus_trace_snapshot(swbus, 0, &stats));
+  CATCH_REQUIRE(0 == stats.pid);
+  CATCH_REQUIRE(n_pkts == stats.publish.count);
+  CATCH_REQUIRE(n_pkts == stats.queue.count);
+  CATCH_REQUIRE(n_pkts == stats.total.count);
+  CATCH_REQUIRE(stats.queue.max <= stats.total.max);
+
+  CATCH_REQUIRE(OK == swbus_trace_snapshot(swbus, 1, &stats));
+  CATCH_REQUIRE(1 == stats.publish.count);
+  CATCH_REQUIRE(stats.publish.max >= 2000000);
+  CATCH_REQUIRE(grind_hist_percentile(&stats.total, 50.0) >= 2000000);
+
+  CATCH_REQUIRE(ERROR == swbus_trace_snapshot(swbus, 2, &stats));
+  CATCH_REQUIRE(2 == swbus_trace_foreach(swbus, th_trace_count, &count));
+  CATCH_REQUIRE(2 == count);
+  swbus_trace_report(swbus);
+
+  swbus_trace_reset(swbus);
+  CATCH_REQUIRE(OK == swbus_trace_snapshot(swbus, 0, &stats));
+  CATCH_REQUIRE(0 == stats.queue.count);
+#else
+  CATCH_REQUIRE(ERROR == swbus_trace_snapshot(swbus, 0, &stats));
+  CATCH_REQUIRE(0 == swbus_trace_foreach(swbus, th_trace_count, &count));
+  CATCH_REQUIRE(0 == count);
+#endif
+
+  swbus_destroy(swbus);
+} /* trace_test() */
+
 /**
  * \brief Test SWBUS in a concurrent setting
  *
@@ -288,7 +933,8 @@ static void concurrent_stress_test(const struct swbus_params * params,
 
                     mtx.unlock();
 
-                    rval = swbus_rxq_pop_front(rxqs[id],
+                    rval = swbus_rxq_pop_front(swbus,
+                                               rxqs[id],
                                                ent);
                     mtx.lock();
                     checks.push_back(rval == OK);
@@ -328,7 +974,8 @@ static void concurrent_stress_test(const struct swbus_params * params,
       CATCH_REQUIRE(std::find(subs.begin(),
                               subs.end(),
                               ent->pid) != subs.end());
-      CATCH_REQUIRE(OK == swbus_rxq_pop_front(rxqs[i],
+      CATCH_REQUIRE(OK == swbus_rxq_pop_front(swbus,
+                                              rxqs[i],
                                               ent));
     }
   } /* for(i..) */
@@ -336,8 +983,7 @@ static void concurrent_stress_test(const struct swbus_params * params,
 
   for (size_t i = 0; i < params->max_pools; ++i) {
     struct mpool* bp = &swbus->pools[i];
-    CATCH_REQUIRE(llist_isfull(&bp->free));
-    CATCH_REQUIRE(llist_isempty(&bp->alloc));
+    CATCH_REQUIRE(mpool_isempty(bp));
   }
 
   swbus_destroy(swbus);
@@ -352,8 +998,227 @@ CATCH_TEST_CASE("Subscribe Test", "[swbus]") { run_test(subscribe_test); }
 CATCH_TEST_CASE("Serial Multi-RXQ, Multi-PID", "[swbus]") {
   run_test(serial_stress_test);
 }
+CATCH_TEST_CASE("Batch Publish/Receive", "[swbus]") {
+  run_test(batch_test);
+}
+CATCH_TEST_CASE("RXQ Overflow Policies", "[swbus]") {
+  run_test(overflow_test);
+}
+CATCH_TEST_CASE("Stuck Publisher", "[swbus]") {
+  run_test(stuck_publisher_test);
+}
+CATCH_TEST_CASE("Wildcard Subscriptions", "[swbus]") {
+  run_test(wildcard_test);
+}
+CATCH_TEST_CASE("RXQ Sets", "[swbus]") {
+  run_test(rxq_set_test);
+}
+CATCH_TEST_CASE("Latency Tracing", "[swbus]") {
+  run_test(trace_test);
+}
 CATCH_TEST_CASE("Concurrent Multi-RXQ, Multi-PID", "[swbus]") {
   for (size_t i = 2; i < 10; ++i) {
     run_test(concurrent_stress_test, i);
   } /* for(i..) */
 }
+
+CATCH_TEST_CASE("Publish Latency Benchmark", "[.][bench][swbus]") {
+  const size_t kOps = 200000;
+  const size_t kMaxUnrelated = 4096;
+  const size_t kRxqSize = 16;
+
+  struct mpool_params pool_params = {};
+  pool_params.elt_size = 64;
+  pool_params.max_elts = kRxqSize;
+  pool_params.flags = RCSW_NONE;
+
+  struct swbus_params bus_params = {};
+  bus_params.pools = &pool_params;
+  bus_params.max_pools = 1;
+  bus_params.max_rxqs = TH_MAX_RXQS;
+  bus_params.max_subs = kMaxUnrelated + 1;
+  bus_params.max_threads = 1;
+  bus_params.flags = RCSW_NONE;
+
+  uint8_t pkt[64] = {0};
+  for (size_t n_unrelated = 0; n_unrelated <= kMaxUnrelated;
+       n_unrelated = (0 == n_unrelated) ? 16 : n_unrelated * 4) {
+    struct swbus* swbus = swbus_init(nullptr, &bus_params);
+    CATCH_REQUIRE(nullptr != swbus);
+    struct pcqueue* rxq = swbus_rxq_init(swbus, nullptr, kRxqSize);
+    CATCH_REQUIRE(nullptr != rxq);
+
+    /*
+     * One subscriber to the published PID, and lots of subscriptions to other
+     * PIDs on both sides of it, spread over the other RXQs.
+     */
+    CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, kMaxUnrelated / 2));
+    struct pcqueue* others[TH_MAX_RXQS - 1];
+    for (size_t i = 0; i < TH_MAX_RXQS - 1; ++i) {
+      others[i] = swbus_rxq_init(swbus, nullptr, kRxqSize);
+      CATCH_REQUIRE(nullptr != others[i]);
+    } /* for(i..) */
+    for (size_t i = 0; i < n_unrelated; ++i) {
+      uint32_t pid = (i < kMaxUnrelated / 2) ? i : i + 1;
+      CATCH_REQUIRE(OK == swbus_subscribe(swbus,
+                                          others[i % (TH_MAX_RXQS - 1)],
+                                          pid));
+    } /* for(i..) */
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kOps; ++i) {
+      CATCH_REQUIRE(OK == swbus_publish(swbus,
+                                        kMaxUnrelated / 2,
+                                        sizeof(pkt),
+                                        pkt));
+      struct swbus_rxq_ent* ent = swbus_rxq_front(rxq);
+      CATCH_REQUIRE(OK == swbus_rxq_pop_front(swbus, rxq, ent));
+    } /* for(i..) */
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << n_unrelated << " unrelated subscriptions: " << ns / kOps
+              << " ns/publish+pop" << std::endl;
+
+    swbus_destroy(swbus);
+  } /* for(n_unrelated..) */
+}
+
+CATCH_TEST_CASE("Multi-Publisher Throughput Benchmark", "[.][bench][swbus]") {
+  const size_t kOpsPerThread = 100000;
+  const size_t kRxqSize = 64;
+
+  std::vector<struct mpool_params> pools(1);
+  pools[0] = {};
+  pools[0].elt_size = 64;
+  pools[0].max_elts = kRxqSize * TH_MAX_THREADS;
+  pools[0].flags = RCSW_NONE;
+
+  struct swbus_params bus_params = {};
+  bus_params.pools = pools.data();
+  bus_params.max_pools = 1;
+  bus_params.max_rxqs = TH_MAX_THREADS;
+  bus_params.max_subs = TH_MAX_THREADS;
+  bus_params.max_threads = TH_MAX_THREADS;
+
+  uint32_t flags[] = {
+    RCSW_SWBUS_ASYNC,
+    RCSW_SWBUS_ASYNC | RCSW_SWBUS_LOCKFREE,
+  };
+  const char* names[] = {"mutex", "lock-free"};
+
+  for (size_t f = 0; f < RCSW_ARRAY_ELTS(flags); ++f) {
+    for (size_t n_threads = 1; n_threads <= 8; n_threads *= 2) {
+      bus_params.flags = flags[f];
+      struct swbus* swbus = swbus_init(nullptr, &bus_params);
+      CATCH_REQUIRE(nullptr != swbus);
+
+      /* each publisher has its own PID and RXQ, so they share nothing */
+      std::vector<struct pcqueue*> rxqs;
+      for (size_t i = 0; i < n_threads; ++i) {
+        rxqs.push_back(swbus_rxq_init(swbus, nullptr, kRxqSize));
+        CATCH_REQUIRE(nullptr != rxqs.back());
+        CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxqs.back(), i));
+      } /* for(i..) */
+
+      std::atomic_size_t n_errs(0);
+      auto pub_cb = [&](size_t id) {
+                      uint8_t pkt[64] = {0};
+                      for (size_t i = 0; i < kOpsPerThread; ++i) {
+                        if (OK != swbus_publish(swbus, id, sizeof(pkt), pkt)) {
+                          ++n_errs;
+                          continue;
+                        }
+                        struct swbus_rxq_ent* ent = swbus_rxq_front(rxqs[id]);
+                        if (OK != swbus_rxq_pop_front(swbus, rxqs[id], ent)) {
+                          ++n_errs;
+                        }
+                      } /* for(i..) */
+                    };
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < n_threads; ++i) {
+        threads.emplace_back(pub_cb, i);
+      } /* for(i..) */
+      for (auto& t : threads) {
+        t.join();
+      } /* for(t..) */
+      auto end = std::chrono::steady_clock::now();
+      CATCH_REQUIRE(0 == n_errs);
+
+      double sec = std::chrono::duration<double>(end - start).count();
+      std::cout << names[f] << ", " << n_threads << " publishers: "
+                << n_threads * kOpsPerThread / sec / 1e6 << " Mpublish/s"
+                << std::endl;
+      swbus_destroy(swbus);
+    } /* for(n_threads..) */
+  } /* for(f..) */
+}
+
+CATCH_TEST_CASE("Batch Benchmark", "[.][bench][swbus]") {
+  const size_t kPkts = 1 << 18;
+  const size_t kMaxBatch = 256;
+
+  struct mpool_params pool_params = {};
+  pool_params.elt_size = 32;
+  pool_params.max_elts = kMaxBatch;
+  pool_params.flags = RCSW_NONE;
+
+  struct swbus_params bus_params = {};
+  bus_params.pools = &pool_params;
+  bus_params.max_pools = 1;
+  bus_params.max_rxqs = 1;
+  bus_params.max_subs = 1;
+  bus_params.max_threads = 1;
+  bus_params.flags = RCSW_NONE;
+
+  struct swbus* swbus = swbus_init(nullptr, &bus_params);
+  CATCH_REQUIRE(nullptr != swbus);
+  struct pcqueue* rxq = swbus_rxq_init(swbus, nullptr, kMaxBatch);
+  CATCH_REQUIRE(nullptr != rxq);
+  CATCH_REQUIRE(OK == swbus_subscribe(swbus, rxq, 0));
+
+  uint8_t pkt[32] = {0};
+  std::vector<uint32_t> pids(kMaxBatch, 0);
+  std::vector<size_t> sizes(kMaxBatch, sizeof(pkt));
+  std::vector<const void*> pkts(kMaxBatch, pkt);
+  std::vector<struct swbus_rxq_ent> ents(kMaxBatch);
+
+  /* one at a time, with the non-batch API */
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kPkts; ++i) {
+    CATCH_REQUIRE(OK == swbus_publish(swbus, 0, sizeof(pkt), pkt));
+    struct swbus_rxq_ent* ent = swbus_rxq_wait(swbus, rxq);
+    CATCH_REQUIRE(OK == swbus_rxq_pop_front(swbus, rxq, ent));
+  } /* for(i..) */
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  std::cout << "unbatched: " << ns / kPkts << " ns/packet" << std::endl;
+
+  for (size_t batch = 1; batch <= kMaxBatch; batch *= 4) {
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kPkts; i += batch) {
+      CATCH_REQUIRE(OK == swbus_publish_batch(swbus,
+                                              pids.data(),
+                                              sizes.data(),
+                                              pkts.data(),
+                                              batch));
+      size_t n_received = 0;
+      while (n_received < batch) {
+        size_t got = 0;
+        CATCH_REQUIRE(OK == swbus_rxq_wait_n(swbus,
+                                             rxq,
+                                             ents.data(),
+                                             batch,
+                                             &got));
+        CATCH_REQUIRE(OK == swbus_rxq_release_n(ents.data(), got));
+        n_received += got;
+      } /* while() */
+    } /* for(i..) */
+    end = std::chrono::steady_clock::now();
+    ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << "batch=" << batch << ": " << ns / kPkts << " ns/packet"
+              << std::endl;
+  } /* for(batch..) */
+
+  swbus_destroy(swbus);
+}